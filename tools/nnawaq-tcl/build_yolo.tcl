@@ -90,7 +90,8 @@ create_nn_conv_neu win=3 step=1 pad=1 neu=512 nwin=13x13
 # Convolution layer 14
 create_nn_conv_neu win=1 step=1 pad=0 neu=425 nwin=13x13
 
-# IGNORED region layer 15
+# Region layer 15 : decoded on the host after software or hardware execution, values are scaled by 2^16
+nn_region -boxes 5 -classes 80 -shift 16 -img 416
 
 # ---------------------------------------------------
 # Post-processing: parallelism, nn_print, etc.
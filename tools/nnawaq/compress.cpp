@@ -26,9 +26,11 @@ void compress_2t3b_test_neuron(layer_t* layer) {
 		return;
 	}
 
-	int **cfg_data = layer->cfg_data;
 	unsigned fsize = layer->fsize;
 	unsigned nbneu = layer->neurons;
+	// Weights may be modified, they must not be shared with other networks
+	layer->cfg_data_unshare(nbneu, fsize);
+	int **cfg_data = layer->cfg_data;
 
 	// Test: for each addr in frame, there must be no more than half weights at -1
 
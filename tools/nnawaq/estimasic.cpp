@@ -14,6 +14,8 @@ extern "C" {
 
 }
 
+#include <algorithm>
+
 #include "nn_layers_utils.h"
 #include "estimasic.h"
 
@@ -185,7 +187,7 @@ void select_techno_st_ll_06() {
 
 // Some macro-parameters
 double logic_freq   = 500e6;
-double toggle_rate  = 0.5;
+double toggle_rate_default = 0.5;  // Used for layers with no measured activity
 
 // Select fifo as SRAM+counters or shift register
 unsigned fifo_depth = 8;
@@ -204,6 +206,19 @@ double estimasic_total_ener(asic_estim_t* estim) {
 	return estim->sram_ener + estim->gate_ener + estim->tcamneu_ener;
 }
 
+// Ratio of bits that toggle, measured on the input data of the layer or taken from the default
+// FIFOs are not executed in software, they see the input data of the next layer
+static layer_t* estimasic_toggle_layer(layer_t* layer) {
+	if(layer->stat_toggle >= 0) return layer;
+	if(layer->type == LAYER_FIFO && layer->next != nullptr && layer->next->stat_toggle >= 0) return layer->next;
+	return nullptr;
+}
+static double estimasic_toggle_rate(layer_t* layer) {
+	layer_t* layer_stat = estimasic_toggle_layer(layer);
+	if(layer_stat != nullptr) return layer_stat->stat_toggle;
+	return toggle_rate_default;
+}
+
 asic_estim_t* estimasic_getdata(layer_t* layer) {
 	asic_estim_t* estim = (asic_estim_t*)layer->ptrdata;
 	if(estim==NULL) {
@@ -297,6 +312,28 @@ void print_table_layers(vector<layer_t*>& layers, asic_estim_t* hwestim_types) {
 	print_estim("Total", hwestim_types + 0, flags);
 	print_hline(14, 14, nbcol);
 }
+// Print the layers that consume the most energy
+static void print_top_layers(vector<layer_t*>& layers, double total_ener, unsigned top_nb) {
+	if(total_ener <= 0) return;
+
+	vector<layer_t*> sorted_layers = layers;
+	stable_sort(sorted_layers.begin(), sorted_layers.end(), [](layer_t* a, layer_t* b) {
+		return estimasic_total_ener(estimasic_getdata(a)) > estimasic_total_ener(estimasic_getdata(b));
+	});
+	if(sorted_layers.size() > top_nb) sorted_layers.resize(top_nb);
+
+	printf("Top energy-consuming layers :\n");
+	for(auto layer : sorted_layers) {
+		double ener = estimasic_total_ener(estimasic_getdata(layer));
+		char buf[100];
+		sprintf(buf, "%s%u", layer->typenamel, layer->typeidx);
+		printf("  %-8s %12.3f pJ/frame  %5.1f%%  toggle %3.0f%%%s\n",
+			buf, ener * 1e12, 100 * ener / total_ener, 100 * estimasic_toggle_rate(layer),
+			(estimasic_toggle_layer(layer) != nullptr) ? "" : " (default)"
+		);
+	}
+}
+
 void print_table(asic_estim_t* hwestim_types) {
 	// Auto-detect if print of TCAM is needed
 	int flags = 0;
@@ -365,6 +402,7 @@ void print_total_stats(double latency, double frames_per_sec, double ener_per_fr
 // Digital estimations
 
 void estimasic_digital_layer_win(layer_t* layer, asic_estim_t* estim) {
+	double toggle_rate = estimasic_toggle_rate(layer);
 	if(asic_verbose > 0) {
 		printf("  win %ux%u step %u %u pad %u %u nwin %u %u %u\n",
 			layer->winx, layer->winy,
@@ -405,6 +443,7 @@ void estimasic_digital_layer_win(layer_t* layer, asic_estim_t* estim) {
 }
 
 void estimasic_digital_layer_neu(layer_t* layer, asic_estim_t* estim) {
+	double toggle_rate = estimasic_toggle_rate(layer);
 	unsigned fsize_split = (layer->fsize + layer->split_in - 1) / layer->split_in;
 	unsigned nbneu_split = (layer->neurons + layer->split_out - 1) / layer->split_out;
 	unsigned cycles      = fsize_split * layer->nbframes;
@@ -522,6 +561,7 @@ void estimasic_digital_layer_neu(layer_t* layer, asic_estim_t* estim) {
 }
 
 void estimasic_digital_layer_pool(layer_t* layer, asic_estim_t* estim) {
+	double toggle_rate = estimasic_toggle_rate(layer);
 	if(asic_verbose > 0) {
 		printf("  win %ux%u step %u %u pad %u %u nwin %u %u %u\n",
 			layer->winx, layer->winy,
@@ -541,6 +581,7 @@ void estimasic_digital_layer_pool(layer_t* layer, asic_estim_t* estim) {
 }
 
 void estimasic_digital_layer_ter(layer_t* layer, asic_estim_t* estim) {
+	double toggle_rate = estimasic_toggle_rate(layer);
 	if(asic_verbose > 0) {
 		printf("  wdata %u->%u\n", layer->wdata, layer->out_wdata);
 	}
@@ -579,6 +620,7 @@ void estimasic_digital_layer_ter(layer_t* layer, asic_estim_t* estim) {
 }
 
 void estimasic_digital_layer_fifo(layer_t* layer, asic_estim_t* estim) {
+	double toggle_rate = estimasic_toggle_rate(layer);
 
 	if(fifo_is_shift==true) {
 		// The shift registers
@@ -746,11 +788,13 @@ void estimasic_digital(Network* network) {
 	print_table(hwestim_types);
 
 	print_total_stats(latency, fps, total_ener, total_macs, total_area);
+	print_top_layers(layers, total_ener, 5);
 }
 
 // Analog estimations
 
 void estimasic_analog_layer_win(layer_t* layer, asic_estim_t* estim) {
+	double toggle_rate = estimasic_toggle_rate(layer);
 	// The memory is ping-pong, 2 cuts of winy planes XZ of frame data
 	// Data width = Fz * data width
 	// Lines = winy * fx
@@ -789,6 +833,7 @@ void estimasic_analog_layer_win(layer_t* layer, asic_estim_t* estim) {
 }
 
 void estimasic_analog_layer_neu(layer_t* layer, asic_estim_t* estim) {
+	double toggle_rate = estimasic_toggle_rate(layer);
 
 	// Remove the sign, there is no weight for that
 	unsigned inwidth = layer->wdata * layer->fsize;
@@ -954,6 +999,7 @@ void estimasic_analog_layer_neu(layer_t* layer, asic_estim_t* estim) {
 }
 
 void estimasic_analog_layer_pool(layer_t* layer, asic_estim_t* estim) {
+	double toggle_rate = estimasic_toggle_rate(layer);
 	unsigned acc_nb = layer->fz;
 	unsigned cycles = layer->fsize * layer->out_fx * layer->out_fx;
 
@@ -973,6 +1019,7 @@ void estimasic_analog_layer_pool(layer_t* layer, asic_estim_t* estim) {
 }
 
 void estimasic_analog_layer_ter(layer_t* layer, asic_estim_t* estim) {
+	double toggle_rate = estimasic_toggle_rate(layer);
 	unsigned par    = layer->fsize;
 	unsigned cycles = layer->nbframes;
 
@@ -1111,6 +1158,7 @@ void estimasic_analog(Network* network) {
 	print_table(hwestim_types);
 
 	print_total_stats(total_time, fps, total_ener, total_macs, total_area);
+	print_top_layers(layers, total_ener, 5);
 }
 
 // Mixed digital-analog estimations
@@ -1242,5 +1290,6 @@ void estimasic_mixed(Network* network) {
 	print_table(hwestim_types);
 
 	print_total_stats(total_time, fps, total_ener, total_macs, total_area);
+	print_top_layers(layers, total_ener, 5);
 }
 
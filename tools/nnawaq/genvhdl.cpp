@@ -10,6 +10,9 @@ extern "C" {
 #include <inttypes.h>
 #include <ctype.h>
 #include <assert.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
 
 #include "nnawaq_utils.h"
 
@@ -29,6 +32,13 @@ char const * vhdl_gen_prefix = NULL;
 // Directory where to generate config dump files
 char* genvhdl_dump_dir = NULL;
 
+// Manifest file to record the hashes of generated files and sections, and what changed
+char* genvhdl_manifest = NULL;
+
+// Generation of constant parameters : number of threads (zero means the number of processors), and use of init files
+unsigned genvhdl_threads = 0;
+bool genvhdl_cst_memfile = false;
+
 
 
 // Utility counters and functions to print warnings
@@ -711,8 +721,7 @@ void LayerSoftMax::genvhdl_cst_decl(FILE* Fo) {
 }
 void LayerFifo::genvhdl_cst_decl(FILE* Fo) {
 	fprintf(Fo, "	constant %s_DATAW : natural := %u;\n", vhdl_prefixu, wdata * split_in);
-	// FIXME Need to compute a more accurate depth, lower of larger according to needs
-	fprintf(Fo, "	constant %s_DEPTH : natural := 64;\n", vhdl_prefixu);
+	fprintf(Fo, "	constant %s_DEPTH : natural := %u;\n", vhdl_prefixu, fifo_depth);
 	fprintf(Fo, "	constant %s_CNTW  : natural := 16;\n", vhdl_prefixu);
 	if(this == network->layer_first) {
 		fprintf(Fo, "	-- To ease talking to the first FIFO\n");
@@ -4018,6 +4027,8 @@ class TemplateFileFiller {
 
 		char const * line_begin = nullptr;
 		char const * line_end   = nullptr;
+		// Name of the generated section in the manifest
+		char const * unit_name  = nullptr;
 
 		virtual ~FillerWorker(void);
 		virtual void fill(TemplateFileFiller& filler);
@@ -4036,7 +4047,7 @@ class TemplateFileFiller {
 	FILE* Fi = nullptr;
 	// Temp file to hold the input template file
 	FILE* Ft = nullptr;
-	// Output file
+	// The output is generated in memory, the output file is only written if its contents changes
 	FILE* Fo = nullptr;
 
 	private :
@@ -4049,6 +4060,20 @@ class TemplateFileFiller {
 	size_t linebuf_size = 0;
 	char*  linebuf = nullptr;
 
+	// The buffer of the output stream
+	size_t outbuf_size = 0;
+	char*  outbuf = nullptr;
+
+	// The generated units : sections, and optional sub-units inside sections
+	typedef struct unit_t {
+		string name;
+		long   begin = 0;
+		long   end = -1;
+	} unit_t;
+	vector<unit_t> units;
+	int unit_section = -1;
+	int unit_sub = -1;
+
 	public :
 
 	// Constructor / Destructor
@@ -4058,6 +4083,10 @@ class TemplateFileFiller {
 	void open(void);
 	void register_worker(FillerWorker* worker);
 	void process(void);
+	int  commit(void);
+
+	// To be called by workers to begin a sub-unit inside the current section
+	void unit_begin(const char* name);
 
 };
 
@@ -4071,6 +4100,7 @@ TemplateFileFiller::~TemplateFileFiller(void) {
 	patterns.clear();
 
 	if(linebuf != nullptr) free(linebuf);
+	if(outbuf != nullptr) free(outbuf);
 
 }
 
@@ -4101,12 +4131,8 @@ void TemplateFileFiller::open(void) {
 	fclose(Fi);
 	Fi = nullptr;
 
-	// Open the output file for writing
-	Fo = fopen(filename_out, "wb");
-	if(Fo==NULL) {
-		printf("Error: Can't open file '%s' for writing\n", filename_out);
-		exit(EXIT_FAILURE);
-	}
+	// The output is generated in memory
+	Fo = open_memstream(&outbuf, &outbuf_size);
 
 }
 
@@ -4149,10 +4175,23 @@ void TemplateFileFiller::process(void) {
 
 			// Write the marker line
 			fprintf(Fo, "%s", linebuf);
+
+			unit_t unit;
+			unit.name  = (worker->unit_name != nullptr) ? worker->unit_name : worker->line_begin;
+			unit.begin = ftell(Fo);
+			units.push_back(unit);
+			unit_section = units.size() - 1;
+			unit_sub = -1;
+
 			if(want_clear==false) {
 				worker->fill(*this);
 			}
 
+			if(unit_sub >= 0) units[unit_sub].end = ftell(Fo);
+			units[unit_section].end = ftell(Fo);
+			unit_section = -1;
+			unit_sub = -1;
+
 			// Find the corresponding end token, drop the temp file contents
 			vhdl_gen_endline(Ft, &linebuf, &linebuf_size, worker->line_end);
 			// Write the end line
@@ -4171,6 +4210,123 @@ void TemplateFileFiller::process(void) {
 
 }
 
+void TemplateFileFiller::unit_begin(const char* name) {
+	if(unit_section < 0) return;
+	long pos = ftell(Fo);
+	if(unit_sub >= 0) units[unit_sub].end = pos;
+	unit_t unit;
+	unit.name  = units[unit_section].name + "/" + name;
+	unit.begin = pos;
+	units.push_back(unit);
+	unit_sub = units.size() - 1;
+}
+
+// FNV-1a hash, 64 bits
+static uint64_t genvhdl_hash(const char* buf, size_t size) {
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for(size_t i=0; i<size; i++) {
+		h ^= (unsigned char)buf[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+static int genvhdl_read_file(const char* filename, string& content) {
+	FILE* F = fopen(filename, "rb");
+	if(F == NULL) return -1;
+	char buf[65536];
+	do {
+		size_t r = fread(buf, 1, sizeof(buf), F);
+		if(r == 0) break;
+		content.append(buf, r);
+	} while(1);
+	fclose(F);
+	return 0;
+}
+
+// Write a file only if its contents changed, so its timestamp is kept otherwise
+// Return non-zero if the file was written
+static int genvhdl_write_if_changed(const char* filename, const char* buf, size_t size) {
+	// The previous contents are only read if the size is the same
+	struct stat st;
+	if(stat(filename, &st) == 0 && (size_t)st.st_size == size) {
+		string content_old;
+		int z = genvhdl_read_file(filename, content_old);
+		if(z == 0 && content_old.size() == size && memcmp(content_old.data(), buf, size) == 0) {
+			printf("Note: File '%s' is unchanged, it is not rewritten\n", filename);
+			return 0;
+		}
+	}
+	FILE* F = fopen(filename, "wb");
+	if(F==NULL) {
+		printf("Error: Can't open file '%s' for writing\n", filename);
+		exit(EXIT_FAILURE);
+	}
+	fwrite(buf, 1, size, F);
+	fclose(F);
+	return 1;
+}
+
+// Write the output file only if its contents changed
+// Then update the manifest, if enabled
+int TemplateFileFiller::commit(void) {
+
+	// Get the generated contents
+	fclose(Fo);
+	Fo = nullptr;
+
+	bool file_changed = (genvhdl_write_if_changed(filename_out, outbuf, outbuf_size) != 0);
+
+	if(genvhdl_manifest == nullptr) return 0;
+
+	// Read the previous manifest, one line per unit : file, unit, hash, status
+	// Lines about other files are kept as-is
+	vector<string> lines_kept;
+	map<string, string> hashes_old;
+	string manifest;
+	genvhdl_read_file(genvhdl_manifest, manifest);
+	size_t pos = 0;
+	while(pos < manifest.size()) {
+		size_t eol = manifest.find('\n', pos);
+		if(eol == string::npos) eol = manifest.size();
+		string line = manifest.substr(pos, eol - pos);
+		pos = eol + 1;
+		char name_file[1024], name_unit[1024], hash[32];
+		if(line.empty() == true || line[0] == '#') continue;
+		if(sscanf(line.c_str(), "%1023s %1023s %31s", name_file, name_unit, hash) != 3) continue;
+		if(strcmp(name_file, filename_out) == 0) hashes_old[name_unit] = hash;
+		else lines_kept.push_back(line);
+	}
+
+	FILE* F = fopen(genvhdl_manifest, "wb");
+	if(F==NULL) {
+		printf("Error: Can't open file '%s' for writing\n", genvhdl_manifest);
+		return -1;
+	}
+	fprintf(F, "# Generated VHDL : file, unit, hash, status\n");
+	for(auto& line : lines_kept) fprintf(F, "%s\n", line.c_str());
+
+	auto print_unit = [&](const string& name, const char* buf, size_t size, bool changed) {
+		char hash[32];
+		sprintf(hash, "%016" PRIx64, genvhdl_hash(buf, size));
+		auto iter = hashes_old.find(name);
+		const char* status = "changed";
+		if(iter == hashes_old.end()) status = "new";
+		else if(iter->second == hash && changed == false) status = "unchanged";
+		fprintf(F, "%s %s %s %s\n", filename_out, name.c_str(), hash, status);
+	};
+
+	print_unit("*", outbuf, outbuf_size, file_changed);
+	for(auto& unit : units) {
+		if(unit.end < unit.begin) continue;
+		print_unit(unit.name, outbuf + unit.begin, unit.end - unit.begin, false);
+	}
+
+	fclose(F);
+
+	return 0;
+}
+
 // Default virtual worker methods
 
 TemplateFileFiller::FillerWorker::~FillerWorker(void) {
@@ -4198,6 +4354,7 @@ class FillerWorker_NNGen_Config : public TemplateFileFiller::FillerWorker {
 	FillerWorker_NNGen_Config(Network* n) {
 		line_begin = "-- AUTOGEN CONFIG NB BEGIN";
 		line_end   = "-- AUTOGEN CONFIG NB END";
+		unit_name  = "config";
 		network = n;
 	}
 
@@ -4290,6 +4447,7 @@ class FillerWorker_NNGen_CstDecl : public TemplateFileFiller::FillerWorker {
 	FillerWorker_NNGen_CstDecl(Network* n) {
 		line_begin = "-- AUTOGEN CST DECL BEGIN";
 		line_end   = "-- AUTOGEN CST DECL END";
+		unit_name  = "cst_decl";
 		network = n;
 	}
 
@@ -4311,6 +4469,7 @@ class FillerWorker_NNGen_CstWeightsVec : public TemplateFileFiller::FillerWorker
 	FillerWorker_NNGen_CstWeightsVec(Network* n) {
 		line_begin = "-- AUTOGEN CONST WEIGHTS VEC BEGIN";
 		line_end   = "-- AUTOGEN CONST WEIGHTS VEC END";
+		unit_name  = "cst_weights_vec";
 		network = n;
 	}
 
@@ -4347,6 +4506,7 @@ class FillerWorker_NNGen_CompDecl : public TemplateFileFiller::FillerWorker {
 	FillerWorker_NNGen_CompDecl(Network* n) {
 		line_begin = "-- AUTOGEN COMP DECL BEGIN";
 		line_end   = "-- AUTOGEN COMP DECL END";
+		unit_name  = "comp_decl";
 		network = n;
 	}
 
@@ -4368,6 +4528,7 @@ class FillerWorker_NNGen_SigDecl : public TemplateFileFiller::FillerWorker {
 	FillerWorker_NNGen_SigDecl(Network* n) {
 		line_begin = "-- AUTOGEN SIG DECL BEGIN";
 		line_end   = "-- AUTOGEN SIG DECL END";
+		unit_name  = "sig_decl";
 		network = n;
 	}
 
@@ -4389,6 +4550,7 @@ class FillerWorker_NNGen_RegsSetConst : public TemplateFileFiller::FillerWorker
 	FillerWorker_NNGen_RegsSetConst(Network* n) {
 		line_begin = "-- AUTOGEN REGS SETCONST BEGIN";
 		line_end   = "-- AUTOGEN REGS SETCONST END";
+		unit_name  = "regs_setconst";
 		network = n;
 	}
 
@@ -4410,6 +4572,7 @@ class FillerWorker_NNGen_RegsSetConstLocked : public TemplateFileFiller::FillerW
 	FillerWorker_NNGen_RegsSetConstLocked(Network* n) {
 		line_begin = "-- AUTOGEN REGS SETCONST LOCKED BEGIN";
 		line_end   = "-- AUTOGEN REGS SETCONST LOCKED END";
+		unit_name  = "regs_setconst_locked";
 		network = n;
 	}
 
@@ -4431,6 +4594,7 @@ class FillerWorker_NNGen_CompInst : public TemplateFileFiller::FillerWorker {
 	FillerWorker_NNGen_CompInst(Network* n) {
 		line_begin = "-- AUTOGEN COMP INST BEGIN";
 		line_end   = "-- AUTOGEN COMP INST END";
+		unit_name  = "comp_inst";
 		network = n;
 	}
 
@@ -4505,7 +4669,10 @@ int vhdl_gen(Network* network, const char* filename_in, const char* filename_out
 	// Scan the input file and insert the VHDL
 	filler.process();
 
-	return 0;
+	// Write the output file if it changed
+	int z = filler.commit();
+
+	return z;
 }
 
 //============================================
@@ -4518,14 +4685,30 @@ int vhdl_gen(Network* network, const char* filename_in, const char* filename_out
 // Assume : indent string is non-empty
 
 // This memory generation methods :
+// Only the memory lines in range [line_beg, line_end[ are generated, the output of consecutive ranges is concatenated
 // Assume : layer has const weights indeed
 // Assume : indent string is non-empty
 
+// Tables of constants can be huge, so values are hand-formatted instead of using fprintf() per bit
+
+// Write a binary literal between double quotes, MSB first
+// Assume : bits <= 32
+static inline void genvhdl_fput_bin(FILE* Fo, unsigned val, unsigned bits) {
+	char buf[32+2];
+	unsigned len = 0;
+	buf[len++] = '"';
+	for(unsigned i=0; i<bits; i++) {
+		buf[len++] = ((val >> (bits-1-i)) & 1) != 0 ? '1' : '0';
+	}
+	buf[len++] = '"';
+	fwrite(buf, 1, len, Fo);
+}
+
 void Layer::genvhdl_const_params_vec(FILE* Fo, const char* indent) {
 	printf("INTERNAL ERROR %s : Missing implementation for method genvhdl_const_params_vec()\n", vhdl_prefixu);
 }
 
-void Layer::genvhdl_const_params_mem(FILE* Fo, const char* indent) {
+void Layer::genvhdl_const_params_mem(FILE* Fo, const char* indent, unsigned line_beg, unsigned line_end) {
 	printf("INTERNAL ERROR %s : Missing implementation for method genvhdl_const_params_mem()\n", vhdl_prefixu);
 }
 
@@ -4533,7 +4716,6 @@ void LayerNeu::genvhdl_const_params_vec(FILE* Fo, const char* indent) {
 	layer_t* layer = this;
 
 	bool bin_sym = (layer->neu_wweight == 1) && ((layer->neu_sgnw & NEUSGN_SIGNED) != 0);
-	int msb_mask = 1 << (layer->neu_wweight - 1);
 
 	unsigned cat_num = 0;
 	unsigned neu_per_po = layer->neurons / layer->split_out;
@@ -4544,108 +4726,104 @@ void LayerNeu::genvhdl_const_params_vec(FILE* Fo, const char* indent) {
 			int* cfg_data_neu = layer->cfg_data[n];
 
 			for(int f = layer->fsize-1; f >= 0; f--) {
-				if(cat_num > 0) fprintf(Fo, " &\n");
+				if(cat_num > 0) fputs(" &\n", Fo);
 				if(f == (int)layer->fsize-1) fprintf(Fo, "%s-- Neuron %u\n", indent, n);
-				fprintf(Fo, "%s\"", indent);
-				// scan bits one by one starting from MSB
+				fputs(indent, Fo);
 				int val = cfg_data_neu[f];
 				if(bin_sym == true) val = (val == -1);  // Stored 0 means +1, stored 1 means -1
-				for(unsigned i=0; i<layer->neu_wweight; i++) {
-					fprintf(Fo, "%c", ((val & msb_mask) != 0) ? '1' : '0');
-					val <<= 1;
-				}
-				fprintf(Fo, "\"");
+				genvhdl_fput_bin(Fo, val, layer->neu_wweight);
 				cat_num ++;
 			}
 
 		}  // neurons
 	}  // PAR_OUT
 
-	if(cat_num > 0) fprintf(Fo, "\n");
+	if(cat_num > 0) fputs("\n", Fo);
 }
 
-void LayerNeu::genvhdl_const_params_mem(FILE* Fo, const char* indent) {
+void LayerNeu::genvhdl_const_params_mem(FILE* Fo, const char* indent, unsigned line_beg, unsigned line_end) {
 	layer_t* layer = this;
 
 	bool bin_sym = (layer->neu_wweight == 1) && ((layer->neu_sgnw & NEUSGN_SIGNED) != 0);
-	int msb_mask = 1 << (layer->neu_wweight - 1);
 
 	unsigned cat_num = 0;
 	unsigned neu_phy = (layer->neurons + layer->neu_time_mux - 1) / layer->neu_time_mux;
 
-	for(unsigned t=0; t<layer->neu_time_mux; t++) {
-		if(cat_num > 0) { fprintf(Fo, ",\n"); cat_num = 0; }
-		if(layer->neu_time_mux > 1) {
+	// Memory lines : all frame positions for each time multiplexing step
+	unsigned lines_per_tmux = (layer->fsize + layer->split_in - 1) / layer->split_in;
+	unsigned lines_nb = lines_per_tmux * layer->neu_time_mux;
+	if(line_end > lines_nb) line_end = lines_nb;
+
+	for(unsigned line = line_beg; line < line_end; line++) {
+		unsigned t  = line / lines_per_tmux;
+		unsigned fi = (line % lines_per_tmux) * layer->split_in;
+
+		// Separation from the previous line, that may have been generated in another range
+		if(line > 0) { fputs(",\n", Fo); cat_num = 0; }
+
+		if(fi == 0 && layer->neu_time_mux > 1) {
 			fprintf(Fo, "%s-- Time multiplexing : ", indent);
 			if(neu_phy > 1) fprintf(Fo, "neurons %u to %u\n", t*neu_phy, (t+1)*neu_phy-1);
 			else fprintf(Fo, "neuron %u\n", t);
 		}
 
-		for(unsigned fi=0; fi < layer->fsize; fi += layer->split_in) {
-			if(cat_num > 0) { fprintf(Fo, ",\n"); cat_num = 0; }
-			if(layer->fsize / layer->split_in > 1 && neu_phy * layer->split_in > 1) {
-				fprintf(Fo, "%s-- Frame position %u\n", indent, fi);
-			}
+		if(layer->fsize / layer->split_in > 1 && neu_phy * layer->split_in > 1) {
+			fprintf(Fo, "%s-- Frame position %u\n", indent, fi);
+		}
 
-			// The memory of weights feeds all physical neurons
-			// Order of neurons depends on PAR_OUT : first all neurons 0 mod PAR_OUT, then 1 mod PAR_OUT, etc
+		// The memory of weights feeds all physical neurons
+		// Order of neurons depends on PAR_OUT : first all neurons 0 mod PAR_OUT, then 1 mod PAR_OUT, etc
 
-			// Here, generate NEU_PHY * PAR_IN concatenated values
+		// Here, generate NEU_PHY * PAR_IN concatenated values
 
-			unsigned neu_per_po = neu_phy / layer->split_out;
+		unsigned neu_per_po = neu_phy / layer->split_out;
 
-			for(int po = layer->split_out-1; po >= 0; po--) {
-				for(int no = neu_per_po-1; no >= 0; no--) {
+		for(int po = layer->split_out-1; po >= 0; po--) {
+			for(int no = neu_per_po-1; no >= 0; no--) {
 
-					unsigned n = t * neu_phy + no * layer->split_out + po;
-					int* cfg_data_neu = layer->cfg_data[n];
+				unsigned n = t * neu_phy + no * layer->split_out + po;
+				int* cfg_data_neu = layer->cfg_data[n];
 
-					for(int pi = layer->split_in-1; pi >= 0; pi--) {
-						unsigned f = fi + pi;
+				for(int pi = layer->split_in-1; pi >= 0; pi--) {
+					unsigned f = fi + pi;
 
-						// Print necessary VHDL keywords and newline
-						if(cat_num > 0) fprintf(Fo, " &\n");
+					// Print necessary VHDL keywords and newline
+					if(cat_num > 0) fputs(" &\n", Fo);
 
-						// Only after newline we can print comments
-						if(pi == (int)layer->split_in-1) {
-							if(layer->split_out > 1 && no == (int)neu_per_po-1) {
-								fprintf(Fo, "%s-- Neurons %u mod PAR_OUT=%u\n", indent, po, layer->split_out);
-							}
-							if(layer->split_in > 1) {
-								fprintf(Fo, "%s-- Neuron %u\n", indent, n);
-							}
+					// Only after newline we can print comments
+					if(pi == (int)layer->split_in-1) {
+						if(layer->split_out > 1 && no == (int)neu_per_po-1) {
+							fprintf(Fo, "%s-- Neurons %u mod PAR_OUT=%u\n", indent, po, layer->split_out);
 						}
-
-						// Print the number
-						fprintf(Fo, "			\"");
-						int val = cfg_data_neu[f];
-						if(bin_sym == true) val = (val == -1);  // Stored 0 means +1, stored 1 means -1
-						for(unsigned i=0; i<layer->neu_wweight; i++) {
-							fprintf(Fo, "%c", ((val & msb_mask) != 0) ? '1' : '0');
-							val <<= 1;
+						if(layer->split_in > 1) {
+							fprintf(Fo, "%s-- Neuron %u\n", indent, n);
 						}
-						fprintf(Fo, "\"");
+					}
+
+					// Print the number
+					fputs("			", Fo);
+					int val = cfg_data_neu[f];
+					if(bin_sym == true) val = (val == -1);  // Stored 0 means +1, stored 1 means -1
+					genvhdl_fput_bin(Fo, val, layer->neu_wweight);
 
-						// Increment the number of concatenated values up to now
-						cat_num++;
+					// Increment the number of concatenated values up to now
+					cat_num++;
 
-					}  // par_in
-				}  // neuron
-			}  // par_out
+				}  // par_in
+			}  // neuron
+		}  // par_out
 
-			// Note : End of a line in memory
+		// Note : End of a line in memory
 
-		}  // fsize
-	}  // tmux
+	}  // lines
 
-	if(cat_num > 0) fprintf(Fo, "\n");
+	if(cat_num > 0 && line_end == lines_nb) fputs("\n", Fo);
 }
 
 void LayerNeu_CM::genvhdl_const_params_vec(FILE* Fo, const char* indent) {
 	layer_t* layer = this;
 
 	bool bin_sym = (layer->neu_wweight == 1) && ((layer->neu_sgnw & NEUSGN_SIGNED) != 0);
-	int msb_mask = 1 << (layer->neu_wweight - 1);
 
 	unsigned cat_num = 0;
 	unsigned neu_per_po = layer->neurons / layer->split_out;
@@ -4656,101 +4834,98 @@ void LayerNeu_CM::genvhdl_const_params_vec(FILE* Fo, const char* indent) {
 			int* cfg_data_neu = layer->cfg_data[n];
 
 			for(int f = layer->fsize-1; f >= 0; f--) {
-				if(cat_num > 0) fprintf(Fo, " &\n");
+				if(cat_num > 0) fputs(" &\n", Fo);
 				if(f == (int)layer->fsize-1) fprintf(Fo, "%s-- Neuron %u\n", indent, n);
-				fprintf(Fo, "%s\"", indent);
-				// scan bits one by one starting from MSB
+				fputs(indent, Fo);
 				int val = cfg_data_neu[f];
 				if(bin_sym == true) val = (val == -1);  // Stored 0 means +1, stored 1 means -1
-				for(unsigned i=0; i<layer->neu_wweight; i++) {
-					fprintf(Fo, "%c", ((val & msb_mask) != 0) ? '1' : '0');
-					val <<= 1;
-				}
-				fprintf(Fo, "\"");
+				genvhdl_fput_bin(Fo, val, layer->neu_wweight);
 				cat_num ++;
 			}
 
 		}  // neurons
 	}  // PAR_OUT
 
-	if(cat_num > 0) fprintf(Fo, "\n");
+	if(cat_num > 0) fputs("\n", Fo);
 }
 
-void LayerNeu_CM::genvhdl_const_params_mem(FILE* Fo, const char* indent) {
+void LayerNeu_CM::genvhdl_const_params_mem(FILE* Fo, const char* indent, unsigned line_beg, unsigned line_end) {
 	layer_t* layer = this;
 
 	bool bin_sym = (layer->neu_wweight == 1) && ((layer->neu_sgnw & NEUSGN_SIGNED) != 0);
-	int msb_mask = 1 << (layer->neu_wweight - 1);
 
 	unsigned cat_num = 0;
 	unsigned neu_phy = (layer->neurons + layer->neu_time_mux - 1) / layer->neu_time_mux;
 
-	for(unsigned t=0; t<layer->neu_time_mux; t++) {
-		if(cat_num > 0) { fprintf(Fo, ",\n"); cat_num = 0; }
-		if(layer->neu_time_mux > 1) {
+	// Memory lines : all frame positions for each time multiplexing step
+	unsigned lines_per_tmux = (layer->fsize + layer->split_in - 1) / layer->split_in;
+	unsigned lines_nb = lines_per_tmux * layer->neu_time_mux;
+	if(line_end > lines_nb) line_end = lines_nb;
+
+	for(unsigned line = line_beg; line < line_end; line++) {
+		unsigned t  = line / lines_per_tmux;
+		unsigned fi = (line % lines_per_tmux) * layer->split_in;
+
+		// Separation from the previous line, that may have been generated in another range
+		if(line > 0) { fputs(",\n", Fo); cat_num = 0; }
+
+		if(fi == 0 && layer->neu_time_mux > 1) {
 			fprintf(Fo, "%s-- Time multiplexing : ", indent);
 			if(neu_phy > 1) fprintf(Fo, "neurons %u to %u\n", t*neu_phy, (t+1)*neu_phy-1);
 			else fprintf(Fo, "neuron %u\n", t);
 		}
 
-		for(unsigned fi=0; fi < layer->fsize; fi += layer->split_in) {
-			if(cat_num > 0) { fprintf(Fo, ",\n"); cat_num = 0; }
-			if(layer->fsize / layer->split_in > 1 && neu_phy * layer->split_in > 1) {
-				fprintf(Fo, "%s-- Frame position %u\n", indent, fi);
-			}
+		if(layer->fsize / layer->split_in > 1 && neu_phy * layer->split_in > 1) {
+			fprintf(Fo, "%s-- Frame position %u\n", indent, fi);
+		}
 
-			// The memory of weights feeds all physical neurons
-			// Order of neurons depends on PAR_OUT : first all neurons 0 mod PAR_OUT, then 1 mod PAR_OUT, etc
+		// The memory of weights feeds all physical neurons
+		// Order of neurons depends on PAR_OUT : first all neurons 0 mod PAR_OUT, then 1 mod PAR_OUT, etc
 
-			// Here, generate NEU_PHY * PAR_IN concatenated values
+		// Here, generate NEU_PHY * PAR_IN concatenated values
 
-			unsigned neu_per_po = neu_phy / layer->split_out;
+		unsigned neu_per_po = neu_phy / layer->split_out;
 
-			for(int po = layer->split_out-1; po >= 0; po--) {
-				for(int no = neu_per_po-1; no >= 0; no--) {
+		for(int po = layer->split_out-1; po >= 0; po--) {
+			for(int no = neu_per_po-1; no >= 0; no--) {
 
-					unsigned n = t * neu_phy + no * layer->split_out + po;
-					int* cfg_data_neu = layer->cfg_data[n];
+				unsigned n = t * neu_phy + no * layer->split_out + po;
+				int* cfg_data_neu = layer->cfg_data[n];
 
-					for(int pi = layer->split_in-1; pi >= 0; pi--) {
-						unsigned f = fi + pi;
+				for(int pi = layer->split_in-1; pi >= 0; pi--) {
+					unsigned f = fi + pi;
 
-						// Print necessary VHDL keywords and newline
-						if(cat_num > 0) fprintf(Fo, " &\n");
+					// Print necessary VHDL keywords and newline
+					if(cat_num > 0) fputs(" &\n", Fo);
 
-						// Only after newline we can print comments
-						if(pi == (int)layer->split_in-1) {
-							if(layer->split_out > 1 && no == (int)neu_per_po-1) {
-								fprintf(Fo, "%s-- Neurons %u mod PAR_OUT=%u\n", indent, po, layer->split_out);
-							}
-							if(layer->split_in > 1) {
-								fprintf(Fo, "%s-- Neuron %u\n", indent, n);
-							}
+					// Only after newline we can print comments
+					if(pi == (int)layer->split_in-1) {
+						if(layer->split_out > 1 && no == (int)neu_per_po-1) {
+							fprintf(Fo, "%s-- Neurons %u mod PAR_OUT=%u\n", indent, po, layer->split_out);
 						}
-
-						// Print the number
-						fprintf(Fo, "			\"");
-						int val = cfg_data_neu[f];
-						if(bin_sym == true) val = (val == -1);  // Stored 0 means +1, stored 1 means -1
-						for(unsigned i=0; i<layer->neu_wweight; i++) {
-							fprintf(Fo, "%c", ((val & msb_mask) != 0) ? '1' : '0');
-							val <<= 1;
+						if(layer->split_in > 1) {
+							fprintf(Fo, "%s-- Neuron %u\n", indent, n);
 						}
-						fprintf(Fo, "\"");
+					}
 
-						// Increment the number of concatenated values up to now
-						cat_num++;
+					// Print the number
+					fputs("			", Fo);
+					int val = cfg_data_neu[f];
+					if(bin_sym == true) val = (val == -1);  // Stored 0 means +1, stored 1 means -1
+					genvhdl_fput_bin(Fo, val, layer->neu_wweight);
 
-					}  // par_in
-				}  // neuron
-			}  // par_out
+					// Increment the number of concatenated values up to now
+					cat_num++;
 
-			// Note : End of a line in memory
+				}  // par_in
+			}  // neuron
+		}  // par_out
 
-		}  // fsize
-	}  // tmux
+		// Note : End of a line in memory
 
-	if(cat_num > 0) fprintf(Fo, "\n");
+	}  // lines
+
+	if(cat_num > 0 && line_end == lines_nb) fputs("\n", Fo);
 }
 
 void LayerNorm::genvhdl_const_params_vec(FILE* Fo, const char* indent) {
@@ -4774,14 +4949,7 @@ void LayerNorm::genvhdl_const_params_vec(FILE* Fo, const char* indent) {
 
 	// Helper lambda function to append a specified amount of bits to the config array
 	auto func_print = [&](unsigned val, unsigned bits) {
-		// Print the data
-		fprintf(Fo, "\"");
-		unsigned msb_mask = 1 << (bits-1);
-		for(unsigned i=0; i<bits; i++) {
-			fprintf(Fo, "%c", ((val & msb_mask) != 0) ? '1' : '0');
-			val <<= 1;
-		}
-		fprintf(Fo, "\"");
+		genvhdl_fput_bin(Fo, val, bits);
 		// Increment the number of concatenated values up to now
 		cat_num++;
 	};
@@ -4790,25 +4958,25 @@ void LayerNorm::genvhdl_const_params_vec(FILE* Fo, const char* indent) {
 		int* cfg_data = layer->cfg_data[n];
 
 		// Print necessary VHDL keywords and newline
-		if(cat_num > 0) fprintf(Fo, " &\n");
+		if(cat_num > 0) fputs(" &\n", Fo);
 
 		// Only after newline we can print comments
 		fprintf(Fo, "%s-- Neuron %u\n", indent, n);
 
 		// Print the parameters
-		fprintf(Fo, "			");
+		fputs("			", Fo);
 		if(norm_wshr  > 0) func_print(cfg_data[col_shr],  norm_wshr);
-		if(cat_num > 0) fprintf(Fo, " & ");
+		if(cat_num > 0) fputs(" & ", Fo);
 		if(norm_wmul  > 0) func_print(cfg_data[col_mul],  norm_wmul);
-		if(cat_num > 0) fprintf(Fo, " & ");
+		if(cat_num > 0) fputs(" & ", Fo);
 		if(norm_wbias > 0) func_print(cfg_data[col_bias], norm_wbias);
 
 	}  // fsize
 
-	if(cat_num > 0) fprintf(Fo, "\n");
+	if(cat_num > 0) fputs("\n", Fo);
 }
 
-void LayerNorm::genvhdl_const_params_mem(FILE* Fo, const char* indent) {
+void LayerNorm::genvhdl_const_params_mem(FILE* Fo, const char* indent, unsigned line_beg, unsigned line_end) {
 	layer_t* layer = this;
 
 	// Get the width of parameters
@@ -4829,20 +4997,20 @@ void LayerNorm::genvhdl_const_params_mem(FILE* Fo, const char* indent) {
 
 	// Helper lambda function to append a specified amount of bits to the config array
 	auto func_print = [&](unsigned val, unsigned bits) {
-		// Print the data
-		fprintf(Fo, "\"");
-		unsigned msb_mask = 1 << (bits-1);
-		for(unsigned i=0; i<bits; i++) {
-			fprintf(Fo, "%c", ((val & msb_mask) != 0) ? '1' : '0');
-			val <<= 1;
-		}
-		fprintf(Fo, "\"");
+		genvhdl_fput_bin(Fo, val, bits);
 		// Increment the number of concatenated values up to now
 		cat_num++;
 	};
 
-	for(unsigned fi=0; fi < layer->fsize; fi += layer->split_in) {
-		if(cat_num > 0) { fprintf(Fo, ",\n"); cat_num = 0; }
+	unsigned lines_nb = (layer->fsize + layer->split_in - 1) / layer->split_in;
+	if(line_end > lines_nb) line_end = lines_nb;
+
+	for(unsigned line = line_beg; line < line_end; line++) {
+		unsigned fi = line * layer->split_in;
+
+		// Separation from the previous line, that may have been generated in another range
+		if(line > 0) { fputs(",\n", Fo); cat_num = 0; }
+
 		if(layer->fsize / layer->split_in > 1) {
 			fprintf(Fo, "%s-- Frame position %u\n", indent, fi);
 		}
@@ -4855,7 +5023,7 @@ void LayerNorm::genvhdl_const_params_mem(FILE* Fo, const char* indent) {
 			int* cfg_data = layer->cfg_data[n];
 
 			// Print necessary VHDL keywords and newline
-			if(cat_num > 0) fprintf(Fo, " &\n");
+			if(cat_num > 0) fputs(" &\n", Fo);
 
 			// Only after newline we can print comments
 			if(pi == (int)layer->split_in-1) {
@@ -4865,20 +5033,20 @@ void LayerNorm::genvhdl_const_params_mem(FILE* Fo, const char* indent) {
 			}
 
 			// Print the parameters
-			fprintf(Fo, "			");
+			fputs("			", Fo);
 			if(norm_wshr  > 0) func_print(cfg_data[col_shr],  norm_wshr);
-			if(cat_num > 0) fprintf(Fo, " & ");
+			if(cat_num > 0) fputs(" & ", Fo);
 			if(norm_wmul  > 0) func_print(cfg_data[col_mul],  norm_wmul);
-			if(cat_num > 0) fprintf(Fo, " & ");
+			if(cat_num > 0) fputs(" & ", Fo);
 			if(norm_wbias > 0) func_print(cfg_data[col_bias], norm_wbias);
 
 		}  // PAR
 
 		// Note : End of a line in memory
 
-	}  // fsize
+	}  // lines
 
-	if(cat_num > 0) fprintf(Fo, "\n");
+	if(cat_num > 0 && line_end == lines_nb) fputs("\n", Fo);
 }
 
 void LayerTernarize::genvhdl_const_params_vec(FILE* Fo, const char* indent) {
@@ -4888,14 +5056,7 @@ void LayerTernarize::genvhdl_const_params_vec(FILE* Fo, const char* indent) {
 
 	// Helper lambda function to append a specified amount of bits to the config array
 	auto func_print = [&](unsigned val, unsigned bits) {
-		// Print the data
-		fprintf(Fo, "\"");
-		unsigned msb_mask = 1 << (bits-1);
-		for(unsigned i=0; i<bits; i++) {
-			fprintf(Fo, "%c", ((val & msb_mask) != 0) ? '1' : '0');
-			val <<= 1;
-		}
-		fprintf(Fo, "\"");
+		genvhdl_fput_bin(Fo, val, bits);
 		// Increment the number of concatenated values up to now
 		cat_num++;
 	};
@@ -4904,51 +5065,51 @@ void LayerTernarize::genvhdl_const_params_vec(FILE* Fo, const char* indent) {
 		int* cfg_data = layer->cfg_data[n];
 
 		// Print necessary VHDL keywords and newline
-		if(cat_num > 0) fprintf(Fo, " &\n");
+		if(cat_num > 0) fputs(" &\n", Fo);
 
 		// Only after newline we can print comments
 		fprintf(Fo, "%s-- Neuron %u\n", indent, n);
 
 		// Print the parameters
-		fprintf(Fo, "			");
+		fputs("			", Fo);
 		if(ter_out_static == false) {
 			func_print(cfg_data[4], out_wdata);
-			fprintf(Fo, " & ");
+			fputs(" & ", Fo);
 			func_print(cfg_data[3], out_wdata);
-			fprintf(Fo, " & ");
+			fputs(" & ", Fo);
 			func_print(cfg_data[2], out_wdata);
-			fprintf(Fo, " & ");
+			fputs(" & ", Fo);
 		}
 		func_print(cfg_data[1], wdata);
-		fprintf(Fo, " & ");
+		fputs(" & ", Fo);
 		func_print(cfg_data[0], wdata);
 
 	}  // fsize
 
-	if(cat_num > 0) fprintf(Fo, "\n");
+	if(cat_num > 0) fputs("\n", Fo);
 }
 
-void LayerTernarize::genvhdl_const_params_mem(FILE* Fo, const char* indent) {
+void LayerTernarize::genvhdl_const_params_mem(FILE* Fo, const char* indent, unsigned line_beg, unsigned line_end) {
 	layer_t* layer = this;
 
 	unsigned cat_num = 0;
 
 	// Helper lambda function to append a specified amount of bits to the config array
 	auto func_print = [&](unsigned val, unsigned bits) {
-		// Print the data
-		fprintf(Fo, "\"");
-		unsigned msb_mask = 1 << (bits-1);
-		for(unsigned i=0; i<bits; i++) {
-			fprintf(Fo, "%c", ((val & msb_mask) != 0) ? '1' : '0');
-			val <<= 1;
-		}
-		fprintf(Fo, "\"");
+		genvhdl_fput_bin(Fo, val, bits);
 		// Increment the number of concatenated values up to now
 		cat_num++;
 	};
 
-	for(unsigned fi=0; fi < layer->fsize; fi += layer->split_in) {
-		if(cat_num > 0) { fprintf(Fo, ",\n"); cat_num = 0; }
+	unsigned lines_nb = (layer->fsize + layer->split_in - 1) / layer->split_in;
+	if(line_end > lines_nb) line_end = lines_nb;
+
+	for(unsigned line = line_beg; line < line_end; line++) {
+		unsigned fi = line * layer->split_in;
+
+		// Separation from the previous line, that may have been generated in another range
+		if(line > 0) { fputs(",\n", Fo); cat_num = 0; }
+
 		if(layer->fsize / layer->split_in > 1) {
 			fprintf(Fo, "%s-- Frame position %u\n", indent, fi);
 		}
@@ -4961,7 +5122,7 @@ void LayerTernarize::genvhdl_const_params_mem(FILE* Fo, const char* indent) {
 			int* cfg_data = layer->cfg_data[n];
 
 			// Print necessary VHDL keywords and newline
-			if(cat_num > 0) fprintf(Fo, " &\n");
+			if(cat_num > 0) fputs(" &\n", Fo);
 
 			// Only after newline we can print comments
 			if(pi == (int)layer->split_in-1) {
@@ -4971,26 +5132,123 @@ void LayerTernarize::genvhdl_const_params_mem(FILE* Fo, const char* indent) {
 			}
 
 			// Print the parameters
-			fprintf(Fo, "			");
+			fputs("			", Fo);
 			if(ter_out_static == false) {
 				func_print(cfg_data[4], out_wdata);
-				fprintf(Fo, " & ");
+				fputs(" & ", Fo);
 				func_print(cfg_data[3], out_wdata);
-				fprintf(Fo, " & ");
+				fputs(" & ", Fo);
 				func_print(cfg_data[2], out_wdata);
-				fprintf(Fo, " & ");
+				fputs(" & ", Fo);
 			}
 			func_print(cfg_data[1], wdata);
-			fprintf(Fo, " & ");
+			fputs(" & ", Fo);
 			func_print(cfg_data[0], wdata);
 
 		}  // PAR
 
 		// Note : End of a line in memory
 
-	}  // fsize
+	}  // lines
+
+	if(cat_num > 0 && line_end == lines_nb) fputs("\n", Fo);
+}
+
+// Parallel generation of the tables of constants
+// Each table is split in blocks of memory lines, that are generated in memory buffers by a pool of threads
+// The buffers are written to the output file in order as soon as they are ready
+// Threads do not run too far ahead of the writer, so the memory usage stays bounded
+
+// Approximate size of one block, in bits of parameters
+#define GENVHDL_CST_BLOCK_BITS  (1024*1024)
+
+typedef struct genvhdl_cst_task_t {
+	Layer*   layer = nullptr;
+	bool     is_vec = false;
+	unsigned line_beg = 0;
+	unsigned line_end = 0;
+	bool     to_hex = false;
+	// Generated text
+	char*    buf = nullptr;
+	size_t   size = 0;
+	bool     done = false;
+} genvhdl_cst_task_t;
+
+typedef struct genvhdl_cst_pool_t {
+	vector<genvhdl_cst_task_t>* tasks;
+	pthread_mutex_t mutex;
+	pthread_cond_t  cond;
+	unsigned next;     // Next task to generate
+	unsigned written;  // Next task to write
+	unsigned window;   // Max number of tasks generated ahead of the writer
+} genvhdl_cst_pool_t;
+
+// Convert generated memory lines to one hexadecimal word per line, MSB first
+// The values are the binary literals between double quotes, the memory lines are separated by commas
+// Comments never contain these characters
+static void genvhdl_cst_to_hex(genvhdl_cst_task_t& task) {
+	string hex;
+	string bits;
+
+	auto flush_line = [&](void) {
+		if(bits.empty() == true) return;
+		// Leading zeros to get a multiple of 4 bits
+		unsigned nb = (4 - bits.size() % 4) % 4;
+		unsigned digit = 0;
+		for(char c : bits) {
+			digit = digit * 2 + (c == '1');
+			nb++;
+			if(nb == 4) { hex += "0123456789ABCDEF"[digit]; digit = 0; nb = 0; }
+		}
+		hex += '\n';
+		bits.clear();
+	};
+
+	bool in_literal = false;
+	for(size_t i=0; i<task.size; i++) {
+		char c = task.buf[i];
+		if(c == '"') in_literal = !in_literal;
+		else if(in_literal == true) bits += c;
+		else if(c == ',') flush_line();
+	}
+	flush_line();
+
+	free(task.buf);
+	task.buf = (char*)malloc(hex.size() + 1);
+	memcpy(task.buf, hex.data(), hex.size());
+	task.size = hex.size();
+}
 
-	if(cat_num > 0) fprintf(Fo, "\n");
+static void genvhdl_cst_task_run(genvhdl_cst_task_t& task) {
+	FILE* F = open_memstream(&task.buf, &task.size);
+	if(task.is_vec == true) task.layer->genvhdl_const_params_vec(F, "			");
+	else task.layer->genvhdl_const_params_mem(F, "			", task.line_beg, task.line_end);
+	fclose(F);
+	if(task.to_hex == true) genvhdl_cst_to_hex(task);
+}
+
+static void* genvhdl_cst_thread(void* arg) {
+	genvhdl_cst_pool_t* pool = (genvhdl_cst_pool_t*)arg;
+	auto& tasks = *pool->tasks;
+
+	pthread_mutex_lock(&pool->mutex);
+	do {
+		while(pool->next < tasks.size() && pool->next >= pool->written + pool->window) {
+			pthread_cond_wait(&pool->cond, &pool->mutex);
+		}
+		if(pool->next >= tasks.size()) break;
+		unsigned idx = pool->next++;
+		pthread_mutex_unlock(&pool->mutex);
+
+		genvhdl_cst_task_run(tasks[idx]);
+
+		pthread_mutex_lock(&pool->mutex);
+		tasks[idx].done = true;
+		pthread_cond_broadcast(&pool->cond);
+	} while(1);
+	pthread_mutex_unlock(&pool->mutex);
+
+	return NULL;
 }
 
 // Filler worker object to generate the constant weights, inside a component that contains a memory
@@ -5004,6 +5262,7 @@ class FillerWorker_ConstantParams : public TemplateFileFiller::FillerWorker {
 	FillerWorker_ConstantParams(Network* n) {
 		line_begin = "-- AUTOGEN CONST PARAMS BEGIN";
 		line_end   = "-- AUTOGEN CONST PARAMS END";
+		unit_name  = "const_params";
 		network = n;
 	}
 
@@ -5014,7 +5273,12 @@ class FillerWorker_ConstantParams : public TemplateFileFiller::FillerWorker {
 void FillerWorker_ConstantParams::fill(TemplateFileFiller& filler) {
 	FILE* Fo = filler.Fo;
 
-	unsigned num_layers_cst = 0;
+	// Select the layers to generate, and split the tables in blocks
+
+	vector<Layer*> layers_cst;
+	vector<unsigned> layers_numlines;
+	vector<unsigned> layers_task_end;
+	vector<genvhdl_cst_task_t> tasks;
 
 	for(auto layer : network->layers) {
 		if(layer->const_params == false) continue;
@@ -5030,6 +5294,87 @@ void FillerWorker_ConstantParams::fill(TemplateFileFiller& filler) {
 		}
 		if(numlines == 0) continue;
 
+		genvhdl_cst_task_t task;
+		task.layer = layer;
+
+		// Handle case where there is no underlying memory : just generate a gigantic vector
+		if(numlines <= 1) {
+			task.is_vec = true;
+			tasks.push_back(task);
+		}
+		else {
+			unsigned line_bits = layer->mem.width * layer->mem.num;
+			unsigned block_lines = GENVHDL_CST_BLOCK_BITS / ((line_bits > 0) ? line_bits : 1);
+			if(block_lines < 1) block_lines = 1;
+			task.to_hex = genvhdl_cst_memfile;
+			for(unsigned l=0; l<numlines; l+=block_lines) {
+				task.line_beg = l;
+				task.line_end = (l + block_lines < numlines) ? l + block_lines : numlines;
+				tasks.push_back(task);
+			}
+		}
+
+		layers_cst.push_back(layer);
+		layers_numlines.push_back(numlines);
+		layers_task_end.push_back(tasks.size());
+	}
+
+	// Launch the pool of threads
+
+	unsigned threads_nb = genvhdl_threads;
+	if(threads_nb == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads_nb = (cpus > 0) ? cpus : 1;
+	}
+	if(threads_nb > tasks.size()) threads_nb = tasks.size();
+	// With one thread, the generation is done by the writer
+	if(threads_nb <= 1) threads_nb = 0;
+
+	genvhdl_cst_pool_t pool;
+	pool.tasks   = &tasks;
+	pool.next    = 0;
+	pool.written = 0;
+	pool.window  = 4 * threads_nb;
+	pthread_mutex_init(&pool.mutex, NULL);
+	pthread_cond_init(&pool.cond, NULL);
+
+	vector<pthread_t> threads(threads_nb);
+	for(unsigned i=0; i<threads_nb; i++) {
+		pthread_create(&threads[i], NULL, genvhdl_cst_thread, &pool);
+	}
+
+	// Get the generated blocks in order
+	auto task_wait = [&](unsigned idx) -> genvhdl_cst_task_t& {
+		if(threads_nb == 0) {
+			genvhdl_cst_task_run(tasks[idx]);
+			return tasks[idx];
+		}
+		pthread_mutex_lock(&pool.mutex);
+		while(tasks[idx].done == false) pthread_cond_wait(&pool.cond, &pool.mutex);
+		pthread_mutex_unlock(&pool.mutex);
+		return tasks[idx];
+	};
+	auto task_release = [&](unsigned idx) {
+		free(tasks[idx].buf);
+		tasks[idx].buf = nullptr;
+		pthread_mutex_lock(&pool.mutex);
+		pool.written = idx + 1;
+		pthread_cond_broadcast(&pool.cond);
+		pthread_mutex_unlock(&pool.mutex);
+	};
+
+	unsigned num_layers_cst = 0;
+	unsigned task_idx = 0;
+
+	for(unsigned i=0; i<layers_cst.size(); i++) {
+		Layer* layer = layers_cst[i];
+		unsigned numlines = layers_numlines[i];
+
+		// One unit per layer in the manifest
+		char namebuf[64];
+		sprintf(namebuf, "%s%u", layer->typenamel, layer->typeidx);
+		filler.unit_begin(namebuf);
+
 		fprintf(Fo, "\n\t");
 		if(num_layers_cst == 0) fprintf(Fo, "gen : ");  // Add an identifier before the "if generate"
 		else fprintf(Fo, "els");  // Convert "if ... generate" into "elsif ... generate"
@@ -5043,7 +5388,9 @@ void FillerWorker_ConstantParams::fill(TemplateFileFiller& filler) {
 		if(numlines <= 1) {
 
 			fprintf(Fo, "		data_out <= (\n");
-			layer->genvhdl_const_params_vec(Fo, "			");
+			auto& task = task_wait(task_idx);
+			fwrite(task.buf, 1, task.size, Fo);
+			task_release(task_idx++);
 			fprintf(Fo, "		);\n");
 
 		}  // Just a constant signal
@@ -5053,9 +5400,50 @@ void FillerWorker_ConstantParams::fill(TemplateFileFiller& filler) {
 
 			// Declaration of memory array
 			fprintf(Fo, "		type mem_type is array (0 to %u-1) of std_logic_vector(WDATA*PAR_OUT-1 downto 0);\n", numlines);
-			fprintf(Fo, "		signal mem : mem_type := (\n");
-			layer->genvhdl_const_params_mem(Fo, "			");
-			fprintf(Fo, "		);\n");
+
+			// The contents are in a separate init file, next to the output file
+			// Note : Function hread() for std_logic_vector needs VHDL-2008, like the "elsif generate" construct
+			if(genvhdl_cst_memfile == true) {
+				string filename_mem = filler.filename_out;
+				size_t pos_slash = filename_mem.find_last_of('/');
+				size_t pos_dot = filename_mem.find_last_of('.');
+				if(pos_dot != string::npos && (pos_slash == string::npos || pos_dot > pos_slash)) filename_mem.resize(pos_dot);
+				filename_mem += string("_") + namebuf + ".mem";
+				string basename_mem = (pos_slash == string::npos) ? filename_mem : filename_mem.substr(pos_slash + 1);
+
+				string content;
+				for( ; task_idx < layers_task_end[i]; task_idx++) {
+					auto& task = task_wait(task_idx);
+					content.append(task.buf, task.size);
+					task_release(task_idx);
+				}
+				genvhdl_write_if_changed(filename_mem.c_str(), content.data(), content.size());
+
+				fprintf(Fo, "\n");
+				fprintf(Fo, "		-- The contents of the memory are read from an init file, one hexadecimal word per line\n");
+				fprintf(Fo, "		impure function mem_init return mem_type is\n");
+				fprintf(Fo, "			file f : std.textio.text open read_mode is \"%s\";\n", basename_mem.c_str());
+				fprintf(Fo, "			variable l : std.textio.line;\n");
+				fprintf(Fo, "			variable m : mem_type;\n");
+				fprintf(Fo, "		begin\n");
+				fprintf(Fo, "			for i in mem_type'range loop\n");
+				fprintf(Fo, "				std.textio.readline(f, l);\n");
+				fprintf(Fo, "				hread(l, m(i));\n");
+				fprintf(Fo, "			end loop;\n");
+				fprintf(Fo, "			return m;\n");
+				fprintf(Fo, "		end function;\n");
+				fprintf(Fo, "\n");
+				fprintf(Fo, "		signal mem : mem_type := mem_init;\n");
+			}
+			else {
+				fprintf(Fo, "		signal mem : mem_type := (\n");
+				for( ; task_idx < layers_task_end[i]; task_idx++) {
+					auto& task = task_wait(task_idx);
+					fwrite(task.buf, 1, task.size, Fo);
+					task_release(task_idx);
+				}
+				fprintf(Fo, "		);\n");
+			}
 
 			// Generate the memory implementation type, lutram or bram
 			fprintf(Fo, "\n");
@@ -5074,6 +5462,12 @@ void FillerWorker_ConstantParams::fill(TemplateFileFiller& filler) {
 		num_layers_cst ++;
 	}
 
+	for(unsigned i=0; i<threads_nb; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_cond_destroy(&pool.cond);
+	pthread_mutex_destroy(&pool.mutex);
+
 	if(num_layers_cst > 0) {
 		fprintf(Fo, "\n");
 		fprintf(Fo, "	else generate\n");
@@ -5154,6 +5548,9 @@ int vhdl_gen_const_params(Network* network, const char* filename_in, const char*
 	// Scan the input file and insert the VHDL
 	filler.process();
 
-	return 0;
+	// Write the output file if it changed
+	int z = filler.commit();
+
+	return z;
 }
 
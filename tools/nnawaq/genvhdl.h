@@ -54,6 +54,9 @@ class GenVhdl_ConnHelper {
 // Global parameters
 extern char const * vhdl_gen_prefix;
 extern char* genvhdl_dump_dir;
+extern char* genvhdl_manifest;
+extern unsigned genvhdl_threads;
+extern bool genvhdl_cst_memfile;
 
 
 int vhdl_gen(Network* network, const char* filename_in, const char* filename_out, const char* want_prefix, bool gen_clear);
@@ -0,0 +1,163 @@
+
+// Pool of buffers for data streams with the HW accelerator
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "nnawaq_utils.h"
+
+}  // extern "C"
+
+#include "hwacc_bufpool.h"
+
+using namespace std;
+
+
+// Size of hugepages, in case the system does not tell
+#define HUGEPAGE_SIZE (2*1024*1024)
+
+
+//============================================
+// Constructor / Destructor
+//============================================
+
+HwAcc_BufPool::~HwAcc_BufPool(void) {
+	for(auto& buf : bufs) release(buf);
+	bufs.clear();
+}
+
+
+//============================================
+// Methods
+//============================================
+
+bool HwAcc_BufPool::alloc(buf_t& buf, size_t bytes) {
+	size_t page_size = sysconf(_SC_PAGESIZE);
+	size_t align_eff = GetMax(align, page_size);
+
+	buf.ptr = nullptr;
+	buf.bytes = 0;
+	buf.mmaped = false;
+	buf.locked = false;
+	buf.used = false;
+
+	// Try hugepages, the size is rounded to hugepage size
+	#ifdef MAP_HUGETLB
+	if(huge == true && align_eff <= HUGEPAGE_SIZE) {
+		size_t huge_bytes = (bytes + HUGEPAGE_SIZE - 1) / HUGEPAGE_SIZE * HUGEPAGE_SIZE;
+		void* ptr = mmap(nullptr, huge_bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+		if(ptr != MAP_FAILED) {
+			buf.ptr = ptr;
+			buf.bytes = huge_bytes;
+			buf.mmaped = true;
+		}
+	}
+	#endif
+
+	// Normal pages
+	if(buf.ptr == nullptr) {
+		size_t alloc_bytes = (bytes + align_eff - 1) / align_eff * align_eff;
+		void* ptr = nullptr;
+		int z = posix_memalign(&ptr, align_eff, alloc_bytes);
+		if(z != 0) return false;
+		// Touch all pages so there is no page fault when the buffer is used
+		memset(ptr, 0, alloc_bytes);
+		buf.ptr = ptr;
+		buf.bytes = alloc_bytes;
+	}
+
+	if(lock == true) {
+		int z = mlock(buf.ptr, buf.bytes);
+		if(z == 0) buf.locked = true;
+		else if(warn_lock == false) {
+			printf("Warning HwAcc : Failed to lock buffers in RAM (%s), check the limits of locked memory\n", strerror(errno));
+			warn_lock = true;
+		}
+	}
+
+	stat_alloc ++;
+
+	return true;
+}
+
+void HwAcc_BufPool::release(buf_t& buf) {
+	if(buf.ptr == nullptr) return;
+	if(buf.locked == true) munlock(buf.ptr, buf.bytes);
+	if(buf.mmaped == true) munmap(buf.ptr, buf.bytes);
+	else free(buf.ptr);
+	buf.ptr = nullptr;
+}
+
+void* HwAcc_BufPool::get(size_t bytes) {
+	pthread_mutex_lock(&mutex);
+
+	// Get the smallest free buffer that is large enough
+	buf_t* best = nullptr;
+	for(auto& buf : bufs) {
+		if(buf.used == true || buf.bytes < bytes) continue;
+		if(best == nullptr || buf.bytes < best->bytes) best = &buf;
+	}
+
+	if(best != nullptr) {
+		stat_reuse ++;
+	}
+	else {
+		buf_t buf;
+		if(alloc(buf, bytes) == false) {
+			pthread_mutex_unlock(&mutex);
+			return nullptr;
+		}
+		bufs.push_back(buf);
+		best = &bufs.back();
+	}
+
+	best->used = true;
+	void* ptr = best->ptr;
+
+	pthread_mutex_unlock(&mutex);
+
+	return ptr;
+}
+
+void HwAcc_BufPool::put(void* ptr) {
+	if(ptr == nullptr) return;
+	pthread_mutex_lock(&mutex);
+	for(auto& buf : bufs) {
+		if(buf.ptr == ptr) { buf.used = false; break; }
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+void HwAcc_BufPool::clear(void) {
+	pthread_mutex_lock(&mutex);
+	vector<buf_t> bufs_used;
+	for(auto& buf : bufs) {
+		if(buf.used == true) bufs_used.push_back(buf);
+		else release(buf);
+	}
+	bufs = bufs_used;
+	pthread_mutex_unlock(&mutex);
+}
+
+void HwAcc_BufPool::print_stats(void) {
+	size_t bytes = 0;
+	unsigned nb_huge = 0;
+	unsigned nb_locked = 0;
+	for(auto& buf : bufs) {
+		bytes += buf.bytes;
+		if(buf.mmaped == true) nb_huge ++;
+		if(buf.locked == true) nb_locked ++;
+	}
+	printf("Info HwAcc : Buffer pool : %zu buffers, %zu kB (%u hugepage-backed, %u locked), %u allocations, %u reuses\n",
+		bufs.size(), bytes / 1024, nb_huge, nb_locked, stat_alloc, stat_reuse
+	);
+}
+
@@ -0,0 +1,90 @@
+
+#pragma once
+
+extern "C" {
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <pthread.h>
+
+}
+
+#include <vector>
+
+
+//============================================
+// Pool of buffers for data streams with the HW accelerator
+//============================================
+
+// Buffers are page-aligned (or more, as requested by the backend), and are recycled across batches of frames
+// On allocation, pages are touched so there is no page fault in the streaming loop
+// Optionally, buffers are backed by hugepages (with fallback to normal pages), and locked in RAM with mlock()
+
+class HwAcc_BufPool {
+
+	public :
+
+	// Requirements declared by the HwAcc backend
+	size_t   align   = 0;      // Alignment in bytes, zero means page size
+	bool     lock    = false;  // Buffers must be locked in RAM, for example because a DMA engine accesses them
+	bool     huge    = false;  // Try to use hugepages
+
+	// Stats
+	unsigned stat_alloc = 0;
+	unsigned stat_reuse = 0;
+
+	private :
+
+	typedef struct buf_t {
+		void*  ptr;
+		size_t bytes;
+		bool   mmaped;
+		bool   locked;
+		bool   used;
+	} buf_t;
+
+	std::vector<buf_t> bufs;
+
+	// Buffers are obtained and released by the send and receive threads concurrently
+	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+	bool warn_lock = false;
+
+	//============================================
+	// Constructor / Destructor
+	//============================================
+
+	public :
+
+	HwAcc_BufPool(void) {}
+	~HwAcc_BufPool(void);
+
+	// Forbid copies because buffers are owned
+	HwAcc_BufPool(const HwAcc_BufPool&) = delete;
+	HwAcc_BufPool& operator=(const HwAcc_BufPool&) = delete;
+
+	//============================================
+	// Methods
+	//============================================
+
+	private :
+
+	bool alloc(buf_t& buf, size_t bytes);
+	void release(buf_t& buf);
+
+	public :
+
+	// Get a buffer of at least the specified size, return nullptr on error
+	void* get(size_t bytes);
+	inline uint32_t* get32(size_t nb32) { return (uint32_t*)get(nb32 * sizeof(uint32_t)); }
+	// Give a buffer back to the pool, it will be reused
+	void put(void* ptr);
+
+	// Free all buffers that are not in use
+	void clear(void);
+
+	void print_stats(void);
+
+};
+
@@ -11,6 +11,14 @@ extern "C" {
 #include <vector>
 
 #include "hw_reg_fields.h"
+#include "hwacc_bufpool.h"
+#include "hwacc_timing.h"
+#include "hwacc_fifomon.h"
+
+class OutWriter;
+
+// Mutex to prevent send and recv threads to conflict when using the control channel
+extern pthread_mutex_t ctrl_mutex;
 
 
 // Object that represents one HW target
@@ -66,6 +74,15 @@ class HwAcc_Common {
 	// The vector of config registers
 	std::vector<uint32_t> accreg_cfgnn;
 
+	// Buffers for data streams, backends set their alignment and locking requirements in their constructor
+	HwAcc_BufPool dmabufs;
+
+	// Timing of frames and batches, backends report received words with timing.recv_progress()
+	HwAcc_Timing timing;
+
+	// The accelerator is configured and owned by another process, config registers and config data are not sent
+	bool      config_shared   = false;
+
 	//============================================
 	// Fields in layer-specific config registers
 	//============================================
@@ -191,6 +208,9 @@ class HwAcc_Common {
 	virtual unsigned fpga_send32_wait(uint32_t* buf, unsigned buf_nb) { return 0; }  // There may be an additional wait to ensure data was processed indeed
 	virtual unsigned fpga_recv32(uint32_t* buf, unsigned buf_nb) { return 0; }
 
+	// Print backend-specific stats about data streams
+	virtual void     print_stream_stats(void) {}
+
 	//============================================
 	// Utility macros
 	//============================================
@@ -252,6 +272,13 @@ class HwAcc_Common {
 
 	inline unsigned accreg_get_fifo_nb(void)       { return accreg_get_unsigned(*memreg_fifo_nb); }
 
+	// Buffers for data streams are sized to a multiple of the interface width
+	inline uint32_t* dmabuf_get(unsigned nb32) {
+		unsigned ifw32 = (accreg_ifw32 > 0) ? accreg_ifw32 : 1;
+		return dmabufs.get32((nb32 + ifw32 - 1) / ifw32 * ifw32);
+	}
+	inline void dmabuf_put(uint32_t* buf) { dmabufs.put(buf); }
+
 	//============================================
 	// Methods
 	//============================================
@@ -287,13 +314,23 @@ class HwAcc_Common {
 	int write_layer_config(layer_t* layer);
 	int write_config(Network* network);
 
+	void get_outputs_frame_size(layer_t* layer, unsigned* frame_size_p, unsigned* frame_size_user_p);
+
 	// These methods should be private, but for now need to be public to be called from extrernal thread function
-	void* getoutputs_thread(layer_t* layer, unsigned frames_nb);
+	void* getoutputs_thread(layer_t* layer, unsigned frames_nb, unsigned frame_first, OutWriter* outwr);
 	int write_frames_inout(const char* filename, layer_t* inlayer, layer_t* outlayer, layer_t* last_layer);
+	int write_frames_lowlat(const char* filename, layer_t* inlayer, layer_t* outlayer, layer_t* last_layer);
 
 	int write_frames(Network* network, const char* filename);
+	int process_frames(Network* network, layer_t* outlayer, const int* values, unsigned frames_nb, int32_t* values_out);
+	int process_frames_user(Network* network, layer_t* outlayer, const int* frames, unsigned frames_nb, int* out);
 
+	void prepare(Network* network);
 	void run(Network* network);
 
 };
 
+// Packing of values into hardware transfers, and the reverse, the layout is the one of the data streams of the accelerator
+unsigned hwacc_pack_inputs(const int* values, unsigned nbvalues, uint32_t* buf, unsigned wdata, unsigned par, unsigned transfer_nb32);
+void     hwacc_unpack_outputs(const uint32_t* buf, int32_t* values, unsigned nbvalues, unsigned wdata, unsigned par, unsigned transfer_nb32, bool sdata);
+
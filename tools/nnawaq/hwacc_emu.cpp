@@ -0,0 +1,438 @@
+
+// Emulation of a HW accelerator, results are computed with the software execution
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <time.h>
+#include <errno.h>
+#include <pthread.h>
+
+#include "nnawaq_utils.h"
+
+}  // extern "C"
+
+#include "nn_layers_utils.h"
+#include "nn_load_config.h"
+#include "swexec.h"
+#include "hwacc_emu.h"
+
+using namespace std;
+
+
+//============================================
+// Class fields
+//============================================
+
+bool HwAcc_Emu::atexit_registered = false;
+
+HwAcc_Emu* HwAcc_Emu::singleton = nullptr;
+
+// The only way of obtaining an HwAcc object for emulation
+HwAcc_Emu* HwAcc_Emu::GetSingleton(Network* network) {
+	if(singleton == nullptr) {
+		singleton = new HwAcc_Emu(network);
+	}
+	return singleton;
+}
+void HwAcc_Emu::CloseSingleton(void) {
+	if(singleton != nullptr) {
+		delete singleton;
+	}
+	singleton = nullptr;
+}
+
+void HwAcc_Emu::emu_atexit(void) {
+	if(singleton == nullptr) return;
+	delete singleton;
+	singleton = nullptr;
+}
+
+
+//============================================
+// Constructor / Destructor
+//============================================
+
+HwAcc_Emu::HwAcc_Emu(Network* network) {
+	this->network = network;
+	emu_init();
+}
+
+HwAcc_Emu::~HwAcc_Emu(void) {
+	if(exec_network != nullptr) {
+		swexec_end(exec_network);
+		exec_network->clear();
+		delete exec_network;
+	}
+	if(this == singleton) singleton = nullptr;
+}
+
+
+//============================================
+// Methods
+//============================================
+
+static unsigned emu_log2(unsigned v) {
+	unsigned l = 0;
+	while((1u << l) < v) l++;
+	return l;
+}
+
+void HwAcc_Emu::emu_init(void) {
+
+	// Get first and last layers of the network
+	for(layer_t* layer = network->layer_first; layer != NULL; layer = layer->next) {
+		if(layer->type != LAYER_FIFO) { inlayer = layer; break; }
+	}
+	for(layer_t* layer = network->layer_last; layer != NULL; layer = layer->prev) {
+		if(layer->type != LAYER_FIFO) { outlayer = layer; break; }
+	}
+	if(inlayer == nullptr || outlayer == nullptr) {
+		printf("Error HwAcc Emu : The network must be built before the emulated accelerator is created\n");
+		exit(EXIT_FAILURE);
+	}
+
+	// Interface parameters, as the generated VHDL would do
+	unsigned ifw = network->hwconfig_writewidth;
+	if(ifw == 0) ifw = 32;
+	ifw = GetMin(uint_round_up(ifw, 8), 256u * 8);
+	emu_ifw32 = (ifw + 31) / 32;
+	emu_wdi   = GetMin(uint_rndpow2_ceil(GetMax(inlayer->wdata, 1u)), 32u);
+	emu_wdo   = GetMin(uint_rndpow2_ceil(GetMax(outlayer->out_wdata, 1u)), 32u);
+	emu_pari  = GetMin(GetMax(ifw / emu_wdi, 1u), 64u);
+	emu_paro  = GetMin(GetMax(ifw / emu_wdo, 1u), 8u);
+
+	// Layout of the chain of config registers : one register for channels, then the layer registers
+	// Layers that don't have their registers assigned yet get enough of them for their write_config_regs() method
+	bool have_layout = true;
+	for(auto layer : network->layers) {
+		if(layer->type == LAYER_FIFO) continue;
+		if(layer->regs_idx == 0) have_layout = false;
+	}
+	unsigned total_regs_nb = 1;
+	for(auto layer : network->layers) {
+		if(layer->type == LAYER_FIFO) continue;
+		total_regs_nb += 1;
+		if(have_layout == false) layer->regs_idx = total_regs_nb;
+		unsigned regs_nb = GetMax(layer->regs_nb, 8 + (unsigned)layer->arr_layers.size());
+		total_regs_nb = GetMax(total_regs_nb, layer->regs_idx + regs_nb);
+	}
+	total_regs_nb += 1;
+	chain_regs.assign(total_regs_nb, 0);
+	chain_shift.assign(total_regs_nb, 0);
+
+	// Initialize the read-only registers
+	memset(regs, 0, sizeof(regs));
+	uint32_t r = 0;
+	memreg_acc_n0->SetRef(r, 'N');
+	memreg_acc_n1->SetRef(r, 'N');
+	memreg_ver_maj->SetRef(r, 3);
+	memreg_ver_min->SetRef(r, 0);
+	regs[memreg_acc_n0->reg_idx] = r;
+
+	r = 0;
+	memreg_regs_nb->SetRef(r, total_regs_nb);
+	regs[memreg_regs_nb->reg_idx] = r;
+
+	r = 0;
+	memreg_ifwdi->SetRef(r, emu_log2(emu_wdi));
+	memreg_ifwdo->SetRef(r, emu_log2(emu_wdo));
+	memreg_ifpari->SetRef(r, emu_pari - 1);
+	memreg_ifparo->SetRef(r, emu_paro - 1);
+	memreg_ifw->SetRef(r, ifw / 8 - 1);
+	regs[memreg_ifw->reg_idx] = r;
+
+	// Buffers for streams
+	frame_in.resize(inlayer->fsize);
+	frame_out.resize(GetMax(outlayer->out_nbframes * outlayer->out_fsize, emu_frame_size()));
+	out_transfer.resize(GetMax(emu_ifw32, (emu_paro * emu_wdo + 31) / 32));
+
+	emu_clear();
+
+	printf("HwAcc Emu : Emulated accelerator with interface %u bits, inputs %u x %u bits, outputs %u x %u bits\n",
+		ifw, emu_pari, emu_wdi, emu_paro, emu_wdo
+	);
+	printf("HwAcc Emu : The network can't be built from the emulated accelerator, use blind mode\n");
+
+	// Register the close function
+	singleton = this;
+	if(atexit_registered == false) {
+		atexit(emu_atexit);
+		atexit_registered = true;
+	}
+}
+
+// Reset the state of streams, like the clear bit of the hardware
+void HwAcc_Emu::emu_clear(void) {
+	frame_in_nb = 0;
+	in_word_idx = 0;
+	in_transfer_nb = 0;
+	in_values_nb = 0;
+	out_transfer_nb = 0;
+	out_values_nb = 0;
+	out_base = 0;
+	out_done = 0;
+	for(auto& w : out_transfer) w = 0;
+	outq.clear();
+	outq_rd = 0;
+}
+
+// The number of values sent per frame, same computation than the receiving side of the software
+unsigned HwAcc_Emu::emu_frame_size(void) {
+	unsigned frame_size = outlayer->out_nbframes * ((outlayer->out_fsize + outlayer->split_out - 1) / outlayer->split_out);
+	if(outlayer->type == LAYER_NEU && param_hw_blind == true) {
+		frame_size = outlayer->out_nbframes * ((outlayer->neurons_max + outlayer->split_out - 1) / outlayer->split_out);
+	}
+	return frame_size;
+}
+
+// Append one value to the current transfer of output values
+void HwAcc_Emu::emu_out_value(int val) {
+	unsigned values_per32 = 32 / emu_wdo;
+	unsigned idx32 = out_transfer_nb / values_per32;
+	unsigned sh = (out_transfer_nb % values_per32) * emu_wdo;
+	out_transfer[idx32] |= (uint32_t(val) & uint_genmask(emu_wdo)) << sh;
+	out_transfer_nb++;
+	out_values_nb++;
+	if(out_transfer_nb == emu_paro) emu_out_commit(false);
+}
+
+// Push the current transfer in the output queue
+// The last transfer of a stream is partial, only its useful words are sent
+void HwAcc_Emu::emu_out_commit(bool partial) {
+	if(out_transfer_nb == 0) return;
+	unsigned nb32 = out_transfer.size();
+	if(partial == true) nb32 = (out_transfer_nb * emu_wdo + 31) / 32;
+	bool freerun = memreg_freeruno->Get(regs[memreg_freeruno->reg_idx]) != 0;
+	if(freerun == false) {
+		outq.insert(outq.end(), out_transfer.begin(), out_transfer.begin() + nb32);
+	}
+	for(auto& w : out_transfer) w = 0;
+	out_transfer_nb = 0;
+}
+
+void HwAcc_Emu::emu_exec_frame(void) {
+	if(exec_network == nullptr) {
+		exec_network = network->clone();
+		for(unsigned i=0; i<network->layers.size(); i++) {
+			Layer* layer = exec_network->layers[i];
+			if(network->layers[i] == outlayer) exec_outlayer = layer;
+			if(layer->cfg_data == nullptr) layer->load_config_files();
+		}
+		swexec_begin(exec_network);
+	}
+
+	// The software sends image data Z-first, the software execution expects the order of frame files
+	int* ptr_in = frame_in.data();
+	if(inlayer->fx > 1 || inlayer->fy > 1) {
+		reorder_to_xfirst_dim2(&ptr_in, 1, inlayer->fsize, inlayer->fx, inlayer->fy, inlayer->fz);
+	}
+
+	unsigned frame_size = emu_frame_size();
+	unsigned exec_size = outlayer->out_nbframes * outlayer->out_fsize;
+	swexec_oneframe(exec_network, exec_outlayer, ptr_in, frame_out.data(), 0);
+	// Padding for the unused neurons
+	for(unsigned i=exec_size; i<frame_size; i++) frame_out[i] = 0;
+
+	for(unsigned i=0; i<frame_size; i++) emu_out_value(frame_out[i]);
+
+	emu_out_check();
+}
+
+// Commit the last partial transfer when all expected results are produced
+void HwAcc_Emu::emu_out_check(void) {
+	unsigned out_nb = regs[memreg_out_nb->reg_idx];
+	if(out_nb == 0 || out_base + out_nb == out_done) return;
+	if(out_values_nb < out_base + out_nb) return;
+	emu_out_commit(true);
+	out_done = out_base + out_nb;
+}
+
+void HwAcc_Emu::emu_push_value(int val) {
+	frame_in[frame_in_nb++] = val;
+	if(frame_in_nb < inlayer->fsize) return;
+	frame_in_nb = 0;
+	emu_exec_frame();
+}
+
+// These methods override the virtual methods
+
+uint32_t HwAcc_Emu::accreg_rd(unsigned idx) {
+	if(idx >= REGS_NB) return 0;
+	pthread_mutex_lock(&mutex);
+	uint32_t r = regs[idx];
+
+	if(idx == memreg_layreg->reg_idx) {
+		bool shregs = memreg_shregs->Get(regs[memreg_shregs->reg_idx]) != 0;
+		r = 0;
+		if(shregs == true && chain_idx < chain_shift.size()) r = chain_shift[chain_idx++];
+	}
+	else if(idx == memreg_in_nb->reg_idx) {
+		r = in_values_nb / GetMax(inlayer->split_in, 1u);
+	}
+	else if(idx == memreg_out_nb->reg_idx) {
+		r = out_values_nb - out_base;
+	}
+	else if(idx == memreg_rxfifo_cnt->reg_idx) {
+		// The RX FIFO is always able to receive data, the TX FIFO contains the queue of results
+		r = 0;
+		memreg_rxfifo_cnt->SetRef(r, uint_genmask(memreg_rxfifo_cnt->bits));
+		memreg_txfifo_cnt->SetRef(r, GetMin(outq.size() - outq_rd, (size_t)uint_genmask(memreg_txfifo_cnt->bits)));
+	}
+
+	pthread_mutex_unlock(&mutex);
+	return r;
+}
+
+void HwAcc_Emu::accreg_wr(unsigned idx, uint32_t val) {
+	if(idx >= REGS_NB) return;
+	pthread_mutex_lock(&mutex);
+
+	if(idx == memreg_acc_n0->reg_idx || idx == memreg_rxfifo_cnt->reg_idx || idx == memreg_fifo_cnt->reg_idx) {
+		// Read-only registers
+	}
+	else if(idx == memreg_layreg->reg_idx) {
+		bool shregs = memreg_shregs->Get(regs[memreg_shregs->reg_idx]) != 0;
+		if(shregs == true && chain_idx < chain_shift.size()) chain_shift[chain_idx++] = val;
+	}
+	else if(idx == memreg_shregs->reg_idx) {
+		uint32_t r = regs[idx];
+		// Actions, these bits are not written
+		if(memreg_getregs->Get(val) != 0) chain_shift = chain_regs;
+		if(memreg_setregs->Get(val) != 0) chain_regs = chain_shift;
+		// The shift chain restarts from its beginning when enabled
+		if(memreg_shregs->Get(val) != 0 && memreg_shregs->Get(r) == 0) chain_idx = 0;
+		memreg_shregs->SetRef(r, memreg_shregs->Get(val));
+		regs[idx] = r;
+	}
+	else if(idx == memreg_clear->reg_idx) {
+		uint32_t r = regs[idx];
+		// Action, this bit is not written
+		if(memreg_clear->Get(val) != 0) {
+			emu_clear();
+			// The numbers of expected inputs and outputs are reset too, so results of the next run are not committed with an old target
+			regs[memreg_in_nb->reg_idx] = 0;
+			regs[memreg_out_nb->reg_idx] = 0;
+		}
+		memreg_freeruni->SetRef(r, memreg_freeruni->Get(val));
+		memreg_freeruno->SetRef(r, memreg_freeruno->Get(val));
+		regs[idx] = r;
+	}
+	else if(idx == memreg_in_nb->reg_idx) {
+		regs[idx] = val;
+		in_values_nb = 0;
+	}
+	else if(idx == memreg_out_nb->reg_idx) {
+		regs[idx] = val;
+		// Expected results follow the previous ones, they may already be there
+		out_base = out_done;
+		emu_out_check();
+		pthread_cond_broadcast(&cond);
+	}
+	else if(idx == memreg_fifo_idx->reg_idx) {
+		uint32_t r = regs[idx];
+		memreg_fifo_idx->SetRef(r, memreg_fifo_idx->Get(val));
+		regs[idx] = r;
+	}
+	else {
+		regs[idx] = val;
+	}
+
+	pthread_mutex_unlock(&mutex);
+}
+
+// Streams of data
+
+unsigned HwAcc_Emu::fpga_send32(uint32_t* buf, unsigned buf_nb) {
+	pthread_mutex_lock(&mutex);
+
+	// Config data streams are dropped
+	bool is_frames = memreg_in_lay->Get(regs[memreg_in_lay->reg_idx]) == memreg_in_lay->mask_val;
+	if(is_frames == false) {
+		pthread_mutex_unlock(&mutex);
+		return buf_nb;
+	}
+
+	// Only the expected number of values is taken, the rest is padding
+	unsigned in_nb = regs[memreg_in_nb->reg_idx] * GetMax(inlayer->split_in, 1u);
+	unsigned values_per32 = 32 / emu_wdi;
+	unsigned useful32 = (emu_pari + values_per32 - 1) / values_per32;
+	unsigned sh = 32 - emu_wdi;
+
+	for(unsigned i=0; i<buf_nb; i++) {
+		uint32_t w = buf[i];
+		if(in_word_idx < useful32) {
+			unsigned nb = GetMin(values_per32, emu_pari - in_transfer_nb);
+			for(unsigned v=0; v<nb; v++) {
+				if(in_values_nb >= in_nb) break;
+				uint32_t u = w << (sh - v * emu_wdi);
+				int val = (inlayer->sdata == true) ? (int32_t(u) >> sh) : int32_t(u >> sh);
+				in_values_nb++;
+				emu_push_value(val);
+			}
+			in_transfer_nb += nb;
+		}
+		in_word_idx++;
+		if(in_word_idx >= emu_ifw32 && in_word_idx >= useful32) {
+			in_word_idx = 0;
+			in_transfer_nb = 0;
+		}
+	}
+
+	pthread_cond_broadcast(&cond);
+	pthread_mutex_unlock(&mutex);
+
+	return buf_nb;
+}
+
+unsigned HwAcc_Emu::fpga_send32_wait(uint32_t* buf, unsigned buf_nb) {
+	// Results are computed during the send operation
+	return fpga_send32(buf, buf_nb);
+}
+
+unsigned HwAcc_Emu::fpga_recv32(uint32_t* buf, unsigned buf_nb) {
+	unsigned res_nb = 0;
+
+	// Absolute time for timeout
+	struct timespec ts;
+	if(param_timeout_recv_us > 0) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		uint64_t ns = ts.tv_nsec + (uint64_t)param_timeout_recv_us * 1000;
+		ts.tv_sec += ns / 1000000000;
+		ts.tv_nsec = ns % 1000000000;
+	}
+
+	pthread_mutex_lock(&mutex);
+	while(res_nb < buf_nb) {
+		size_t avail = outq.size() - outq_rd;
+		if(avail == 0) {
+			if(param_timeout_recv_us > 0) {
+				int z = pthread_cond_timedwait(&cond, &mutex, &ts);
+				if(z == ETIMEDOUT) break;
+			}
+			else {
+				pthread_cond_wait(&cond, &mutex);
+			}
+			continue;
+		}
+		unsigned len = GetMin((size_t)(buf_nb - res_nb), avail);
+		memcpy(buf + res_nb, outq.data() + outq_rd, len * sizeof(*buf));
+		outq_rd += len;
+		res_nb += len;
+		timing.recv_progress(len);
+		// Release memory when the queue is empty
+		if(outq_rd == outq.size()) {
+			outq.clear();
+			outq_rd = 0;
+		}
+	}
+	pthread_mutex_unlock(&mutex);
+
+	return res_nb;
+}
+
@@ -0,0 +1,144 @@
+
+#pragma once
+
+extern "C" {
+#include <stdbool.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <pthread.h>
+}
+
+#include <vector>
+
+#include "hwacc_common.h"
+
+
+// Emulation of a HW accelerator, with the network defined in software
+// The memory-mapped registers and the data streams behave like the hardware, results are computed with the software execution
+// Limitations :
+//   The network can't be built from the emulated config registers, use blind mode
+//   Config data streams are accepted and dropped, the layers use their configuration files like for software execution
+//   Only the last layer can be selected as output, and only split_out=1 is emulated accurately
+
+class HwAcc_Emu : public HwAcc_Common {
+
+	//============================================
+	// Class fields
+	//============================================
+
+	public :
+
+	static const unsigned REGS_NB = 16;
+
+	private :
+
+	static bool atexit_registered;
+
+	// Only one instance is allowed for now
+	static HwAcc_Emu* singleton;
+
+	//============================================
+	// Class methods
+	//============================================
+
+	// The only way of obtaining an HwAcc object for emulation
+	public :
+	static HwAcc_Emu* GetSingleton(Network* network);
+	static void CloseSingleton(void);
+
+	private :
+	static void emu_atexit(void);
+
+	//============================================
+	// Fields
+	//============================================
+
+	private :
+
+	// The network that is emulated
+	Network* network = nullptr;
+	layer_t* inlayer = nullptr;
+	layer_t* outlayer = nullptr;
+
+	// Interface parameters
+	unsigned emu_wdi   = 8;
+	unsigned emu_wdo   = 32;
+	unsigned emu_pari  = 1;
+	unsigned emu_paro  = 1;
+	unsigned emu_ifw32 = 1;
+
+	// The memory-mapped registers
+	uint32_t regs[REGS_NB];
+
+	// The chain of NN config registers, and the shift chain to read/write them
+	std::vector<uint32_t> chain_regs;
+	std::vector<uint32_t> chain_shift;
+	unsigned chain_idx = 0;
+
+	// Software execution uses a private clone of the network, so it does not interfere with other users of the network
+	// The clone is created on first frame, when configuration data is loaded and can be shared
+	Network* exec_network = nullptr;
+	layer_t* exec_outlayer = nullptr;
+
+	// Unpacking of input values
+	std::vector<int> frame_in;
+	unsigned frame_in_nb = 0;
+	unsigned in_word_idx = 0;     // Index of 32b word within the current transfer
+	unsigned in_transfer_nb = 0;  // Number of values already got from the current transfer
+	unsigned in_values_nb = 0;    // Number of values received since the last write to register in_nb
+
+	// Results of one frame, and packing of output values
+	std::vector<int> frame_out;
+	std::vector<uint32_t> out_transfer;
+	unsigned out_transfer_nb = 0;  // Number of values in the current transfer
+	unsigned out_values_nb = 0;    // Number of values produced since the last clear
+	unsigned out_base = 0;         // Value of out_values_nb when the current number of expected outputs was set
+	unsigned out_done = 0;         // Value of out_values_nb when the previous number of expected outputs was reached
+
+	// Queue of output 32b words
+	std::vector<uint32_t> outq;
+	size_t outq_rd = 0;
+
+	// Protect the queue of output words, and the registers, against concurrent send and receive threads
+	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+	pthread_cond_t  cond  = PTHREAD_COND_INITIALIZER;
+
+	//============================================
+	// Constructor / Destructor
+	//============================================
+
+	private :
+	HwAcc_Emu(Network* network);
+
+	public :
+	~HwAcc_Emu();
+
+	//============================================
+	// Override of virtual methods
+	//============================================
+
+	// Access configuration registers
+	uint32_t accreg_rd(unsigned idx);
+	void     accreg_wr(unsigned idx, uint32_t val);
+
+	// Streams of data
+	unsigned fpga_send32(uint32_t* buf, unsigned buf_nb);
+	unsigned fpga_send32_wait(uint32_t* buf, unsigned buf_nb);
+	unsigned fpga_recv32(uint32_t* buf, unsigned buf_nb);
+
+	//============================================
+	// Methods
+	//============================================
+
+	private :
+	void emu_init(void);
+	void emu_clear(void);
+	unsigned emu_frame_size(void);
+	void emu_push_value(int val);
+	void emu_exec_frame(void);
+	void emu_out_value(int val);
+	void emu_out_commit(bool partial);
+	void emu_out_check(void);
+
+};
+
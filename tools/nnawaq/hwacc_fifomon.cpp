@@ -0,0 +1,307 @@
+
+// Periodic sampler of the FIFOs inside the HW accelerator, for detection of the pipeline bottleneck
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>  // For usleep()
+
+#include "nnawaq_utils.h"
+
+}
+
+#include "nn_layers_utils.h"
+
+#include "hwacc_common.h"
+#include "hwacc_fifomon.h"
+
+using namespace std;
+
+
+// Rate of sampling of FIFOs during hardware runs, zero means disabled
+unsigned     param_hw_fifomon_hz = 0;
+// Export the time series of FIFO occupancy to this CSV file
+char const * param_hw_fifomon_csv = NULL;
+
+
+//============================================
+// Sampling
+//============================================
+
+int HwAcc_FifoMon::start(HwAcc_Common* hwacc, Network* network, unsigned rate_hz) {
+	if(running == true) stop();
+	if(rate_hz == 0) return -1;
+
+	if(hwacc->accreg_fifomon == false) {
+		printf("Warning HwAcc : The accelerator does not have the FIFO monitoring option, sampling of FIFOs is disabled\n");
+		return -1;
+	}
+
+	this->hwacc = hwacc;
+	this->network = network;
+	period_ns = 1000000000 / rate_hz;
+
+	pthread_mutex_lock(&ctrl_mutex);
+	fifos_nb = hwacc->accreg_get_fifo_nb();
+	pthread_mutex_unlock(&ctrl_mutex);
+
+	// Associate FIFO layers to monitored FIFOs, the index is the FIFO layer type index
+	stats.clear();
+	stats.resize(fifos_nb);
+	for(auto& s : stats) {
+		memset(&s, 0, sizeof(s));
+	}
+	for(auto layer : network->layers) {
+		if(layer->type != LAYER_FIFO) continue;
+		if(layer->typeidx < fifos_nb) stats[layer->typeidx].layer = layer;
+	}
+
+	series_time.clear();
+	series_samples.clear();
+	sweeps_nb = 0;
+	sweeps_idle = 0;
+
+	stop_req = false;
+	time_beg = Time64_GetReal();
+	int z = pthread_create(&thread, NULL, thread_wrapper, this);
+	if(z != 0) {
+		printf("Warning HwAcc : Failed to launch the FIFO sampling thread\n");
+		return -1;
+	}
+	running = true;
+
+	return 0;
+}
+
+void HwAcc_FifoMon::stop(void) {
+	if(running == false) return;
+	stop_req = true;
+	pthread_join(thread, NULL);
+	running = false;
+}
+
+void* HwAcc_FifoMon::thread_wrapper(void* arg) {
+	HwAcc_FifoMon* fifomon = (HwAcc_FifoMon*)arg;
+	fifomon->sample_loop();
+	return NULL;
+}
+
+void HwAcc_FifoMon::sweep(vector<uint32_t>& sweep_samples) {
+	for(unsigned i=0; i<fifos_nb; i++) {
+		// The control channel is shared with the send and receive threads
+		pthread_mutex_lock(&ctrl_mutex);
+		hwacc->accreg_set_fifosel(i);
+		// A dummy read lets the selection propagate to the observation register
+		hwacc->accreg_sync_read();
+		usleep(15);  // FIXME This should be target-dependent
+		uint32_t r = hwacc->accreg_rd(HwAcc_Common::memreg_fifo_cnt->reg_idx);  // Note : All fields of interest are in the same register
+		pthread_mutex_unlock(&ctrl_mutex);
+
+		uint32_t s = GetMin(HwAcc_Common::memreg_fifo_cnt->Get(r), SAMPLE_CNT);
+		if(HwAcc_Common::memreg_fifo_in_rdy->Get(r)  != 0) s |= SAMPLE_IN_RDY;
+		if(HwAcc_Common::memreg_fifo_in_ack->Get(r)  != 0) s |= SAMPLE_IN_ACK;
+		if(HwAcc_Common::memreg_fifo_out_rdy->Get(r) != 0) s |= SAMPLE_OUT_RDY;
+		if(HwAcc_Common::memreg_fifo_out_ack->Get(r) != 0) s |= SAMPLE_OUT_ACK;
+		sweep_samples[i] = s;
+	}
+}
+
+void HwAcc_FifoMon::sample_loop(void) {
+	vector<uint32_t> sweep_samples(fifos_nb);
+
+	struct timespec ts_next;
+	clock_gettime(CLOCK_MONOTONIC, &ts_next);
+
+	while(stop_req == false) {
+		int64_t now = Time64_GetReal();
+		sweep(sweep_samples);
+		sweeps_nb ++;
+
+		// Skip sweeps where the accelerator is idle
+		bool idle = true;
+		for(unsigned i=0; i<fifos_nb; i++) {
+			uint32_t s = sweep_samples[i];
+			if((s & SAMPLE_CNT) != 0 || (s & SAMPLE_OUT_RDY) != 0 || (s & SAMPLE_IN_ACK) != 0) { idle = false; break; }
+		}
+
+		if(idle == true) {
+			sweeps_idle ++;
+		}
+		else {
+			for(unsigned i=0; i<fifos_nb; i++) {
+				uint32_t s = sweep_samples[i];
+				unsigned cnt = s & SAMPLE_CNT;
+				auto& st = stats[i];
+				st.samples ++;
+				st.sum_cnt += cnt;
+				st.max_cnt = GetMax(st.max_cnt, cnt);
+				if((s & SAMPLE_IN_RDY) == 0) st.nb_full ++;
+				if((s & SAMPLE_OUT_RDY) == 0) st.nb_empty ++;
+				else if((s & SAMPLE_OUT_ACK) == 0) st.nb_blocked ++;
+			}
+			if(series_samples.size() + fifos_nb <= SAMPLES_MAX) {
+				series_time.push_back(now - time_beg);
+				series_samples.insert(series_samples.end(), sweep_samples.begin(), sweep_samples.end());
+			}
+		}
+
+		// Wait until the next period, late sweeps are not caught up
+		uint64_t ns = ts_next.tv_nsec + (uint64_t)period_ns;
+		ts_next.tv_sec += ns / 1000000000;
+		ts_next.tv_nsec = ns % 1000000000;
+		struct timespec ts_now;
+		clock_gettime(CLOCK_MONOTONIC, &ts_now);
+		if(ts_now.tv_sec > ts_next.tv_sec || (ts_now.tv_sec == ts_next.tv_sec && ts_now.tv_nsec > ts_next.tv_nsec)) {
+			ts_next = ts_now;
+		}
+		else {
+			clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts_next, NULL);
+		}
+	}
+}
+
+
+//============================================
+// Analysis
+//============================================
+
+const HwAcc_FifoMon::fifo_stats_t* HwAcc_FifoMon::get_fifo_stats(const Layer* layer) const {
+	if(layer == nullptr || layer->type != LAYER_FIFO) return nullptr;
+	if(layer->typeidx >= stats.size()) return nullptr;
+	const fifo_stats_t* st = &stats[layer->typeidx];
+	if(st->layer != layer || st->samples == 0) return nullptr;
+	return st;
+}
+
+void HwAcc_FifoMon::print_report(void) {
+	printf("Stats HwAcc FIFOs : %" PRIu64 " sweeps of %u FIFOs, %" PRIu64 " idle sweeps discarded\n", sweeps_nb, fifos_nb, sweeps_idle);
+	if(sweeps_nb == sweeps_idle) {
+		printf("  No activity was observed\n");
+		return;
+	}
+
+	printf("  FIFO  Layers                    occupancy  max   full  empty  blocked\n");
+	for(unsigned i=0; i<fifos_nb; i++) {
+		auto& st = stats[i];
+		char buf[64];
+		char buf_prev[24] = "in";
+		char buf_next[24] = "out";
+		if(st.layer != nullptr) {
+			Layer* prev = st.layer->prev;
+			Layer* next = st.layer->next;
+			if(prev != nullptr) snprintf(buf_prev, sizeof(buf_prev), "%s%u", prev->typenamel, prev->typeidx);
+			if(next != nullptr) snprintf(buf_next, sizeof(buf_next), "%s%u", next->typenamel, next->typeidx);
+			snprintf(buf, sizeof(buf), "%s -> %s", buf_prev, buf_next);
+		}
+		else {
+			snprintf(buf, sizeof(buf), "?");
+		}
+		printf("  %4u  %-24s %9.1f  %3u  %4.0f%%  %4.0f%%    %4.0f%%\n", i, buf,
+			(st.samples > 0) ? (double)st.sum_cnt / st.samples : 0, st.max_cnt,
+			ratio(st.nb_full, st.samples) * 100, ratio(st.nb_empty, st.samples) * 100, ratio(st.nb_blocked, st.samples) * 100
+		);
+	}
+
+	// Score layers : backpressure on input FIFOs and starvation of output FIFOs
+	Layer* best_layer = nullptr;
+	double best_score = 0;
+	double best_press = 0;
+	double best_starve = 0;
+	for(auto layer : network->layers) {
+		if(layer->type == LAYER_FIFO) continue;
+
+		double press = -1;
+		double starve = -1;
+		auto eval_in = [&](Layer* l) {
+			auto st = get_fifo_stats(l);
+			if(st != nullptr) press = GetMax(press, ratio(st->nb_blocked, st->samples));
+		};
+		auto eval_out = [&](Layer* l) {
+			auto st = get_fifo_stats(l);
+			if(st != nullptr) starve = GetMax(starve, ratio(st->nb_empty, st->samples));
+		};
+		if(layer->prev_is_arr == true) for(auto l : layer->arr_layers) eval_in(l);
+		else eval_in(layer->prev);
+		if(layer->next_is_arr == true) for(auto l : layer->arr_layers) eval_out(l);
+		else eval_out(layer->next);
+
+		if(press < 0 && starve < 0) continue;
+		double score = 0;
+		if(press >= 0 && starve >= 0) score = (press + starve) / 2;
+		else score = GetMax(press, starve);
+
+		if(best_layer == nullptr || score > best_score) {
+			best_layer = layer;
+			best_score = score;
+			best_press = press;
+			best_starve = starve;
+		}
+	}
+
+	if(best_layer != nullptr && best_score >= 0.5) {
+		printf("  Bottleneck : layer %s%u (score %.2f", best_layer->typenamel, best_layer->typeidx, best_score);
+		if(best_press >= 0) printf(", input FIFO blocked %.0f%%", best_press * 100);
+		if(best_starve >= 0) printf(", output FIFO empty %.0f%%", best_starve * 100);
+		printf("), consider increasing its parallelism\n");
+	}
+	else {
+		// No layer stands out, look at the FIFOs at the boundaries of the accelerator
+		auto st_first = get_fifo_stats(network->layer_first);
+		auto st_last  = get_fifo_stats(network->layer_last);
+		if(st_first != nullptr && ratio(st_first->nb_empty, st_first->samples) >= 0.5) {
+			printf("  Bottleneck : no layer stands out, the first FIFO is mostly empty so the input stream from the host is limiting\n");
+		}
+		else if(st_last != nullptr && ratio(st_last->nb_blocked, st_last->samples) >= 0.5) {
+			printf("  Bottleneck : no layer stands out, the last FIFO is mostly blocked so the output stream to the host is limiting\n");
+		}
+		else {
+			printf("  Bottleneck : no layer stands out\n");
+		}
+	}
+
+	// The occupancy counter observed by the monitor has limited width
+	unsigned cnt_max = uint_genmask(HwAcc_Common::memreg_fifo_cnt->bits);
+
+	// Oversized FIFOs : the observed occupancy stays far below the depth, see nn_size_fifos
+	unsigned oversized_nb = 0;
+	for(unsigned i=0; i<fifos_nb; i++) {
+		auto& st = stats[i];
+		if(st.samples == 0 || st.layer == nullptr) continue;
+		unsigned depth = GetMin(st.layer->fifo_depth, cnt_max);
+		if(st.max_cnt >= depth / 4) continue;
+		if(oversized_nb == 0) printf("  Oversized FIFOs :");
+		printf(" %u (max %u depth %u)", i, st.max_cnt, depth);
+		oversized_nb ++;
+	}
+	if(oversized_nb > 0) printf("\n");
+}
+
+int HwAcc_FifoMon::write_csv(const char* filename) {
+	FILE* F = fopen(filename, "wb");
+	if(F == NULL) {
+		printf("ERROR HwAcc : Can't open file '%s' for writing\n", filename);
+		return -1;
+	}
+
+	fprintf(F, "time_us");
+	for(unsigned i=0; i<fifos_nb; i++) fprintf(F, ",fifo%u", i);
+	fprintf(F, "\n");
+
+	for(unsigned t=0; t<series_time.size(); t++) {
+		fprintf(F, "%.3f", series_time[t] / 1e3);
+		const uint32_t* samples = series_samples.data() + (uint64_t)t * fifos_nb;
+		for(unsigned i=0; i<fifos_nb; i++) fprintf(F, ",%u", samples[i] & SAMPLE_CNT);
+		fprintf(F, "\n");
+	}
+
+	fclose(F);
+	return 0;
+}
+
@@ -0,0 +1,103 @@
+
+#pragma once
+
+extern "C" {
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+}
+
+#include <vector>
+
+class HwAcc_Common;
+class Network;
+class Layer;
+
+
+//============================================
+// Periodic sampler of the FIFOs inside the HW accelerator
+//============================================
+
+// While frames are streamed, a background thread walks all monitored FIFOs at a configurable rate
+// Each sample holds the occupancy and the rdy/ack signals of both sides of the FIFO
+// Sweeps where all FIFOs are empty are discarded, the accelerator is then idle and they give no information on the pipeline
+//
+// The analysis is based on the usual dataflow reasoning :
+//   - a FIFO that is often full, or that holds data not taken by its consumer, indicates that the consumer layer is slow
+//   - a FIFO that is often empty indicates that the producer layer is slow
+// The bottleneck is the layer that has the most backpressure on its input FIFO and the most starvation on its output FIFO
+
+class HwAcc_FifoMon {
+
+	public :
+
+	// Limit on the memory used by the time series
+	static const unsigned SAMPLES_MAX = 4*1024*1024;
+
+	// Packed sample : occupancy in low bits, then flags
+	static const uint32_t SAMPLE_IN_RDY  = 1u << 16;
+	static const uint32_t SAMPLE_IN_ACK  = 1u << 17;
+	static const uint32_t SAMPLE_OUT_RDY = 1u << 18;
+	static const uint32_t SAMPLE_OUT_ACK = 1u << 19;
+	static const uint32_t SAMPLE_CNT     = 0xFFFF;
+
+	typedef struct fifo_stats_t {
+		Layer*   layer;      // The FIFO layer, may be null if it is unknown
+		uint64_t samples;
+		uint64_t sum_cnt;
+		unsigned max_cnt;
+		uint64_t nb_full;    // Input side not ready
+		uint64_t nb_empty;   // Output side not ready
+		uint64_t nb_blocked; // Data present at output side but not taken by the consumer
+	} fifo_stats_t;
+
+	unsigned fifos_nb = 0;
+	std::vector<fifo_stats_t> stats;
+
+	// Time series, one timestamp per kept sweep and one sample per FIFO per sweep
+	std::vector<int64_t>  series_time;
+	std::vector<uint32_t> series_samples;
+
+	uint64_t sweeps_nb = 0;
+	uint64_t sweeps_idle = 0;
+
+	private :
+
+	HwAcc_Common* hwacc = nullptr;
+	Network* network = nullptr;
+	unsigned period_ns = 0;
+	int64_t  time_beg = 0;
+
+	pthread_t thread;
+	volatile bool running = false;
+	volatile bool stop_req = false;
+
+	//============================================
+	// Methods
+	//============================================
+
+	public :
+
+	// Launch the sampling thread, return non-zero on error
+	int  start(HwAcc_Common* hwacc, Network* network, unsigned rate_hz);
+	void stop(void);
+
+	void print_report(void);
+	int  write_csv(const char* filename);
+
+	private :
+
+	static void* thread_wrapper(void* arg);
+	void sample_loop(void);
+	void sweep(std::vector<uint32_t>& sweep_samples);
+
+	inline double ratio(uint64_t nb, uint64_t total) const { return (total > 0) ? (double)nb / total : 0; }
+	const fifo_stats_t* get_fifo_stats(const Layer* layer) const;
+
+};
+
+extern unsigned     param_hw_fifomon_hz;
+extern char const * param_hw_fifomon_csv;
+
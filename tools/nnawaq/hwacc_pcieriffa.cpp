@@ -60,6 +60,8 @@ void HwAcc_PcieRiffa::riffa_atexit(void) {
 //============================================
 
 HwAcc_PcieRiffa::HwAcc_PcieRiffa(void) {
+	// The driver performs DMA directly from user buffers
+	dmabufs.lock = true;
 	riffa_init();
 }
 
@@ -27,6 +27,9 @@ extern "C" {
 #include "nn_load_config.h"
 
 #include "hwacc_common.h"
+#include "nn_out_writer.h"
+
+#include <algorithm>
 
 using namespace std;
 
@@ -155,17 +158,81 @@ typedef struct frame_thread_data_t {
 	HwAcc_Common* hwacc;
 	layer_t* layer;
 	unsigned frames_nb;
+	unsigned frame_first;  // Index of the first frame of the batch
+	OutWriter* outwr;
 } frame_thread_data_t;
 
+// Unpack values of width wdata (power of 2, at most 32) from hardware transfers of transfer_nb32 32b words
+// Each transfer holds par values, starting at LSB of its first 32b word
+// The 8b and 16b cases are written so that the compiler can vectorize the sign or zero extension
+void hwacc_unpack_outputs(const uint32_t* buf, int32_t* values, unsigned nbvalues, unsigned wdata, unsigned par, unsigned transfer_nb32, bool sdata) {
+	unsigned values_per32 = 32 / wdata;
+	unsigned sh = 32 - wdata;
+
+	for(unsigned idx=0; idx<nbvalues; idx+=par, buf+=transfer_nb32) {
+		unsigned nb = GetMin(par, nbvalues - idx);
+		int32_t* dst = values + idx;
+
+		// Note : Values are extracted from the first bytes of the 32b words, this assumes a little-endian host
+		if(wdata == 8 && sdata == true) {
+			const int8_t* src = (const int8_t*)buf;
+			for(unsigned i=0; i<nb; i++) dst[i] = src[i];
+		}
+		else if(wdata == 8) {
+			const uint8_t* src = (const uint8_t*)buf;
+			for(unsigned i=0; i<nb; i++) dst[i] = src[i];
+		}
+		else if(wdata == 16 && sdata == true) {
+			const int16_t* src = (const int16_t*)buf;
+			for(unsigned i=0; i<nb; i++) dst[i] = src[i];
+		}
+		else if(wdata == 16) {
+			const uint16_t* src = (const uint16_t*)buf;
+			for(unsigned i=0; i<nb; i++) dst[i] = src[i];
+		}
+		else if(wdata == 32) {
+			memcpy(dst, buf, nb * sizeof(*dst));
+		}
+		else {
+			// Generic path for widths 1, 2 and 4
+			for(unsigned i=0; i<nb; i++) {
+				uint32_t w = buf[i / values_per32] << (sh - (i % values_per32) * wdata);
+				dst[i] = (sdata == true) ? (int32_t(w) >> sh) : int32_t(w >> sh);
+			}
+		}
+	}
+}
+
+// Pack values of width wdata (power of 2, at most 32) into hardware transfers of transfer_nb32 32b words, same layout as write_frames_inout()
+// The last transfer only contains the useful 32b words, return the number of 32b words written
+unsigned hwacc_pack_inputs(const int* values, unsigned nbvalues, uint32_t* buf, unsigned wdata, unsigned par, unsigned transfer_nb32) {
+	unsigned values_per32 = 32 / wdata;
+	uint32_t mask = uint_genmask(wdata);
+	unsigned nb32 = 0;
+
+	for(unsigned idx=0; idx<nbvalues; idx+=par) {
+		unsigned nb = GetMin(par, nbvalues - idx);
+		unsigned words_nb = (nb == par) ? transfer_nb32 : (nb + values_per32 - 1) / values_per32;
+		uint32_t* dst = buf + nb32;
+		for(unsigned w=0; w<words_nb; w++) dst[w] = 0;
+		for(unsigned i=0; i<nb; i++) {
+			dst[i / values_per32] |= (uint32_t(values[idx + i]) & mask) << ((i % values_per32) * wdata);
+		}
+		nb32 += words_nb;
+	}
+
+	return nb32;
+}
+
 // Wrapper thread routine to call pthread_create on a non-member function
 static void* getoutputs_thread_wrapper(void* arg) {
 	frame_thread_data_t* thdata = (frame_thread_data_t*)arg;
 	HwAcc_Common* hwacc = thdata->hwacc;
-	return hwacc->getoutputs_thread(thdata->layer, thdata->frames_nb);
+	return hwacc->getoutputs_thread(thdata->layer, thdata->frames_nb, thdata->frame_first, thdata->outwr);
 }
 
-// Thread routine to receive NN results while the frames are being sent
-void* HwAcc_Common::getoutputs_thread(layer_t* layer, unsigned frames_nb) {
+// Get the number of values per frame sent by the accelerator, and the number of values that are useful to the user
+void HwAcc_Common::get_outputs_frame_size(layer_t* layer, unsigned* frame_size_p, unsigned* frame_size_user_p) {
 	unsigned frame_size = layer->out_nbframes * ((layer->out_fsize + layer->split_out - 1) / layer->split_out);
 	unsigned frame_size_user = frame_size;
 	Network* network = layer->network;
@@ -178,20 +245,50 @@ void* HwAcc_Common::getoutputs_thread(layer_t* layer, unsigned frames_nb) {
 			frame_size_user = layer->out_nbframes * ((neurons            + layer->split_out - 1) / layer->split_out);
 		}
 	}
-	unsigned frame_extra = frame_size - frame_size_user;
 
-	// FIXME Support width other than 32
-	if(accreg_wdo != 32) {
-		printf("Warning HwAcc : Hardware output width is %u but currently only 32 is supported\n", accreg_wdo);
-	}
+	*frame_size_p = frame_size;
+	*frame_size_user_p = frame_size_user;
+}
 
-	unsigned nb32 = frames_nb * frame_size;
-	unsigned nb32_rnd_if = uint_next_multiple(nb32, accreg_ifw32);
-	int32_t* buf = (int32_t*)malloc(nb32_rnd_if * sizeof(*buf));
+// Thread routine to receive NN results while the frames are being sent
+void* HwAcc_Common::getoutputs_thread(layer_t* layer, unsigned frames_nb, unsigned frame_first, OutWriter* outwr) {
+	unsigned frame_size = 0;
+	unsigned frame_size_user = 0;
+	get_outputs_frame_size(layer, &frame_size, &frame_size_user);
+
+	// Output values are packed by the accelerator the same way the input values are packed by write_frames_inout()
+	// Each hardware transfer contains PAR_OUT values of WDO bits, starting at LSB of the first 32b word of the transfer
+	// Transfers are aligned to the interface width, except the last one that only contains the useful 32b words
+	if(accreg_wdo > 32) {
+		printf("Warning HwAcc : Hardware output width is %u but at most 32 is supported\n", accreg_wdo);
+	}
+	unsigned wdo = GetMin(accreg_wdo, 32);
+	unsigned values_per32 = 32 / wdo;
+	unsigned paro = GetMax(accreg_paro, 1);
+	unsigned transfer_nb32 = GetMax(accreg_ifw32, (paro + values_per32 - 1) / values_per32);
+
+	unsigned nbvalues = frames_nb * frame_size;
+	unsigned full_transfers_nb = nbvalues / paro;
+	unsigned last_values_nb = nbvalues % paro;
+	unsigned nb32 = full_transfers_nb * transfer_nb32 + (last_values_nb + values_per32 - 1) / values_per32;
+	unsigned nb32_rnd_if = uint_next_multiple(nb32, transfer_nb32);
+
+	uint32_t* buf = dmabuf_get(nb32_rnd_if);
+	if(buf == nullptr) {
+		printf("ERROR HwAcc : Failed to allocate a buffer of %u 32b words for the results\n", nb32_rnd_if);
+		return NULL;
+	}
 	// In case of timeout, clear the buffer for debug
 	if(param_timeout_recv_us > 0) memset(buf, 0, nb32_rnd_if * sizeof(*buf));
 
-	printf("Info HwAcc : Expecting to receive %u 32-bit words from the accelerator\n", nb32);
+	// When values are already 32-bit and contiguous, no unpacking is needed
+	bool need_unpack = (wdo < 32 || transfer_nb32 != paro);
+	int32_t* values = (int32_t*)buf;
+	if(need_unpack == true) {
+		values = (int32_t*)malloc(nbvalues * sizeof(*values));
+	}
+
+	printf("Info HwAcc : Expecting to receive %u 32-bit words from the accelerator (%u values of %u bits)\n", nb32, nbvalues, wdo);
 	if(param_debug==true) {
 		printf("DEBUG HwAcc : Asking for %u 32-bit words (buffer of %u words)\n", nb32, nb32_rnd_if);
 	}
@@ -199,49 +296,174 @@ void* HwAcc_Common::getoutputs_thread(layer_t* layer, unsigned frames_nb) {
 	// For some HwAcc backends, concurrent access to the control channel must be protected
 	// FIXME This may require a config flag in HwAcc object because some backends don't need this
 	pthread_mutex_lock(&ctrl_mutex);
-	accreg_set_nboutputs(nb32);
+	accreg_set_nboutputs(nbvalues);
 	pthread_mutex_unlock(&ctrl_mutex);
 
 	// Launch the receive operation
-	int recv_nb32 = fpga_recv32((uint32_t*)buf, nb32);
+	bool hist = (param_hw_hist == true || param_hw_hist_json != NULL);
+	if(hist == true) timing.recv_begin(frames_nb, frame_size, paro, transfer_nb32);
+	int recv_nb32 = fpga_recv32(buf, nb32);
+	if(hist == true) timing.recv_end(GetMax(recv_nb32, 0));
 	if(param_debug == true) {
 		printf("DEBUG HwAcc : Revc() returned %i\n", recv_nb32);
 		pthread_mutex_lock(&ctrl_mutex);
 		unsigned hwr_got = accreg_get_nboutputs();
 		pthread_mutex_unlock(&ctrl_mutex);
-		printf("DEBUG HwAcc : Hardware counters indicate the network produced %u results (%+i)\n", hwr_got, hwr_got - recv_nb32);
+		printf("DEBUG HwAcc : Hardware counters indicate the network produced %u results (%+i)\n", hwr_got, (int)(hwr_got - nbvalues));
 	}
 	if(recv_nb32 < (int)nb32) {
-		printf("Warning HwAcc : Received %i values from the accelerator, instead of %u\n", recv_nb32, nb32);
+		printf("Warning HwAcc : Received %i 32b words from the accelerator, instead of %u\n", recv_nb32, nb32);
 	}
 
-	if(param_noout==false) {
+	// Unpack and sign-extend the received values
+	if(need_unpack == true) {
+		hwacc_unpack_outputs(buf, values, nbvalues, wdo, paro, transfer_nb32, layer->out_sdata);
+	}
+
+	// Decode the outputs into boxes, instead of writing raw values
+	LayerRegion* region = layer->network->layer_region;
+	if(param_noout==false && region != nullptr && region->decodes(layer) == true) {
+		vector<RegionBox> boxes;
+		region->decode(layer, values, frames_nb, frame_size, frame_first, boxes);
+		region->write_boxes(Fo, boxes);
+	}
+	else if(param_noout==false && outwr != nullptr) {
 
 		unsigned mask = (unsigned)~0;
 		if(param_out_mask==true) mask = uint_genmask(layer->out_wdata);
 
 		// Display
+		if(outwr->IsActive() == false) {
+			outwr->begin(Fo, param_out_bin, layer->out_wdata, layer->out_sdata, frame_size_user);
+		}
+		// Note : When neurons_max is used, the extra padding values at end of each frame are skipped
 		unsigned bufidx = 0;
 		for(unsigned f=0; f<frames_nb; f++) {
-			if(Fo==stdout) printf("RESULT: Frame %u: ", f);
-			for(unsigned r=0; r<frame_size_user; r++) {
-				if(param_out_nl > 0 && r > 0 && r % param_out_nl == 0) fprintf(Fo, "\n");
-				else if(r > 0 && param_out_sep != NULL) fprintf(Fo, "%s", param_out_sep);
-				fprintf(Fo, param_out_format, buf[bufidx++] & mask);
-			}
-			bufidx += frame_extra;
-			fprintf(Fo, "\n");
-			if(param_out_nl > 0) fprintf(Fo, "\n");
+			outwr->frame(f, values + bufidx, frame_size_user, 1, mask);
+			bufidx += frame_size;
 		}  // Loop on frames
 
 	}  // param_noout == false
 
 	// Clean
-	free(buf);
+	if(values != (int32_t*)buf) free(values);
+	dmabuf_put(buf);
 
 	return NULL;
 }
 
+// Auto-tuning of the number of frames per batch
+// Objective max frames/s : The batch size is doubled as long as the throughput improves by more than 5%, then the best size is kept
+// Objective p99 latency : The batch size is scaled so that the p99 of recent batch latencies approaches 90% of the target
+// The latency of a batch is the time from the start of loading its frames to the end of the reception of its results
+
+class HwAcc_BatchTuner {
+
+	public :
+
+	unsigned mode = BUFSZ_AUTO_NONE;
+	double   lat_target = 0;
+
+	unsigned frames_max = 1;
+	unsigned frames_cur = 1;
+
+	private :
+
+	static const unsigned WINDOW_SIZE = 64;
+
+	// For objective of max throughput
+	bool     settled = false;
+	double   best_fps = 0;
+	unsigned best_frames = 0;
+
+	// Window of recent batch latencies, for objective of latency
+	std::vector<double> window;
+
+	// Stats at the current operating point
+	unsigned stat_frames = 0;
+	double   stat_time = 0;
+	std::vector<double> stat_lat;
+
+	static double percentile(std::vector<double> vec, double p) {
+		if(vec.empty()) return 0;
+		sort(vec.begin(), vec.end());
+		unsigned idx = ceil(p * vec.size()) - 1;
+		return vec[GetMin(idx, vec.size() - 1)];
+	}
+
+	inline void set_frames(unsigned nb) {
+		nb = GetMax(nb, 1u);
+		nb = GetMin(nb, frames_max);
+		if(nb != frames_cur) {
+			stat_frames = 0;
+			stat_time = 0;
+			stat_lat.clear();
+			window.clear();
+		}
+		frames_cur = nb;
+	}
+
+	public :
+
+	void init(unsigned mode, unsigned long lat_us, unsigned frames_max) {
+		this->mode = mode;
+		this->lat_target = lat_us / 1e6;
+		this->frames_max = GetMax(frames_max, 1u);
+		// Start with small batches, they are fast to measure
+		frames_cur = (mode == BUFSZ_AUTO_NONE) ? this->frames_max : 1;
+	}
+
+	// Only full batches are given, the time of the batch in seconds includes both file processing and accelerator
+	void update(unsigned frames_nb, double time_file, double time_nn) {
+		double time_batch = time_file + time_nn;
+		stat_frames += frames_nb;
+		stat_time   += time_batch;
+		stat_lat.push_back(time_batch);
+		if(stat_lat.size() > WINDOW_SIZE) stat_lat.erase(stat_lat.begin());
+
+		if(mode == BUFSZ_AUTO_FPS) {
+			if(settled == true) return;
+			double fps = frames_nb / time_batch;
+			if(fps > best_fps * 1.05) {
+				best_fps = fps;
+				best_frames = frames_cur;
+				if(frames_cur >= frames_max) settled = true;
+				else set_frames(frames_cur * 2);
+			}
+			else {
+				settled = true;
+				set_frames(best_frames);
+			}
+		}
+
+		else if(mode == BUFSZ_AUTO_LAT) {
+			window.push_back(time_batch);
+			// Shrink immediately when the target is exceeded, otherwise wait for a few samples
+			if(time_batch <= lat_target && window.size() < 4) return;
+			double p99 = percentile(window, 0.99);
+			double ratio = (0.9 * lat_target) / p99;
+			ratio = GetMax(ratio, 0.5);
+			ratio = GetMin(ratio, 2.0);
+			unsigned nb = frames_cur * ratio;
+			if(ratio > 1 && nb == frames_cur) nb++;
+			set_frames(nb);
+			if(window.size() > WINDOW_SIZE) window.erase(window.begin());
+		}
+	}
+
+	void print_stats(void) {
+		if(mode == BUFSZ_AUTO_NONE) return;
+		printf("Info HwAcc : Auto batch size, objective %s", mode == BUFSZ_AUTO_FPS ? "max frames/s" : "p99 latency");
+		if(mode == BUFSZ_AUTO_LAT) printf(" under %g ms", lat_target * 1e3);
+		printf(" : chose %u frames per batch (max %u)\n", frames_cur, frames_max);
+		if(stat_lat.empty() == true) return;
+		printf("  Measured at this point : %g frames/s, batch latency p50 %g ms, p99 %g ms\n",
+			stat_frames / stat_time, percentile(stat_lat, 0.50) * 1e3, percentile(stat_lat, 0.99) * 1e3
+		);
+	}
+
+};
+
 int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, layer_t* outlayer, layer_t* last_layer) {
 	int64_t totime_file = 0;
 	int64_t totime_nn = 0;
@@ -256,9 +478,11 @@ int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, lay
 	}
 
 	// Set primary write mode
+	pthread_mutex_lock(&ctrl_mutex);
 	accreg_set_wmode_frame();
 	// Make sure the mode is correctly taken into account
 	accreg_sync_read();
+	pthread_mutex_unlock(&ctrl_mutex);
 
 	// FIXME The network is only necessary to get a few values such as fsize and PAR
 	Network* network = inlayer->network;
@@ -279,13 +503,28 @@ int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, lay
 	}
 	if(param_fn > 0 && max_frames_nb > param_fn) max_frames_nb = param_fn;
 
+	// The buffer is allocated for the max size, the tuner decides how much of it is used
+	HwAcc_BatchTuner tuner;
+	tuner.init(param_bufsz_auto, param_bufsz_lat_us, max_frames_nb);
+	if(param_freerun == true && param_bufsz_auto != BUFSZ_AUTO_NONE) {
+		printf("Warning HwAcc : Auto batch size is not possible in free run mode, it is disabled\n");
+		tuner.init(BUFSZ_AUTO_NONE, 0, max_frames_nb);
+	}
+	int64_t batch_time_file = 0;
+
 	// Compute the number of 32b words needed for the buffer, rounded to upper multiple of transfer size
 	// Note : Frames are contiguous in input buffer
 	unsigned alloc_transfers_nb = (uint64_t(max_frames_nb) * fsize + accreg_pari - 1) / accreg_pari;
 	unsigned alloc_nb32 = alloc_transfers_nb * accreg_ifw32;
 
 	// Allocate the buffer that will be sent directly to the hardware
-	uint32_t* databuf = (uint32_t*)malloc(alloc_nb32 * sizeof(*databuf));
+	dmabufs.huge = param_hw_hugepages;
+	uint32_t* databuf = dmabuf_get(alloc_nb32);
+	if(databuf == nullptr) {
+		printf("ERROR HwAcc : Failed to allocate a buffer of %u 32b words\n", alloc_nb32);
+		fclose(F);
+		return -1;
+	}
 	int* framebuf = (int*)malloc(fsize * sizeof(*framebuf));
 
 	// This is aligned to hardware transfer boundary
@@ -294,6 +533,9 @@ int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, lay
 	unsigned databuf_nb32 = 0;
 	unsigned databuf_nbvalues = 0;
 
+	// The writer for results, shared by the successive receiving threads
+	OutWriter outwr;
+
 	// Accumulator of frame values
 	uint64_t buf64 = 0;
 	unsigned buf64_bits = 0;  // Number of bits in the current 32-bit word
@@ -305,11 +547,18 @@ int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, lay
 
 	load_warnings_clear();
 
+	// Timing histograms, only when requested
+	bool hist = (param_hw_hist == true || param_hw_hist_json != NULL);
+	int64_t hist_time = 0;
+	timing.clear();
+
 	// Force set free run mode each time, to reset the output counter
+	pthread_mutex_lock(&ctrl_mutex);
 	accreg_freerun_out_clear();
 	if(param_freerun==true) {
 		accreg_freerun_out_set();
 	}
+	pthread_mutex_unlock(&ctrl_mutex);
 
 	// Only to know the execution time
 	oldtime = Time64_GetReal();
@@ -318,6 +567,7 @@ int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, lay
 	do {
 
 		// Get one frame
+		if(hist == true) hist_time = Time64_GetReal();
 		int r = loadfile_oneframe(F, framebuf, fsize, param_multiline);
 		if(r < 0 && param_floop==true && param_fn > 0) {
 			// Sanity check to avoid infinite loop
@@ -330,6 +580,12 @@ int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, lay
 		// Add the frame to the big buffer
 		if(r >= 0) {
 
+			if(hist == true) {
+				int64_t t = Time64_GetReal();
+				timing.hists[HwAcc_Timing::FRAME_PARSE].record(t - hist_time);
+				hist_time = t;
+			}
+
 			// If needed, reorder image data
 			if(inlayer->fx > 1 || inlayer->fy > 1) {
 				unsigned fx = inlayer->fx;
@@ -375,6 +631,10 @@ int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, lay
 				}
 			}
 
+			if(hist == true) {
+				timing.hists[HwAcc_Timing::FRAME_PACK].record(Time64_GetReal() - hist_time);
+			}
+
 			// Increment frame counters
 			curframes_nb ++;
 			totalframes_nb ++;
@@ -382,7 +642,7 @@ int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, lay
 
 		// If the big buffer contains enough frames, send that
 		if(
-			(curframes_nb >= max_frames_nb) ||
+			(curframes_nb >= tuner.frames_cur) ||
 			(param_fn > 0 && totalframes_nb >= param_fn) ||
 			(curframes_nb > 0 && r<0)
 		) {
@@ -399,6 +659,8 @@ int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, lay
 			// Only to know the execution time
 			newtime = Time64_GetReal();
 			totime_file += newtime - oldtime;
+			batch_time_file = newtime - oldtime;
+			if(hist == true) timing.hists[HwAcc_Timing::BATCH_PARSE].record(batch_time_file);
 
 			printf("Info HwAcc: Starting the receiving thread...\n");
 
@@ -418,6 +680,11 @@ int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, lay
 			thdata.hwacc = this;
 			thdata.layer = outlayer;
 			thdata.frames_nb = curframes_nb;
+			thdata.frame_first = totalframes_nb - curframes_nb;
+			thdata.outwr = &outwr;
+
+			// The control channel is shared with the FIFO sampler
+			pthread_mutex_lock(&ctrl_mutex);
 
 			// FIXME Reset the entire HW accelerator
 			#if 1
@@ -444,6 +711,8 @@ int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, lay
 			accreg_set_recv2(0);
 			accreg_sync_read();
 
+			pthread_mutex_unlock(&ctrl_mutex);
+
 			// Launch receive thread
 			if(param_freerun==false) {
 				pthread_create(&th_get, NULL, getoutputs_thread_wrapper, &thdata);
@@ -479,7 +748,9 @@ int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, lay
 			pthread_mutex_unlock(&ctrl_mutex);
 
 			// Send the data buffer to the FPGA
+			if(hist == true) timing.send_begin();
 			int sent_nb32 = fpga_send32(databuf, databuf_nb32);
+			if(hist == true) timing.send_end(GetMax(sent_nb32, 0));
 			printf("Info HwAcc : Data sent\n");
 			if(param_debug == true) {
 				printf("DEBUG HwAcc : Send() returned %u\n", sent_nb32);
@@ -503,6 +774,14 @@ int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, lay
 			// Only to know the execution time
 			newtime = Time64_GetReal();
 			totime_nn += newtime - oldtime;
+
+			// Adjust the batch size, partial batches at end of file are not representative
+			if(curframes_nb >= tuner.frames_cur) {
+				unsigned prev_frames = tuner.frames_cur;
+				tuner.update(curframes_nb, TimeDouble_From64(batch_time_file), TimeDouble_From64(newtime - oldtime));
+				// Receive buffers sized for the previous batch size are not kept
+				if(tuner.frames_cur != prev_frames) dmabufs.clear();
+			}
 			oldtime = newtime;
 
 			// Debug : To cover transmission latencies, also query and print the amount of sent data after the results have been received
@@ -512,12 +791,15 @@ int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, lay
 					// FIXME Replace by polling on busy flag (to be implemented)
 					usleep(100*1000);
 				}
+				pthread_mutex_lock(&ctrl_mutex);
 				unsigned hwr = accreg_get_nbinputs();
+				pthread_mutex_unlock(&ctrl_mutex);
 				printf("DEBUG HwAcc : Hardware counters indicate the network received %u inputs (%+i)\n", hwr, hwr - databuf_nbtransfers);
 			}
 
 			// Reset counters for next big buffer of frames
 			curframes_nb = 0;
+			databuf_ref32_transfer = 0;
 			databuf_nb32 = 0;
 			databuf_nbvalues = 0;
 		}
@@ -529,11 +811,19 @@ int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, lay
 
 	} while(1);  // Read the lines of the file
 
+	// Flush the results
+	if(outwr.IsActive() == true) {
+		int z = outwr.end();
+		if(z != 0) printf("ERROR HwAcc : Failed to write the results\n");
+	}
+
 	// Clean
-	free(databuf);
+	dmabuf_put(databuf);
 	free(framebuf);
 	fclose(F);
 
+	if(param_debug==true) dmabufs.print_stats();
+
 	if(totalframes_nb==0) {
 		printf("ERROR HwAcc : No frames were found in file '%s'\n", filename);
 		return -1;
@@ -546,10 +836,384 @@ int HwAcc_Common::write_frames_inout(const char* filename, layer_t* inlayer, lay
 	printf("  Time, file .. %g s, %g frames/s\n", diff, totalframes_nb / diff);
 	diff = TimeDouble_From64(totime_nn);
 	printf("  Time, FPGA .. %g s, %g frames/s\n", diff, totalframes_nb / diff);
+	print_stream_stats();
+	tuner.print_stats();
+	if(param_hw_hist == true) timing.print();
+	if(param_hw_hist_json != NULL) timing.write_json(param_hw_hist_json);
+
+	return 0;
+}
+
+// Low-latency mode : frames are processed one at a time, for interactive usage
+// Buffers are allocated and output settings are applied once, then for each frame the send and receive operations are done from the calling thread
+// Nothing is printed and nothing is allocated on the path of one frame, results are written after all frames are processed
+int HwAcc_Common::write_frames_lowlat(const char* filename, layer_t* inlayer, layer_t* outlayer, layer_t* last_layer) {
+	Network* network = inlayer->network;
+	unsigned fsize = inlayer->fsize;
+
+	FILE* F = fopen(filename, "rb");
+	if(F==NULL) {
+		printf("ERROR HwAcc : Can't open file '%s'\n", filename);
+		return -1;
+	}
+
+	// Load all frames beforehand, so file parsing is not accounted in latency
+	vector<int> frames;
+	unsigned frames_nb = 0;
+	int* framebuf = (int*)malloc(fsize * sizeof(*framebuf));
+	load_warnings_clear();
+	do {
+		if(param_fn > 0 && frames_nb >= param_fn) break;
+		int r = loadfile_oneframe(F, framebuf, fsize, param_multiline);
+		if(r < 0) break;
+		// If needed, reorder image data
+		if(inlayer->fx > 1 || inlayer->fy > 1) {
+			reorder_to_zfirst_dim2(&framebuf, 1, fsize, inlayer->fx, inlayer->fy, inlayer->fz, 0);
+		}
+		frames.insert(frames.end(), framebuf, framebuf + fsize);
+		frames_nb ++;
+	} while(1);
+	free(framebuf);
+	fclose(F);
+
+	if(frames_nb==0) {
+		printf("ERROR HwAcc : No frames were found in file '%s'\n", filename);
+		return -1;
+	}
+
+	// With file loop, the loaded frames are sent again until the desired number of frames is reached
+	unsigned totalframes_nb = frames_nb;
+	if(param_floop==true && param_fn > frames_nb) totalframes_nb = param_fn;
+
+	// Size of the inputs, the last transfer of a frame only contains the useful 32b words
+	unsigned in_values_per32 = 32 / accreg_wdi;
+	unsigned in_transfer_nb32 = GetMax(accreg_ifw32, (accreg_pari + in_values_per32 - 1) / in_values_per32);
+	unsigned in_nb32 = ((fsize + accreg_pari - 1) / accreg_pari) * in_transfer_nb32;
+	unsigned in_nbtransfers = fsize / inlayer->split_in;
+
+	// Size of the outputs, same computation than in getoutputs_thread()
+	unsigned frame_size = 0;
+	unsigned frame_size_user = 0;
+	get_outputs_frame_size(outlayer, &frame_size, &frame_size_user);
+
+	unsigned wdo = GetMin(accreg_wdo, 32);
+	unsigned out_values_per32 = 32 / wdo;
+	unsigned paro = GetMax(accreg_paro, 1);
+	unsigned out_transfer_nb32 = GetMax(accreg_ifw32, (paro + out_values_per32 - 1) / out_values_per32);
+	unsigned out_nb32 = (frame_size / paro) * out_transfer_nb32 + ((frame_size % paro) + out_values_per32 - 1) / out_values_per32;
+	unsigned out_nb32_rnd_if = uint_next_multiple(out_nb32, out_transfer_nb32);
+
+	// Aligned buffers, suited to DMA transfers
+	dmabufs.huge = param_hw_hugepages;
+	uint32_t* inbuf = dmabuf_get(in_nb32);
+	uint32_t* outbuf = dmabuf_get(out_nb32_rnd_if);
+	if(inbuf == nullptr || outbuf == nullptr) {
+		printf("ERROR HwAcc : Failed to allocate aligned buffers\n");
+		dmabuf_put(inbuf);
+		dmabuf_put(outbuf);
+		return -1;
+	}
+	memset(outbuf, 0, out_nb32_rnd_if * sizeof(*outbuf));
+
+	// Results of all frames, and latency of all frames
+	vector<int32_t> values(uint64_t(totalframes_nb) * frame_size);
+	vector<int64_t> lat_total(totalframes_nb);
+	vector<int64_t> lat_host(totalframes_nb);
+	unsigned errors_nb = 0;
+
+	// Clear the accelerator and set the output selection, same as the batch path after each clear
+	// The control channel must be locked, it is shared with the FIFO sampler
+	auto clear_and_arm = [&](void) {
+		accreg_clear();
+		accreg_sync_read();
+		accreg_set_wmode_frame();
+		accreg_freerun_out_clear();
+		if(accreg_selout==true && network->param_selout==true && outlayer != last_layer) {
+			accreg_set_recv1(outlayer->id);
+		}
+		else {
+			accreg_set_recv_out();
+		}
+		accreg_set_recv2(0);
+		accreg_sync_read();
+	};
+
+	// Pre-arm the accelerator once
+	pthread_mutex_lock(&ctrl_mutex);
+	clear_and_arm();
+	pthread_mutex_unlock(&ctrl_mutex);
+
+	// When the frame size is not a multiple of the input parallelism, the padding of the last transfer must be dropped by a clear
+	bool need_clear = (fsize % accreg_pari) != 0;
+
+	// Timing histograms, only when requested
+	bool hist = (param_hw_hist == true || param_hw_hist_json != NULL);
+	timing.clear();
+
+	printf("Info HwAcc : Low-latency mode, %u frames, %u 32b words per frame sent, %u 32b words per frame received\n",
+		totalframes_nb, in_nb32, out_nb32
+	);
+
+	for(unsigned f=0; f<totalframes_nb; f++) {
+		int64_t time_beg = Time64_GetReal();
+
+		pthread_mutex_lock(&ctrl_mutex);
+		if(need_clear == true) clear_and_arm();
+		accreg_set_nboutputs(frame_size);
+		accreg_set_nbinputs(in_nbtransfers);
+		pthread_mutex_unlock(&ctrl_mutex);
+
+		const int* frame = frames.data() + uint64_t(f % frames_nb) * fsize;
+		int64_t time_pack = (hist == true) ? Time64_GetReal() : 0;
+		unsigned nb32 = hwacc_pack_inputs(frame, fsize, inbuf, accreg_wdi, accreg_pari, in_transfer_nb32);
+
+		int64_t time_send = Time64_GetReal();
+		if(hist == true) {
+			timing.hists[HwAcc_Timing::FRAME_PACK].record(time_send - time_pack);
+			timing.send_begin();
+		}
+		unsigned sent_nb32 = fpga_send32(inbuf, nb32);
+		if(hist == true) {
+			timing.send_end(sent_nb32);
+			timing.recv_begin(1, frame_size, paro, out_transfer_nb32);
+		}
+		unsigned recv_nb32 = fpga_recv32(outbuf, out_nb32);
+		if(hist == true) timing.recv_end(recv_nb32);
+		int64_t time_recv = Time64_GetReal();
+
+		if(sent_nb32 != nb32 || recv_nb32 != out_nb32) errors_nb ++;
+
+		hwacc_unpack_outputs(outbuf, values.data() + uint64_t(f) * frame_size, frame_size, wdo, paro, out_transfer_nb32, outlayer->out_sdata);
+
+		int64_t time_end = Time64_GetReal();
+		lat_total[f] = time_end - time_beg;
+		lat_host[f] = (time_send - time_beg) + (time_end - time_recv);
+	}
+
+	if(errors_nb > 0) {
+		printf("Warning HwAcc : Incomplete transfers for %u frames\n", errors_nb);
+	}
+
+	// Write the results, or the decoded boxes
+	if(param_noout==false && network->layer_region != nullptr && network->layer_region->decodes(outlayer) == true) {
+		vector<RegionBox> boxes;
+		network->layer_region->decode(outlayer, values.data(), totalframes_nb, frame_size, 0, boxes);
+		network->layer_region->write_boxes(Fo, boxes);
+	}
+	else if(param_noout==false) {
+		unsigned mask = (unsigned)~0;
+		if(param_out_mask==true) mask = uint_genmask(outlayer->out_wdata);
+		OutWriter outwr;
+		outwr.begin(Fo, param_out_bin, outlayer->out_wdata, outlayer->out_sdata, frame_size_user);
+		for(unsigned f=0; f<totalframes_nb; f++) {
+			outwr.frame(f, values.data() + uint64_t(f) * frame_size, frame_size_user, 1, mask);
+		}
+		int z = outwr.end();
+		if(z != 0) printf("ERROR HwAcc : Failed to write the results\n");
+	}
+
+	dmabuf_put(inbuf);
+	dmabuf_put(outbuf);
+
+	// Print stats
+	int64_t sum_total = 0;
+	int64_t sum_host = 0;
+	for(unsigned f=0; f<totalframes_nb; f++) {
+		sum_total += lat_total[f];
+		sum_host += lat_host[f];
+	}
+	sort(lat_total.begin(), lat_total.end());
+	sort(lat_host.begin(), lat_host.end());
+
+	auto percentile = [&](vector<int64_t>& vec, double p) {
+		unsigned idx = ceil(p * vec.size()) - 1;
+		return TimeDouble_From64(vec[GetMin(idx, vec.size() - 1)]) * 1e6;
+	};
+
+	printf("Stats HwAcc :\n");
+	printf("  Frames ...... %u\n", totalframes_nb);
+	printf("  Latency (us)   mean        p50        p99        max\n");
+	printf("  Total ..... %9.2f  %9.2f  %9.2f  %9.2f\n",
+		TimeDouble_From64(sum_total) * 1e6 / totalframes_nb, percentile(lat_total, 0.50), percentile(lat_total, 0.99), percentile(lat_total, 1)
+	);
+	printf("  Host ...... %9.2f  %9.2f  %9.2f  %9.2f\n",
+		TimeDouble_From64(sum_host) * 1e6 / totalframes_nb, percentile(lat_host, 0.50), percentile(lat_host, 0.99), percentile(lat_host, 1)
+	);
+
+	// Histogram of total latency, with power-of-2 bins in microseconds
+	printf("  Histogram of total latency :\n");
+	unsigned bin_beg = 0;
+	while(bin_beg < totalframes_nb) {
+		unsigned us = TimeDouble_From64(lat_total[bin_beg]) * 1e6;
+		unsigned bin_max = uint_rndpow2_ceil(us + 1);
+		unsigned bin_end = bin_beg;
+		while(bin_end < totalframes_nb && TimeDouble_From64(lat_total[bin_end]) * 1e6 < bin_max) bin_end++;
+		printf("    < %8u us : %u\n", bin_max, bin_end - bin_beg);
+		bin_beg = bin_end;
+	}
+
+	if(param_hw_hist == true) timing.print();
+	if(param_hw_hist_json != NULL) timing.write_json(param_hw_hist_json);
 
 	return 0;
 }
 
+typedef struct process_recv_data_t {
+	HwAcc_Common* hwacc;
+	uint32_t* buf;
+	unsigned  nb32;
+	unsigned  got_nb32;
+} process_recv_data_t;
+
+static void* process_recv_thread(void* arg) {
+	process_recv_data_t* data = (process_recv_data_t*)arg;
+	data->got_nb32 = data->hwacc->fpga_recv32(data->buf, data->nb32);
+	return NULL;
+}
+
+// Process a batch of frames that are already in memory, for callers that are not based on files
+// Input values are in the order expected by the accelerator, the accelerator must already be configured
+// The output buffer receives frame_size values per frame, see get_outputs_frame_size()
+int HwAcc_Common::process_frames(Network* network, layer_t* outlayer, const int* values, unsigned frames_nb, int32_t* values_out) {
+	layer_t* last_layer = NULL;
+	for(layer_t* layer = network->layer_last; layer != NULL; layer = layer->prev) {
+		if(layer->type != LAYER_FIFO) { last_layer = layer; break; }
+	}
+	layer_t* inlayer = NULL;
+	for(layer_t* layer = network->layer_first; layer != NULL; layer = layer->next) {
+		if(layer->type != LAYER_FIFO) { inlayer = layer; break; }
+	}
+	if(inlayer == NULL || last_layer == NULL) {
+		printf("ERROR HwAcc : Could not find first and last layers\n");
+		return -1;
+	}
+	if(outlayer == NULL) outlayer = last_layer;
+
+	unsigned frame_size = 0;
+	unsigned frame_size_user = 0;
+	get_outputs_frame_size(outlayer, &frame_size, &frame_size_user);
+
+	// Layout of inputs, same than write_frames_lowlat()
+	unsigned nbvalues_in = frames_nb * inlayer->fsize;
+	unsigned pari = GetMax(accreg_pari, 1);
+	unsigned in_values_per32 = 32 / accreg_wdi;
+	unsigned in_transfer_nb32 = GetMax(accreg_ifw32, (pari + in_values_per32 - 1) / in_values_per32);
+	unsigned in_nb32 = ((nbvalues_in + pari - 1) / pari) * in_transfer_nb32;
+
+	// Layout of outputs, same than getoutputs_thread()
+	unsigned nbvalues_out = frames_nb * frame_size;
+	unsigned wdo = GetMin(accreg_wdo, 32);
+	unsigned paro = GetMax(accreg_paro, 1);
+	unsigned out_values_per32 = 32 / wdo;
+	unsigned out_transfer_nb32 = GetMax(accreg_ifw32, (paro + out_values_per32 - 1) / out_values_per32);
+	unsigned out_nb32 = (nbvalues_out / paro) * out_transfer_nb32 + ((nbvalues_out % paro) + out_values_per32 - 1) / out_values_per32;
+	unsigned out_nb32_rnd_if = uint_next_multiple(out_nb32, out_transfer_nb32);
+
+	uint32_t* inbuf = dmabuf_get(in_nb32);
+	uint32_t* outbuf = dmabuf_get(out_nb32_rnd_if);
+	if(inbuf == nullptr || outbuf == nullptr) {
+		printf("ERROR HwAcc : Failed to allocate buffers for %u frames\n", frames_nb);
+		dmabuf_put(inbuf);
+		dmabuf_put(outbuf);
+		return -1;
+	}
+
+	unsigned nb32 = hwacc_pack_inputs(values, nbvalues_in, inbuf, accreg_wdi, pari, in_transfer_nb32);
+	memset(outbuf, 0, out_nb32_rnd_if * sizeof(*outbuf));
+
+	// Set up the accelerator for this batch, like write_frames_inout()
+	pthread_mutex_lock(&ctrl_mutex);
+	accreg_clear();
+	accreg_sync_read();
+	accreg_set_wmode_frame();
+	accreg_freerun_out_clear();
+	if(accreg_selout==true && network->param_selout==true && outlayer != last_layer) {
+		accreg_set_recv1(outlayer->id);
+	}
+	else {
+		accreg_set_recv_out();
+	}
+	accreg_set_recv2(0);
+	accreg_sync_read();
+	accreg_set_nboutputs(nbvalues_out);
+	accreg_set_nbinputs(nbvalues_in / network->layer_first->split_in);
+	pthread_mutex_unlock(&ctrl_mutex);
+
+	// Receive from another thread, so the accelerator is never blocked on its output side
+	process_recv_data_t recv_data;
+	recv_data.hwacc = this;
+	recv_data.buf = outbuf;
+	recv_data.nb32 = out_nb32;
+	recv_data.got_nb32 = 0;
+
+	pthread_t th_recv;
+	pthread_create(&th_recv, NULL, process_recv_thread, &recv_data);
+	unsigned sent_nb32 = fpga_send32(inbuf, nb32);
+	pthread_join(th_recv, NULL);
+
+	int z = 0;
+	if(sent_nb32 < nb32 || recv_data.got_nb32 < out_nb32) {
+		printf("Warning HwAcc : Incomplete transfers for a batch of %u frames : sent %u/%u, received %u/%u 32b words\n",
+			frames_nb, sent_nb32, nb32, recv_data.got_nb32, out_nb32
+		);
+		z = -1;
+	}
+
+	hwacc_unpack_outputs(outbuf, values_out, nbvalues_out, wdo, paro, out_transfer_nb32, outlayer->out_sdata);
+
+	dmabuf_put(inbuf);
+	dmabuf_put(outbuf);
+
+	return z;
+}
+
+// Same as process_frames(), but frames and results use the layout of files : frames are reordered if needed,
+// results have frame_size_user values per frame, and the batch is split according to the user-specified buffer size
+int HwAcc_Common::process_frames_user(Network* network, layer_t* outlayer, const int* frames, unsigned frames_nb, int* out) {
+	layer_t* inlayer = NULL;
+	for(layer_t* layer = network->layer_first; layer != NULL; layer = layer->next) {
+		if(layer->type != LAYER_FIFO) { inlayer = layer; break; }
+	}
+	if(inlayer == NULL) {
+		printf("ERROR HwAcc : Could not find first layer\n");
+		return -1;
+	}
+	if(outlayer == NULL) outlayer = network->layer_last;
+
+	unsigned fsize = inlayer->fsize;
+	unsigned frame_size = 0;
+	unsigned frame_size_user = 0;
+	get_outputs_frame_size(outlayer, &frame_size, &frame_size_user);
+
+	// Limit the number of frames per batch, like write_frames_inout()
+	unsigned max_transfers_nb = (param_bufsz_mb * 1024 * 1024 / 4) / GetMax(accreg_ifw32, 1);
+	unsigned max_frames_nb = GetMax((max_transfers_nb * GetMax(accreg_pari, 1)) / fsize, 1);
+
+	std::vector<int> values_in;
+	std::vector<int32_t> values_out;
+	int z = 0;
+
+	for(unsigned f=0; f<frames_nb && z == 0; f+=max_frames_nb) {
+		unsigned nb = GetMin(max_frames_nb, frames_nb - f);
+		values_in.assign(frames + uint64_t(f) * fsize, frames + uint64_t(f + nb) * fsize);
+		// If needed, reorder image data
+		if(inlayer->fx > 1 || inlayer->fy > 1) {
+			for(unsigned i=0; i<nb; i++) {
+				int* ptr = values_in.data() + uint64_t(i) * fsize;
+				reorder_to_zfirst_dim2(&ptr, 1, fsize, inlayer->fx, inlayer->fy, inlayer->fz, 0);
+			}
+		}
+		values_out.resize(uint64_t(nb) * frame_size);
+		z = process_frames(network, outlayer, values_in.data(), nb, values_out.data());
+		// The padding values at end of each frame are skipped
+		for(unsigned i=0; i<nb; i++) {
+			memcpy(out + uint64_t(f + i) * frame_size_user, values_out.data() + uint64_t(i) * frame_size, frame_size_user * sizeof(*out));
+		}
+	}
+
+	return z;
+}
+
 int HwAcc_Common::write_frames(Network* network, const char* filename) {
 	layer_t* inlayer = NULL;
 	layer_t* outlayer = NULL;
@@ -589,7 +1253,29 @@ int HwAcc_Common::write_frames(Network* network, const char* filename) {
 	}
 	if(errors_nb != 0) return -1;
 
-	int z = write_frames_inout(filename, inlayer, outlayer, last_layer);
+	// Sampling of FIFOs in background, only when requested
+	HwAcc_FifoMon fifomon;
+	bool fifomon_en = false;
+	if(param_hw_fifomon_hz > 0) {
+		fifomon_en = (fifomon.start(this, network, param_hw_fifomon_hz) == 0);
+	}
+
+	int z = 0;
+	if(param_hw_lowlat == true && param_freerun == true) {
+		printf("Warning HwAcc : Low-latency mode is not possible in free run mode, it is disabled\n");
+	}
+	if(param_hw_lowlat == true && param_freerun == false) {
+		z = write_frames_lowlat(filename, inlayer, outlayer, last_layer);
+	}
+	else {
+		z = write_frames_inout(filename, inlayer, outlayer, last_layer);
+	}
+
+	if(fifomon_en == true) {
+		fifomon.stop();
+		fifomon.print_report();
+		if(param_hw_fifomon_csv != NULL) fifomon.write_csv(param_hw_fifomon_csv);
+	}
 
 	return z;
 }
@@ -600,7 +1286,8 @@ int HwAcc_Common::write_frames(Network* network, const char* filename) {
 // Global usage
 //============================================
 
-void HwAcc_Common::run(Network* network) {
+// Get the accelerator ready to process frames
+void HwAcc_Common::prepare(Network* network) {
 
 	// Ensure the hardware accelerator is initialized
 	accreg_config_get();
@@ -617,7 +1304,7 @@ void HwAcc_Common::run(Network* network) {
 
 	if(param_hw_blind == true) {
 		// Update the config registers from the layer structures + send them to the FPGA
-		write_config_regs(network);
+		if(config_shared == false) write_config_regs(network);
 	}
 	else {
 		if(network->param_cnn_origin != Network::CNN_ORIGIN_HARDWARE) {
@@ -630,7 +1317,14 @@ void HwAcc_Common::run(Network* network) {
 	accreg_config_print();
 
 	// Send configuration data
-	write_config(network);
+	if(config_shared == false) {
+		write_config(network);
+	}
+}
+
+void HwAcc_Common::run(Network* network) {
+
+	prepare(network);
 
 	// Finally, send the frames
 	if(filename_frames!=NULL) {
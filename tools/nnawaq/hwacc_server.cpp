@@ -0,0 +1,949 @@
+
+// Server that shares one HW accelerator between processes, and the corresponding client backend
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <fcntl.h>
+#include <unistd.h>  // For usleep()
+#include <time.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "nnawaq_utils.h"
+
+}
+
+#include "nn_layers_utils.h"
+
+#include "hwacc_server.h"
+
+using namespace std;
+
+
+// Time to wait for jobs of other clients before launching a batch, in microseconds
+// With zero, the jobs that arrive while the accelerator is busy are still merged in the next batch
+unsigned param_serve_batch_us = 0;
+
+
+//============================================
+// Protocol
+//============================================
+
+int HwAcc_Proto::SendMsg(int sock, const msg_t* msg, int fd) {
+	struct iovec iov;
+	iov.iov_base = (void*)msg;
+	iov.iov_len = sizeof(*msg);
+
+	struct msghdr mh;
+	memset(&mh, 0, sizeof(mh));
+	mh.msg_iov = &iov;
+	mh.msg_iovlen = 1;
+
+	// Ancillary data to pass a file descriptor
+	char cbuf[CMSG_SPACE(sizeof(int))];
+	if(fd >= 0) {
+		memset(cbuf, 0, sizeof(cbuf));
+		mh.msg_control = cbuf;
+		mh.msg_controllen = sizeof(cbuf);
+		struct cmsghdr* cmsg = CMSG_FIRSTHDR(&mh);
+		cmsg->cmsg_level = SOL_SOCKET;
+		cmsg->cmsg_type = SCM_RIGHTS;
+		cmsg->cmsg_len = CMSG_LEN(sizeof(int));
+		memcpy(CMSG_DATA(cmsg), &fd, sizeof(int));
+	}
+
+	ssize_t z;
+	do {
+		z = sendmsg(sock, &mh, MSG_NOSIGNAL);
+	} while(z < 0 && errno == EINTR);
+
+	return (z == (ssize_t)sizeof(*msg)) ? 0 : -1;
+}
+
+int HwAcc_Proto::RecvMsg(int sock, msg_t* msg, int* fd) {
+	if(fd != nullptr) *fd = -1;
+	size_t got = 0;
+
+	while(got < sizeof(*msg)) {
+		struct iovec iov;
+		iov.iov_base = (char*)msg + got;
+		iov.iov_len = sizeof(*msg) - got;
+
+		struct msghdr mh;
+		memset(&mh, 0, sizeof(mh));
+		mh.msg_iov = &iov;
+		mh.msg_iovlen = 1;
+
+		char cbuf[CMSG_SPACE(sizeof(int))];
+		mh.msg_control = cbuf;
+		mh.msg_controllen = sizeof(cbuf);
+
+		ssize_t z = recvmsg(sock, &mh, 0);
+		if(z < 0 && errno == EINTR) continue;
+		if(z <= 0) return -1;
+		got += z;
+
+		for(struct cmsghdr* cmsg = CMSG_FIRSTHDR(&mh); cmsg != NULL; cmsg = CMSG_NXTHDR(&mh, cmsg)) {
+			if(cmsg->cmsg_level != SOL_SOCKET || cmsg->cmsg_type != SCM_RIGHTS) continue;
+			int recv_fd = -1;
+			memcpy(&recv_fd, CMSG_DATA(cmsg), sizeof(int));
+			// A descriptor that is not expected is closed
+			if(fd != nullptr && *fd < 0) *fd = recv_fd;
+			else close(recv_fd);
+		}
+	}
+
+	return 0;
+}
+
+int HwAcc_Proto::ShmCreate(shm_t* shm, size_t nb) {
+	static unsigned counter = 0;
+
+	// The name is removed right after creation, the segment only lives through its file descriptors
+	char name[64];
+	sprintf(name, "/nnawaq-%u-%u", (unsigned)getpid(), __atomic_fetch_add(&counter, 1, __ATOMIC_RELAXED));
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if(fd < 0) {
+		printf("ERROR HwAcc : Can't create shared memory segment '%s' : %s\n", name, strerror(errno));
+		return -1;
+	}
+	shm_unlink(name);
+
+	shm->fd = fd;
+	return ShmMap(shm, nb, true);
+}
+
+int HwAcc_Proto::ShmMap(shm_t* shm, size_t nb, bool resize) {
+	if(shm->ptr != nullptr) {
+		munmap(shm->ptr, shm->nb * sizeof(*shm->ptr));
+		shm->ptr = nullptr;
+		shm->nb = 0;
+	}
+	if(shm->fd < 0 || nb == 0) return -1;
+
+	if(resize == true && ftruncate(shm->fd, nb * sizeof(*shm->ptr)) != 0) {
+		printf("ERROR HwAcc : Can't resize shared memory segment to %zu 32b words : %s\n", nb, strerror(errno));
+		return -1;
+	}
+
+	void* ptr = mmap(NULL, nb * sizeof(*shm->ptr), PROT_READ | PROT_WRITE, MAP_SHARED, shm->fd, 0);
+	if(ptr == MAP_FAILED) {
+		printf("ERROR HwAcc : Can't map shared memory segment of %zu 32b words : %s\n", nb, strerror(errno));
+		return -1;
+	}
+
+	shm->ptr = (uint32_t*)ptr;
+	shm->nb = nb;
+	return 0;
+}
+
+void HwAcc_Proto::ShmClose(shm_t* shm) {
+	if(shm->ptr != nullptr) munmap(shm->ptr, shm->nb * sizeof(*shm->ptr));
+	if(shm->fd >= 0) close(shm->fd);
+	shm->ptr = nullptr;
+	shm->nb = 0;
+	shm->fd = -1;
+}
+
+
+//============================================
+// Server
+//============================================
+
+static volatile sig_atomic_t serve_signaled = 0;
+
+static void serve_sighandler(int sig) {
+	serve_signaled = 1;
+}
+
+HwAcc_Server::HwAcc_Server(HwAcc_Common* hwacc, Network* network) {
+	this->hwacc = hwacc;
+	this->network = network;
+}
+
+HwAcc_Server::~HwAcc_Server(void) {
+	for(auto job : jobs) delete job;
+	jobs.clear();
+	for(auto session : sessions) delete session;
+	sessions.clear();
+}
+
+int HwAcc_Server::listen_open(const char* path) {
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(addr.sun_path)) {
+		printf("ERROR HwAcc : Socket path '%s' is too long\n", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	listen_sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listen_sock < 0) {
+		printf("ERROR HwAcc : Can't create socket : %s\n", strerror(errno));
+		return -1;
+	}
+
+	// A socket file left by a previous server is removed, unless that server is still running
+	struct stat st;
+	if(stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+		int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+		int z = connect(sock, (struct sockaddr*)&addr, sizeof(addr));
+		close(sock);
+		if(z == 0) {
+			printf("ERROR HwAcc : A server is already running on socket '%s'\n", path);
+			close(listen_sock);
+			listen_sock = -1;
+			return -1;
+		}
+		unlink(path);
+	}
+
+	if(bind(listen_sock, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_sock, 16) != 0) {
+		printf("ERROR HwAcc : Can't listen on socket '%s' : %s\n", path, strerror(errno));
+		close(listen_sock);
+		listen_sock = -1;
+		return -1;
+	}
+
+	return 0;
+}
+
+void HwAcc_Server::listen_close(const char* path) {
+	if(listen_sock < 0) return;
+	close(listen_sock);
+	listen_sock = -1;
+	unlink(path);
+}
+
+int HwAcc_Server::serve(const char* path) {
+
+	// Configure the accelerator once for all clients
+	hwacc->prepare(network);
+
+	// Get first and last layers of the network, like write_frames()
+	for(layer_t* layer = network->layer_first; layer != NULL; layer = layer->next) {
+		if(layer->type != LAYER_FIFO) { inlayer = layer; break; }
+	}
+	for(layer_t* layer = network->layer_last; layer != NULL; layer = layer->prev) {
+		if(layer->type != LAYER_FIFO) { outlayer = layer; break; }
+	}
+	if(inlayer == NULL || outlayer == NULL) {
+		printf("ERROR HwAcc : Could not find first and last layers\n");
+		return -1;
+	}
+	if(hwacc->accreg_wdi > 32 || hwacc->accreg_wdo > 32) {
+		printf("ERROR HwAcc : Data width of the accelerator interface is above 32 bits, this is not supported by the server\n");
+		return -1;
+	}
+
+	if(listen_open(path) != 0) return -1;
+
+	// Stop on usual termination signals, without SA_RESTART so poll() is interrupted
+	struct sigaction sa, sa_int_prev, sa_term_prev;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = serve_sighandler;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, &sa_int_prev);
+	sigaction(SIGTERM, &sa, &sa_term_prev);
+	serve_signaled = 0;
+
+	stop_req = false;
+	pthread_create(&batch_thread, NULL, batch_thread_wrapper, this);
+
+	printf("Info HwAcc : Server listening on socket '%s'\n", path);
+	fflush(stdout);
+
+	while(serve_signaled == 0) {
+		struct pollfd pfd;
+		pfd.fd = listen_sock;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		int z = poll(&pfd, 1, 200);
+		if(z <= 0) continue;
+
+		int sock = accept(listen_sock, NULL, NULL);
+		if(sock < 0) continue;
+
+		conn_t* conn = new conn_t;
+		conn->server = this;
+		conn->sock = sock;
+
+		pthread_mutex_lock(&mutex);
+		conns.push_back(conn);
+		pthread_mutex_unlock(&mutex);
+
+		pthread_create(&conn->thread, NULL, conn_thread_wrapper, conn);
+		pthread_detach(conn->thread);
+	}
+
+	printf("Info HwAcc : Server stopping\n");
+
+	// Wake up all threads, and wait for the connection threads to finish
+	pthread_mutex_lock(&mutex);
+	stop_req = true;
+	for(auto conn : conns) shutdown(conn->sock, SHUT_RDWR);
+	pthread_cond_broadcast(&cond_job);
+	pthread_cond_broadcast(&cond_out);
+	while(conns.empty() == false) pthread_cond_wait(&cond_conn, &mutex);
+	pthread_mutex_unlock(&mutex);
+
+	pthread_join(batch_thread, NULL);
+
+	listen_close(path);
+	sigaction(SIGINT, &sa_int_prev, NULL);
+	sigaction(SIGTERM, &sa_term_prev, NULL);
+
+	print_stats();
+
+	return 0;
+}
+
+void HwAcc_Server::print_stats(void) {
+	printf("Stats HwAcc server :\n");
+	printf("  Sessions ...... %" PRIu64 "\n", stat_sessions);
+	printf("  Jobs .......... %" PRIu64 ", %" PRIu64 " frames\n", stat_jobs, stat_frames);
+	printf("  Batches ....... %" PRIu64 ", %.2f jobs per batch\n", stat_batches, (stat_batches > 0) ? (double)stat_jobs / stat_batches : 0);
+	printf("  Dropped ....... %" PRIu64 " config register writes and config streams\n", stat_dropped);
+	if(stat_errors > 0) {
+		printf("  Errors ........ %" PRIu64 "\n", stat_errors);
+	}
+}
+
+//============================================
+// Connections
+//============================================
+
+void* HwAcc_Server::conn_thread_wrapper(void* arg) {
+	conn_t* conn = (conn_t*)arg;
+	conn->server->conn_loop(conn);
+	return NULL;
+}
+
+void HwAcc_Server::conn_loop(conn_t* conn) {
+	HwAcc_Proto::msg_t msg;
+	int fd = -1;
+
+	// The first message attaches the connection to a session
+	if(HwAcc_Proto::RecvMsg(conn->sock, &msg, &fd) != 0 || conn_hello(conn, &msg, fd) != 0) {
+		msg.op = HwAcc_Proto::OP_ERR;
+		HwAcc_Proto::SendMsg(conn->sock, &msg);
+		conn_release(conn);
+		return;
+	}
+
+	do {
+
+		if(HwAcc_Proto::RecvMsg(conn->sock, &msg) != 0) break;
+
+		HwAcc_Proto::msg_t reply = msg;
+
+		// Follow the size of the shared memory segment
+		if(msg.shm_nb != conn->shm.nb) {
+			if(HwAcc_Proto::ShmMap(&conn->shm, msg.shm_nb, false) != 0) break;
+		}
+
+		if(msg.op == HwAcc_Proto::OP_RD) {
+			reply.val = reg_rd(conn->session, msg.arg);
+		}
+		else if(msg.op == HwAcc_Proto::OP_WR) {
+			reg_wr(conn->session, msg.arg, msg.val);
+		}
+		else if((msg.op == HwAcc_Proto::OP_SEND || msg.op == HwAcc_Proto::OP_SENDW) && msg.val <= conn->shm.nb) {
+			reply.val = job_submit(conn->session, conn->shm.ptr, msg.val);
+		}
+		else if(msg.op == HwAcc_Proto::OP_RECV && msg.val <= conn->shm.nb) {
+			reply.val = recv_take(conn->session, conn->shm.ptr, msg.val);
+		}
+		else {
+			reply.op = HwAcc_Proto::OP_ERR;
+		}
+
+		if(HwAcc_Proto::SendMsg(conn->sock, &reply) != 0) break;
+
+	} while(1);
+
+	conn_release(conn);
+}
+
+int HwAcc_Server::conn_hello(conn_t* conn, HwAcc_Proto::msg_t* msg, int fd) {
+	if(msg->op != HwAcc_Proto::OP_HELLO || msg->val != HwAcc_Proto::VERSION) {
+		printf("Warning HwAcc : Server, rejected a client with unexpected protocol version %u\n", msg->val);
+		if(fd >= 0) close(fd);
+		return -1;
+	}
+
+	conn->shm.fd = fd;
+	if(HwAcc_Proto::ShmMap(&conn->shm, msg->shm_nb, false) != 0) return -1;
+
+	pthread_mutex_lock(&mutex);
+
+	session_t* session = nullptr;
+	if(msg->arg == 0) {
+		session = new session_t;
+		session->id = session_next++;
+		sessions.push_back(session);
+		stat_sessions ++;
+	}
+	else {
+		for(auto s : sessions) if(s->id == msg->arg) { session = s; break; }
+	}
+	if(session != nullptr) {
+		session->conns_nb ++;
+		conn->session = session;
+	}
+
+	pthread_mutex_unlock(&mutex);
+
+	if(session == nullptr) {
+		printf("Warning HwAcc : Server, a client asked for unknown session %u\n", msg->arg);
+		return -1;
+	}
+
+	// The session registers start from the current state of the accelerator
+	if(msg->arg == 0) {
+		pthread_mutex_lock(&ctrl_mutex);
+		for(unsigned i=0; i<16; i++) session->regs[i] = hwacc->accreg_rd(i);
+		pthread_mutex_unlock(&ctrl_mutex);
+		uint32_t& r = session->regs[hwacc->memreg_shregs->reg_idx];
+		hwacc->memreg_shregs->SetRef(r, 0);
+		hwacc->memreg_getregs->SetRef(r, 0);
+		hwacc->memreg_setregs->SetRef(r, 0);
+		session->regs[hwacc->memreg_in_nb->reg_idx] = 0;
+		session->regs[hwacc->memreg_out_nb->reg_idx] = 0;
+		printf("Info HwAcc : Server, session %u opened\n", session->id);
+		fflush(stdout);
+	}
+
+	msg->arg = session->id;
+	return HwAcc_Proto::SendMsg(conn->sock, msg);
+}
+
+void HwAcc_Server::conn_release(conn_t* conn) {
+	close(conn->sock);
+	HwAcc_Proto::ShmClose(&conn->shm);
+
+	pthread_mutex_lock(&mutex);
+	for(unsigned i=0; i<conns.size(); i++) {
+		if(conns[i] == conn) { conns.erase(conns.begin() + i); break; }
+	}
+	if(conn->session != nullptr) {
+		conn->session->conns_nb --;
+		session_release(conn->session);
+	}
+	pthread_cond_broadcast(&cond_conn);
+	pthread_mutex_unlock(&mutex);
+
+	delete conn;
+}
+
+// The session is freed when it has no connection and no pending job, the mutex must be locked
+void HwAcc_Server::session_release(session_t* session) {
+	if(session->conns_nb > 0 || session->jobs_nb > 0) return;
+	for(unsigned i=0; i<sessions.size(); i++) {
+		if(sessions[i] == session) { sessions.erase(sessions.begin() + i); break; }
+	}
+	printf("Info HwAcc : Server, session %u closed after %" PRIu64 " frames\n", session->id, session->frames_nb);
+	fflush(stdout);
+	delete session;
+}
+
+//============================================
+// Requests of clients
+//============================================
+
+uint32_t HwAcc_Server::reg_rd(session_t* session, unsigned idx) {
+	if(idx >= 16) return 0;
+	uint32_t r = 0;
+
+	// Scan chain of config registers : the values read by the server at startup
+	if(idx == hwacc->memreg_layreg->reg_idx) {
+		pthread_mutex_lock(&mutex);
+		bool shregs = hwacc->memreg_shregs->Get(session->regs[hwacc->memreg_shregs->reg_idx]) != 0;
+		if(shregs == true && session->chain_idx < hwacc->accreg_cfgnn.size()) r = hwacc->accreg_cfgnn[session->chain_idx++];
+		pthread_mutex_unlock(&mutex);
+		return r;
+	}
+
+	// Registers specific to the session
+	if(
+		idx == hwacc->memreg_shregs->reg_idx ||
+		idx == hwacc->memreg_in_lay->reg_idx || idx == hwacc->memreg_out_lay->reg_idx ||
+		idx == hwacc->memreg_in_nb->reg_idx || idx == hwacc->memreg_out_nb->reg_idx
+	) {
+		pthread_mutex_lock(&mutex);
+		r = session->regs[idx];
+		pthread_mutex_unlock(&mutex);
+		return r;
+	}
+
+	pthread_mutex_lock(&ctrl_mutex);
+	r = hwacc->accreg_rd(idx);
+	pthread_mutex_unlock(&ctrl_mutex);
+
+	return r;
+}
+
+void HwAcc_Server::reg_wr(session_t* session, unsigned idx, uint32_t val) {
+	if(idx >= 16) return;
+
+	// Writes to the scan chain would reconfigure the accelerator
+	if(idx == hwacc->memreg_layreg->reg_idx) {
+		pthread_mutex_lock(&mutex);
+		session->dropped_nb ++;
+		stat_dropped ++;
+		pthread_mutex_unlock(&mutex);
+		return;
+	}
+
+	// Control of the scan chain, same behaviour than the hardware
+	if(idx == hwacc->memreg_shregs->reg_idx) {
+		pthread_mutex_lock(&mutex);
+		uint32_t r = session->regs[idx];
+		if(hwacc->memreg_setregs->Get(val) != 0) {
+			session->dropped_nb ++;
+			stat_dropped ++;
+		}
+		if(hwacc->memreg_shregs->Get(val) != 0 && hwacc->memreg_shregs->Get(r) == 0) session->chain_idx = 0;
+		hwacc->memreg_shregs->SetRef(r, hwacc->memreg_shregs->Get(val));
+		session->regs[idx] = r;
+		pthread_mutex_unlock(&mutex);
+		return;
+	}
+
+	// Clear and free run are handled by the server for each batch
+	if(idx == hwacc->memreg_clear->reg_idx) return;
+
+	// Registers specific to the session
+	if(
+		idx == hwacc->memreg_in_lay->reg_idx || idx == hwacc->memreg_out_lay->reg_idx ||
+		idx == hwacc->memreg_in_nb->reg_idx || idx == hwacc->memreg_out_nb->reg_idx
+	) {
+		pthread_mutex_lock(&mutex);
+		session->regs[idx] = val;
+		pthread_mutex_unlock(&mutex);
+		return;
+	}
+
+	pthread_mutex_lock(&ctrl_mutex);
+	hwacc->accreg_wr(idx, val);
+	pthread_mutex_unlock(&ctrl_mutex);
+}
+
+unsigned HwAcc_Server::job_submit(session_t* session, const uint32_t* buf, unsigned buf_nb) {
+	pthread_mutex_lock(&mutex);
+	unsigned in_lay  = hwacc->memreg_in_lay->GetUnsigned(session->regs[hwacc->memreg_in_lay->reg_idx]);
+	unsigned out_sel = hwacc->memreg_out_lay->GetUnsigned(session->regs[hwacc->memreg_out_lay->reg_idx]);
+	unsigned in_nb   = session->regs[hwacc->memreg_in_nb->reg_idx];
+	pthread_mutex_unlock(&mutex);
+
+	// Config data : the accelerator is already configured
+	if(in_lay != hwacc->memreg_in_lay->GetUnsigned(~0)) {
+		pthread_mutex_lock(&mutex);
+		session->dropped_nb ++;
+		stat_dropped ++;
+		pthread_mutex_unlock(&mutex);
+		return buf_nb;
+	}
+
+	// Layout of the inputs, same than write_frames_lowlat()
+	unsigned wdi = hwacc->accreg_wdi;
+	unsigned pari = GetMax(hwacc->accreg_pari, 1u);
+	unsigned values_per32 = 32 / wdi;
+	unsigned transfer_nb32 = GetMax(hwacc->accreg_ifw32, (pari + values_per32 - 1) / values_per32);
+
+	// The number of values is given by the number of expected inputs, otherwise assume full transfers
+	unsigned nbvalues = in_nb * GetMax(network->layer_first->split_in, 1u);
+	if(nbvalues == 0) nbvalues = (buf_nb / transfer_nb32) * pari;
+	unsigned nb32 = (nbvalues / pari) * transfer_nb32 + ((nbvalues % pari) + values_per32 - 1) / values_per32;
+
+	if(nbvalues == 0 || nbvalues % inlayer->fsize != 0 || buf_nb < nb32) {
+		printf("Warning HwAcc : Server, session %u sent %u values that are not whole frames, they are dropped\n", session->id, nbvalues);
+		pthread_mutex_lock(&mutex);
+		stat_errors ++;
+		pthread_mutex_unlock(&mutex);
+		return 0;
+	}
+
+	job_t* job = new job_t;
+	job->session = session;
+	job->out_sel = out_sel;
+	job->frames_nb = nbvalues / inlayer->fsize;
+	job->values.resize(nbvalues);
+	hwacc_unpack_outputs(buf, (int32_t*)job->values.data(), nbvalues, wdi, pari, transfer_nb32, false);
+
+	pthread_mutex_lock(&mutex);
+	if(stop_req == true) {
+		pthread_mutex_unlock(&mutex);
+		delete job;
+		return 0;
+	}
+	session->jobs_nb ++;
+	session->frames_nb += job->frames_nb;
+	jobs.push_back(job);
+	stat_jobs ++;
+	pthread_cond_signal(&cond_job);
+	pthread_mutex_unlock(&mutex);
+
+	return buf_nb;
+}
+
+// Wait until the wanted amount of results is available, until all jobs of the session are completed, or until timeout
+unsigned HwAcc_Server::recv_take(session_t* session, uint32_t* buf, unsigned buf_nb) {
+	// Absolute time for timeout, like receive operations of other backends
+	struct timespec ts;
+	if(param_timeout_recv_us > 0) {
+		clock_gettime(CLOCK_REALTIME, &ts);
+		uint64_t ns = ts.tv_nsec + (uint64_t)param_timeout_recv_us * 1000;
+		ts.tv_sec += ns / 1000000000;
+		ts.tv_nsec = ns % 1000000000;
+	}
+
+	pthread_mutex_lock(&mutex);
+
+	size_t avail = 0;
+	do {
+		avail = session->outq.size() - session->outq_rd;
+		if(avail >= buf_nb) break;
+		// No more results will come, for example if nothing was sent or if the frames were dropped
+		if(session->jobs_nb == 0) break;
+		if(stop_req == true) break;
+		if(param_timeout_recv_us > 0) {
+			int z = pthread_cond_timedwait(&cond_out, &mutex, &ts);
+			if(z == ETIMEDOUT) break;
+		}
+		else {
+			pthread_cond_wait(&cond_out, &mutex);
+		}
+	} while(1);
+
+	unsigned nb = GetMin(avail, (size_t)buf_nb);
+	memcpy(buf, session->outq.data() + session->outq_rd, nb * sizeof(*buf));
+	session->outq_rd += nb;
+	if(session->outq_rd == session->outq.size()) {
+		session->outq.clear();
+		session->outq_rd = 0;
+	}
+
+	pthread_mutex_unlock(&mutex);
+
+	return nb;
+}
+
+//============================================
+// Execution of batches
+//============================================
+
+void* HwAcc_Server::batch_thread_wrapper(void* arg) {
+	HwAcc_Server* server = (HwAcc_Server*)arg;
+	server->batch_loop();
+	return NULL;
+}
+
+void HwAcc_Server::batch_loop(void) {
+	// Max number of values per batch, from the user-specified buffer size like write_frames_inout()
+	uint64_t max_values_nb = uint64_t(param_bufsz_mb) * 1024 * 1024 / 4 / GetMax(hwacc->accreg_ifw32, 1u) * GetMax(hwacc->accreg_pari, 1u);
+
+	pthread_mutex_lock(&mutex);
+
+	do {
+
+		while(jobs.empty() == true && stop_req == false) pthread_cond_wait(&cond_job, &mutex);
+		if(stop_req == true) break;
+
+		// Give other clients a chance to join the batch
+		if(param_serve_batch_us > 0) {
+			pthread_mutex_unlock(&mutex);
+			usleep(param_serve_batch_us);
+			pthread_mutex_lock(&mutex);
+			if(stop_req == true) break;
+		}
+
+		// Gather the jobs with the same output selection than the oldest one
+		vector<job_t*> batch;
+		unsigned out_sel = jobs.front()->out_sel;
+		uint64_t values_nb = 0;
+		for(auto it = jobs.begin(); it != jobs.end(); ) {
+			job_t* job = *it;
+			if(job->out_sel != out_sel) { ++it; continue; }
+			if(batch.empty() == false && values_nb + job->values.size() > max_values_nb) break;
+			batch.push_back(job);
+			values_nb += job->values.size();
+			it = jobs.erase(it);
+		}
+
+		pthread_mutex_unlock(&mutex);
+		batch_run(batch);
+		pthread_mutex_lock(&mutex);
+
+	} while(1);
+
+	pthread_mutex_unlock(&mutex);
+}
+
+layer_t* HwAcc_Server::get_outlayer(unsigned out_sel) {
+	if(out_sel == hwacc->memreg_out_lay->GetUnsigned(~0)) return outlayer;
+	if(hwacc->accreg_selout == false) return nullptr;
+	for(layer_t* layer = network->layer_first; layer != NULL; layer = layer->next) {
+		if(layer->id == (int)out_sel) return layer;
+	}
+	return nullptr;
+}
+
+// Layout of the outputs, same than getoutputs_thread()
+void HwAcc_Server::get_out_layout(unsigned* wdo, unsigned* paro, unsigned* transfer_nb32) {
+	*wdo = GetMin(hwacc->accreg_wdo, 32u);
+	*paro = GetMax(hwacc->accreg_paro, 1u);
+	unsigned values_per32 = 32 / *wdo;
+	*transfer_nb32 = GetMax(hwacc->accreg_ifw32, (*paro + values_per32 - 1) / values_per32);
+}
+
+void HwAcc_Server::batch_run(vector<job_t*>& batch) {
+	layer_t* outl = get_outlayer(batch[0]->out_sel);
+
+	unsigned frame_size = 0;
+	unsigned frame_size_user = 0;
+	if(outl != nullptr) hwacc->get_outputs_frame_size(outl, &frame_size, &frame_size_user);
+
+	// Concatenate the frames of all jobs
+	vector<int> values_in;
+	unsigned frames_nb = 0;
+	for(auto job : batch) {
+		values_in.insert(values_in.end(), job->values.begin(), job->values.end());
+		frames_nb += job->frames_nb;
+	}
+
+	unsigned wdo, paro, out_transfer_nb32;
+	get_out_layout(&wdo, &paro, &out_transfer_nb32);
+	unsigned out_values_per32 = 32 / wdo;
+
+	unsigned nbvalues_out = frames_nb * frame_size;
+	vector<int32_t> values_out(nbvalues_out);
+
+	bool ok = (outl != nullptr);
+	if(outl == nullptr) {
+		printf("Warning HwAcc : Server, output layer %u is not available, the jobs are dropped\n", batch[0]->out_sel);
+	}
+	if(ok == true && hwacc->process_frames(network, outl, values_in.data(), frames_nb, values_out.data()) != 0) {
+		pthread_mutex_lock(&mutex);
+		stat_errors ++;
+		pthread_mutex_unlock(&mutex);
+	}
+
+	// Split the results back into the queues of the sessions, packed like the accelerator does
+	pthread_mutex_lock(&mutex);
+
+	unsigned values_idx = 0;
+	for(auto job : batch) {
+		session_t* session = job->session;
+		unsigned nb = job->frames_nb * frame_size;
+		if(ok == true) {
+			size_t prev_nb32 = session->outq.size();
+			session->outq.resize(prev_nb32 + (nb / paro) * out_transfer_nb32 + ((nb % paro) + out_values_per32 - 1) / out_values_per32);
+			unsigned nb32 = hwacc_pack_inputs(values_out.data() + values_idx, nb, session->outq.data() + prev_nb32, wdo, paro, out_transfer_nb32);
+			session->outq.resize(prev_nb32 + nb32);
+		}
+		values_idx += nb;
+		stat_frames += job->frames_nb;
+		session->jobs_nb --;
+		delete job;
+		session_release(session);
+	}
+	stat_batches ++;
+
+	pthread_cond_broadcast(&cond_out);
+	pthread_mutex_unlock(&mutex);
+}
+
+
+//============================================
+// Client backend
+//============================================
+
+bool HwAcc_Client::atexit_registered = false;
+
+HwAcc_Client* HwAcc_Client::singleton = nullptr;
+
+HwAcc_Client* HwAcc_Client::OpenSingleton(const char* path) {
+	CloseSingleton();
+
+	HwAcc_Client* client = new HwAcc_Client();
+	// The receive connection joins the session created by the control connection
+	if(client->conn_open(&client->conn_ctrl, path) != 0 || client->conn_open(&client->conn_recv, path) != 0) {
+		delete client;
+		return nullptr;
+	}
+	singleton = client;
+
+	if(atexit_registered == false) {
+		atexit(client_atexit);
+		atexit_registered = true;
+	}
+
+	printf("Info HwAcc : Connected to server '%s', session %u\n", path, client->session);
+
+	return singleton;
+}
+void HwAcc_Client::CloseSingleton(void) {
+	if(singleton != nullptr) {
+		delete singleton;
+		singleton = nullptr;
+	}
+}
+
+void HwAcc_Client::client_atexit(void) {
+	CloseSingleton();
+}
+
+HwAcc_Client::HwAcc_Client(void) {
+	config_shared = true;
+}
+
+HwAcc_Client::~HwAcc_Client(void) {
+	conn_close(&conn_recv);
+	conn_close(&conn_ctrl);
+	if(this == singleton) singleton = nullptr;
+	if(HwAcc_Common::CurrentHwAcc_Get() == this) HwAcc_Common::CurrentHwAcc_Set(nullptr);
+}
+
+int HwAcc_Client::conn_open(conn_t* conn, const char* path) {
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(addr.sun_path)) {
+		printf("ERROR HwAcc : Socket path '%s' is too long\n", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	conn->sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(conn->sock < 0 || connect(conn->sock, (struct sockaddr*)&addr, sizeof(addr)) != 0) {
+		printf("ERROR HwAcc : Can't connect to server '%s' : %s\n", path, strerror(errno));
+		return -1;
+	}
+
+	// Initial size of the shared memory, it is enlarged on demand
+	if(HwAcc_Proto::ShmCreate(&conn->shm, 64*1024) != 0) return -1;
+
+	HwAcc_Proto::msg_t msg;
+	msg.op = HwAcc_Proto::OP_HELLO;
+	msg.arg = session;
+	msg.val = HwAcc_Proto::VERSION;
+	msg.shm_nb = conn->shm.nb;
+	if(HwAcc_Proto::SendMsg(conn->sock, &msg, conn->shm.fd) != 0 || HwAcc_Proto::RecvMsg(conn->sock, &msg) != 0 || msg.op != HwAcc_Proto::OP_HELLO) {
+		printf("ERROR HwAcc : Server '%s' refused the connection\n", path);
+		return -1;
+	}
+	session = msg.arg;
+
+	return 0;
+}
+
+void HwAcc_Client::conn_close(conn_t* conn) {
+	if(conn->sock >= 0) close(conn->sock);
+	conn->sock = -1;
+	HwAcc_Proto::ShmClose(&conn->shm);
+}
+
+int HwAcc_Client::request(conn_t* conn, HwAcc_Proto::msg_t* msg) {
+	if(broken == true) return -1;
+	msg->shm_nb = conn->shm.nb;
+	if(HwAcc_Proto::SendMsg(conn->sock, msg) != 0 || HwAcc_Proto::RecvMsg(conn->sock, msg) != 0) {
+		printf("ERROR HwAcc : Lost connection to the server\n");
+		broken = true;
+		return -1;
+	}
+	__atomic_fetch_add(&reqs_nb, 1, __ATOMIC_RELAXED);
+	if(msg->op == HwAcc_Proto::OP_ERR) return -1;
+	return 0;
+}
+
+uint32_t HwAcc_Client::accreg_rd(unsigned idx) {
+	HwAcc_Proto::msg_t msg;
+	msg.op = HwAcc_Proto::OP_RD;
+	msg.arg = idx;
+	msg.val = 0;
+	pthread_mutex_lock(&mutex);
+	int z = request(&conn_ctrl, &msg);
+	pthread_mutex_unlock(&mutex);
+	return (z == 0) ? msg.val : 0;
+}
+
+void HwAcc_Client::accreg_wr(unsigned idx, uint32_t val) {
+	HwAcc_Proto::msg_t msg;
+	msg.op = HwAcc_Proto::OP_WR;
+	msg.arg = idx;
+	msg.val = val;
+	pthread_mutex_lock(&mutex);
+	request(&conn_ctrl, &msg);
+	pthread_mutex_unlock(&mutex);
+}
+
+unsigned HwAcc_Client::send_common(unsigned op, uint32_t* buf, unsigned buf_nb) {
+	pthread_mutex_lock(&mutex);
+
+	// The segment is enlarged to the largest transfer
+	if(buf_nb > conn_ctrl.shm.nb && HwAcc_Proto::ShmMap(&conn_ctrl.shm, GetMax((size_t)buf_nb, 2 * conn_ctrl.shm.nb), true) != 0) {
+		pthread_mutex_unlock(&mutex);
+		return 0;
+	}
+	memcpy(conn_ctrl.shm.ptr, buf, buf_nb * sizeof(*buf));
+
+	HwAcc_Proto::msg_t msg;
+	msg.op = op;
+	msg.arg = 0;
+	msg.val = buf_nb;
+	int z = request(&conn_ctrl, &msg);
+
+	pthread_mutex_unlock(&mutex);
+
+	if(z != 0) return 0;
+	__atomic_fetch_add(&sent_nb32, msg.val, __ATOMIC_RELAXED);
+	return msg.val;
+}
+
+unsigned HwAcc_Client::fpga_send32(uint32_t* buf, unsigned buf_nb) {
+	return send_common(HwAcc_Proto::OP_SEND, buf, buf_nb);
+}
+unsigned HwAcc_Client::fpga_send32_wait(uint32_t* buf, unsigned buf_nb) {
+	return send_common(HwAcc_Proto::OP_SENDW, buf, buf_nb);
+}
+
+// Only one thread receives at a time, so the receive connection needs no lock
+unsigned HwAcc_Client::fpga_recv32(uint32_t* buf, unsigned buf_nb) {
+	if(buf_nb > conn_recv.shm.nb && HwAcc_Proto::ShmMap(&conn_recv.shm, GetMax((size_t)buf_nb, 2 * conn_recv.shm.nb), true) != 0) {
+		return 0;
+	}
+
+	HwAcc_Proto::msg_t msg;
+	msg.op = HwAcc_Proto::OP_RECV;
+	msg.arg = 0;
+	msg.val = buf_nb;
+	if(request(&conn_recv, &msg) != 0) return 0;
+
+	unsigned nb = GetMin(msg.val, buf_nb);
+	memcpy(buf, conn_recv.shm.ptr, nb * sizeof(*buf));
+	timing.recv_progress(nb);
+	__atomic_fetch_add(&recv_nb32, nb, __ATOMIC_RELAXED);
+
+	return nb;
+}
+
+void HwAcc_Client::print_stream_stats(void) {
+	printf("Stats HwAcc client : session %u, %" PRIu64 " requests, %" PRIu64 " 32b words sent, %" PRIu64 " received\n",
+		session, reqs_nb, sent_nb32, recv_nb32
+	);
+}
+
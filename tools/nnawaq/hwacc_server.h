@@ -0,0 +1,276 @@
+
+#pragma once
+
+extern "C" {
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+}
+
+#include <vector>
+#include <deque>
+
+#include "hwacc_common.h"
+
+
+//============================================
+// Protocol between the server and its clients
+//============================================
+
+// Messages have a fixed size and are exchanged over a UNIX domain socket, one reply for each request
+// The payloads of data streams go through a shared memory segment, one per connection
+// The segment is created by the client and its file descriptor is passed to the server with the first message
+// A client session uses two connections : one for register accesses and sent data, one for received data
+// This way, a receive operation that waits for results does not block the sender
+
+class HwAcc_Proto {
+
+	public :
+
+	static const uint32_t VERSION = 1;
+
+	enum op_type {
+		OP_HELLO = 1,  // arg = session to join, 0 for a new session, val = protocol version. Reply : arg = session
+		OP_RD    = 2,  // arg = register index. Reply : val = register value
+		OP_WR    = 3,  // arg = register index, val = register value
+		OP_SEND  = 4,  // val = number of 32b words in shared memory. Reply : val = number of words accepted
+		OP_SENDW = 5,  // Same, with wait for the data to be processed
+		OP_RECV  = 6,  // val = number of 32b words wanted. Reply : val = number of words written in shared memory
+		OP_ERR   = 7,  // Reply only, the request failed
+	};
+
+	typedef struct msg_t {
+		uint32_t op;
+		uint32_t arg;
+		uint32_t val;
+		uint32_t shm_nb;  // Size of the shared memory segment in 32b words, so the server follows when the client enlarges it
+	} msg_t;
+
+	// A shared memory segment, mapped in the current process
+	typedef struct shm_t {
+		int       fd  = -1;
+		uint32_t* ptr = nullptr;
+		size_t    nb  = 0;  // Size in 32b words
+	} shm_t;
+
+	static int  SendMsg(int sock, const msg_t* msg, int fd = -1);
+	static int  RecvMsg(int sock, msg_t* msg, int* fd = nullptr);
+
+	static int  ShmCreate(shm_t* shm, size_t nb);
+	static int  ShmMap(shm_t* shm, size_t nb, bool resize);
+	static void ShmClose(shm_t* shm);
+
+};
+
+
+//============================================
+// Server that shares one HW accelerator between processes
+//============================================
+
+// The server owns the current backend, configures the accelerator once and keeps it configured
+// Each client session sees its own copy of the registers that control data streams and of the scan chain of config registers
+// Writes that would reconfigure the accelerator are dropped, config data streams too
+//
+// Frames sent by clients become jobs, values are unpacked from the client buffer
+// A single thread runs the accelerator : pending jobs of all clients are concatenated into one hardware batch,
+// results are split back into each session queue, where the receive requests of the clients take them
+// Jobs with different output layer selections are not mixed in the same batch
+// Free run mode is not supported by clients : streams are always controlled by the server
+
+class HwAcc_Server {
+
+	//============================================
+	// Types
+	//============================================
+
+	private :
+
+	typedef struct session_t {
+		unsigned id = 0;
+		unsigned conns_nb = 0;
+		unsigned jobs_nb = 0;  // Jobs not completed yet
+		// Registers specific to this session, only a few are used
+		uint32_t regs[16];
+		// Scan chain of config registers, and read position
+		unsigned chain_idx = 0;
+		// Queue of packed results waiting for receive requests
+		std::vector<uint32_t> outq;
+		size_t outq_rd = 0;
+		// Stats
+		uint64_t frames_nb = 0;
+		uint64_t dropped_nb = 0;
+	} session_t;
+
+	typedef struct job_t {
+		session_t* session = nullptr;
+		unsigned out_sel = 0;  // Value of the field for selection of output layer
+		unsigned frames_nb = 0;
+		std::vector<int> values;
+	} job_t;
+
+	typedef struct conn_t {
+		HwAcc_Server* server = nullptr;
+		int sock = -1;
+		session_t* session = nullptr;
+		HwAcc_Proto::shm_t shm;
+		pthread_t thread;
+	} conn_t;
+
+	//============================================
+	// Fields
+	//============================================
+
+	private :
+
+	HwAcc_Common* hwacc = nullptr;
+	Network* network = nullptr;
+	layer_t* inlayer = nullptr;
+	layer_t* outlayer = nullptr;
+
+	int listen_sock = -1;
+
+	// Protects sessions, connections and queues
+	pthread_mutex_t mutex    = PTHREAD_MUTEX_INITIALIZER;
+	pthread_cond_t  cond_job = PTHREAD_COND_INITIALIZER;
+	pthread_cond_t  cond_out = PTHREAD_COND_INITIALIZER;
+	pthread_cond_t  cond_conn = PTHREAD_COND_INITIALIZER;
+
+	std::vector<session_t*> sessions;
+	std::vector<conn_t*> conns;
+	std::deque<job_t*> jobs;
+	unsigned session_next = 1;
+	bool stop_req = false;
+
+	pthread_t batch_thread;
+
+	// Stats
+	uint64_t stat_sessions = 0;
+	uint64_t stat_jobs = 0;
+	uint64_t stat_batches = 0;
+	uint64_t stat_frames = 0;
+	uint64_t stat_dropped = 0;
+	uint64_t stat_errors = 0;
+
+	//============================================
+	// Methods
+	//============================================
+
+	public :
+
+	HwAcc_Server(HwAcc_Common* hwacc, Network* network);
+	~HwAcc_Server();
+
+	// Configure the accelerator, then serve clients until SIGINT or SIGTERM is received, return non-zero on error
+	int serve(const char* path);
+
+	private :
+
+	int  listen_open(const char* path);
+	void listen_close(const char* path);
+
+	static void* conn_thread_wrapper(void* arg);
+	void conn_loop(conn_t* conn);
+	int  conn_hello(conn_t* conn, HwAcc_Proto::msg_t* msg, int fd);
+	void conn_release(conn_t* conn);
+	void session_release(session_t* session);
+
+	uint32_t reg_rd(session_t* session, unsigned idx);
+	void     reg_wr(session_t* session, unsigned idx, uint32_t val);
+	unsigned job_submit(session_t* session, const uint32_t* buf, unsigned buf_nb);
+	unsigned recv_take(session_t* session, uint32_t* buf, unsigned buf_nb);
+
+	static void* batch_thread_wrapper(void* arg);
+	void batch_loop(void);
+	void batch_run(std::vector<job_t*>& batch);
+	layer_t* get_outlayer(unsigned out_sel);
+	void get_out_layout(unsigned* wdo, unsigned* paro, unsigned* transfer_nb32);
+
+	void print_stats(void);
+
+};
+
+
+//============================================
+// Client backend
+//============================================
+
+// Implements the access methods by forwarding them to a server
+// The accelerator is already configured by the server, so config registers and config data are not sent
+
+class HwAcc_Client : public HwAcc_Common {
+
+	private :
+
+	static bool atexit_registered;
+	static HwAcc_Client* singleton;
+
+	public :
+	static HwAcc_Client* OpenSingleton(const char* path);
+	static void CloseSingleton(void);
+
+	private :
+	static void client_atexit(void);
+
+	//============================================
+	// Fields
+	//============================================
+
+	private :
+
+	typedef struct conn_t {
+		int sock = -1;
+		HwAcc_Proto::shm_t shm;
+	} conn_t;
+
+	conn_t   conn_ctrl;
+	conn_t   conn_recv;
+	unsigned session = 0;
+	bool     broken = false;
+
+	// The control connection is used by the send and receive threads concurrently
+	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+	// Stats
+	uint64_t reqs_nb = 0;
+	uint64_t sent_nb32 = 0;
+	uint64_t recv_nb32 = 0;
+
+	//============================================
+	// Constructor / Destructor
+	//============================================
+
+	private :
+	HwAcc_Client(void);
+
+	public :
+	~HwAcc_Client();
+
+	//============================================
+	// Override of virtual methods
+	//============================================
+
+	uint32_t accreg_rd(unsigned idx);
+	void     accreg_wr(unsigned idx, uint32_t val);
+
+	unsigned fpga_send32(uint32_t* buf, unsigned buf_nb);
+	unsigned fpga_send32_wait(uint32_t* buf, unsigned buf_nb);
+	unsigned fpga_recv32(uint32_t* buf, unsigned buf_nb);
+
+	void     print_stream_stats(void);
+
+	//============================================
+	// Methods
+	//============================================
+
+	private :
+
+	int  conn_open(conn_t* conn, const char* path);
+	void conn_close(conn_t* conn);
+	int  request(conn_t* conn, HwAcc_Proto::msg_t* msg);
+	unsigned send_common(unsigned op, uint32_t* buf, unsigned buf_nb);
+
+};
+
+extern unsigned param_serve_batch_us;
+
@@ -0,0 +1,205 @@
+
+// Timing of frames and batches sent to the HW accelerator
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <math.h>
+
+#include "nnawaq_utils.h"
+
+}  // extern "C"
+
+#include "hwacc_timing.h"
+
+using namespace std;
+
+
+// Print the histograms at the end of hardware runs
+bool         param_hw_hist = false;
+// Export the histograms in JSON format to this file
+char const * param_hw_hist_json = NULL;
+
+
+//============================================
+// Histogram of durations
+//============================================
+
+void HwAcc_Hist::clear(void) {
+	memset(buckets, 0, sizeof(buckets));
+	count = 0;
+	sum = 0;
+	min = UINT64_MAX;
+	max = 0;
+}
+
+uint64_t HwAcc_Hist::GetValue(unsigned idx) {
+	if(idx < SUB_NB) return idx;
+	unsigned g = idx / SUB_NB;
+	unsigned sub = idx % SUB_NB;
+	unsigned sh = g - 1;
+	return ((uint64_t(SUB_NB + sub + 1)) << sh) - 1;
+}
+
+uint64_t HwAcc_Hist::percentile(double p) const {
+	if(count == 0) return 0;
+	uint64_t target = ceil(p * count);
+	if(target == 0) target = 1;
+	uint64_t acc = 0;
+	for(unsigned i=0; i<BUCKETS_NB; i++) {
+		acc += buckets[i];
+		if(acc >= target) return GetMin(GetMax(GetValue(i), min), max);
+	}
+	return max;
+}
+
+void HwAcc_Hist::print_json(FILE* F) const {
+	fprintf(F, "{ \"count\": %" PRIu64 ", \"min_ns\": %" PRIu64 ", \"mean_ns\": %.1f, \"max_ns\": %" PRIu64,
+		count, (count > 0) ? min : 0, mean(), max
+	);
+	fprintf(F, ", \"p50_ns\": %" PRIu64 ", \"p90_ns\": %" PRIu64 ", \"p99_ns\": %" PRIu64 ", \"p999_ns\": %" PRIu64,
+		percentile(0.50), percentile(0.90), percentile(0.99), percentile(0.999)
+	);
+	// Only non-empty buckets, as pairs of highest value and count
+	fprintf(F, ", \"buckets\": [");
+	bool first = true;
+	for(unsigned i=0; i<BUCKETS_NB; i++) {
+		if(buckets[i] == 0) continue;
+		fprintf(F, "%s[%" PRIu64 ", %" PRIu64 "]", first ? "" : ", ", GetValue(i), buckets[i]);
+		first = false;
+	}
+	fprintf(F, "] }");
+}
+
+
+//============================================
+// Timing of frames and batches
+//============================================
+
+const char* HwAcc_Timing::GetHistName(unsigned idx) {
+	if(idx == FRAME_PARSE)  return "frame_parse";
+	if(idx == FRAME_PACK)   return "frame_pack";
+	if(idx == FRAME_RESULT) return "frame_result";
+	if(idx == BATCH_PARSE)  return "batch_parse";
+	if(idx == BATCH_SEND)   return "batch_send";
+	if(idx == BATCH_FIRST)  return "batch_first";
+	if(idx == BATCH_LAST)   return "batch_last";
+	return "unknown";
+}
+
+void HwAcc_Timing::clear(void) {
+	for(unsigned i=0; i<HIST_NB; i++) hists[i].clear();
+	frames_nb = 0;
+	sent_bytes = 0;
+	recv_bytes = 0;
+	send_ns = 0;
+	recv_ns = 0;
+}
+
+void HwAcc_Timing::send_begin(void) {
+	__atomic_store_n(&batch_t0, Time64_GetReal(), __ATOMIC_RELEASE);
+}
+
+void HwAcc_Timing::send_end(unsigned nb32) {
+	int64_t dur = Time64_GetReal() - __atomic_load_n(&batch_t0, __ATOMIC_ACQUIRE);
+	hists[BATCH_SEND].record(dur);
+	sent_bytes += uint64_t(nb32) * 4;
+	send_ns += dur;
+}
+
+void HwAcc_Timing::recv_begin(unsigned frames_nb, unsigned frame_size, unsigned paro, unsigned transfer_nb32) {
+	recv_active = true;
+	recv_frames_nb = frames_nb;
+	recv_frames_done = 0;
+	recv_frame_size = frame_size;
+	recv_paro = GetMax(paro, 1u);
+	recv_transfer_nb32 = GetMax(transfer_nb32, 1u);
+	recv_nb32 = 0;
+	recv_next_nb32 = uint64_t((frame_size + recv_paro - 1) / recv_paro) * recv_transfer_nb32;
+}
+
+// Record the frames that are complete with this amount of received words
+void HwAcc_Timing::recv_frames_until(uint64_t nb32, int64_t now) {
+	int64_t t0 = __atomic_load_n(&batch_t0, __ATOMIC_ACQUIRE);
+	if(recv_nb32 == 0 && nb32 > 0) hists[BATCH_FIRST].record(now - t0);
+	recv_nb32 = nb32;
+	while(recv_frames_done < recv_frames_nb && recv_nb32 >= recv_next_nb32) {
+		hists[FRAME_RESULT].record(now - t0);
+		recv_frames_done ++;
+		uint64_t values_nb = uint64_t(recv_frames_done + 1) * recv_frame_size;
+		recv_next_nb32 = (values_nb + recv_paro - 1) / recv_paro * recv_transfer_nb32;
+	}
+}
+
+void HwAcc_Timing::recv_progress(unsigned nb32) {
+	if(recv_active == false) return;
+	recv_frames_until(recv_nb32 + nb32, Time64_GetReal());
+}
+
+void HwAcc_Timing::recv_end(unsigned nb32) {
+	if(recv_active == false) return;
+	recv_active = false;
+	int64_t now = Time64_GetReal();
+	// The backend may not have reported progress
+	if(nb32 > recv_nb32) recv_frames_until(nb32, now);
+	// The last transfer is not padded, so the last frame may need fewer words than expected
+	int64_t t0 = __atomic_load_n(&batch_t0, __ATOMIC_ACQUIRE);
+	for( ; recv_frames_done < recv_frames_nb; recv_frames_done++) hists[FRAME_RESULT].record(now - t0);
+	hists[BATCH_LAST].record(now - t0);
+	frames_nb += recv_frames_nb;
+	recv_bytes += uint64_t(nb32) * 4;
+	recv_ns += now - t0;
+}
+
+void HwAcc_Timing::print(void) {
+	printf("Stats HwAcc timing :\n");
+	printf("  Step (us)          count       mean        p50        p90        p99      p99.9        max\n");
+	for(unsigned i=0; i<HIST_NB; i++) {
+		const HwAcc_Hist& h = hists[i];
+		if(h.count == 0) continue;
+		printf("  %-14s %9" PRIu64 "  %9.2f  %9.2f  %9.2f  %9.2f  %9.2f  %9.2f\n",
+			GetHistName(i), h.count, h.mean() / 1e3,
+			h.percentile(0.50) / 1e3, h.percentile(0.90) / 1e3, h.percentile(0.99) / 1e3, h.percentile(0.999) / 1e3,
+			h.max / 1e3
+		);
+	}
+	// The send throughput is what the link accepts, the receive throughput includes the processing by the accelerator
+	if(send_ns > 0) {
+		printf("  Send ......... %" PRIu64 " bytes, %g MB/s\n", sent_bytes, sent_bytes / (send_ns / 1e9) / 1e6);
+	}
+	if(recv_ns > 0) {
+		printf("  Receive ...... %" PRIu64 " bytes, %g MB/s (from start of send to last result)\n", recv_bytes, recv_bytes / (recv_ns / 1e9) / 1e6);
+	}
+}
+
+int HwAcc_Timing::write_json(const char* filename) {
+	FILE* F = fopen(filename, "wb");
+	if(F == NULL) {
+		printf("ERROR HwAcc : Can't open file '%s' for writing\n", filename);
+		return -1;
+	}
+
+	fprintf(F, "{\n");
+	fprintf(F, "  \"frames\": %" PRIu64 ",\n", frames_nb);
+	fprintf(F, "  \"sent_bytes\": %" PRIu64 ",\n", sent_bytes);
+	fprintf(F, "  \"recv_bytes\": %" PRIu64 ",\n", recv_bytes);
+	fprintf(F, "  \"send_mbps\": %g,\n", (send_ns > 0) ? sent_bytes / (send_ns / 1e9) / 1e6 : 0);
+	fprintf(F, "  \"recv_mbps\": %g,\n", (recv_ns > 0) ? recv_bytes / (recv_ns / 1e9) / 1e6 : 0);
+	fprintf(F, "  \"histograms\": {\n");
+	for(unsigned i=0; i<HIST_NB; i++) {
+		fprintf(F, "    \"%s\": ", GetHistName(i));
+		hists[i].print_json(F);
+		fprintf(F, "%s\n", (i + 1 < HIST_NB) ? "," : "");
+	}
+	fprintf(F, "  }\n");
+	fprintf(F, "}\n");
+
+	fclose(F);
+	return 0;
+}
+
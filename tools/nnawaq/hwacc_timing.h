@@ -0,0 +1,156 @@
+
+#pragma once
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+}
+
+
+//============================================
+// Histogram of durations
+//============================================
+
+// Log-linear buckets in the style of HDR histograms : values below 2^SUB_BITS ns are exact,
+// above that each power of 2 is split in 2^SUB_BITS buckets, so the relative error is at most 1/2^SUB_BITS
+// Recording is lock-free, it can be done concurrently from the send and receive threads
+
+class HwAcc_Hist {
+
+	public :
+
+	static const unsigned SUB_BITS = 5;
+	static const unsigned SUB_NB   = 1 << SUB_BITS;
+	static const unsigned EXP_MAX  = 42;  // More than one hour in ns
+	static const unsigned BUCKETS_NB = (EXP_MAX - SUB_BITS + 2) * SUB_NB;
+
+	uint64_t buckets[BUCKETS_NB];
+	uint64_t count;
+	uint64_t sum;
+	uint64_t min;
+	uint64_t max;
+
+	//============================================
+	// Methods
+	//============================================
+
+	HwAcc_Hist(void) { clear(); }
+
+	void clear(void);
+
+	static inline unsigned GetIndex(uint64_t v) {
+		if(v < SUB_NB) return v;
+		unsigned e = 63 - __builtin_clzll(v);
+		if(e > EXP_MAX) return BUCKETS_NB - 1;
+		return (e - SUB_BITS + 1) * SUB_NB + ((v >> (e - SUB_BITS)) & (SUB_NB - 1));
+	}
+	// Highest value that falls in a bucket
+	static uint64_t GetValue(unsigned idx);
+
+	inline void record(int64_t ns) {
+		uint64_t v = (ns > 0) ? ns : 0;
+		__atomic_fetch_add(&buckets[GetIndex(v)], 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&count, 1, __ATOMIC_RELAXED);
+		__atomic_fetch_add(&sum, v, __ATOMIC_RELAXED);
+		uint64_t cur = __atomic_load_n(&min, __ATOMIC_RELAXED);
+		while(v < cur && __atomic_compare_exchange_n(&min, &cur, v, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED) == false);
+		cur = __atomic_load_n(&max, __ATOMIC_RELAXED);
+		while(v > cur && __atomic_compare_exchange_n(&max, &cur, v, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED) == false);
+	}
+
+	// Get the value at a percentile, p is in 0..1
+	uint64_t percentile(double p) const;
+	inline double mean(void) const { return (count > 0) ? (double)sum / count : 0; }
+
+	void print_json(FILE* F) const;
+
+};
+
+
+//============================================
+// Timing of frames and batches sent to the HW accelerator
+//============================================
+
+// The steps that are measured for each frame :
+//   - parse  : reading the frame from the file
+//   - pack   : reordering and packing the values into hardware transfers
+//   - result : from the start of the send operation to the reception of the last result of the frame
+// The steps that are measured for each batch :
+//   - parse  : reading, reordering and packing all frames of the batch
+//   - send   : duration of the send operation
+//   - first  : from the start of the send operation to the reception of the first results
+//   - last   : from the start of the send operation to the reception of the last results
+// Reception times are reported by the backend as data arrives, backends that don't report progress only give the end of the receive operation
+
+class HwAcc_Timing {
+
+	public :
+
+	enum hist_type {
+		FRAME_PARSE = 0,
+		FRAME_PACK,
+		FRAME_RESULT,
+		BATCH_PARSE,
+		BATCH_SEND,
+		BATCH_FIRST,
+		BATCH_LAST,
+		HIST_NB
+	};
+
+	static const char* GetHistName(unsigned idx);
+
+	HwAcc_Hist hists[HIST_NB];
+
+	// Volume of data and total durations, for throughput
+	uint64_t frames_nb = 0;
+	uint64_t sent_bytes = 0;
+	uint64_t recv_bytes = 0;
+	int64_t  send_ns = 0;
+	int64_t  recv_ns = 0;
+
+	private :
+
+	// State of the current batch, the receive side is updated by the receive thread
+	int64_t  batch_t0 = 0;
+	bool     recv_active = false;
+	unsigned recv_frames_nb = 0;
+	unsigned recv_frames_done = 0;
+	unsigned recv_frame_size = 0;
+	unsigned recv_paro = 1;
+	unsigned recv_transfer_nb32 = 1;
+	uint64_t recv_nb32 = 0;
+	uint64_t recv_next_nb32 = 0;  // Number of words needed to complete the next frame
+
+	//============================================
+	// Methods
+	//============================================
+
+	public :
+
+	void clear(void);
+
+	// Called by the sending side
+	void send_begin(void);
+	void send_end(unsigned nb32);
+
+	// Called by the receiving side, before and after the receive operation
+	void recv_begin(unsigned frames_nb, unsigned frame_size, unsigned paro, unsigned transfer_nb32);
+	void recv_end(unsigned nb32);
+	// Called by the backend when words have been received
+	void recv_progress(unsigned nb32);
+
+	void print(void);
+	int  write_json(const char* filename);
+
+	private :
+
+	void recv_frames_until(uint64_t nb32, int64_t now);
+
+};
+
+extern bool         param_hw_hist;
+extern char const * param_hw_hist_json;
+
@@ -0,0 +1,423 @@
+
+// Record and replay of the traffic with a HW accelerator
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <unistd.h>  // For usleep()
+
+#include "nnawaq_utils.h"
+
+}
+
+#include "nn_layers_utils.h"
+
+#include "hwacc_trace.h"
+
+using namespace std;
+
+
+//============================================
+// Trace format
+//============================================
+
+// FNV-1a hash, on 32b words
+uint64_t HwAcc_Trace::Hash32(const uint32_t* buf, unsigned nb) {
+	uint64_t h = 0xcbf29ce484222325ULL;
+	for(unsigned i=0; i<nb; i++) {
+		h ^= buf[i];
+		h *= 0x100000001b3ULL;
+	}
+	return h;
+}
+
+
+//============================================
+// Recording interposer
+//============================================
+
+bool HwAcc_Record::atexit_registered = false;
+
+HwAcc_Record* HwAcc_Record::singleton = nullptr;
+
+HwAcc_Record* HwAcc_Record::OpenSingleton(HwAcc_Common* inner, const char* filename, bool full) {
+	CloseSingleton();
+
+	HwAcc_Record* rec = new HwAcc_Record(inner);
+	rec->full = full;
+	if(rec->trace_open(filename) != 0) {
+		delete rec;
+		return nullptr;
+	}
+	singleton = rec;
+
+	if(atexit_registered == false) {
+		atexit(record_atexit);
+		atexit_registered = true;
+	}
+
+	return singleton;
+}
+void HwAcc_Record::CloseSingleton(void) {
+	if(singleton != nullptr) {
+		delete singleton;
+		singleton = nullptr;
+	}
+}
+
+void HwAcc_Record::record_atexit(void) {
+	CloseSingleton();
+}
+
+HwAcc_Record::HwAcc_Record(HwAcc_Common* inner) {
+	this->inner = inner;
+	// Buffers must suit the wrapped backend
+	dmabufs.align = inner->dmabufs.align;
+	dmabufs.lock  = inner->dmabufs.lock;
+}
+
+HwAcc_Record::~HwAcc_Record(void) {
+	trace_close();
+	if(this == singleton) singleton = nullptr;
+	if(HwAcc_Common::CurrentHwAcc_Get() == this) HwAcc_Common::CurrentHwAcc_Set(inner);
+}
+
+int HwAcc_Record::trace_open(const char* filename) {
+	F = fopen(filename, "wb");
+	if(F == NULL) {
+		printf("ERROR HwAcc : Can't open file '%s' for writing\n", filename);
+		return -1;
+	}
+
+	time_beg = Time64_GetReal();
+
+	HwAcc_Trace::header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, HWACC_TRACE_MAGIC, sizeof(header.magic));
+	header.version = HWACC_TRACE_VERSION;
+	header.flags = full ? 1 : 0;
+	header.time_beg = time_beg;
+	fwrite(&header, sizeof(header), 1, F);
+
+	recs_nb = 0;
+	bytes_nb = sizeof(header);
+
+	return 0;
+}
+
+void HwAcc_Record::trace_close(void) {
+	if(F == NULL) return;
+	fclose(F);
+	F = NULL;
+}
+
+void HwAcc_Record::trace_write(unsigned type, uint32_t arg, uint32_t val, int64_t time_beg_call, const uint32_t* payload, bool with_payload) {
+	int64_t now = Time64_GetReal();
+
+	HwAcc_Trace::rec_t rec;
+	memset(&rec, 0, sizeof(rec));
+	rec.type    = type;
+	rec.arg     = arg;
+	rec.val     = val;
+	rec.dur_ns  = GetMin(now - time_beg_call, (int64_t)UINT32_MAX);
+	rec.time_ns = time_beg_call - time_beg;
+	// The hash is computed outside of the lock
+	if(payload != nullptr) rec.hash = HwAcc_Trace::Hash32(payload, val);
+	if(payload != nullptr && with_payload == true) rec.flags |= HwAcc_Trace::REC_PAYLOAD;
+
+	pthread_mutex_lock(&mutex);
+	if(F != NULL) {
+		fwrite(&rec, sizeof(rec), 1, F);
+		bytes_nb += sizeof(rec);
+		if((rec.flags & HwAcc_Trace::REC_PAYLOAD) != 0) {
+			fwrite(payload, sizeof(*payload), val, F);
+			bytes_nb += val * sizeof(*payload);
+		}
+		recs_nb ++;
+	}
+	pthread_mutex_unlock(&mutex);
+}
+
+uint32_t HwAcc_Record::accreg_rd(unsigned idx) {
+	int64_t t = Time64_GetReal();
+	uint32_t val = inner->accreg_rd(idx);
+	trace_write(HwAcc_Trace::REC_RD, idx, val, t, nullptr, false);
+	return val;
+}
+
+void HwAcc_Record::accreg_wr(unsigned idx, uint32_t val) {
+	int64_t t = Time64_GetReal();
+	inner->accreg_wr(idx, val);
+	trace_write(HwAcc_Trace::REC_WR, idx, val, t, nullptr, false);
+}
+
+unsigned HwAcc_Record::fpga_send32(uint32_t* buf, unsigned buf_nb) {
+	int64_t t = Time64_GetReal();
+	unsigned res = inner->fpga_send32(buf, buf_nb);
+	trace_write(HwAcc_Trace::REC_SEND, buf_nb, res, t, buf, full);
+	return res;
+}
+
+unsigned HwAcc_Record::fpga_send32_wait(uint32_t* buf, unsigned buf_nb) {
+	int64_t t = Time64_GetReal();
+	unsigned res = inner->fpga_send32_wait(buf, buf_nb);
+	trace_write(HwAcc_Trace::REC_SENDW, buf_nb, res, t, buf, full);
+	return res;
+}
+
+unsigned HwAcc_Record::fpga_recv32(uint32_t* buf, unsigned buf_nb) {
+	int64_t t = Time64_GetReal();
+	unsigned res = inner->fpga_recv32(buf, buf_nb);
+	trace_write(HwAcc_Trace::REC_RECV, buf_nb, res, t, buf, true);
+	return res;
+}
+
+void HwAcc_Record::print_stream_stats(void) {
+	inner->print_stream_stats();
+	printf("Stats trace recording : %" PRIu64 " records, %" PRIu64 " kB\n", recs_nb, bytes_nb / 1024);
+}
+
+
+//============================================
+// Replay backend
+//============================================
+
+bool HwAcc_Replay::atexit_registered = false;
+
+HwAcc_Replay* HwAcc_Replay::singleton = nullptr;
+
+HwAcc_Replay* HwAcc_Replay::OpenSingleton(const char* filename, bool timed) {
+	CloseSingleton();
+
+	HwAcc_Replay* rep = new HwAcc_Replay();
+	rep->timed = timed;
+	if(rep->trace_load(filename) != 0) {
+		delete rep;
+		return nullptr;
+	}
+	singleton = rep;
+
+	if(atexit_registered == false) {
+		atexit(replay_atexit);
+		atexit_registered = true;
+	}
+
+	return singleton;
+}
+void HwAcc_Replay::CloseSingleton(void) {
+	if(singleton != nullptr) {
+		delete singleton;
+		singleton = nullptr;
+	}
+}
+
+void HwAcc_Replay::replay_atexit(void) {
+	CloseSingleton();
+}
+
+HwAcc_Replay::HwAcc_Replay(void) {
+	memset(shadow_regs, 0, sizeof(shadow_regs));
+}
+
+HwAcc_Replay::~HwAcc_Replay(void) {
+	if(this == singleton) singleton = nullptr;
+	if(HwAcc_Common::CurrentHwAcc_Get() == this) HwAcc_Common::CurrentHwAcc_Set(nullptr);
+}
+
+int HwAcc_Replay::trace_load(const char* filename) {
+	FILE* F = fopen(filename, "rb");
+	if(F == NULL) {
+		printf("ERROR HwAcc : Can't open file '%s'\n", filename);
+		return -1;
+	}
+
+	HwAcc_Trace::header_t header;
+	size_t z = fread(&header, sizeof(header), 1, F);
+	if(z != 1 || memcmp(header.magic, HWACC_TRACE_MAGIC, sizeof(header.magic)) != 0) {
+		printf("ERROR HwAcc : File '%s' is not a trace of HW accelerator\n", filename);
+		fclose(F);
+		return -1;
+	}
+	if(header.version != HWACC_TRACE_VERSION) {
+		printf("ERROR HwAcc : Trace '%s' has version %u, only version %u is supported\n", filename, header.version, HWACC_TRACE_VERSION);
+		fclose(F);
+		return -1;
+	}
+
+	HwAcc_Trace::rec_t rec;
+	while(fread(&rec, sizeof(rec), 1, F) == 1) {
+		unsigned idx = recs.size();
+		recs.push_back(rec);
+		recs_payload.push_back(payloads.size());
+		if((rec.flags & HwAcc_Trace::REC_PAYLOAD) != 0) {
+			size_t beg = payloads.size();
+			payloads.resize(beg + rec.val);
+			if(fread(payloads.data() + beg, sizeof(uint32_t), rec.val, F) != rec.val) {
+				printf("Warning HwAcc : Trace '%s' is truncated\n", filename);
+				recs.pop_back();
+				recs_payload.pop_back();
+				payloads.resize(beg);
+				break;
+			}
+		}
+		if(rec.type == HwAcc_Trace::REC_RD || rec.type == HwAcc_Trace::REC_WR) chan_regs.push_back(idx);
+		else if(rec.type == HwAcc_Trace::REC_SEND || rec.type == HwAcc_Trace::REC_SENDW) chan_send.push_back(idx);
+		else if(rec.type == HwAcc_Trace::REC_RECV) chan_recv.push_back(idx);
+	}
+	fclose(F);
+
+	consumed.resize(recs.size(), false);
+
+	printf("Info HwAcc : Loaded trace '%s' with %zu records : %zu register accesses, %zu sends, %zu receives\n",
+		filename, recs.size(), chan_regs.size(), chan_send.size(), chan_recv.size()
+	);
+
+	return 0;
+}
+
+// Find the next register access of this type and index, the caller must hold the mutex
+const HwAcc_Trace::rec_t* HwAcc_Replay::match_reg(unsigned type, unsigned idx) {
+	const HwAcc_Trace::rec_t* res = nullptr;
+
+	// The window follows the last match, so records that are never matched don't block the replay
+	unsigned end = GetMin((size_t)GetMax(cur_regs, last_regs) + MATCH_WINDOW, chan_regs.size());
+	for(unsigned i=cur_regs; i<end; i++) {
+		unsigned r = chan_regs[i];
+		if(consumed[r] == true) continue;
+		if(recs[r].type != type || recs[r].arg != idx) continue;
+		consumed[r] = true;
+		res = &recs[r];
+		last_regs = i;
+		break;
+	}
+
+	// Records far behind the last match are given up
+	while(cur_regs + MATCH_WINDOW < last_regs) {
+		unsigned r = chan_regs[cur_regs++];
+		if(consumed[r] == true) continue;
+		consumed[r] = true;
+		skip_regs ++;
+	}
+	// Skip the consumed records
+	while(cur_regs < chan_regs.size() && consumed[chan_regs[cur_regs]] == true) cur_regs++;
+
+	return res;
+}
+
+// Reproduce the duration of the recorded operation
+void HwAcc_Replay::wait_dur(int64_t time_beg_call, const HwAcc_Trace::rec_t* rec) {
+	if(timed == false) return;
+	int64_t time_end = time_beg_call + rec->dur_ns;
+	do {
+		int64_t rem = time_end - Time64_GetReal();
+		if(rem <= 0) break;
+		if(rem > 100000) usleep(rem / 1000 - 50);
+	} while(1);
+}
+
+uint32_t HwAcc_Replay::accreg_rd(unsigned idx) {
+	pthread_mutex_lock(&mutex);
+	const HwAcc_Trace::rec_t* rec = match_reg(HwAcc_Trace::REC_RD, idx);
+	uint32_t val = 0;
+	if(rec != nullptr) {
+		val = rec->val;
+		shadow_regs[idx % 256] = val;
+	}
+	else {
+		miss_rd ++;
+		val = shadow_regs[idx % 256];
+	}
+	pthread_mutex_unlock(&mutex);
+	return val;
+}
+
+void HwAcc_Replay::accreg_wr(unsigned idx, uint32_t val) {
+	pthread_mutex_lock(&mutex);
+	const HwAcc_Trace::rec_t* rec = match_reg(HwAcc_Trace::REC_WR, idx);
+	if(rec == nullptr) miss_wr ++;
+	else if(rec->val != val) {
+		diff_wr ++;
+		if(param_debug == true) printf("DEBUG HwAcc : Replay, write to register %u : 0x%08x, recorded 0x%08x\n", idx, val, rec->val);
+	}
+	shadow_regs[idx % 256] = val;
+	pthread_mutex_unlock(&mutex);
+}
+
+unsigned HwAcc_Replay::send_common(unsigned type, uint32_t* buf, unsigned buf_nb) {
+	int64_t t = Time64_GetReal();
+
+	pthread_mutex_lock(&mutex);
+	const HwAcc_Trace::rec_t* rec = nullptr;
+	if(cur_send < chan_send.size()) {
+		unsigned r = chan_send[cur_send++];
+		consumed[r] = true;
+		rec = &recs[r];
+	}
+	else {
+		miss_send ++;
+	}
+	pthread_mutex_unlock(&mutex);
+
+	if(rec == nullptr) return buf_nb;
+
+	unsigned nb = GetMin(rec->val, buf_nb);
+	if(rec->type != type || rec->arg != buf_nb || HwAcc_Trace::Hash32(buf, nb) != rec->hash) {
+		__atomic_fetch_add(&diff_send, 1, __ATOMIC_RELAXED);
+		if(param_debug == true) printf("DEBUG HwAcc : Replay, send of %u words differs from the recording (%u words)\n", buf_nb, rec->arg);
+	}
+
+	wait_dur(t, rec);
+
+	return nb;
+}
+
+unsigned HwAcc_Replay::fpga_send32(uint32_t* buf, unsigned buf_nb) {
+	return send_common(HwAcc_Trace::REC_SEND, buf, buf_nb);
+}
+
+unsigned HwAcc_Replay::fpga_send32_wait(uint32_t* buf, unsigned buf_nb) {
+	return send_common(HwAcc_Trace::REC_SENDW, buf, buf_nb);
+}
+
+unsigned HwAcc_Replay::fpga_recv32(uint32_t* buf, unsigned buf_nb) {
+	int64_t t = Time64_GetReal();
+
+	pthread_mutex_lock(&mutex);
+	unsigned r = ~0u;
+	if(cur_recv < chan_recv.size()) {
+		r = chan_recv[cur_recv++];
+		consumed[r] = true;
+	}
+	else {
+		miss_recv ++;
+	}
+	pthread_mutex_unlock(&mutex);
+
+	if(r == ~0u) return 0;
+
+	const HwAcc_Trace::rec_t* rec = &recs[r];
+	unsigned nb = GetMin(rec->val, buf_nb);
+	memcpy(buf, payloads.data() + recs_payload[r], nb * sizeof(*buf));
+	timing.recv_progress(nb);
+
+	wait_dur(t, rec);
+
+	return nb;
+}
+
+void HwAcc_Replay::print_stream_stats(void) {
+	printf("Stats trace replay :\n");
+	printf("  Consumed ...... %u/%zu register accesses, %u/%zu sends, %u/%zu receives\n",
+		cur_regs, chan_regs.size(), cur_send, chan_send.size(), cur_recv, chan_recv.size()
+	);
+	printf("  Divergences ... %" PRIu64 " register writes, %" PRIu64 " sends, %" PRIu64 " recorded register accesses skipped\n", diff_wr, diff_send, skip_regs);
+	printf("  Missing ....... %" PRIu64 " register reads, %" PRIu64 " register writes, %" PRIu64 " sends, %" PRIu64 " receives\n",
+		miss_rd, miss_wr, miss_send, miss_recv
+	);
+}
+
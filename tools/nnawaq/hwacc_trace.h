@@ -0,0 +1,238 @@
+
+#pragma once
+
+extern "C" {
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+}
+
+#include <vector>
+
+#include "hwacc_common.h"
+
+
+//============================================
+// Binary trace of the traffic with a HW accelerator
+//============================================
+
+// The trace file begins with a header, then records follow in order of completion of the calls
+// Received data is always stored because it is needed for replay, sent data is stored only on request, otherwise only its hash is kept
+// All values are stored in host endianness
+
+#define HWACC_TRACE_MAGIC   "NNAWTRC"  // With the terminating null character, this is 8 bytes
+#define HWACC_TRACE_VERSION 1
+
+class HwAcc_Trace {
+
+	public :
+
+	enum rec_type {
+		REC_RD    = 1,
+		REC_WR    = 2,
+		REC_SEND  = 3,
+		REC_SENDW = 4,
+		REC_RECV  = 5,
+	};
+
+	// Flag for records that are followed by the payload, with as many 32b words as transferred
+	static const uint8_t REC_PAYLOAD = 0x01;
+
+	typedef struct header_t {
+		char     magic[8];
+		uint32_t version;
+		uint32_t flags;
+		int64_t  time_beg;  // Real time at beginning of recording, in ns
+	} header_t;
+
+	typedef struct rec_t {
+		uint8_t  type;
+		uint8_t  flags;
+		uint16_t reserved;
+		uint32_t arg;      // Register index, or number of words requested
+		uint32_t val;      // Register value, or number of words transferred
+		uint32_t dur_ns;   // Duration of the call, saturated
+		int64_t  time_ns;  // Beginning of the call, relative to the beginning of recording
+		uint64_t hash;     // Hash of transferred words
+	} rec_t;
+
+	static uint64_t Hash32(const uint32_t* buf, unsigned nb);
+
+};
+
+
+//============================================
+// Recording interposer
+//============================================
+
+// Wraps a real backend, forwards all calls to it and logs them
+// The wrapped backend is not owned, it is closed by its own means
+
+class HwAcc_Record : public HwAcc_Common {
+
+	private :
+
+	static bool atexit_registered;
+	static HwAcc_Record* singleton;
+
+	public :
+	static HwAcc_Record* OpenSingleton(HwAcc_Common* inner, const char* filename, bool full);
+	static void CloseSingleton(void);
+
+	private :
+	static void record_atexit(void);
+
+	//============================================
+	// Fields
+	//============================================
+
+	private :
+
+	HwAcc_Common* inner = nullptr;
+	FILE*    F = nullptr;
+	bool     full = false;
+	int64_t  time_beg = 0;
+
+	// Stats
+	uint64_t recs_nb = 0;
+	uint64_t bytes_nb = 0;
+
+	// Calls may come from the send and receive threads concurrently
+	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+	//============================================
+	// Constructor / Destructor
+	//============================================
+
+	private :
+	HwAcc_Record(HwAcc_Common* inner);
+
+	public :
+	~HwAcc_Record();
+
+	//============================================
+	// Override of virtual methods
+	//============================================
+
+	uint32_t accreg_rd(unsigned idx);
+	void     accreg_wr(unsigned idx, uint32_t val);
+
+	unsigned fpga_send32(uint32_t* buf, unsigned buf_nb);
+	unsigned fpga_send32_wait(uint32_t* buf, unsigned buf_nb);
+	unsigned fpga_recv32(uint32_t* buf, unsigned buf_nb);
+
+	void     print_stream_stats(void);
+
+	//============================================
+	// Methods
+	//============================================
+
+	private :
+
+	int  trace_open(const char* filename);
+	void trace_close(void);
+	void trace_write(unsigned type, uint32_t arg, uint32_t val, int64_t time_beg_call, const uint32_t* payload, bool with_payload);
+
+};
+
+
+//============================================
+// Replay backend
+//============================================
+
+// Serves the calls from a recorded trace, without hardware
+// Register accesses, sent data and received data are matched separately, so the interleaving of threads does not need to be identical
+// Register accesses are matched by register index within a small window, to tolerate reordering between threads
+// Divergences from the recording are counted : different written values, different sent data, missing records
+
+class HwAcc_Replay : public HwAcc_Common {
+
+	private :
+
+	static bool atexit_registered;
+	static HwAcc_Replay* singleton;
+
+	public :
+	static HwAcc_Replay* OpenSingleton(const char* filename, bool timed);
+	static void CloseSingleton(void);
+
+	private :
+	static void replay_atexit(void);
+
+	//============================================
+	// Fields
+	//============================================
+
+	private :
+
+	// Number of records that are searched for a matching register access
+	static const unsigned MATCH_WINDOW = 64;
+
+	// Reproduce the durations of stream operations
+	bool timed = false;
+
+	std::vector<HwAcc_Trace::rec_t> recs;
+	std::vector<uint64_t> recs_payload;  // Offset of payload in 32b words, for each record
+	std::vector<uint32_t> payloads;
+
+	// Records of each channel, with index of the first not consumed
+	std::vector<unsigned> chan_regs;
+	std::vector<unsigned> chan_send;
+	std::vector<unsigned> chan_recv;
+	std::vector<bool>     consumed;
+	unsigned cur_regs = 0;
+	unsigned last_regs = 0;  // Position of the last matched register access
+	unsigned cur_send = 0;
+	unsigned cur_recv = 0;
+
+	// Last known register values, for reads that were not recorded
+	uint32_t shadow_regs[256];
+
+	// Stats
+	uint64_t diff_wr = 0;
+	uint64_t diff_send = 0;
+	uint64_t skip_regs = 0;
+	uint64_t miss_rd = 0;
+	uint64_t miss_wr = 0;
+	uint64_t miss_send = 0;
+	uint64_t miss_recv = 0;
+
+	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+	//============================================
+	// Constructor / Destructor
+	//============================================
+
+	private :
+	HwAcc_Replay(void);
+
+	public :
+	~HwAcc_Replay();
+
+	//============================================
+	// Override of virtual methods
+	//============================================
+
+	uint32_t accreg_rd(unsigned idx);
+	void     accreg_wr(unsigned idx, uint32_t val);
+
+	unsigned fpga_send32(uint32_t* buf, unsigned buf_nb);
+	unsigned fpga_send32_wait(uint32_t* buf, unsigned buf_nb);
+	unsigned fpga_recv32(uint32_t* buf, unsigned buf_nb);
+
+	void     print_stream_stats(void);
+
+	//============================================
+	// Methods
+	//============================================
+
+	private :
+
+	int  trace_load(const char* filename);
+	const HwAcc_Trace::rec_t* match_reg(unsigned type, unsigned idx);
+	unsigned send_common(unsigned type, uint32_t* buf, unsigned buf_nb);
+	void wait_dur(int64_t time_beg_call, const HwAcc_Trace::rec_t* rec);
+
+};
+
@@ -0,0 +1,197 @@
+
+// Wait strategy for polling of HW accelerator FIFOs
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+#include <time.h>
+#include <unistd.h>  // For usleep()
+
+#include "nnawaq_utils.h"
+
+}  // extern "C"
+
+#include "hwacc_wait.h"
+
+using namespace std;
+
+
+// The wait strategy selected by the user
+HwAcc_Wait::mode_type param_hw_wait = HwAcc_Wait::MODE_ADAPTIVE;
+
+
+// Hint to the CPU that this is a spin loop
+static inline void cpu_relax(void) {
+	#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+	#elif defined(__aarch64__) || defined(__arm__)
+	asm volatile("yield" ::: "memory");
+	#else
+	asm volatile("" ::: "memory");
+	#endif
+}
+
+static inline int64_t time_mono_ns(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static inline void sleep_ns(unsigned ns) {
+	struct timespec ts;
+	ts.tv_sec  = ns / 1000000000;
+	ts.tv_nsec = ns % 1000000000;
+	nanosleep(&ts, nullptr);
+}
+
+
+//============================================
+// Class methods
+//============================================
+
+HwAcc_Wait::mode_type HwAcc_Wait::GetMode(const char* name) {
+	if(strcmp(name, "adaptive") == 0) return MODE_ADAPTIVE;
+	if(strcmp(name, "spin") == 0)     return MODE_SPIN;
+	if(strcmp(name, "pause") == 0)    return MODE_PAUSE;
+	if(strcmp(name, "backoff") == 0)  return MODE_BACKOFF;
+	if(strcmp(name, "sleep") == 0)    return MODE_SLEEP;
+	return (mode_type)-1;
+}
+
+HwAcc_Wait::mode_type HwAcc_Wait::GetModeVerbose(const char* name) {
+	mode_type mode = GetMode(name);
+	if(mode == (mode_type)-1) {
+		printf("Error: Unknown wait strategy '%s', expected adaptive, spin, pause, backoff or sleep\n", name);
+	}
+	return mode;
+}
+
+const char* HwAcc_Wait::GetModeName(mode_type mode) {
+	if(mode == MODE_ADAPTIVE) return "adaptive";
+	if(mode == MODE_SPIN)     return "spin";
+	if(mode == MODE_PAUSE)    return "pause";
+	if(mode == MODE_BACKOFF)  return "backoff";
+	if(mode == MODE_SLEEP)    return "sleep";
+	return "unknown";
+}
+
+
+//============================================
+// Methods
+//============================================
+
+bool HwAcc_Wait::wait(uint64_t timeout_us) {
+	int64_t now = time_mono_ns();
+	stat_polls ++;
+
+	if(in_stall == false) {
+		in_stall = true;
+		stall_beg = now;
+		backoff_cur_ns = backoff_min_ns;
+	}
+	stall_dur = now - stall_beg;
+
+	if(timeout_us > 0 && (uint64_t)stall_dur > timeout_us * 1000) {
+		in_stall = false;
+		stat_stalls ++;
+		stat_timeouts ++;
+		stat_wait_ns += stall_dur;
+		return false;
+	}
+
+	// Select the phase
+	mode_type phase = mode;
+	if(mode == MODE_ADAPTIVE) {
+		if(stall_dur < spin_ns) phase = MODE_PAUSE;
+		else if(stall_dur < backoff_ns) phase = MODE_BACKOFF;
+		else phase = MODE_SLEEP;
+	}
+
+	if(phase == MODE_SPIN) {
+		// Immediately poll again
+	}
+	else if(phase == MODE_PAUSE) {
+		for(unsigned i=0; i<8; i++) cpu_relax();
+	}
+	else if(phase == MODE_BACKOFF) {
+		sleep_ns(backoff_cur_ns);
+		backoff_cur_ns = GetMin(backoff_cur_ns * 2, backoff_max_ns);
+	}
+	else {
+		usleep(sleep_us);
+	}
+
+	return true;
+}
+
+void HwAcc_Wait::stall_end(unsigned words_nb) {
+	int64_t dur = time_mono_ns() - stall_beg;
+	in_stall = false;
+
+	stat_stalls ++;
+	stat_wait_ns += dur;
+	if((uint64_t)dur > stat_max_ns) stat_max_ns = dur;
+	if(dur < spin_ns) stat_phase_spin ++;
+	else if(dur < backoff_ns) stat_phase_backoff ++;
+	else stat_phase_sleep ++;
+
+	// Moving averages, with a short warmup
+	double alpha = (stat_stalls < 16) ? 1.0 / stat_stalls : 1.0 / 16;
+	avg_stall_ns += alpha * (dur - avg_stall_ns);
+	if(dur > 0) avg_rate += alpha * ((double)words_nb / dur - avg_rate);
+
+	// Periodic update of thresholds
+	if(mode == MODE_ADAPTIVE && stat_stalls % 64 == 0) tune();
+}
+
+void HwAcc_Wait::tune(void) {
+	if(stat_stalls == 0) return;
+
+	// Spin long enough to cover twice the typical stall
+	double spin = 2 * avg_stall_ns;
+	spin = GetMax(spin, (double)SPIN_MIN_NS);
+	spin = GetMin(spin, (double)SPIN_MAX_NS);
+	spin_ns = spin;
+
+	// Back off until the time to fill half the FIFO, beyond that the FIFO is probably blocked for a long time
+	double backoff = 8 * spin;
+	if(avg_rate > 0 && fifo_depth > 0) backoff = GetMax(backoff, fifo_depth / 2 / avg_rate);
+	backoff = GetMin(backoff, (double)BACKOFF_MAX_NS);
+	backoff_ns = GetMax(backoff, spin);
+
+	// The backoff steps and the sleep durations follow the scale of the stalls
+	backoff_min_ns = GetMax(spin_ns / 4, 250u);
+	backoff_max_ns = GetMax(backoff_ns / 4, backoff_min_ns);
+	sleep_us = GetMax(backoff_max_ns / 1000, 10u);
+}
+
+void HwAcc_Wait::stats_clear(void) {
+	stat_stalls = 0;
+	stat_polls = 0;
+	stat_wait_ns = 0;
+	stat_max_ns = 0;
+	stat_phase_spin = 0;
+	stat_phase_backoff = 0;
+	stat_phase_sleep = 0;
+	stat_timeouts = 0;
+}
+
+void HwAcc_Wait::print_stats(const char* name) {
+	printf("  %s : strategy %s, %" PRIu64 " stalls, %" PRIu64 " polls, wait %g ms (max %g us), timeouts %" PRIu64 "\n",
+		name, GetModeName(mode), stat_stalls, stat_polls, stat_wait_ns / 1e6, stat_max_ns / 1e3, stat_timeouts
+	);
+	if(mode == MODE_ADAPTIVE) {
+		printf("    Resolved while spinning %" PRIu64 ", in backoff %" PRIu64 ", in sleep %" PRIu64 "\n",
+			stat_phase_spin, stat_phase_backoff, stat_phase_sleep
+		);
+		printf("    Thresholds : spin %u ns, backoff %u ns (steps %u to %u ns), sleep %u us\n",
+			spin_ns, backoff_ns, backoff_min_ns, backoff_max_ns, sleep_us
+		);
+	}
+}
+
@@ -0,0 +1,105 @@
+
+#pragma once
+
+extern "C" {
+
+#include <stdint.h>
+#include <stdbool.h>
+
+}
+
+
+//============================================
+// Wait strategy for polling of HW accelerator FIFOs
+//============================================
+
+// A stall begins when a FIFO is not ready, and ends when it is ready again
+// The adaptive strategy goes through these phases, depending on the time already spent in the current stall :
+//   - spin with a CPU pause instruction, short stalls are resolved with no latency
+//   - exponential backoff with short sleeps, doubling from the min to the max duration
+//   - sleep with a fixed duration, long stalls don't burn CPU
+// The phase thresholds are tuned from the measured stall durations and FIFO fill rates :
+// spinning lasts long enough to cover the typical stall, and backoff covers the time to fill a significant part of the FIFO
+
+class HwAcc_Wait {
+
+	public :
+
+	enum mode_type {
+		MODE_ADAPTIVE = 0,
+		MODE_SPIN     = 1,
+		MODE_PAUSE    = 2,
+		MODE_BACKOFF  = 3,
+		MODE_SLEEP    = 4,
+	};
+
+	static mode_type GetMode(const char* name);
+	static mode_type GetModeVerbose(const char* name);
+	static const char* GetModeName(mode_type mode);
+
+	// Parameters
+	mode_type mode = MODE_ADAPTIVE;
+	unsigned  spin_ns        = 2000;     // Duration of the spin phase
+	unsigned  backoff_ns     = 200000;   // End of the backoff phase
+	unsigned  backoff_min_ns = 1000;
+	unsigned  backoff_max_ns = 50000;
+	unsigned  sleep_us       = 100;      // Duration of sleeps in the last phase
+
+	// Depth of the FIFO in words, used for tuning
+	unsigned  fifo_depth     = 0;
+
+	// Bounds of the tuned thresholds
+	static const unsigned SPIN_MIN_NS    = 500;
+	static const unsigned SPIN_MAX_NS    = 50000;
+	static const unsigned BACKOFF_MAX_NS = 2000000;
+
+	// Stats
+	uint64_t stat_stalls    = 0;
+	uint64_t stat_polls     = 0;
+	uint64_t stat_wait_ns   = 0;
+	uint64_t stat_max_ns    = 0;
+	uint64_t stat_phase_spin    = 0;  // Number of stalls resolved in each phase
+	uint64_t stat_phase_backoff = 0;
+	uint64_t stat_phase_sleep   = 0;
+	uint64_t stat_timeouts  = 0;
+
+	private :
+
+	// State of the current stall
+	bool     in_stall = false;
+	int64_t  stall_beg = 0;
+	int64_t  stall_dur = 0;
+	unsigned backoff_cur_ns = 0;
+
+	// Moving averages for tuning
+	double   avg_stall_ns = 0;
+	double   avg_rate = 0;  // In words per ns
+
+	//============================================
+	// Methods
+	//============================================
+
+	public :
+
+	// Called when the FIFO is not ready, return false on timeout (zero means no timeout)
+	bool wait(uint64_t timeout_us);
+
+	// Called when the FIFO is ready, with the number of words it can transfer
+	inline void ready(unsigned words_nb) {
+		if(in_stall == true) stall_end(words_nb);
+	}
+
+	// Tune the thresholds, this is done periodically in adaptive mode
+	void tune(void);
+
+	void stats_clear(void);
+	void print_stats(const char* name);
+
+	private :
+
+	void stall_end(unsigned words_nb);
+
+};
+
+extern HwAcc_Wait::mode_type param_hw_wait;
+
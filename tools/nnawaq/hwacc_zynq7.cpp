@@ -42,6 +42,12 @@ HwAcc_Zynq7* HwAcc_Zynq7::GetSingleton(intptr_t addr) {
 	}
 	return singleton;
 }
+HwAcc_Zynq7* HwAcc_Zynq7::GetSingletonMock(double rx_rate, double tx_rate) {
+	if(singleton == nullptr) {
+		singleton = new HwAcc_Zynq7(rx_rate, tx_rate);
+	}
+	return singleton;
+}
 void HwAcc_Zynq7::CloseSingleton(void) {
 	if(singleton != nullptr) {
 		delete singleton;
@@ -64,6 +70,12 @@ HwAcc_Zynq7::HwAcc_Zynq7(intptr_t addr) {
 	zynq7_init(addr);
 }
 
+HwAcc_Zynq7::HwAcc_Zynq7(double rx_rate, double tx_rate) {
+	mock_rx_rate = rx_rate;
+	mock_tx_rate = tx_rate;
+	zynq7_init_mock();
+}
+
 HwAcc_Zynq7::~HwAcc_Zynq7(void) {
 	zynq7_close();
 	if(this == singleton) singleton = nullptr;
@@ -108,6 +120,43 @@ void HwAcc_Zynq7::zynq7_init(intptr_t addr) {
 	printf("Successful memory mapping to access hardware at address 0x%" PRIxPTR "\n", addr);
 	fflush(stdout);
 
+	// The depth of FIFOs is not known, use the max value of the counters
+	wait_send.fifo_depth = uint_genmask(memreg_rxfifo_cnt->bits);
+	wait_recv.fifo_depth = uint_genmask(memreg_txfifo_cnt->bits);
+
+	// Register the close function
+	singleton = this;
+	if(atexit_registered == false) {
+		atexit(zynq7_atexit);
+		atexit_registered = true;
+	}
+}
+
+void HwAcc_Zynq7::zynq7_init_mock(void) {
+	if(mmap_base != nullptr) return;
+
+	page_size = sysconf(_SC_PAGESIZE);
+	mmap_base = mmap(nullptr, page_size, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANONYMOUS, -1, 0);
+	if(mmap_base == MAP_FAILED) {
+		int errno_saved = errno;
+		printf("System error %d : %s\n", errno_saved, strerror(errno_saved));
+		printf("Zynq7 Error: Could not perform memory map for the mock registers\n");
+		exit(EXIT_FAILURE);
+	}
+	hwacc_ptr_regs32 = (uint32_t*)mmap_base;
+	mock = true;
+
+	wait_send.fifo_depth = uint_genmask(memreg_rxfifo_cnt->bits);
+	wait_recv.fifo_depth = uint_genmask(memreg_txfifo_cnt->bits);
+
+	// Launch the simulator of the FIFOs
+	mock_time = Time64_GetReal();
+	mock_stop = false;
+	pthread_create(&mock_thread, NULL, mock_thread_wrapper, this);
+
+	printf("Zynq7 mock : Registers are simulated, RX FIFO consumes %g words/us, TX FIFO produces %g words/us\n", mock_rx_rate, mock_tx_rate);
+	fflush(stdout);
+
 	// Register the close function
 	singleton = this;
 	if(atexit_registered == false) {
@@ -117,20 +166,92 @@ void HwAcc_Zynq7::zynq7_init(intptr_t addr) {
 }
 
 void HwAcc_Zynq7::zynq7_close() {
+	if(mock == true) {
+		mock_stop = true;
+		pthread_join(mock_thread, NULL);
+		mock = false;
+	}
 	munmap(mmap_base, page_size);
-	close(fd_mem);
+	if(fd_mem >= 0) close(fd_mem);
+	fd_mem = -1;
 	mmap_base = nullptr;
 	hwacc_ptr_regs32 = nullptr;
 }
 
+void* HwAcc_Zynq7::mock_thread_wrapper(void* arg) {
+	HwAcc_Zynq7* hwacc = (HwAcc_Zynq7*)arg;
+	hwacc->mock_simulate();
+	return NULL;
+}
+
+// Simulation of the FIFOs behind the register window
+// The RX FIFO is drained and the TX FIFO is filled according to the elapsed time
+// The simulator thread advances the state periodically, and reads of FIFO counters also advance it so they are never stale
+void HwAcc_Zynq7::mock_step(void) {
+	unsigned tx_depth = uint_genmask(memreg_txfifo_cnt->bits);
+
+	pthread_mutex_lock(&mock_mutex);
+
+	int64_t newtime = Time64_GetReal();
+	double elapsed_us = (newtime - mock_time) / 1e3;
+	mock_time = newtime;
+
+	uint32_t pushed = __atomic_load_n(&hwacc_ptr_regs32[MOCK_REG_PUSHED], __ATOMIC_ACQUIRE);
+	uint32_t popped = __atomic_load_n(&hwacc_ptr_regs32[MOCK_REG_POPPED], __ATOMIC_ACQUIRE);
+
+	// Consume words from the RX FIFO, no credit is accumulated while the FIFO is empty
+	unsigned rx_occ = pushed - mock_rx_drained;
+	mock_rx_frac += mock_rx_rate * elapsed_us;
+	unsigned drain = GetMin((double)rx_occ, mock_rx_frac);
+	mock_rx_drained += drain;
+	mock_rx_frac -= drain;
+	if(drain == rx_occ) mock_rx_frac = GetMin(mock_rx_frac, 1.0);
+
+	// Produce words into the TX FIFO, no credit is accumulated while the FIFO is full
+	unsigned tx_free = tx_depth - GetMin(mock_tx_produced - popped, tx_depth);
+	mock_tx_frac += mock_tx_rate * elapsed_us;
+	unsigned produce = GetMin((double)tx_free, mock_tx_frac);
+	mock_tx_produced += produce;
+	mock_tx_frac -= produce;
+	if(produce == tx_free) mock_tx_frac = GetMin(mock_tx_frac, 1.0);
+
+	__atomic_store_n(&hwacc_ptr_regs32[MOCK_REG_DRAINED], mock_rx_drained, __ATOMIC_RELEASE);
+	__atomic_store_n(&hwacc_ptr_regs32[MOCK_REG_PRODUCED], mock_tx_produced, __ATOMIC_RELEASE);
+
+	pthread_mutex_unlock(&mock_mutex);
+}
+
+void HwAcc_Zynq7::mock_simulate(void) {
+	while(mock_stop == false) {
+		mock_step();
+		usleep(10);
+	}
+}
+
+// The FIFO counters are computed from the counters of the software and of the simulator, so they are always up to date
+uint32_t HwAcc_Zynq7::mock_fifo_cnt(void) {
+	mock_step();
+	unsigned rx_depth = uint_genmask(memreg_rxfifo_cnt->bits);
+	unsigned tx_depth = uint_genmask(memreg_txfifo_cnt->bits);
+	uint32_t pushed   = __atomic_load_n(&hwacc_ptr_regs32[MOCK_REG_PUSHED], __ATOMIC_ACQUIRE);
+	uint32_t popped   = __atomic_load_n(&hwacc_ptr_regs32[MOCK_REG_POPPED], __ATOMIC_ACQUIRE);
+	uint32_t drained  = __atomic_load_n(&hwacc_ptr_regs32[MOCK_REG_DRAINED], __ATOMIC_ACQUIRE);
+	uint32_t produced = __atomic_load_n(&hwacc_ptr_regs32[MOCK_REG_PRODUCED], __ATOMIC_ACQUIRE);
+	uint32_t r = 0;
+	memreg_rxfifo_cnt->SetRef(r, rx_depth - GetMin(pushed - drained, rx_depth));
+	memreg_txfifo_cnt->SetRef(r, GetMin(produced - popped, tx_depth));
+	return r;
+}
+
 // These methods override the virtual methods
 
 // Access configuration registers
 uint32_t HwAcc_Zynq7::accreg_rd(unsigned reg) {
-	return hwacc_ptr_regs32[reg];
+	if(mock == true && reg == memreg_rxfifo_cnt->reg_idx) return mock_fifo_cnt();
+	return ((volatile uint32_t*)hwacc_ptr_regs32)[reg];
 }
 void HwAcc_Zynq7::accreg_wr(unsigned reg, uint32_t v) {
-	hwacc_ptr_regs32[reg] = v;
+	((volatile uint32_t*)hwacc_ptr_regs32)[reg] = v;
 }
 
 // Just perform a dummy read operation for synchronization purposes
@@ -147,21 +268,18 @@ void HwAcc_Zynq7::accreg_sync_read(void) {
 
 // Streams of data
 // Read/Write anywhere in the slave registers 64 to 127 result in push/pop to/from RX and TX fifos
+// When a FIFO is not ready, the wait strategy decides whether to spin, back off or sleep
 unsigned HwAcc_Zynq7::fpga_send32(uint32_t* buf, unsigned buf_nb) {
 	unsigned rem_nb = buf_nb;
 	unsigned res_nb = 0;
-	unsigned total_sleep_us = 0;
+	wait_send.mode = param_hw_wait;
 	while(rem_nb > 0) {
 		unsigned len = std::min(rem_nb, accreg_get_rxfifo_cnt());
 		if(len == 0) {
-			if(param_timeout_send_us > 0 && total_sleep_us > param_timeout_send_us) {
-				break;
-			}
-			usleep(100);  // FIXME Arbitrary sleep
-			total_sleep_us += 1000;
+			if(wait_send.wait(param_timeout_send_us) == false) break;
 			continue;
 		}
-		total_sleep_us = 0;
+		wait_send.ready(len);
 		if(BURSTS_ENABLE == true) {
 			len = std::min(len, BURSTS_MAX);
 			memcpy(hwacc_ptr_regs32+64, buf, len*sizeof(*buf));
@@ -170,6 +288,7 @@ unsigned HwAcc_Zynq7::fpga_send32(uint32_t* buf, unsigned buf_nb) {
 			// Don't use burst transfers
 			for(unsigned i=0; i<len; i++) ((volatile uint32_t*)hwacc_ptr_regs32)[64] = buf[i];
 		}
+		if(mock == true) __atomic_fetch_add(&hwacc_ptr_regs32[MOCK_REG_PUSHED], len, __ATOMIC_RELEASE);
 		buf += len;
 		rem_nb -= len;
 		res_nb += len;
@@ -185,18 +304,14 @@ unsigned HwAcc_Zynq7::fpga_send32_wait(uint32_t* buf, unsigned buf_nb) {
 unsigned HwAcc_Zynq7::fpga_recv32(uint32_t* buf, unsigned buf_nb) {
 	unsigned rem_nb = buf_nb;
 	unsigned res_nb = 0;
-	unsigned total_sleep_us = 0;
+	wait_recv.mode = param_hw_wait;
 	while(rem_nb > 0) {
 		unsigned len = std::min(rem_nb, accreg_get_txfifo_cnt());
 		if(len == 0) {
-			if(param_timeout_send_us > 0 && total_sleep_us > param_timeout_send_us) {
-				break;
-			}
-			usleep(100);  // FIXME Arbitrary sleep
-			total_sleep_us += 1000;
+			if(wait_recv.wait(param_timeout_recv_us) == false) break;
 			continue;
 		}
-		total_sleep_us = 0;
+		wait_recv.ready(len);
 		if(BURSTS_ENABLE == true) {
 			len = std::min(len, BURSTS_MAX);
 			memcpy(buf, hwacc_ptr_regs32+64, len*sizeof(*buf));
@@ -205,6 +320,8 @@ unsigned HwAcc_Zynq7::fpga_recv32(uint32_t* buf, unsigned buf_nb) {
 			// Don't use burst transfers
 			for(unsigned i=0; i<len; i++) buf[i] = ((volatile uint32_t*)hwacc_ptr_regs32)[64];
 		}
+		if(mock == true) __atomic_fetch_add(&hwacc_ptr_regs32[MOCK_REG_POPPED], len, __ATOMIC_RELEASE);
+		timing.recv_progress(len);
 		buf += len;
 		rem_nb -= len;
 		res_nb += len;
@@ -212,3 +329,35 @@ unsigned HwAcc_Zynq7::fpga_recv32(uint32_t* buf, unsigned buf_nb) {
 	return res_nb;
 }
 
+void HwAcc_Zynq7::print_stream_stats(void) {
+	printf("Stats Zynq7 FIFOs :\n");
+	wait_send.print_stats("Send");
+	wait_recv.print_stats("Recv");
+}
+
+// Measure the throughput of data streams, and the behaviour of the wait strategy
+// This is mostly useful with the mock registers
+void HwAcc_Zynq7::zynq7_bench(unsigned nb32) {
+	uint32_t* buf = dmabuf_get(nb32);
+	for(unsigned i=0; i<nb32; i++) buf[i] = i;
+
+	wait_send.stats_clear();
+	wait_recv.stats_clear();
+
+	int64_t oldtime = Time64_GetReal();
+	unsigned sent_nb = fpga_send32(buf, nb32);
+	int64_t midtime = Time64_GetReal();
+	unsigned recv_nb = fpga_recv32(buf, nb32);
+	int64_t newtime = Time64_GetReal();
+
+	double diff_send = TimeDouble_From64(midtime - oldtime);
+	double diff_recv = TimeDouble_From64(newtime - midtime);
+	printf("Zynq7 bench : Sent %u words in %g s (%g MB/s), received %u words in %g s (%g MB/s)\n",
+		sent_nb, diff_send, sent_nb * 4 / diff_send / 1e6,
+		recv_nb, diff_recv, recv_nb * 4 / diff_recv / 1e6
+	);
+	print_stream_stats();
+
+	dmabuf_put(buf);
+}
+
@@ -5,9 +5,11 @@ extern "C" {
 #include <stdbool.h>
 #include <stdint.h>
 #include <inttypes.h>
+#include <pthread.h>
 }
 
 #include "hwacc_common.h"
+#include "hwacc_wait.h"
 
 
 class HwAcc_Zynq7 : public HwAcc_Common {
@@ -38,6 +40,31 @@ class HwAcc_Zynq7 : public HwAcc_Common {
 	// The virtual address the maps to the desired hardware
 	uint32_t* hwacc_ptr_regs32 = nullptr;
 
+	// Wait strategies when FIFOs are not ready
+	HwAcc_Wait wait_send;
+	HwAcc_Wait wait_recv;
+
+	// Mock of the register window, to validate the streaming code without a board
+	// The registers are an anonymous memory map, a simulator thread updates the FIFO counters at the specified rates
+	// Counters of words are kept in spare registers, outside of the registers of the accelerator
+	// The software increments the counters of pushed and popped words, the simulator increments the counters of drained and produced words
+	static const unsigned MOCK_REG_PUSHED   = 128;
+	static const unsigned MOCK_REG_POPPED   = 129;
+	static const unsigned MOCK_REG_DRAINED  = 130;
+	static const unsigned MOCK_REG_PRODUCED = 131;
+	bool      mock = false;
+	double    mock_rx_rate = 0;  // In words per us, consumed from RX FIFO
+	double    mock_tx_rate = 0;  // In words per us, produced into TX FIFO
+	pthread_t mock_thread;
+	volatile bool mock_stop = false;
+	// State of the simulator
+	pthread_mutex_t mock_mutex = PTHREAD_MUTEX_INITIALIZER;
+	int64_t   mock_time = 0;
+	uint32_t  mock_rx_drained = 0;
+	uint32_t  mock_tx_produced = 0;
+	double    mock_rx_frac = 0;
+	double    mock_tx_frac = 0;
+
 	static bool atexit_registered;
 
 	// Only one instance is allowed for now
@@ -51,10 +78,12 @@ class HwAcc_Zynq7 : public HwAcc_Common {
 	// The only way of obtaining an HwAcc object for Zynq7
 	public :
 	static HwAcc_Zynq7* GetSingleton(intptr_t addr = ADDR_AXI_GP0);
+	static HwAcc_Zynq7* GetSingletonMock(double rx_rate, double tx_rate);
 	static void CloseSingleton(void);
 
 	private :
 	static void zynq7_atexit(void);
+	static void* mock_thread_wrapper(void* arg);
 
 	//============================================
 	// Constructor / Destructor
@@ -62,6 +91,7 @@ class HwAcc_Zynq7 : public HwAcc_Common {
 
 	private :
 	HwAcc_Zynq7(intptr_t addr);
+	HwAcc_Zynq7(double rx_rate, double tx_rate);
 
 	public :
 	~HwAcc_Zynq7();
@@ -82,13 +112,22 @@ class HwAcc_Zynq7 : public HwAcc_Common {
 	unsigned fpga_send32_wait(uint32_t* buf, unsigned buf_nb);  // There may be an additional wait to ensure data was processed indeed
 	unsigned fpga_recv32(uint32_t* buf, unsigned buf_nb);
 
+	void     print_stream_stats(void);
+
 	//============================================
 	// Methods
 	//============================================
 
 	private :
 	void zynq7_init(intptr_t addr);
+	void zynq7_init_mock(void);
 	void zynq7_close(void);
+	void mock_step(void);
+	void mock_simulate(void);
+	uint32_t mock_fifo_cnt(void);
+
+	public :
+	void zynq7_bench(unsigned nb32);
 
 };
 
@@ -0,0 +1,356 @@
+
+// Embeddable API of NNawaq : sessions that own a network and execute frames in memory
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+#include "nnawaq_utils.h"
+
+}
+
+#include "nn_layers_utils.h"
+#include "nn_load_config.h"
+#include "swexec.h"
+#include "hwacc_common.h"
+
+#ifndef NOTCL
+#include "tcl_parser.h"
+#endif
+
+#include "libnnawaq.h"
+
+using namespace std;
+
+
+//============================================
+// Shared state of the library
+//============================================
+
+// Protects library initialization, the build of networks and the preparation of execution engines
+// These steps use global parameters, the Tcl interpreter and static buffers of the file loaders
+static pthread_mutex_t lib_mutex = PTHREAD_MUTEX_INITIALIZER;
+static bool lib_initialized = false;
+
+// The accelerator is shared by all sessions, and it is configured for one network at a time
+static pthread_mutex_t lib_hw_mutex = PTHREAD_MUTEX_INITIALIZER;
+static Network* lib_hw_network = nullptr;
+
+// Same initializations as main(), the library mutex must be locked
+static int lib_init(void) {
+	if(lib_initialized == true) return 0;
+
+	if(Fo == NULL) Fo = stdout;
+
+	int z = declare_builtin_layers();
+	if(z != 0) {
+		printf("Error : Failures occurred during initialization of built-in layer types\n");
+		return -1;
+	}
+	HwAcc_Common::DefineConfigRegs();
+
+	#ifndef NOTCL
+	tcl_init_interp("libnnawaq");
+	#endif
+
+	lib_initialized = true;
+	return 0;
+}
+
+
+//============================================
+// Session
+//============================================
+
+NnSession::~NnSession(void) {
+	pthread_mutex_lock(&lib_mutex);
+	release();
+	if(network != nullptr) {
+		network->clear();
+		delete network;
+	}
+	pthread_mutex_unlock(&lib_mutex);
+}
+
+NnSession* NnSession::OpenScript(const char* tcl_filename) {
+
+	#ifdef NOTCL
+	printf("Error : This build of the library has no Tcl interpreter, can't build a network from '%s'\n", tcl_filename);
+	return nullptr;
+	#else
+
+	pthread_mutex_lock(&lib_mutex);
+
+	int z = lib_init();
+	if(z != 0) {
+		pthread_mutex_unlock(&lib_mutex);
+		return nullptr;
+	}
+
+	NnSession* session = new NnSession();
+	session->network = new Network();
+
+	// The Tcl commands operate on the singleton network, so the session network temporarily replaces it
+	Network* prev_network = Network::GetAndSetSingleton(session->network);
+	layer_t* prev_out_layer = param_out_layer;
+
+	z = tcl_eval_file(tcl_filename);
+
+	// An output layer selected by the script is kept by the session
+	if(param_out_layer != NULL && param_out_layer->network == session->network) {
+		session->outlayer = param_out_layer;
+	}
+	param_out_layer = prev_out_layer;
+	Network::GetAndSetSingleton(prev_network);
+
+	pthread_mutex_unlock(&lib_mutex);
+
+	if(z == 0) {
+		for(layer_t* layer = session->network->layer_first; layer != NULL; layer = layer->next) {
+			if(layer->type != LAYER_FIFO) { session->inlayer = layer; break; }
+		}
+		if(session->inlayer == NULL) {
+			printf("Error : The script '%s' did not create a network\n", tcl_filename);
+			z = -1;
+		}
+	}
+	if(z != 0) {
+		delete session;
+		return nullptr;
+	}
+
+	if(session->outlayer == NULL) {
+		for(layer_t* layer = session->network->layer_last; layer != NULL; layer = layer->prev) {
+			if(layer->type != LAYER_FIFO) { session->outlayer = layer; break; }
+		}
+	}
+
+	// Software execution does not report resized outputs and overflows on the stdout of the host program
+	session->network->swexec_opt_quiet = true;
+
+	// Default engine : the hardware accelerator if one is initialized
+	if(HwAcc_Common::CurrentHwAcc_Get() != nullptr) session->engine = ENGINE_HW;
+
+	return session;
+
+	#endif
+}
+
+NnSession* NnSession::clone(void) {
+	pthread_mutex_lock(&mutex);
+
+	NnSession* session = new NnSession();
+	session->network = network->clone();
+	for(unsigned i=0; i<network->layers.size(); i++) {
+		if(network->layers[i] == inlayer) session->inlayer = session->network->layers[i];
+		if(network->layers[i] == outlayer) session->outlayer = session->network->layers[i];
+	}
+	session->engine = engine;
+	session->swexec_tcam = swexec_tcam;
+	session->swexec_gen_in = swexec_gen_in;
+
+	pthread_mutex_unlock(&mutex);
+	return session;
+}
+
+// Free the resources of the execution engines, the library mutex must be locked
+void NnSession::release(void) {
+	if(sw_ready == true) {
+		swexec_end(network);
+		sw_ready = false;
+	}
+	pthread_mutex_lock(&lib_hw_mutex);
+	if(lib_hw_network == network) lib_hw_network = nullptr;
+	pthread_mutex_unlock(&lib_hw_mutex);
+	hwacc = nullptr;
+}
+
+// Prepare the selected execution engine, the session mutex must be locked
+int NnSession::prepare(void) {
+	if(engine == ENGINE_SW && sw_ready == true) return 0;
+	if(engine == ENGINE_HW && hwacc != nullptr) return 0;
+
+	int z = 0;
+	pthread_mutex_lock(&lib_mutex);
+
+	if(engine == ENGINE_SW) {
+		// Configuration data is loaded only once
+		z = network->load_config_files();
+		if(z == 0) z = swexec_begin(network, swexec_tcam, swexec_gen_in);
+		if(z == 0) sw_ready = true;
+	}
+	else {
+		hwacc = HwAcc_Common::CurrentHwAcc_Get();
+		if(hwacc == nullptr) {
+			printf("Error : No hardware accelerator is initialized\n");
+			z = -1;
+		}
+		if(z == 0 && outlayer != network->layer_last && hwacc->accreg_selout == false) {
+			layer_t* last_layer = NULL;
+			for(layer_t* layer = network->layer_last; layer != NULL; layer = layer->prev) {
+				if(layer->type != LAYER_FIFO) { last_layer = layer; break; }
+			}
+			if(outlayer != last_layer) {
+				printf("Error : The hardware supports only output at last layer\n");
+				hwacc = nullptr;
+				z = -1;
+			}
+		}
+	}
+
+	pthread_mutex_unlock(&lib_mutex);
+	return (z == 0) ? 0 : -1;
+}
+
+int NnSession::set_engine(engine_type engine) {
+	pthread_mutex_lock(&mutex);
+	this->engine = engine;
+	int z = prepare();
+	pthread_mutex_unlock(&mutex);
+	return z;
+}
+
+int NnSession::set_outlayer(const char* layer_name) {
+	layer_t* layer = network->getlayer_from_string_id(layer_name);
+	if(layer == nullptr) {
+		printf("Error : Layer '%s' not found\n", layer_name);
+		return -1;
+	}
+	pthread_mutex_lock(&mutex);
+	outlayer = layer;
+	// The hardware engine checks again if this output layer is supported
+	hwacc = nullptr;
+	pthread_mutex_unlock(&mutex);
+	return 0;
+}
+
+int NnSession::set_swexec_options(bool mode_tcam, bool gen_in) {
+	pthread_mutex_lock(&mutex);
+	swexec_tcam = mode_tcam;
+	swexec_gen_in = gen_in;
+	// Software execution is prepared again with the new options
+	if(sw_ready == true) {
+		pthread_mutex_lock(&lib_mutex);
+		swexec_end(network);
+		sw_ready = false;
+		pthread_mutex_unlock(&lib_mutex);
+	}
+	pthread_mutex_unlock(&mutex);
+	return 0;
+}
+
+int NnSession::set_quiet(bool quiet) {
+	pthread_mutex_lock(&mutex);
+	network->swexec_opt_quiet = quiet;
+	pthread_mutex_unlock(&mutex);
+	return 0;
+}
+
+unsigned NnSession::get_insize(void) {
+	return inlayer->fsize;
+}
+
+unsigned NnSession::get_outsize(void) {
+	pthread_mutex_lock(&mutex);
+	unsigned outsize = 0;
+	if(engine == ENGINE_HW) {
+		HwAcc_Common* hwacc_cur = (hwacc != nullptr) ? hwacc : HwAcc_Common::CurrentHwAcc_Get();
+		if(hwacc_cur != nullptr) {
+			unsigned frame_size = 0;
+			hwacc_cur->get_outputs_frame_size(outlayer, &frame_size, &outsize);
+		}
+	}
+	else if(swexec_gen_in == true) outsize = outlayer->nbframes * outlayer->fsize;
+	else outsize = outlayer->out_nbframes * outlayer->out_fsize;
+	pthread_mutex_unlock(&mutex);
+	return outsize;
+}
+
+int NnSession::run(const int* in, int* out, unsigned frames_nb) {
+	pthread_mutex_lock(&mutex);
+
+	int z = prepare();
+	if(z != 0) {
+		pthread_mutex_unlock(&mutex);
+		return z;
+	}
+
+	if(engine == ENGINE_SW) {
+		// All the state of software execution is in the network of the session
+		unsigned fsize = inlayer->fsize;
+		unsigned outsize = swexec_gen_in ? outlayer->nbframes * outlayer->fsize : outlayer->out_nbframes * outlayer->out_fsize;
+		for(unsigned f=0; f<frames_nb; f++) {
+			z = swexec_oneframe(network, outlayer, in + uint64_t(f) * fsize, out + uint64_t(f) * outsize, f);
+			if(z != 0) break;
+		}
+	}
+
+	else {
+		pthread_mutex_lock(&lib_hw_mutex);
+		// Configure the accelerator if it was last used by another network
+		if(lib_hw_network != network) {
+			hwacc->prepare(network);
+			lib_hw_network = network;
+		}
+		z = hwacc->process_frames_user(network, outlayer, in, frames_nb, out);
+		pthread_mutex_unlock(&lib_hw_mutex);
+	}
+
+	pthread_mutex_unlock(&mutex);
+	return z;
+}
+
+
+//============================================
+// C API
+//============================================
+
+nnawaq_session_t* nnawaq_session_open(const char* tcl_filename) {
+	return (nnawaq_session_t*)NnSession::OpenScript(tcl_filename);
+}
+
+nnawaq_session_t* nnawaq_session_clone(nnawaq_session_t* session) {
+	return (nnawaq_session_t*)((NnSession*)session)->clone();
+}
+
+void nnawaq_session_close(nnawaq_session_t* session) {
+	delete (NnSession*)session;
+}
+
+int nnawaq_session_set_engine(nnawaq_session_t* session, int engine) {
+	if(engine != NNAWAQ_ENGINE_SW && engine != NNAWAQ_ENGINE_HW) {
+		printf("Error : Unknown engine %i\n", engine);
+		return -1;
+	}
+	return ((NnSession*)session)->set_engine((NnSession::engine_type)engine);
+}
+
+int nnawaq_session_set_outlayer(nnawaq_session_t* session, const char* layer_name) {
+	return ((NnSession*)session)->set_outlayer(layer_name);
+}
+
+int nnawaq_session_set_swexec_options(nnawaq_session_t* session, int mode_tcam, int gen_in) {
+	return ((NnSession*)session)->set_swexec_options(mode_tcam != 0, gen_in != 0);
+}
+
+int nnawaq_session_set_quiet(nnawaq_session_t* session, int quiet) {
+	return ((NnSession*)session)->set_quiet(quiet != 0);
+}
+
+unsigned nnawaq_session_get_insize(nnawaq_session_t* session) {
+	return ((NnSession*)session)->get_insize();
+}
+
+unsigned nnawaq_session_get_outsize(nnawaq_session_t* session) {
+	return ((NnSession*)session)->get_outsize();
+}
+
+int nnawaq_session_run(nnawaq_session_t* session, const int32_t* in, int32_t* out, unsigned frames_nb) {
+	return ((NnSession*)session)->run(in, out, frames_nb);
+}
+
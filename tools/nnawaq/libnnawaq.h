@@ -0,0 +1,129 @@
+
+#pragma once
+
+// Embeddable API of NNawaq, built as libnnawaq.a and libnnawaq.so
+//
+// A session owns one network, built by a Tcl script, and its execution options
+// Sessions are independent : different sessions can be used concurrently from different threads
+// Calls on one session are serialized, and hardware executions are serialized because the accelerator is shared
+//
+// Frames and results are arrays of 32-bit values, frames are contiguous, with the layout of frames files
+// Results have the size returned by get_outsize(), without padding
+//
+// Notes :
+// - Building a network from a script, and preparing an execution engine, are serialized between all sessions
+// - The global parameters set by the script, like nn_set, are shared with the program and with other sessions
+// - The hardware engine uses the current accelerator, as initialized by the script (for example with nn_emu_init)
+
+#define NNAWAQ_ENGINE_SW  0
+#define NNAWAQ_ENGINE_HW  1
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+typedef struct nnawaq_session nnawaq_session_t;
+
+// Return NULL on error
+nnawaq_session_t* nnawaq_session_open(const char* tcl_filename);
+// A new session with a copy of the network and the same options, configuration data is shared
+nnawaq_session_t* nnawaq_session_clone(nnawaq_session_t* session);
+void nnawaq_session_close(nnawaq_session_t* session);
+
+// Return non-zero on error
+int nnawaq_session_set_engine(nnawaq_session_t* session, int engine);
+int nnawaq_session_set_outlayer(nnawaq_session_t* session, const char* layer_name);
+int nnawaq_session_set_swexec_options(nnawaq_session_t* session, int mode_tcam, int gen_in);
+// Sessions are quiet by default : software execution does not report resized outputs and overflows
+int nnawaq_session_set_quiet(nnawaq_session_t* session, int quiet);
+
+unsigned nnawaq_session_get_insize(nnawaq_session_t* session);
+unsigned nnawaq_session_get_outsize(nnawaq_session_t* session);
+
+// Return non-zero on error
+int nnawaq_session_run(nnawaq_session_t* session, const int32_t* in, int32_t* out, unsigned frames_nb);
+
+#ifdef __cplusplus
+}
+#endif
+
+
+#ifdef __cplusplus
+
+extern "C" {
+#include <pthread.h>
+}
+
+class Network;
+class Layer;
+class HwAcc_Common;
+
+class NnSession {
+
+	public :
+
+	enum engine_type {
+		ENGINE_SW = NNAWAQ_ENGINE_SW,
+		ENGINE_HW = NNAWAQ_ENGINE_HW,
+	};
+
+	//============================================
+	// Fields
+	//============================================
+
+	private :
+
+	Network* network = nullptr;
+	Layer* inlayer = nullptr;
+	Layer* outlayer = nullptr;
+
+	engine_type engine = ENGINE_SW;
+	bool sw_ready = false;
+	HwAcc_Common* hwacc = nullptr;
+
+	// Options of software execution
+	bool swexec_tcam = false;
+	bool swexec_gen_in = false;
+
+	// Calls on this session are serialized
+	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+
+	//============================================
+	// Constructor / Destructor
+	//============================================
+
+	private :
+	NnSession(void) {}
+
+	public :
+	~NnSession(void);
+
+	// Build the network with a Tcl script, return nullptr on error
+	static NnSession* OpenScript(const char* tcl_filename);
+	NnSession* clone(void);
+
+	//============================================
+	// Methods
+	//============================================
+
+	int set_engine(engine_type engine);
+	int set_outlayer(const char* layer_name);
+	int set_swexec_options(bool mode_tcam, bool gen_in);
+	int set_quiet(bool quiet);
+
+	unsigned get_insize(void);
+	unsigned get_outsize(void);
+
+	int run(const int* in, int* out, unsigned frames_nb);
+
+	private :
+
+	int  prepare(void);
+	void release(void);
+
+};
+
+#endif
+
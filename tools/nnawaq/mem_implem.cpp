@@ -174,5 +174,7 @@ void MemImplem::EvalBlocks(unsigned lut_threshold, bool use_uram) {
 	else if(style == STYLE_LUTRAM) EvalBlocksLutram();
 	else if(style == STYLE_BRAM)   EvalBlocksBram();
 	else if(style == STYLE_URAM)   EvalBlocksUram();
+
+	blocks_packed = blocks;
 }
 
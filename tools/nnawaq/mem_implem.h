@@ -36,6 +36,7 @@ class MemImplem {
 	// Resulting properties
 	style_type style = STYLE_NONE;
 	unsigned long blocks = 0;  // Total number of memory blocks (bram, lutram, reg, ...)
+	unsigned long blocks_packed = 0;  // Blocks attributed to this memory when small memories share blocks, see Network::mem_pack()
 
 	public :
 
@@ -0,0 +1,325 @@
+
+// Design space exploration : parallelism, time multiplexing and memory implementation
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "nnawaq_utils.h"
+
+}
+
+#include <algorithm>
+
+#include "nn_layers_utils.h"
+#include "nn_hw_config.h"
+
+#include "nn_explore.h"
+
+using namespace std;
+
+
+//============================================
+// One configuration
+//============================================
+
+static const char* explore_tmux_names[EXPLORE_TMUX_NB] = { "none", "tmux", "parin" };
+
+// Return non-zero if the parallelism could not be applied
+int ExploreConfig::apply(Network* network, bool verbose) const {
+
+	if(par > 1) {
+		unsigned cycles_target = maxcycles_per_layer(network) / par;
+		if(cycles_target < 1) cycles_target = 1;
+		unsigned cycles = apply_parallelism_maxcy(network, cycles_target, verbose);
+		if(cycles == 0) return -1;
+	}
+
+	if(tmux_mode == EXPLORE_TMUX_AUTO || tmux_mode == EXPLORE_TMUX_PARIN) {
+		apply_time_mux_maxcy(network, maxcycles_per_layer(network), verbose);
+	}
+	if(tmux_mode == EXPLORE_TMUX_PARIN) {
+		apply_parin_with_time_mux(network, verbose);
+	}
+
+	// Layers with no memory style given take the default one at finalization
+	network->default_mem_implem_win = mem_win;
+	network->default_mem_implem_neu = mem_neu;
+
+	// Same layers as in apply_network_defaults()
+	network->hwconfig_bram_opt_speed = opt_speed;
+	for(auto layer : network->layers) {
+		if(layer->type == LAYER_WIN || layer->type == LAYER_NEU || layer->type == LAYER_NEU_CM) {
+			layer->mem.opt_speed = opt_speed;
+		}
+	}
+
+	// Configurations that hwconfig_finalize() would reject are skipped
+	unsigned errors_nb = 0;
+	for(auto layer : network->layers) {
+		if(layer->check_par(verbose) != 0) errors_nb++;
+	}
+	if(errors_nb != 0) return -1;
+
+	return 0;
+}
+
+void ExploreConfig::evaluate(Network* network_ref) {
+	Network* network = network_ref->clone();
+
+	int z = apply(network, false);
+	if(z != 0) {
+		network->clear();
+		delete network;
+		return;
+	}
+
+	// Same as Network::hwconfig_finalize(), without report
+	network->total_neurons     = 0;
+	network->total_neurons_phy = 0;
+	network->total_multipliers = 0;
+	network->total_weights     = 0;
+	network->total_weight_bits = 0;
+	network->total_macs        = 0;
+
+	for(auto layer : network->layers) {
+		unsigned neurons_phy = network->total_neurons_phy;
+		layer->hwconfig_finalize();
+		layer->eval_mem_size();
+		layer->mem.EvalBlocks(network->hwconfig_lut_threshold, network->hwconfig_use_uram);
+
+		if(layer->mem.style == MemImplem::STYLE_LUTRAM) lutram += layer->mem.blocks;
+		else if(layer->mem.style == MemImplem::STYLE_BRAM) bram18 += layer->mem.blocks;
+		else if(layer->mem.style == MemImplem::STYLE_URAM) uram += layer->mem.blocks;
+
+		if(layer->type == LAYER_NEU || layer->type == LAYER_NEU_CM) {
+			neurons_phy = network->total_neurons_phy - neurons_phy;
+			luts += (unsigned long)neurons_phy * hwconfig_luts_per_neuron(layer->neu_style, layer->wdata, layer->neu_waccu, layer->split_in);
+		}
+	}
+
+	// Small memories may share blocks, this is only an estimate
+	if(network->hwconfig_mem_pack == true) {
+		bram18_packed = network->mem_pack();
+		uram_packed = 0;
+		for(auto layer : network->layers) {
+			if(layer->mem.style == MemImplem::STYLE_URAM) uram_packed += layer->mem.blocks_packed;
+		}
+	}
+
+	luts += lutram;
+
+	cycles  = maxcycles_per_layer(network);
+	latency = network->eval_latency();
+	valid   = true;
+
+	network->clear();
+	delete network;
+}
+
+// Better or equal on all objectives, and strictly better on at least one
+bool ExploreConfig::dominates(const ExploreConfig& other) const {
+	if(cycles > other.cycles || bram18 > other.bram18 || uram > other.uram || luts > other.luts) return false;
+	return cycles < other.cycles || bram18 < other.bram18 || uram < other.uram || luts < other.luts;
+}
+
+
+//============================================
+// Pool of threads
+//============================================
+
+typedef struct explore_pool_t {
+	Network* network;
+	vector<ExploreConfig>* configs;
+	pthread_mutex_t mutex;
+	unsigned next;
+} explore_pool_t;
+
+static void* explore_thread(void* arg) {
+	explore_pool_t* pool = (explore_pool_t*)arg;
+
+	do {
+		pthread_mutex_lock(&pool->mutex);
+		unsigned idx = pool->next++;
+		pthread_mutex_unlock(&pool->mutex);
+		if(idx >= pool->configs->size()) break;
+		(*pool->configs)[idx].evaluate(pool->network);
+	} while(1);
+
+	return NULL;
+}
+
+
+//============================================
+// Exploration
+//============================================
+
+static void explore_print_config(const ExploreConfig& config, const char* mark) {
+	printf("%2s %5u %-6s %-7s %-7s %-6s %9u %10lu %7u %5u %7u %9lu\n",
+		mark, config.par, explore_tmux_names[config.tmux_mode],
+		MemImplem::GetStyleName(config.mem_win), MemImplem::GetStyleName(config.mem_neu),
+		config.opt_speed ? "speed" : "size",
+		config.cycles, config.latency, config.bram18, config.uram, config.lutram, config.luts
+	);
+}
+
+int nn_explore(Network* network, const ExploreParams& params) {
+
+	if(network->layers.empty()) {
+		printf("Error : The network is empty\n");
+		return -1;
+	}
+	for(auto layer : network->layers) {
+		if(layer->type == LAYER_FIFO) {
+			printf("Error : The exploration must be done before the hardware configuration is finalized\n");
+			return -1;
+		}
+	}
+
+	// Enumerate the configurations
+	vector<ExploreConfig> configs;
+
+	unsigned cycles_ref = maxcycles_per_layer(network);
+	static const MemImplem::style_type mem_styles[] = { MemImplem::STYLE_AUTO, MemImplem::STYLE_LUTRAM, MemImplem::STYLE_BRAM };
+
+	for(unsigned par = 1; par <= cycles_ref; par *= 2) {
+		if(params.par_max > 0 && par > params.par_max) break;
+		for(unsigned tmux_mode = 0; tmux_mode < EXPLORE_TMUX_NB; tmux_mode++) {
+			for(auto mem_win : mem_styles) {
+				for(auto mem_neu : mem_styles) {
+					for(unsigned opt_speed = 0; opt_speed < 2; opt_speed++) {
+						ExploreConfig config;
+						config.par       = par;
+						config.tmux_mode = tmux_mode;
+						config.mem_win   = mem_win;
+						config.mem_neu   = mem_neu;
+						config.opt_speed = opt_speed;
+						configs.push_back(config);
+					}
+				}
+			}
+		}
+		// Avoid an endless loop on overflow
+		if(par > cycles_ref / 2) break;
+	}
+
+	// The experimental weight decompressors write to a shared file during finalization
+	bool thread_safe = true;
+	if(network->default_comp_all_style > 5 || network->default_comp_bram_style > 5 || network->default_comp_fc_style > 5) thread_safe = false;
+	for(auto layer : network->layers) {
+		if(layer->neu_comp_style > 5) thread_safe = false;
+	}
+
+	unsigned threads_nb = params.threads_nb;
+	if(threads_nb == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads_nb = (cpus > 0) ? cpus : 1;
+	}
+	if(thread_safe == false) threads_nb = 1;
+	if(threads_nb > configs.size()) threads_nb = configs.size();
+
+	printf("Design space exploration : %zu configurations, %u threads\n", configs.size(), threads_nb);
+
+	// Evaluate all configurations
+	explore_pool_t pool;
+	pool.network = network;
+	pool.configs = &configs;
+	pthread_mutex_init(&pool.mutex, NULL);
+	pool.next = 0;
+
+	vector<pthread_t> threads(threads_nb);
+	for(unsigned i=0; i<threads_nb; i++) {
+		pthread_create(&threads[i], NULL, explore_thread, &pool);
+	}
+	for(unsigned i=0; i<threads_nb; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&pool.mutex);
+
+	// Select the Pareto front, duplicate results are only kept once
+	vector<ExploreConfig*> front;
+	unsigned invalid_nb = 0;
+	for(auto& config : configs) {
+		if(config.valid == false) { invalid_nb++; continue; }
+		bool dominated = false;
+		for(auto& other : configs) {
+			if(other.valid == false) continue;
+			if(other.dominates(config) == true) { dominated = true; break; }
+		}
+		if(dominated == true) continue;
+		for(auto other : front) {
+			if(other->cycles == config.cycles && other->bram18 == config.bram18 && other->uram == config.uram && other->luts == config.luts) {
+				dominated = true;
+				break;
+			}
+		}
+		if(dominated == true) continue;
+		config.pareto = true;
+		front.push_back(&config);
+	}
+	if(invalid_nb > 0) {
+		printf("Note : %u configurations have no legal parallelism\n", invalid_nb);
+	}
+
+	sort(front.begin(), front.end(), [](const ExploreConfig* a, const ExploreConfig* b) {
+		if(a->cycles != b->cycles) return a->cycles < b->cycles;
+		return a->luts < b->luts;
+	});
+
+	// Select the fastest configuration that fits in the device budget
+	ExploreConfig* best = nullptr;
+	for(auto& config : configs) {
+		if(config.valid == false) continue;
+		if(params.budget_bram18 > 0 && config.bram18 > params.budget_bram18) continue;
+		if(params.budget_uram > 0 && config.uram > params.budget_uram) continue;
+		if(params.budget_luts > 0 && config.luts > params.budget_luts) continue;
+		if(best != nullptr) {
+			if(config.cycles > best->cycles) continue;
+			if(config.cycles == best->cycles) {
+				if(config.latency > best->latency) continue;
+				if(config.latency == best->latency) {
+					if(config.bram18 > best->bram18) continue;
+					if(config.bram18 == best->bram18 && config.luts >= best->luts) continue;
+				}
+			}
+		}
+		best = &config;
+	}
+
+	// Report
+	printf("Pareto front : %zu configurations\n", front.size());
+	printf("   %5s %-6s %-7s %-7s %-6s %9s %10s %7s %5s %7s %9s\n",
+		"par", "tmux", "win", "neu", "bram", "cycles", "latency", "bram18", "uram", "lutram", "luts"
+	);
+	for(auto config : front) {
+		explore_print_config(*config, (config == best) ? "*" : "");
+	}
+	if(best == nullptr) {
+		printf("No configuration fits in the device budget\n");
+		return (params.apply == true) ? -1 : 0;
+	}
+	if(best->pareto == false) {
+		explore_print_config(*best, "*");
+	}
+	printf("Best configuration in budget : par %u, tmux %s, mem win %s, mem neu %s, bram opt %s : %u cycles/frame\n",
+		best->par, explore_tmux_names[best->tmux_mode],
+		MemImplem::GetStyleName(best->mem_win), MemImplem::GetStyleName(best->mem_neu),
+		best->opt_speed ? "speed" : "size", best->cycles
+	);
+	if(network->hwconfig_mem_pack == true) {
+		printf("Estimation with packing of small memories : %u bram18, %u uram\n", best->bram18_packed, best->uram_packed);
+	}
+
+	if(params.apply == true) {
+		best->apply(network, true);
+	}
+
+	return 0;
+}
+
@@ -0,0 +1,85 @@
+
+#pragma once
+
+extern "C" {
+#include <stdbool.h>
+}
+
+#include <vector>
+
+#include "nn_layers_create.h"
+
+
+//============================================
+// Design space exploration
+//============================================
+
+// Each configuration of the design space is evaluated on a copy of the network, on a pool of threads
+// The explored parameters are :
+// - a global parallelism factor, converted to legal PAR_IN / PAR_OUT of each layer like with nn_autopar
+// - the time multiplexing of neuron layers, like with nn_autotmux and nn_maxparin
+// - the default memory implementation of window and neuron layers
+// - the optimization of BRAM for speed
+// Memory styles are only explored for layers that were left to the default choice
+// The network must not be finalized yet : the exploration is done before nn_finalize_hw_config
+// Memory resources do not include the FIFOs that are inserted at finalization
+// When the packing of small memories is enabled, the memory blocks after packing are only reported as an estimation, see Network::mem_pack()
+// The device budget applies to the memory blocks without packing
+
+// Time multiplexing modes
+#define EXPLORE_TMUX_NONE   0
+#define EXPLORE_TMUX_AUTO   1  // Like nn_autotmux
+#define EXPLORE_TMUX_PARIN  2  // Like nn_autotmux then nn_maxparin
+#define EXPLORE_TMUX_NB     3
+
+class ExploreConfig {
+
+	public :
+
+	// Parameters
+	unsigned par = 1;
+	unsigned tmux_mode = EXPLORE_TMUX_NONE;
+	MemImplem::style_type mem_win = MemImplem::STYLE_AUTO;
+	MemImplem::style_type mem_neu = MemImplem::STYLE_AUTO;
+	bool     opt_speed = false;
+
+	// Results
+	bool     valid = false;
+	unsigned cycles = 0;         // Max clock cycles per layer, this is the throughput in clock cycles per frame
+	unsigned long latency = 0;   // Clock cycles
+	unsigned bram18 = 0;
+	unsigned uram   = 0;
+	unsigned lutram = 0;         // LUTs used as memory
+	unsigned long luts = 0;      // Estimation of logic LUTs of neurons, plus LUTRAM
+	unsigned bram18_packed = 0;  // Estimation with packing of small memories, if enabled
+	unsigned uram_packed = 0;
+	bool     pareto = false;
+
+	// Methods
+
+	int  apply(Network* network, bool verbose) const;
+	void evaluate(Network* network_ref);
+
+	bool dominates(const ExploreConfig& other) const;
+
+};
+
+class ExploreParams {
+
+	public :
+
+	unsigned threads_nb = 0;     // Zero means the number of processors
+	unsigned par_max = 0;        // Zero means no limit
+
+	// Device budget, zero means no limit
+	unsigned      budget_bram18 = 0;
+	unsigned      budget_uram = 0;
+	unsigned long budget_luts = 0;
+
+	// Apply the best configuration to the network
+	bool apply = false;
+
+};
+
+int nn_explore(Network* network, const ExploreParams& params);
+
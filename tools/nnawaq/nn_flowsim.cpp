@@ -0,0 +1,598 @@
+
+// Transaction-level simulation of the dataflow pipeline of the accelerator
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <inttypes.h>
+
+#include "nnawaq_utils.h"
+
+}
+
+#include <algorithm>
+
+#include "nn_layers_utils.h"
+
+#include "nn_flowsim.h"
+
+using namespace std;
+
+
+//============================================
+// Build the model
+//============================================
+
+FlowSim::~FlowSim(void) {
+	if(network_sim != nullptr) {
+		network_sim->clear();
+		delete network_sim;
+	}
+}
+
+static unsigned flowsim_gcd(unsigned a, unsigned b) {
+	while(b != 0) { unsigned t = a % b; a = b; b = t; }
+	return a;
+}
+
+static unsigned flowsim_clamp(unsigned v, unsigned min, unsigned max) {
+	if(v < min) return min;
+	if(v > max) return max;
+	return v;
+}
+
+int FlowSim::build(void) {
+
+	// The simulation uses a copy of the network with all parameters propagated again
+	// This way the numbers of transfers between layers are consistent even after manual edits of parallelism
+	if(network_sim != nullptr) {
+		network_sim->clear();
+		delete network_sim;
+	}
+	network_sim = network->clone();
+	network_sim->propag_params();
+
+	auto& layers = network_sim->layers;
+
+	simlayers.clear();
+	simlayers.resize(layers.size());
+
+	for(auto layer : layers) {
+		if(layer->index >= layers.size() || layers[layer->index] != layer) {
+			printf("Error : The indexes of the layers are not consistent\n");
+			return -1;
+		}
+
+		auto& sl = simlayers[layer->index];
+		sl.layer = layer;
+
+		Latency lat;
+		layer->eval_latency(lat);
+		sl.latency = GetMax(lat.cycles_to_first_out, 1U);
+
+		sl.in_beats  = GetMax(layer->cycles, 1U);
+		sl.out_beats = GetMax(layer->out_cycles, 1U);
+
+		// Multi-input layers read their predecessors in rounds
+		if(layer->prev_is_arr == true) {
+			unsigned in_beats = 0;
+			unsigned g = 0;
+			for(auto layer_prev : layer->arr_layers) {
+				unsigned beats = GetMax(layer_prev->out_cycles, 1U);
+				sl.pred_beats.push_back(beats);
+				in_beats += beats;
+				g = flowsim_gcd(g, beats);
+			}
+			// Layer GATHER reads its predecessors one after the other
+			if(layer->type == LAYER_GATHER) g = 1;
+			for(auto& beats : sl.pred_beats) beats /= g;
+			sl.pred_round = in_beats / g;
+			sl.in_beats = in_beats;
+			sl.queues.resize(layer->arr_layers.size());
+		}
+		else {
+			sl.queues.resize(1);
+		}
+
+		// Group model
+		if(layer->type == LAYER_WIN) {
+			sl.pre = flowsim_clamp(lat.nbin_before_begin, 1, sl.in_beats);
+			sl.groups = GetMax(layer->nwiny, 1U);
+			sl.gin = sl.in_beats;
+			if(sl.groups > 1) sl.gin = GetMax((sl.in_beats - sl.pre + sl.groups - 2) / (sl.groups - 1), 1U);
+		}
+		else if(layer->type == LAYER_NEU || layer->type == LAYER_NEU_CM || layer->type == LAYER_POOL) {
+			sl.gin = flowsim_clamp(lat.nbin_before_begin, 1, sl.in_beats);
+			sl.groups = GetMax(sl.in_beats / sl.gin, 1U);
+			sl.pre = sl.gin;
+		}
+		else if(layer->type == LAYER_SOFTMAX) {
+			sl.gin = sl.in_beats;
+			sl.groups = 1;
+			sl.pre = sl.gin;
+		}
+		else {
+			sl.groups = flowsim_gcd(sl.in_beats, sl.out_beats);
+			sl.gin = sl.in_beats / sl.groups;
+			sl.pre = sl.gin;
+		}
+		sl.gout = (sl.out_beats + sl.groups - 1) / sl.groups;
+
+		// FIFO layers have their own depth
+		if(layer->type == LAYER_FIFO) {
+			unsigned depth = fifo_depth;
+			if(depth == 0) depth = layer->fifo_depth;
+			if(depth == 0) depth = 64;
+			sl.queues[0].capacity = depth;
+		}
+	}
+
+	// Links between layers
+	for(auto layer : layers) {
+		auto& sl = simlayers[layer->index];
+		vector<Layer*> layers_next;
+		if(layer->next_is_arr == true) layers_next = layer->arr_layers;
+		else if(layer->next != nullptr) layers_next.push_back(layer->next);
+
+		for(auto layer_next : layers_next) {
+			unsigned port = 0;
+			if(layer_next->prev_is_arr == true) {
+				auto it = find(layer_next->arr_layers.begin(), layer_next->arr_layers.end(), layer);
+				if(it == layer_next->arr_layers.end()) {
+					printf("Error : layer %s%u : Not found in the predecessors of layer %s%u\n",
+						layer->typenamel, layer->typeidx, layer_next->typenamel, layer_next->typeidx
+					);
+					return -1;
+				}
+				port = it - layer_next->arr_layers.begin();
+			}
+			// Each successor must receive the transfers it expects
+			if(layer->type != LAYER_SCATTER && layer_next->prev_is_arr == false && layer_next->cycles != layer->out_cycles) {
+				printf("Error : layer %s%u : Expects %u transfers per frame but layer %s%u emits %u\n",
+					layer_next->typenamel, layer_next->typeidx, layer_next->cycles, layer->typenamel, layer->typeidx, layer->out_cycles
+				);
+				return -1;
+			}
+			sl.succ.push_back(layer_next->index);
+			sl.succ_port.push_back(port);
+			// The input registers of other layers hold the transfers that are in the pipeline of the predecessor
+			if(layer_next->type != LAYER_FIFO) {
+				simlayers[layer_next->index].queues[port].capacity = sl.latency + 2;
+			}
+		}
+	}
+
+	return 0;
+}
+
+
+//============================================
+// Simulation
+//============================================
+
+// Index of the predecessor that provides the next input transfer
+unsigned FlowSim::input_port(const flowsim_layer_t& sl) const {
+	if(sl.pred_beats.size() <= 1) return 0;
+	unsigned r = (sl.consumed % sl.in_beats) % sl.pred_round;
+	for(unsigned i=0; i<sl.pred_beats.size(); i++) {
+		if(r < sl.pred_beats[i]) return i;
+		r -= sl.pred_beats[i];
+	}
+	return 0;
+}
+
+// Max number of input transfers that can be accepted : the inputs of the next group, while the current group is emitted
+uint64_t FlowSim::accept_bound(const flowsim_layer_t& sl) const {
+	uint64_t fo = sl.emitted / sl.out_beats;
+	uint64_t k  = (sl.emitted % sl.out_beats) / sl.gout;
+	return fo * sl.in_beats + sl.pre + (k + 1) * sl.gin;
+}
+
+// Max number of output transfers that can be emitted with the inputs already accepted
+uint64_t FlowSim::emit_bound(const flowsim_layer_t& sl) const {
+	uint64_t fi = sl.consumed / sl.in_beats;
+	uint64_t fo = sl.emitted / sl.out_beats;
+	if(fi > fo) return (fo + 1) * sl.out_beats;
+	uint64_t ci = sl.consumed % sl.in_beats;
+	if(ci < sl.pre) return fo * sl.out_beats;
+	uint64_t groups = (ci - sl.pre) / sl.gin + 1;
+	return fo * sl.out_beats + GetMin(groups * sl.gout, (uint64_t)sl.out_beats);
+}
+
+void FlowSim::step_layer(unsigned idx) {
+	auto& sl = simlayers[idx];
+	bool active = false;
+
+	// Emit one output transfer
+	if(sl.emitted < (uint64_t)frames_nb * sl.out_beats && sl.emitted < emit_bound(sl)) {
+		uint64_t beat = sl.emitted % sl.out_beats;
+		bool blocked = false;
+		for(unsigned i=0; i<sl.succ.size(); i++) {
+			auto& sl_next = simlayers[sl.succ[i]];
+			// Layer SCATTER only sends the beginning of the frame to smaller successors
+			if(sl.layer->type == LAYER_SCATTER && beat >= sl_next.in_beats) continue;
+			auto& q = sl_next.queues[sl.succ_port[i]];
+			if(q.beats.size() >= q.capacity) { blocked = true; break; }
+		}
+		if(blocked == true) {
+			sl.cycles_stall++;
+		}
+		else {
+			for(unsigned i=0; i<sl.succ.size(); i++) {
+				auto& sl_next = simlayers[sl.succ[i]];
+				if(sl.layer->type == LAYER_SCATTER && beat >= sl_next.in_beats) continue;
+				auto& q = sl_next.queues[sl.succ_port[i]];
+				q.beats.push_back(cycles + sl.latency);
+				q.occupancy_max = GetMax(q.occupancy_max, (unsigned)q.beats.size());
+			}
+			sl.emitted++;
+			active = true;
+			// The network output is always ready
+			if(sl.succ.empty() == true && sl.emitted % sl.out_beats == 0) {
+				unsigned f = sl.emitted / sl.out_beats - 1;
+				frame_last_out[f] = GetMax(frame_last_out[f], cycles + sl.latency);
+			}
+		}
+	}
+
+	// Accept one input transfer
+	if(sl.consumed < (uint64_t)frames_nb * sl.in_beats && sl.consumed < accept_bound(sl)) {
+		// The network input is always valid
+		if(sl.layer->prev == nullptr && sl.layer->prev_is_arr == false) {
+			if(sl.consumed % sl.in_beats == 0) frame_first_in[sl.consumed / sl.in_beats] = cycles;
+			sl.consumed++;
+			active = true;
+		}
+		else {
+			auto& q = sl.queues[input_port(sl)];
+			if(q.beats.empty() == false && q.beats.front() <= cycles) {
+				q.beats.pop_front();
+				sl.consumed++;
+				active = true;
+			}
+			else {
+				sl.cycles_starve++;
+			}
+		}
+	}
+
+	if(active == true) {
+		sl.cycles_busy++;
+		progress = true;
+	}
+}
+
+int FlowSim::run(void) {
+
+	if(network->layers.empty()) {
+		printf("Error : The network is empty\n");
+		return -1;
+	}
+	if(frames_nb == 0) frames_nb = 1;
+
+	int z = build();
+	if(z != 0) return z;
+
+	// Order of simulation : successors before predecessors, so room freed in a FIFO can be used in the same clock cycle
+	vector<unsigned> order;
+	vector<unsigned> pending(simlayers.size(), 0);
+	for(auto& sl : simlayers) {
+		for(auto s : sl.succ) pending[s]++;
+	}
+	for(unsigned i=0; i<simlayers.size(); i++) {
+		if(pending[i] == 0) order.push_back(i);
+	}
+	for(unsigned i=0; i<order.size(); i++) {
+		for(auto s : simlayers[order[i]].succ) {
+			if(--pending[s] == 0) order.push_back(s);
+		}
+	}
+	if(order.size() != simlayers.size()) {
+		printf("Error : The network contains a cycle\n");
+		return -1;
+	}
+	reverse(order.begin(), order.end());
+
+	frame_first_in.assign(frames_nb, 0);
+	frame_last_out.assign(frames_nb, 0);
+
+	// Automatic limit for deadlock detection : no transfer during more cycles than the longest pipeline latency
+	unsigned latency_max = 0;
+	for(auto& sl : simlayers) latency_max = GetMax(latency_max, sl.latency);
+
+	uint64_t cycles_progress = 0;
+	for(cycles = 0; ; cycles++) {
+		progress = false;
+		for(auto idx : order) step_layer(idx);
+		if(progress == true) cycles_progress = cycles;
+
+		bool done = true;
+		for(auto& sl : simlayers) {
+			if(sl.succ.empty() == true && sl.emitted < (uint64_t)frames_nb * sl.out_beats) { done = false; break; }
+		}
+		if(done == true) break;
+
+		if(cycles - cycles_progress > latency_max + 16) {
+			if(verbose == true) {
+				printf("Error : Deadlock at clock cycle %" PRIu64 ", no transfer since clock cycle %" PRIu64 "\n", cycles, cycles_progress);
+			}
+			return -1;
+		}
+		if(cycles_max > 0 && cycles >= cycles_max) {
+			printf("Error : Simulation stopped after %" PRIu64 " clock cycles\n", cycles);
+			return -1;
+		}
+	}
+
+	// Include the pipeline latency of the last transfers
+	for(auto t : frame_last_out) cycles = GetMax(cycles, t);
+
+	return 0;
+}
+
+
+//============================================
+// Results
+//============================================
+
+// Throughput in steady state : measured on the second half of the frames
+double FlowSim::get_cycles_per_frame(void) const {
+	if(frame_last_out.empty() == true) return 0;
+	if(frames_nb >= 2) {
+		unsigned f0 = frames_nb / 2 - (frames_nb == 2 ? 1 : 0);
+		return (double)(frame_last_out[frames_nb-1] - frame_last_out[f0]) / (frames_nb - 1 - f0);
+	}
+	return frame_last_out[0] - frame_first_in[0];
+}
+
+// Max occupancy of the input queues of a layer, the layer is one of the original network
+unsigned FlowSim::get_occupancy_max(const Layer* layer) const {
+	if(layer->index >= simlayers.size()) return 0;
+	unsigned occupancy_max = 0;
+	for(auto& q : simlayers[layer->index].queues) {
+		occupancy_max = GetMax(occupancy_max, q.occupancy_max);
+	}
+	return occupancy_max;
+}
+
+
+//============================================
+// Report
+//============================================
+
+void FlowSim::print(void) {
+
+	printf("Dataflow simulation : %u frames, %" PRIu64 " clock cycles\n", frames_nb, cycles);
+
+	double cycles_per_frame = get_cycles_per_frame();
+	printf("  Throughput : %.1f clock cycles/frame in steady state (analytic %u)\n", cycles_per_frame, maxcycles_per_layer(network));
+	if(freq_mhz > 0 && cycles_per_frame > 0) {
+		printf("  Throughput : %.1f frames/s at %g MHz\n", freq_mhz * 1e6 / cycles_per_frame, freq_mhz);
+	}
+
+	uint64_t lat_max = 0;
+	double lat_avg = 0;
+	for(unsigned f=0; f<frames_nb; f++) {
+		uint64_t lat = frame_last_out[f] - frame_first_in[f];
+		lat_max = GetMax(lat_max, lat);
+		lat_avg += lat;
+	}
+	lat_avg /= frames_nb;
+	printf("  Latency : first frame %" PRIu64 ", average %.1f, max %" PRIu64 " clock cycles (analytic %lu)\n",
+		frame_last_out[0] - frame_first_in[0], lat_avg, lat_max, network->eval_latency()
+	);
+
+	// Per-layer statistics
+	printf("  Layer      busy   stall  starve   queue max\n");
+	Layer* bottleneck = nullptr;
+	double bottleneck_busy = 0;
+	for(auto layer : network->layers) {
+		auto& sl = simlayers[layer->index];
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%s%u", layer->typenamel, layer->typeidx);
+		unsigned occupancy_max = 0;
+		unsigned capacity = 0;
+		for(auto& q : sl.queues) {
+			occupancy_max = GetMax(occupancy_max, q.occupancy_max);
+			capacity = GetMax(capacity, q.capacity);
+		}
+		printf("  %-8s  %4.0f%%   %4.0f%%   %4.0f%%   %5u / %u\n", buf,
+			100.0 * sl.cycles_busy / cycles, 100.0 * sl.cycles_stall / cycles, 100.0 * sl.cycles_starve / cycles,
+			occupancy_max, capacity
+		);
+		// The bottleneck is the layer that transfers data most of the time without being stalled by its successors
+		if(layer->type == LAYER_FIFO) continue;
+		double busy = (double)sl.cycles_busy / cycles - (double)sl.cycles_stall / cycles;
+		if(bottleneck == nullptr || busy > bottleneck_busy) {
+			bottleneck = layer;
+			bottleneck_busy = busy;
+		}
+	}
+	if(bottleneck != nullptr) {
+		printf("  Bottleneck : layer %s%u (busy %.0f%% without stall)\n", bottleneck->typenamel, bottleneck->typeidx, bottleneck_busy * 100);
+	}
+
+}
+
+
+
+//============================================
+// Sizing of FIFOs
+//============================================
+
+// The counters of FIFO levels have 16 bits
+#define SIZE_FIFOS_DEPTH_MAX 32768
+
+// The data that can arrive in a FIFO after its level is seen as full by the layer in control of the flow :
+// the pipeline of all layers since the previous FIFO, plus the extra fifo room of the layer in control of the flow
+static unsigned size_fifos_latency(Layer* layer_fifo) {
+	Latency lat;
+	// Write into memory and propagation of the level of the FIFO
+	layer_fifo->eval_latency(lat);
+	unsigned depth = lat.cycles_to_first_out;
+	unsigned margin = 0;
+
+	Layer* layer = layer_fifo->prev;
+	while(layer != nullptr && layer->type != LAYER_FIFO) {
+		layer->eval_latency(lat);
+		depth += lat.cycles_to_first_out;
+		margin = GetMax(margin, layer->out_extra_fifo_room);
+		// Layers CAT and GATHER have FIFOs on all their inputs
+		if(layer->prev_is_arr == true) break;
+		layer = layer->prev;
+	}
+
+	return depth + margin;
+}
+
+// Evaluate the memory blocks of a FIFO for a given depth, the implementation style is chosen automatically
+static void size_fifos_eval(Network* network, Layer* layer, unsigned depth, MemImplem& mem) {
+	mem = layer->mem;
+	mem.width = layer->wdata * layer->split_out;
+	mem.lines = depth;
+	mem.num   = 1;
+	mem.style = MemImplem::STYLE_AUTO;
+	mem.EvalBlocks(network->hwconfig_lut_threshold, network->hwconfig_use_uram);
+}
+
+// Round up the depth to the largest one that uses the same memory blocks
+// Candidate shapes are 32 lines, multiples of 64 lines for LUTRAM, and powers of 2 for BRAM
+static unsigned size_fifos_round(Network* network, Layer* layer, unsigned depth) {
+	depth = GetMin(GetMax(depth, 2U), (unsigned)SIZE_FIFOS_DEPTH_MAX);
+
+	unsigned lut_threshold = network->hwconfig_lut_threshold;
+	if(lut_threshold == 0) lut_threshold = 64;
+
+	MemImplem mem_ref;
+	MemImplem mem;
+	size_fifos_eval(network, layer, depth, mem_ref);
+
+	unsigned depth_best = depth;
+	for(unsigned d = 32; d <= SIZE_FIFOS_DEPTH_MAX; ) {
+		if(d > depth) {
+			size_fifos_eval(network, layer, d, mem);
+			if(mem.style != mem_ref.style || mem.blocks != mem_ref.blocks) break;
+			depth_best = d;
+		}
+		if(d < 64) d = 64;
+		else if(d + 64 <= lut_threshold) d += 64;
+		else d = uint_rndpow2_ceil(d + 1);
+	}
+
+	return depth_best;
+}
+
+static void size_fifos_set(Network* network, vector<Layer*>& fifos, vector<unsigned>& depths) {
+	for(unsigned i=0; i<fifos.size(); i++) {
+		auto layer = fifos[i];
+		layer->fifo_depth = depths[i];
+		layer->mem.style = MemImplem::STYLE_NONE;
+		layer->eval_mem_size();
+		layer->mem.EvalBlocks(network->hwconfig_lut_threshold, network->hwconfig_use_uram);
+	}
+}
+
+int nn_size_fifos(Network* network, bool use_sim, unsigned frames_nb) {
+
+	// The first and last FIFOs are the interface of the accelerator, these are not modified
+	vector<Layer*> fifos;
+	for(auto layer : network->layers) {
+		if(layer->type != LAYER_FIFO) continue;
+		if(layer == network->layer_first || layer == network->layer_last) continue;
+		fifos.push_back(layer);
+	}
+	if(fifos.empty() == true) {
+		printf("Error : No FIFO to size, the hardware configuration must be finalized first\n");
+		return -1;
+	}
+
+	vector<unsigned> depths_old(fifos.size());
+	vector<unsigned> depths(fifos.size());
+	for(unsigned i=0; i<fifos.size(); i++) {
+		depths_old[i] = fifos[i]->fifo_depth;
+		depths[i] = size_fifos_latency(fifos[i]);
+	}
+
+	// The reference throughput, and the FIFO levels actually needed, are obtained with the current depths
+	double cycles_ref = 0;
+	if(use_sim == true) {
+		FlowSim flowsim(network);
+		flowsim.frames_nb = frames_nb;
+		int z = flowsim.run();
+		if(z != 0) return z;
+		cycles_ref = flowsim.get_cycles_per_frame();
+		for(unsigned i=0; i<fifos.size(); i++) {
+			depths[i] = GetMax(depths[i], flowsim.get_occupancy_max(fifos[i]));
+		}
+	}
+
+	for(unsigned i=0; i<fifos.size(); i++) {
+		depths[i] = size_fifos_round(network, fifos[i], depths[i]);
+	}
+	size_fifos_set(network, fifos, depths);
+
+	// Enlarge the FIFOs that are full until the throughput is the same as with the previous depths
+	double cycles_new = 0;
+	if(use_sim == true) {
+		for(unsigned iter=0; ; iter++) {
+			FlowSim flowsim(network);
+			flowsim.frames_nb = frames_nb;
+			flowsim.verbose = false;
+			int z = flowsim.run();
+			cycles_new = flowsim.get_cycles_per_frame();
+			if(z == 0 && cycles_new <= cycles_ref * 1.001) break;
+
+			bool enlarged = false;
+			if(iter < 16) {
+				for(unsigned i=0; i<fifos.size(); i++) {
+					if(flowsim.get_occupancy_max(fifos[i]) < depths[i] || depths[i] >= SIZE_FIFOS_DEPTH_MAX) continue;
+					depths[i] = size_fifos_round(network, fifos[i], depths[i] * 2);
+					enlarged = true;
+				}
+			}
+			if(enlarged == false) {
+				printf("Warning : The throughput could not be preserved, the FIFO depths are not changed\n");
+				depths = depths_old;
+				size_fifos_set(network, fifos, depths);
+				cycles_new = cycles_ref;
+				break;
+			}
+			size_fifos_set(network, fifos, depths);
+		}
+	}
+
+	// Report
+	unsigned long bram18_old = 0, bram18_new = 0;
+	unsigned long lutram_old = 0, lutram_new = 0;
+
+	printf("FIFO sizing :\n");
+	printf("  Layer     width   depth          memory\n");
+	for(unsigned i=0; i<fifos.size(); i++) {
+		auto layer = fifos[i];
+		MemImplem mem_old;
+		size_fifos_eval(network, layer, depths_old[i], mem_old);
+		auto& mem_new = layer->mem;
+
+		if(mem_old.style == MemImplem::STYLE_BRAM) bram18_old += mem_old.blocks;
+		if(mem_old.style == MemImplem::STYLE_LUTRAM) lutram_old += mem_old.blocks;
+		if(mem_new.style == MemImplem::STYLE_BRAM) bram18_new += mem_new.blocks;
+		if(mem_new.style == MemImplem::STYLE_LUTRAM) lutram_new += mem_new.blocks;
+
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%s%u", layer->typenamel, layer->typeidx);
+		printf("  %-8s  %5u   %5u -> %-5u  %s %lu -> %s %lu\n", buf, mem_new.width, depths_old[i], depths[i],
+			mem_old.GetStyleName(), mem_old.blocks, mem_new.GetStyleName(), mem_new.blocks
+		);
+	}
+	printf("  BRAM18 : %lu -> %lu (saved %ld)\n", bram18_old, bram18_new, (long)bram18_old - (long)bram18_new);
+	printf("  LUTRAM : %lu -> %lu (saved %ld)\n", lutram_old, lutram_new, (long)lutram_old - (long)lutram_new);
+	if(use_sim == true) {
+		printf("  Throughput : %.1f clock cycles/frame, previously %.1f\n", cycles_new, cycles_ref);
+	}
+
+	return 0;
+}
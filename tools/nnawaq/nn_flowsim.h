@@ -0,0 +1,135 @@
+
+#pragma once
+
+extern "C" {
+#include <stdbool.h>
+#include <stdint.h>
+}
+
+#include <vector>
+#include <deque>
+
+#include "nn_layers_create.h"
+
+
+//============================================
+// Transaction-level simulation of the dataflow pipeline
+//============================================
+
+// The accelerator is simulated clock cycle by clock cycle, at the level of transfers between layers
+// One transfer is one beat of PAR values, no data is computed
+// Each layer is modeled as a series of groups of input transfers that each enable a group of output transfers :
+// - window layers : the first group needs WINY lines, then each output line of windows needs STEPY more lines
+// - neuron, pooling layers : each output group needs the inputs of one window
+// - other layers : transfers are streamed
+// A layer accepts the inputs of the next group while the outputs of the current group are emitted
+// Branches are approximated : layer SCATTER sends the first transfers of each frame to each successor,
+//   layer CAT reads its predecessors in rounds, layer GATHER reads its predecessors one after the other
+// Outputs are delayed by the pipeline latency of the layer, see eval_latency()
+// FIFO layers have their actual depth, and the input stream of the network is always valid and the output stream is always ready
+
+class FlowSim {
+
+	private :
+
+	// The input queue of a layer, for one predecessor
+	// The queue contains the clock cycles when the transfers become visible to the layer
+	typedef struct flowsim_queue_t {
+		std::deque<uint64_t> beats;
+		unsigned capacity = 2;
+		unsigned occupancy_max = 0;
+	} flowsim_queue_t;
+
+	typedef struct flowsim_layer_t {
+		Layer* layer = nullptr;
+
+		// Transfers per frame
+		unsigned in_beats  = 1;
+		unsigned out_beats = 1;
+		// Group model
+		unsigned pre = 1;
+		unsigned gin = 1;
+		unsigned gout = 1;
+		unsigned groups = 1;
+		unsigned latency = 1;
+
+		// Links, indexes in the vector of simulated layers
+		std::vector<unsigned> succ;
+		std::vector<unsigned> succ_port;  // Input queue of the successor
+		std::vector<unsigned> pred_beats; // For multi-input layers, the transfers per frame of each predecessor
+		unsigned pred_round = 0;          // Transfers in one round of all predecessors
+
+		std::vector<flowsim_queue_t> queues;
+
+		// Progress, cumulated over all frames
+		uint64_t consumed = 0;
+		uint64_t emitted = 0;
+
+		// Statistics
+		uint64_t cycles_stall = 0;   // Outputs are ready but the successors have no room
+		uint64_t cycles_starve = 0;  // The layer can accept inputs but none is available
+		uint64_t cycles_busy = 0;    // At least one transfer is accepted or emitted
+	} flowsim_layer_t;
+
+	Network* network = nullptr;
+	Network* network_sim = nullptr;
+	std::vector<flowsim_layer_t> simlayers;
+
+	// Per-frame timestamps
+	std::vector<uint64_t> frame_first_in;
+	std::vector<uint64_t> frame_last_out;
+
+	// If any transfer occurred during the current clock cycle
+	bool progress = false;
+
+	public :
+
+	// Parameters
+	unsigned frames_nb = 16;
+	unsigned fifo_depth = 0;     // Zero means the depth of the FIFO layers
+	double   freq_mhz = 0;       // To report frames/s, zero means no report
+	uint64_t cycles_max = 0;     // Zero means automatic limit to detect deadlocks
+	bool     verbose = true;     // Report deadlocks
+
+	// Results
+	uint64_t cycles = 0;
+
+	// Constructor / Destructor
+
+	public :
+	FlowSim(Network* network) : network(network) {}
+	~FlowSim(void);
+
+	// Methods
+
+	private :
+	int  build(void);
+	unsigned input_port(const flowsim_layer_t& sl) const;
+	uint64_t accept_bound(const flowsim_layer_t& sl) const;
+	uint64_t emit_bound(const flowsim_layer_t& sl) const;
+	void step_layer(unsigned idx);
+
+	public :
+	int  run(void);
+	void print(void);
+
+	// Results after run()
+	double   get_cycles_per_frame(void) const;
+	unsigned get_occupancy_max(const Layer* layer) const;
+
+};
+
+
+//============================================
+// Sizing of FIFOs
+//============================================
+
+// Each FIFO receives the minimum depth that does not stall the layers that write into it :
+// - the data in flight in the pipeline of these layers, plus the extra fifo room of the layer in control of the flow
+// - with simulation, at least the max level observed with the current depths,
+//   then full FIFOs are enlarged until the throughput is the same as with the current depths
+// The depth is rounded up to the largest one that uses the same memory blocks, see MemImplem::EvalBlocks()
+// The first and last FIFOs are the interface of the accelerator, these are not modified
+
+int nn_size_fifos(Network* network, bool use_sim, unsigned frames_nb);
+
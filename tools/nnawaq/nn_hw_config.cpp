@@ -29,6 +29,117 @@ extern "C" {
 static const char* neu_compr_filename_csv = "experimental_neu_weight_decomp_lut.csv";
 static FILE* neu_compr_file_csv = nullptr;
 
+// Estimation of the number of LUTs of one physical neuron
+// The accumulator width is only used by neuron style 0
+unsigned hwconfig_luts_per_neuron(unsigned neu_style, unsigned wdata, unsigned waccu, unsigned split_in) {
+	unsigned luts_per_neu = 0;
+	if(neu_style==0) luts_per_neu = waccu + (waccu + 1) / 2 + 1;
+	else {
+		luts_per_neu = wdata + (wdata + 1) / 2;
+		unsigned nb_ternmult = split_in;
+		luts_per_neu += nb_ternmult;
+		unsigned waccu_ternmult = 2;
+		while(nb_ternmult > 1) {
+			nb_ternmult = (nb_ternmult + 1) / 2;
+			luts_per_neu += nb_ternmult * waccu_ternmult;
+			waccu_ternmult++;
+		}
+	}
+	return luts_per_neu;
+}
+
+// Check the legality of the parallelism, without exiting
+// Return the number of errors found
+int Layer::check_par(bool verbose) {
+	if(split_in == 0 || split_out == 0) {
+		if(verbose == true) printf("Error %s%u: Illegal PAR_IN=%u PAR_OUT=%u\n", typenameu, typeidx, split_in, split_out);
+		return 1;
+	}
+	return 0;
+}
+
+int LayerWin::check_par(bool verbose) {
+
+	// This variable is just to ease code refactoring
+	layer_t* layer = this;
+
+	int errors_nb = Layer::check_par(verbose);
+	if(errors_nb != 0) return errors_nb;
+	if(layer->split_in <= 1) return 0;
+
+	// PAR_OZ is set to 1 by hwconfig_finalize() if not set
+	unsigned par_oz = (layer->win_par_oz == 0) ? 1 : layer->win_par_oz;
+
+	// Some fields must be multiples of other fields
+	if(par_oz % layer->split_in != 0) {
+		if(verbose == true) printf("Error %s%u: PAR_OZ=%u is not a multiple of PAR_IN=%u\n", layer->typenameu, layer->typeidx, par_oz, layer->split_in);
+		errors_nb++;
+	}
+	if(layer->split_out % par_oz != 0) {
+		if(verbose == true) printf("Error %s%u: PAR_OUT=%u is not a multiple of PAR_OZ=%u\n", layer->typenameu, layer->typeidx, layer->split_out, par_oz);
+		errors_nb++;
+	}
+	if(layer->fz % par_oz != 0) {
+		if(verbose == true) printf("Error %s%u: in_fz=%u is not a multiple of PAR_OZ=%u\n", layer->typenameu, layer->typeidx, layer->fz, par_oz);
+		errors_nb++;
+	}
+	if(layer->out_fz % par_oz != 0) {
+		if(verbose == true) printf("Error %s%u: out_fz=%u is not a multiple of PAR_OZ=%u\n", layer->typenameu, layer->typeidx, layer->out_fz, par_oz);
+		errors_nb++;
+	}
+	if(errors_nb != 0) {
+		if(verbose == true) {
+			printf("Error %s%u: Errors found with PAR_IN=%u PAR_OUT=%u PAR_OZ=%u in_fz=%u out_fz=%u\n", layer->typenameu, layer->typeidx,
+				layer->split_in, layer->split_out, par_oz, layer->fz, layer->out_fz
+			);
+		}
+		return errors_nb;
+	}
+
+	// The non-PAR_OZ factor of PAR_OUT must be an appropriate divisor of the window size
+	// FIXME When in ZFIRST mode, we can have multiple concurrent reads within FZ
+	unsigned par_win = layer->split_out / par_oz;
+	if(
+		(par_win <= layer->winx && layer->winx % par_win != 0) ||
+		(par_win >= layer->winx && par_win % layer->winx != 0) ||
+		(par_win >= layer->winx && (layer->winy % (par_win / layer->winx) != 0))
+	) {
+		if(verbose == true) printf("Error %s%u: PAR_WIN=%u win=%ux%u\n", layer->typenameu, layer->typeidx, par_win, layer->winx, layer->winy);
+		errors_nb++;
+	}
+
+	return errors_nb;
+}
+
+// Checks shared by the neuron layers LayerNeu and LayerNeu_CM
+static int neu_check_par(layer_t* layer, bool verbose) {
+	int errors_nb = 0;
+
+	if(layer->win_dwconv == false && layer->fsize % layer->split_in != 0) {
+		if(verbose == true) printf("Error %s%u: Frame size %u is not a multiple of PAR_IN=%u\n", layer->typenameu, layer->typeidx, layer->fsize, layer->split_in);
+		errors_nb++;
+	}
+	// Time multiplexing forces neuron style 2, which needs locked data signedness
+	if(layer->neu_time_mux > 1 && (layer->neu_sgnd & NEUSGN_LOCKED) == 0) {
+		if(verbose == true) printf("Error %s%u: Time multiplexing %u is incompatible with data signedness\n", layer->typenameu, layer->typeidx, layer->neu_time_mux);
+		errors_nb++;
+	}
+
+	return errors_nb;
+}
+
+int LayerNeu::check_par(bool verbose) {
+	int errors_nb = Layer::check_par(verbose);
+	if(errors_nb != 0) return errors_nb;
+	return neu_check_par(this, verbose);
+}
+
+int LayerNeu_CM::check_par(bool verbose) {
+	int errors_nb = Layer::check_par(verbose);
+	if(errors_nb != 0) return errors_nb;
+	return neu_check_par(this, verbose);
+}
+
 void Layer::hwconfig_finalize(void) {
 	// Nothing is done by default
 }
@@ -48,41 +159,7 @@ void LayerWin::hwconfig_finalize(void) {
 	// This component is special in the sense that its support for PAR_IN > 1 is a hack : it is a scaling factor for actual data width
 	if(layer->split_in > 1) {
 		if(layer->win_par_oz == 0) layer->win_par_oz = 1;
-		// Some fields must be multiples of other fields
-		unsigned errors_nb = 0;
-		if(layer->win_par_oz % layer->split_in != 0) {
-			printf("Error %s%u: PAR_OZ=%u is not a multiple of PAR_IN=%u\n", layer->typenameu, layer->typeidx, layer->win_par_oz, layer->split_in);
-			errors_nb++;
-		}
-		if(layer->split_out % layer->win_par_oz != 0) {
-			printf("Error %s%u: PAR_OUT=%u is not a multiple of PAR_OZ=%u\n", layer->typenameu, layer->typeidx, layer->split_out, layer->win_par_oz);
-			errors_nb++;
-		}
-		if(layer->fz % layer->win_par_oz != 0) {
-			printf("Error %s%u: in_fz=%u is not a multiple of PAR_OZ=%u\n", layer->typenameu, layer->typeidx, layer->fz, layer->win_par_oz);
-			errors_nb++;
-		}
-		if(layer->out_fz % layer->win_par_oz != 0) {
-			printf("Error %s%u: out_fz=%u is not a multiple of PAR_OZ=%u\n", layer->typenameu, layer->typeidx, layer->out_fz, layer->win_par_oz);
-			errors_nb++;
-		}
-		if(errors_nb != 0) {
-			printf("Error %s%u: Errors found with PAR_IN=%u PAR_OUT=%u PAR_OZ=%u in_fz=%u out_fz=%u\n", layer->typenameu, layer->typeidx,
-				layer->split_in, layer->split_out, layer->win_par_oz, layer->fz, layer->out_fz
-			);
-			exit(EXIT_FAILURE);
-		}
-		// The non-PAR_OZ factor of PAR_OUT must be an appropriate divisor of the window size
-		// FIXME When in ZFIRST mode, we can have multiple concurrent reads within FZ
-		unsigned par_win = layer->split_out / layer->win_par_oz;
-		if(
-			(par_win <= layer->winx && layer->winx % par_win != 0) ||
-			(par_win >= layer->winx && par_win % layer->winx != 0) ||
-			(par_win >= layer->winx && (layer->winy % (par_win / layer->winx) != 0))
-		) {
-			printf("Error %s%u: PAR_WIN=%u win=%ux%u\n", layer->typenameu, layer->typeidx, par_win, layer->winx, layer->winy);
-			exit(EXIT_FAILURE);
-		}
+		if(layer->check_par(true) != 0) exit(EXIT_FAILURE);
 	}
 
 }
@@ -94,6 +171,8 @@ void LayerNeu::hwconfig_finalize(void) {
 
 	Network* network = layer->network;
 
+	if(layer->check_par(true) != 0) exit(EXIT_FAILURE);
+
 	unsigned fsize = (layer->fsize + layer->split_in - 1) / layer->split_in;
 	unsigned nbneu = (layer->neurons_max + layer->split_out - 1) / layer->split_out;
 
@@ -181,18 +260,7 @@ void LayerNeu::hwconfig_finalize(void) {
 	unsigned blk_per_neu = 1;
 
 	// Compute the number of LUTs per neuron
-	if(layer->neu_style==0) luts_per_neu = waccu + (waccu + 1) / 2 + 1;
-	else {
-		luts_per_neu = layer->wdata + (layer->wdata + 1) / 2;
-		unsigned nb_ternmult = layer->split_in;
-		luts_per_neu += nb_ternmult;
-		unsigned waccu_ternmult = 2;
-		while(nb_ternmult > 1) {
-			nb_ternmult = (nb_ternmult + 1) / 2;
-			luts_per_neu += nb_ternmult * waccu_ternmult;
-			waccu_ternmult++;
-		}
-	}
+	luts_per_neu = hwconfig_luts_per_neuron(layer->neu_style, layer->wdata, waccu, layer->split_in);
 	//printf("Info: layer %s%u: %u lut/neu\n", layer->typenameu, layer->typeidx, luts_per_neu);
 
 	// Apply global default implementation of mem style
@@ -492,6 +560,8 @@ void LayerNeu_CM::hwconfig_finalize(void) {
 
 	Network* network = layer->network;
 
+	if(layer->check_par(true) != 0) exit(EXIT_FAILURE);
+
 	unsigned fsize = (layer->fsize + layer->split_in - 1) / layer->split_in;
 	unsigned nbneu = (layer->neurons_max + layer->split_out - 1) / layer->split_out;
 
@@ -579,18 +649,7 @@ void LayerNeu_CM::hwconfig_finalize(void) {
 	unsigned blk_per_neu = 1;
 
 	// Compute the number of LUTs per neuron
-	if(layer->neu_style==0) luts_per_neu = waccu + (waccu + 1) / 2 + 1;
-	else {
-		luts_per_neu = layer->wdata + (layer->wdata + 1) / 2;
-		unsigned nb_ternmult = layer->split_in;
-		luts_per_neu += nb_ternmult;
-		unsigned waccu_ternmult = 2;
-		while(nb_ternmult > 1) {
-			nb_ternmult = (nb_ternmult + 1) / 2;
-			luts_per_neu += nb_ternmult * waccu_ternmult;
-			waccu_ternmult++;
-		}
-	}
+	luts_per_neu = hwconfig_luts_per_neuron(layer->neu_style, layer->wdata, waccu, layer->split_in);
 	//printf("Info: layer %s%u: %u lut/neu\n", layer->typenameu, layer->typeidx, luts_per_neu);
 
 	// Apply global default implementation of mem style
@@ -894,15 +953,48 @@ void Network::hwconfig_finalize(void) {
 	total_macs        = 0;
 
 	for(auto layer : layers) {
+		HwconfigTotals& totals = layer->cache_hwconfig_totals;
+		// Layers that are not dirty and not changed since the previous call only contribute their cached results
+		LayerSignature sig;
+		layer->get_signature(sig);
+		if(layer->cache_hwconfig_valid == true && layer->params_dirty == false && sig == layer->cache_hwconfig_sig) {
+			total_neurons     += totals.neurons;
+			total_neurons_phy += totals.neurons_phy;
+			total_multipliers += totals.multipliers;
+			total_weights     += totals.weights;
+			total_weight_bits += totals.weight_bits;
+			total_macs        += totals.macs;
+			continue;
+		}
+		// Save the totals before the layer, to obtain the contribution of the layer
+		totals.neurons     = total_neurons;
+		totals.neurons_phy = total_neurons_phy;
+		totals.multipliers = total_multipliers;
+		totals.weights     = total_weights;
+		totals.weight_bits = total_weight_bits;
+		totals.macs        = total_macs;
 		layer->hwconfig_finalize();
 		// This triggers decision of memory implem
 		layer->eval_mem_size();
+		totals.neurons     = total_neurons     - totals.neurons;
+		totals.neurons_phy = total_neurons_phy - totals.neurons_phy;
+		totals.multipliers = total_multipliers - totals.multipliers;
+		totals.weights     = total_weights     - totals.weights;
+		totals.weight_bits = total_weight_bits - totals.weight_bits;
+		totals.macs        = total_macs        - totals.macs;
+		// The finalization may set hardware parameters, so the signature is taken afterwards
+		layer->get_signature(layer->cache_hwconfig_sig);
+		layer->cache_hwconfig_valid = true;
 	}
 
 	// Report
 	printf("Global network report :\n");
 	unsigned long latency = eval_latency();
 	printf("  Latency : %lu clock cycles\n", latency);
+	if(hwconfig_mem_pack == true) {
+		mem_pack();
+		printf("  Memory : Total %u bram18 blocks, estimation %u with packing of small memories\n", total_bram18, total_bram18_packed);
+	}
 	printf("  Neuron layers : Total %lu MAC operations/image\n", total_macs);
 	printf("  Neuron layers : Total %u neurons (%u physical), %u multipliers\n",
 		total_neurons, total_neurons_phy, total_multipliers
@@ -10,4 +10,5 @@ extern "C" {
 #define GENVHDL_VERSION_MAJ 3
 #define GENVHDL_VERSION_MIN 0
 
+unsigned hwconfig_luts_per_neuron(unsigned neu_style, unsigned wdata, unsigned waccu, unsigned split_in);
 
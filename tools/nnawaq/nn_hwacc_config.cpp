@@ -13,6 +13,7 @@ extern "C" {
 #include <math.h>
 #include <assert.h>
 #include <time.h>
+#include <unistd.h>  // For sysconf()
 
 #include "nnawaq_utils.h"
 #include "load_config.h"
@@ -801,6 +802,19 @@ int LayerGather::hwacc_genconfig(const HwAcc_Common* hwacc, std::vector<uint32_t
 // Frames
 //============================================
 
+// Page-aligned buffer for frame data, with clear padding
+static uint32_t* frames_alloc_aligned(unsigned nb32) {
+	void* ptr = nullptr;
+	size_t bytes = uint_round_up(nb32 * sizeof(uint32_t), sysconf(_SC_PAGESIZE));
+	int z = posix_memalign(&ptr, sysconf(_SC_PAGESIZE), bytes);
+	if(z != 0) {
+		printf("ERROR: Failed to allocate a buffer of %u 32b words\n", nb32);
+		exit(EXIT_FAILURE);
+	}
+	memset(ptr, 0, bytes);
+	return (uint32_t*)ptr;
+}
+
 // FIXME Use function loadfile_oneframe() to reuse code
 // FIXME Does not handle all data reordering and stuff
 int nn_frames_loadfile(
@@ -825,7 +839,8 @@ int nn_frames_loadfile(
 	size_t linebuf_size = 2048;
 	char* linebuf = (char*)malloc(linebuf_size);
 
-	uint32_t* databuf_alloc = (uint32_t*)malloc(alloc_nb32 * sizeof(*databuf_alloc) + 128);
+	// Note : The size is already a multiple of the transfer size
+	uint32_t* databuf_alloc = frames_alloc_aligned(alloc_nb32);
 	*pdatabuf = databuf_alloc;
 	*pnb32 = alloc_nb32;
 
@@ -969,8 +984,11 @@ int nn_frames_loadfile_layer(
 	unsigned bits_per_frame = fsize * inwdata;
 	unsigned total_nb32 = ((uint64_t)param_fn * bits_per_frame + 31) / 32;
 
-	// Allocate some extra space just to make sure PCIe 128-bit buffers fit
-	uint32_t* databuf = (uint32_t*)realloc(*pdatabuf, total_nb32 * sizeof(*databuf) + 128);
+	// Round to the transfer size, so the last transfer can be read entirely
+	unsigned nb32perblock = (inlayer->network->hwconfig_writewidth + 31) / 32;
+	unsigned alloc_nb32 = uint_next_multiple(total_nb32, GetMax(nb32perblock, 1u));
+	free(*pdatabuf);
+	uint32_t* databuf = frames_alloc_aligned(alloc_nb32);
 	int* framebuf = (int*)malloc(fsize * sizeof(*framebuf));
 
 	unsigned databuf_nb32 = 0;
@@ -0,0 +1,582 @@
+
+// Persistent inference server : the network is loaded once, then requests are served
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdarg.h>
+#include <inttypes.h>
+#include <errno.h>
+#include <signal.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "nnawaq_utils.h"
+#include "load_config.h"
+
+}
+
+#include "nn_layers_utils.h"
+#include "nn_load_config.h"
+#include "nn_out_writer.h"
+#include "swexec.h"
+#include "hwacc_common.h"
+
+#include "nn_infer_server.h"
+
+using namespace std;
+
+
+// Execution engine selected by default, negative for automatic selection
+int param_infer_mode = -1;
+
+static volatile sig_atomic_t infer_signaled = 0;
+
+static void infer_sighandler(int sig) {
+	infer_signaled = 1;
+}
+
+
+//============================================
+// Constructor / Destructor
+//============================================
+
+InferServer::InferServer(Network* network) {
+	this->network = network;
+}
+
+InferServer::~InferServer(void) {
+	if(sw_ready == true) swexec_end(network);
+}
+
+
+//============================================
+// Execution engines
+//============================================
+
+int InferServer::set_mode(mode_type mode) {
+
+	// Get first and last layers of the network, like HwAcc_Common::write_frames()
+	inlayer = NULL;
+	outlayer = NULL;
+	for(layer_t* layer = network->layer_first; layer != NULL; layer = layer->next) {
+		if(layer->type != LAYER_FIFO) { inlayer = layer; break; }
+	}
+	for(layer_t* layer = network->layer_last; layer != NULL; layer = layer->prev) {
+		if(layer->type != LAYER_FIFO) { outlayer = layer; break; }
+	}
+	if(inlayer == NULL || outlayer == NULL) {
+		printf("Error : The network has no layers\n");
+		return -1;
+	}
+	if(param_out_layer != NULL) outlayer = param_out_layer;
+
+	if(mode == MODE_SW && sw_ready == false) {
+		// Load configuration data, and pre-compute what software execution needs
+		int z = network->load_config_files();
+		if(z != 0) return -1;
+		z = swexec_begin(network);
+		if(z != 0) return -1;
+		sw_ready = true;
+	}
+
+	if(mode == MODE_HW) {
+		HwAcc_Common* hwacc = HwAcc_Common::CurrentHwAcc_Get();
+		if(hwacc == nullptr) {
+			printf("Error : No hardware accelerator is initialized\n");
+			return -1;
+		}
+		// The accelerator is configured only once, unless it was replaced
+		if(hwacc != hw_ready) {
+			hwacc->prepare(network);
+			hw_ready = hwacc;
+		}
+		if(outlayer != network->layer_last && hwacc->accreg_selout == false) {
+			layer_t* last = outlayer;
+			for(layer_t* layer = network->layer_last; layer != NULL; layer = layer->prev) {
+				if(layer->type != LAYER_FIFO) { last = layer; break; }
+			}
+			if(outlayer != last) {
+				printf("Error : The hardware supports only output at last layer\n");
+				return -1;
+			}
+		}
+	}
+
+	this->mode = mode;
+	return 0;
+}
+
+// Number of values per frame returned to clients
+unsigned InferServer::get_outsize(void) {
+	if(mode == MODE_HW) {
+		unsigned frame_size = 0;
+		unsigned frame_size_user = 0;
+		hw_ready->get_outputs_frame_size(outlayer, &frame_size, &frame_size_user);
+		return frame_size_user;
+	}
+	if(network->swexec_opt_gen_in == true) return outlayer->nbframes * outlayer->fsize;
+	return outlayer->out_nbframes * outlayer->out_fsize;
+}
+
+// Number of frames processed at once, for hardware this is limited by the user-specified buffer size
+unsigned InferServer::get_chunk_frames(void) {
+	if(mode == MODE_SW) return 1024;
+	HwAcc_Common* hwacc = hw_ready;
+	unsigned max_transfers_nb = (param_bufsz_mb * 1024 * 1024 / 4) / GetMax(hwacc->accreg_ifw32, 1u);
+	unsigned max_frames_nb = (max_transfers_nb * GetMax(hwacc->accreg_pari, 1u)) / inlayer->fsize;
+	return GetMax(max_frames_nb, 1u);
+}
+
+// Frames and results are contiguous, the execution mutex must be locked
+int InferServer::exec_frames(const int* frames, unsigned frames_nb, int* out) {
+	unsigned fsize = inlayer->fsize;
+	unsigned outsize = get_outsize();
+	int64_t time_beg = Time64_GetReal();
+	int z = 0;
+
+	if(mode == MODE_SW) {
+		// The frame index is only used for printing, results are captured
+		for(unsigned f=0; f<frames_nb; f++) {
+			z = swexec_oneframe(network, outlayer, frames + uint64_t(f) * fsize, out + uint64_t(f) * outsize, f);
+			if(z != 0) break;
+		}
+	}
+
+	else {
+		z = hw_ready->process_frames_user(network, outlayer, frames, frames_nb, out);
+	}
+
+	stat_exec_ns += Time64_GetReal() - time_beg;
+	stat_frames += frames_nb;
+
+	return z;
+}
+
+// Process a file of frames, results are written with the usual output options, the execution mutex must be locked
+int InferServer::exec_file(const char* filename_in, const char* filename_out, unsigned* frames_nb_p) {
+	FILE* F = fopen(filename_in, "rb");
+	if(F == NULL) {
+		printf("Error : Can't open file '%s'\n", filename_in);
+		return -1;
+	}
+	FILE* Fout = fopen(filename_out, "wb");
+	if(Fout == NULL) {
+		printf("Error : Can't open file '%s' for writing\n", filename_out);
+		fclose(F);
+		return -1;
+	}
+
+	unsigned fsize = inlayer->fsize;
+	unsigned outsize = get_outsize();
+	unsigned chunk = get_chunk_frames();
+
+	unsigned out_wdata = (mode == MODE_SW && network->swexec_opt_gen_in == true) ? outlayer->wdata : outlayer->out_wdata;
+	bool     out_sdata = (mode == MODE_SW && network->swexec_opt_gen_in == true) ? outlayer->sdata : outlayer->out_sdata;
+	unsigned mask = (param_out_mask == true) ? uint_genmask(out_wdata) : (unsigned)~0;
+	// Like swexec(), software execution may output only some values
+	unsigned step = (mode == MODE_SW) ? GetMax(swexec_param_mod, 1u) : 1;
+
+	vector<int> frames(uint64_t(chunk) * fsize);
+	vector<int> out(uint64_t(chunk) * outsize);
+
+	// The outputs may be decoded into boxes instead of writing raw values
+	LayerRegion* region = network->layer_region;
+	if(mode == MODE_SW && network->swexec_opt_gen_in == true) region = nullptr;
+	if(region != nullptr && region->decodes(outlayer) == false) region = nullptr;
+
+	OutWriter outwr;
+	if(region == nullptr) outwr.begin(Fout, param_out_bin, out_wdata, out_sdata, (outsize + step - 1) / step);
+
+	unsigned frames_nb = 0;
+	int z = 0;
+	load_warnings_clear();
+
+	do {
+		unsigned nb = 0;
+		while(nb < chunk) {
+			int* ptr = frames.data() + uint64_t(nb) * fsize;
+			memset(ptr, 0, fsize * sizeof(*ptr));
+			int r = loadfile_oneframe(F, ptr, fsize, param_multiline);
+			if(r < 0) break;
+			// Empty lines are skipped
+			if(r > 0) nb++;
+		}
+		if(nb == 0) break;
+
+		z = exec_frames(frames.data(), nb, out.data());
+		if(region != nullptr) {
+			vector<RegionBox> boxes;
+			if(z == 0) z = region->decode(outlayer, out.data(), nb, outsize, frames_nb, boxes);
+			region->write_boxes(Fout, boxes);
+		}
+		else {
+			for(unsigned f=0; f<nb; f++) {
+				outwr.frame(frames_nb + f, out.data() + uint64_t(f) * outsize, outsize, step, mask);
+			}
+		}
+		frames_nb += nb;
+
+		if(nb < chunk) break;
+	} while(z == 0);
+
+	int zw = outwr.end();
+	fclose(Fout);
+	fclose(F);
+
+	*frames_nb_p = frames_nb;
+	if(zw != 0) {
+		printf("Error : Failed to write the results to '%s'\n", filename_out);
+		return -1;
+	}
+	return z;
+}
+
+
+//============================================
+// Connections
+//============================================
+
+int InferServer::conn_read(conn_t* conn, void* data, size_t size) {
+	char* ptr = (char*)data;
+
+	// Data that is already buffered
+	unsigned nb = GetMin((size_t)(conn->buf_len - conn->buf_pos), size);
+	memcpy(ptr, conn->buf + conn->buf_pos, nb);
+	conn->buf_pos += nb;
+	ptr += nb;
+	size -= nb;
+
+	while(size > 0) {
+		ssize_t z = read(conn->fd_in, ptr, size);
+		if(z < 0 && errno == EINTR) continue;
+		if(z <= 0) return -1;
+		ptr += z;
+		size -= z;
+	}
+
+	return 0;
+}
+
+// Return the length of the line without the newline character, or -1 at end of input
+int InferServer::conn_readline(conn_t* conn, char* line, unsigned size) {
+	unsigned len = 0;
+
+	do {
+		if(conn->buf_pos == conn->buf_len) {
+			ssize_t z = read(conn->fd_in, conn->buf, sizeof(conn->buf));
+			if(z < 0 && errno == EINTR) continue;
+			if(z <= 0) return (len > 0) ? (int)len : -1;
+			conn->buf_pos = 0;
+			conn->buf_len = z;
+		}
+		char c = conn->buf[conn->buf_pos++];
+		if(c == '\n') break;
+		if(c == '\r') continue;
+		// Lines that are too long are truncated
+		if(len + 1 < size) line[len++] = c;
+	} while(1);
+
+	line[len] = 0;
+	return len;
+}
+
+int InferServer::conn_write(conn_t* conn, const void* data, size_t size) {
+	const char* ptr = (const char*)data;
+	while(size > 0) {
+		ssize_t z = (conn->fd_in == conn->fd_out) ? send(conn->fd_out, ptr, size, MSG_NOSIGNAL) : write(conn->fd_out, ptr, size);
+		if(z < 0 && errno == EINTR) continue;
+		if(z <= 0) return -1;
+		ptr += z;
+		size -= z;
+	}
+	return 0;
+}
+
+int InferServer::conn_reply(conn_t* conn, const char* fmt, ...) {
+	char buf[1024];
+	va_list args;
+	va_start(args, fmt);
+	int len = vsnprintf(buf, sizeof(buf) - 1, fmt, args);
+	va_end(args);
+	len = GetMin(len, (int)sizeof(buf) - 2);
+	buf[len++] = '\n';
+	return conn_write(conn, buf, len);
+}
+
+// Return non-zero when the connection must be closed
+int InferServer::request(conn_t* conn, char* line) {
+	char* saveptr = NULL;
+	char* cmd = strtok_r(line, " \t", &saveptr);
+	if(cmd == NULL) return 0;
+
+	__atomic_fetch_add(&stat_requests, 1, __ATOMIC_RELAXED);
+
+	if(strcmp(cmd, "quit") == 0) {
+		conn_reply(conn, "ok");
+		return 1;
+	}
+
+	if(strcmp(cmd, "shutdown") == 0) {
+		stop_req = true;
+		conn_reply(conn, "ok");
+		return 1;
+	}
+
+	if(strcmp(cmd, "info") == 0) {
+		pthread_mutex_lock(&exec_mutex);
+		int z = conn_reply(conn, "ok mode %s fsize %u outsize %u maxframes %u", (mode == MODE_SW) ? "sw" : "hw", inlayer->fsize, get_outsize(), get_chunk_frames());
+		pthread_mutex_unlock(&exec_mutex);
+		return z;
+	}
+
+	if(strcmp(cmd, "mode") == 0) {
+		char* name = strtok_r(NULL, " \t", &saveptr);
+		mode_type new_mode = MODE_SW;
+		if(name != NULL && strcmp(name, "sw") == 0) new_mode = MODE_SW;
+		else if(name != NULL && strcmp(name, "hw") == 0) new_mode = MODE_HW;
+		else return conn_reply(conn, "error usage : mode <sw|hw>");
+		pthread_mutex_lock(&exec_mutex);
+		int z = set_mode(new_mode);
+		pthread_mutex_unlock(&exec_mutex);
+		if(z != 0) return conn_reply(conn, "error can't select mode %s", name);
+		return conn_reply(conn, "ok");
+	}
+
+	if(strcmp(cmd, "frames") == 0) {
+		char* str = strtok_r(NULL, " \t", &saveptr);
+		if(str == NULL) return conn_reply(conn, "error usage : frames <n>");
+		char* end = NULL;
+		unsigned long frames_nb = strtoul(str, &end, 10);
+		if(end == str || *end != 0) return conn_reply(conn, "error usage : frames <n>");
+
+		// Same limit as the chunks of the run request, so the buffers stay bounded
+		// The payload can't be skipped, so the connection is closed
+		pthread_mutex_lock(&exec_mutex);
+		unsigned frames_max = get_chunk_frames();
+		pthread_mutex_unlock(&exec_mutex);
+		if(frames_nb > frames_max) {
+			conn_reply(conn, "error too many frames %lu, the maximum is %u", frames_nb, frames_max);
+			return 1;
+		}
+
+		// The payload is read even if the execution fails, to stay synchronized with the client
+		unsigned fsize = inlayer->fsize;
+		vector<int> frames(uint64_t(frames_nb) * fsize);
+		if(conn_read(conn, frames.data(), frames.size() * sizeof(int)) != 0) return 1;
+
+		pthread_mutex_lock(&exec_mutex);
+		unsigned outsize = get_outsize();
+		vector<int> out(uint64_t(frames_nb) * outsize);
+		int z = exec_frames(frames.data(), frames_nb, out.data());
+		pthread_mutex_unlock(&exec_mutex);
+
+		if(z != 0) return conn_reply(conn, "error execution failed");
+		if(conn_reply(conn, "ok %lu %u", frames_nb, outsize) != 0) return 1;
+		return conn_write(conn, out.data(), out.size() * sizeof(int));
+	}
+
+	if(strcmp(cmd, "run") == 0) {
+		char* filename_in = strtok_r(NULL, " \t", &saveptr);
+		char* filename_out = strtok_r(NULL, " \t", &saveptr);
+		if(filename_in == NULL || filename_out == NULL) return conn_reply(conn, "error usage : run <in> <out>");
+
+		pthread_mutex_lock(&exec_mutex);
+		unsigned frames_nb = 0;
+		int z = exec_file(filename_in, filename_out, &frames_nb);
+		pthread_mutex_unlock(&exec_mutex);
+
+		if(z != 0) return conn_reply(conn, "error execution failed after %u frames", frames_nb);
+		return conn_reply(conn, "ok %u", frames_nb);
+	}
+
+	return conn_reply(conn, "error unknown request '%s'", cmd);
+}
+
+void InferServer::conn_loop(conn_t* conn) {
+	char line[4096];
+	while(stop_req == false) {
+		int len = conn_readline(conn, line, sizeof(line));
+		if(len < 0) break;
+		if(request(conn, line) != 0) break;
+		// Messages of the program are visible as soon as the request is done
+		fflush(stdout);
+	}
+}
+
+void* InferServer::conn_thread_wrapper(void* arg) {
+	conn_t* conn = (conn_t*)arg;
+	InferServer* server = conn->server;
+
+	server->conn_loop(conn);
+	close(conn->fd_in);
+
+	pthread_mutex_lock(&server->mutex);
+	for(unsigned i=0; i<server->conns.size(); i++) {
+		if(server->conns[i] == conn) { server->conns.erase(server->conns.begin() + i); break; }
+	}
+	pthread_cond_broadcast(&server->cond_conn);
+	pthread_mutex_unlock(&server->mutex);
+
+	delete conn;
+	return NULL;
+}
+
+
+//============================================
+// Serve
+//============================================
+
+int InferServer::serve(const char* path, int mode_init) {
+	bool use_stdin = (strcmp(path, "-") == 0);
+
+	// With stdin, replies go to the original stdout, messages of the program go to stderr
+	// This is done first so the messages of the initialization of the engine are not mixed with the replies
+	int fd_out = -1;
+	if(use_stdin == true) {
+		fflush(stdout);
+		fd_out = dup(STDOUT_FILENO);
+		dup2(STDERR_FILENO, STDOUT_FILENO);
+	}
+
+	int z = 0;
+	if(mode_init >= 0) {
+		z = set_mode((mode_type)mode_init);
+	}
+	else if(inlayer == NULL) {
+		// Default engine : the hardware accelerator if one is initialized
+		mode_type mode = (HwAcc_Common::CurrentHwAcc_Get() != nullptr) ? MODE_HW : MODE_SW;
+		if(param_infer_mode >= 0) mode = (mode_type)param_infer_mode;
+		z = set_mode(mode);
+	}
+
+	if(z == 0) {
+		if(use_stdin == true) z = serve_stdin(fd_out);
+		else z = serve_socket(path);
+	}
+
+	if(use_stdin == true) {
+		fflush(stdout);
+		dup2(fd_out, STDOUT_FILENO);
+		close(fd_out);
+	}
+
+	if(z == 0) print_stats();
+	return z;
+}
+
+int InferServer::serve_stdin(int fd_out) {
+	conn_t* conn = new conn_t;
+	conn->server = this;
+	conn->fd_in = STDIN_FILENO;
+	conn->fd_out = fd_out;
+
+	conn_loop(conn);
+	delete conn;
+
+	return 0;
+}
+
+int InferServer::serve_socket(const char* path) {
+	struct sockaddr_un addr;
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	if(strlen(path) >= sizeof(addr.sun_path)) {
+		printf("Error : Socket path '%s' is too long\n", path);
+		return -1;
+	}
+	strcpy(addr.sun_path, path);
+
+	int listen_sock = socket(AF_UNIX, SOCK_STREAM, 0);
+	if(listen_sock < 0) {
+		printf("Error : Can't create socket : %s\n", strerror(errno));
+		return -1;
+	}
+	// A socket file left by a previous server is removed, unless that server is still running
+	struct stat st;
+	if(stat(path, &st) == 0 && S_ISSOCK(st.st_mode)) {
+		int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+		int z = connect(sock, (struct sockaddr*)&addr, sizeof(addr));
+		close(sock);
+		if(z == 0) {
+			printf("Error : A server is already running on socket '%s'\n", path);
+			close(listen_sock);
+			return -1;
+		}
+		unlink(path);
+	}
+	if(bind(listen_sock, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(listen_sock, 16) != 0) {
+		printf("Error : Can't listen on socket '%s' : %s\n", path, strerror(errno));
+		close(listen_sock);
+		return -1;
+	}
+
+	// Stop on usual termination signals, without SA_RESTART so poll() is interrupted
+	struct sigaction sa, sa_int_prev, sa_term_prev;
+	memset(&sa, 0, sizeof(sa));
+	sa.sa_handler = infer_sighandler;
+	sigemptyset(&sa.sa_mask);
+	sigaction(SIGINT, &sa, &sa_int_prev);
+	sigaction(SIGTERM, &sa, &sa_term_prev);
+	infer_signaled = 0;
+
+	printf("Info : Inference server listening on socket '%s'\n", path);
+	fflush(stdout);
+
+	while(infer_signaled == 0 && stop_req == false) {
+		struct pollfd pfd;
+		pfd.fd = listen_sock;
+		pfd.events = POLLIN;
+		pfd.revents = 0;
+		int z = poll(&pfd, 1, 200);
+		if(z <= 0) continue;
+
+		int sock = accept(listen_sock, NULL, NULL);
+		if(sock < 0) continue;
+
+		conn_t* conn = new conn_t;
+		conn->server = this;
+		conn->fd_in = sock;
+		conn->fd_out = sock;
+
+		pthread_mutex_lock(&mutex);
+		conns.push_back(conn);
+		pthread_mutex_unlock(&mutex);
+
+		pthread_create(&conn->thread, NULL, conn_thread_wrapper, conn);
+		pthread_detach(conn->thread);
+	}
+
+	// Wake up the connection threads, and wait for them to finish
+	pthread_mutex_lock(&mutex);
+	stop_req = true;
+	for(auto conn : conns) shutdown(conn->fd_in, SHUT_RDWR);
+	while(conns.empty() == false) pthread_cond_wait(&cond_conn, &mutex);
+	pthread_mutex_unlock(&mutex);
+
+	close(listen_sock);
+	unlink(path);
+	sigaction(SIGINT, &sa_int_prev, NULL);
+	sigaction(SIGTERM, &sa_term_prev, NULL);
+
+	return 0;
+}
+
+void InferServer::print_stats(void) {
+	printf("Stats inference server :\n");
+	printf("  Requests ...... %" PRIu64 "\n", stat_requests);
+	printf("  Frames ........ %" PRIu64 "\n", stat_frames);
+	if(stat_frames > 0) {
+		double diff = TimeDouble_From64(stat_exec_ns);
+		printf("  Time, exec .... %g s, %g frames/s\n", diff, stat_frames / diff);
+	}
+}
+
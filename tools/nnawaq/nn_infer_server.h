@@ -0,0 +1,125 @@
+
+#pragma once
+
+extern "C" {
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+
+}
+
+#include <vector>
+
+class Network;
+class Layer;
+class HwAcc_Common;
+
+
+//============================================
+// Persistent inference server
+//============================================
+
+// The network is built once, the configuration data is loaded once and the execution engine is prepared once
+// Then requests are served until the end, either from stdin or from clients of a UNIX socket
+//
+// Requests are text lines, frames and results are binary 32-bit values in host endianness
+// All replies begin with a line "ok ..." or "error <message>"
+//   info            Reply : ok mode <sw|hw> fsize <n> outsize <n> maxframes <n>
+//   mode <sw|hw>    Select the execution engine, for hw the current hardware accelerator is used
+//   frames <n>      Followed by n frames, reply : ok <n> <outsize> followed by the n results
+//                   Above maxframes the request is rejected and the connection is closed, because the frames can't be skipped
+//   run <in> <out>  Process the frames file <in>, results are written to file <out> with the usual output options, reply : ok <n>
+//   quit            Close the connection
+//   shutdown        Stop the server
+//
+// With stdin, replies are written to the original stdout and the messages of the program are redirected to stderr
+// With a UNIX socket, clients are served concurrently but requests are executed one at a time
+
+class InferServer {
+
+	public :
+
+	enum mode_type {
+		MODE_SW = 0,
+		MODE_HW = 1,
+	};
+
+	private :
+
+	typedef struct conn_t {
+		InferServer* server = nullptr;
+		int fd_in = -1;
+		int fd_out = -1;
+		pthread_t thread;
+		// Buffered input
+		char     buf[4096];
+		unsigned buf_pos = 0;
+		unsigned buf_len = 0;
+	} conn_t;
+
+	//============================================
+	// Fields
+	//============================================
+
+	Network* network = nullptr;
+	Layer* inlayer = nullptr;
+	Layer* outlayer = nullptr;
+
+	mode_type mode = MODE_SW;
+	bool sw_ready = false;
+	HwAcc_Common* hw_ready = nullptr;  // The accelerator that was prepared
+
+	// Requests are executed one at a time
+	pthread_mutex_t exec_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+	// Connections
+	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+	pthread_cond_t  cond_conn = PTHREAD_COND_INITIALIZER;
+	std::vector<conn_t*> conns;
+	volatile bool stop_req = false;
+
+	// Stats
+	uint64_t stat_requests = 0;
+	uint64_t stat_frames = 0;
+	int64_t  stat_exec_ns = 0;
+
+	//============================================
+	// Methods
+	//============================================
+
+	public :
+
+	InferServer(Network* network);
+	~InferServer();
+
+	// Prepare the execution engine, return non-zero on error
+	int set_mode(mode_type mode);
+	// Serve requests from stdin when path is "-", otherwise from a UNIX socket, until the end of input or until SIGINT or SIGTERM
+	// The engine given by mode_init is prepared first, if negative the default engine is used unless one is already prepared
+	int serve(const char* path, int mode_init = -1);
+
+	private :
+
+	int  serve_stdin(int fd_out);
+	int  serve_socket(const char* path);
+
+	static void* conn_thread_wrapper(void* arg);
+	void conn_loop(conn_t* conn);
+	int  conn_readline(conn_t* conn, char* line, unsigned size);
+	int  conn_read(conn_t* conn, void* data, size_t size);
+	int  conn_write(conn_t* conn, const void* data, size_t size);
+	int  conn_reply(conn_t* conn, const char* fmt, ...);
+	int  request(conn_t* conn, char* line);
+
+	unsigned get_outsize(void);
+	unsigned get_chunk_frames(void);
+	int  exec_frames(const int* frames, unsigned frames_nb, int* out);
+	int  exec_file(const char* filename_in, const char* filename_out, unsigned* frames_nb_p);
+
+	void print_stats(void);
+
+};
+
+extern int param_infer_mode;
+
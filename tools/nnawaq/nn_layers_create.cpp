@@ -13,8 +13,10 @@ extern "C" {
 #include <math.h>
 #include <assert.h>
 #include <time.h>
+#include <pthread.h>
 
 #include "nnawaq_utils.h"
+#include "load_config.h"
 
 }
 
@@ -55,7 +57,9 @@ Layer::~Layer(void) {
 	if(vhdl_prefixl != NULL) free(vhdl_prefixl);
 	if(vhdl_prefixu != NULL) free(vhdl_prefixu);
 	if(cfg_filename != NULL) free(cfg_filename);
-	if(cfg_data != NULL)   { free(cfg_data[0]); free(cfg_data); }
+	if(custom_entity != NULL) free(custom_entity);
+	// Shared configuration data is freed by its last owner
+	if(cfg_data != NULL && cfg_data_shared.get() != cfg_data) { free(cfg_data[0]); free(cfg_data); }
 	if(swexec_output != NULL) free(swexec_output);
 }
 
@@ -144,6 +148,8 @@ Layer* Layer::create_new_from_id(unsigned type_id, const char* type_name) {
 	if(ref_layer == nullptr) return nullptr;
 	// Use a clone method to inherit all custom fields
 	layer_t* layer = ref_layer->clone();
+	// The entity name is owned by each layer, it is freed by the destructor
+	if(ref_layer->custom_entity != nullptr) layer->custom_entity = strdup(ref_layer->custom_entity);
 	int z = layer->params_from_type_name(type_name);
 	if(z != 0) {
 		delete layer;
@@ -541,6 +547,18 @@ LayerFifo::LayerFifo(void) {
 	typenamel = "fifo";
 	typenameu = "FIFO";
 
+}
+LayerRegion::LayerRegion(void) {
+
+	type = LAYER_REGION;
+
+	// FIXME The layer type name should not be set here
+	typenamel = "region";
+	typenameu = "REGION";
+
+	// Anchors of YOLOv2-tiny on COCO
+	anchors = { 0.57273, 0.677385, 1.87446, 2.06253, 3.33843, 5.47434, 7.88282, 3.52778, 9.77052, 9.16828 };
+
 }
 
 void Layer::apply_network_defaults(Network* network) {
@@ -670,6 +688,9 @@ Layer* LayerSoftMax::create_new(void) {
 Layer* LayerFifo::create_new(void) {
 	return new LayerFifo();
 }
+Layer* LayerRegion::create_new(void) {
+	return new LayerRegion();
+}
 
 // Methods to create a new clone of a Layer object
 
@@ -738,6 +759,54 @@ Layer* LayerSoftMax::clone(void) {
 Layer* LayerFifo::clone(void) {
 	return new LayerFifo(*this);
 }
+Layer* LayerRegion::clone(void) {
+	return new LayerRegion(*this);
+}
+
+// Copy of a layer for a cloned network : owned strings are duplicated, and configuration data is shared
+// Links to other layers are set by Network::clone()
+
+// Protects the first sharing of configuration data, so one network can be cloned from several threads
+static pthread_mutex_t cfg_data_share_mutex = PTHREAD_MUTEX_INITIALIZER;
+
+static void cfg_data_free(void* ptr) {
+	int** cfg_data = (int**)ptr;
+	free(cfg_data[0]);
+	free(cfg_data);
+}
+
+Layer* Layer::clone_for_network(Network* network) {
+	if(cfg_data != nullptr) {
+		pthread_mutex_lock(&cfg_data_share_mutex);
+		if(cfg_data_shared.get() != cfg_data) cfg_data_shared.reset((void*)cfg_data, cfg_data_free);
+		pthread_mutex_unlock(&cfg_data_share_mutex);
+	}
+
+	Layer* layer = clone();
+
+	layer->network = network;
+	if(vhdl_prefixl != nullptr) layer->vhdl_prefixl = strdup(vhdl_prefixl);
+	if(vhdl_prefixu != nullptr) layer->vhdl_prefixu = strdup(vhdl_prefixu);
+	if(cfg_filename != nullptr) layer->cfg_filename = strdup(cfg_filename);
+	if(custom_entity != nullptr) layer->custom_entity = strdup(custom_entity);
+
+	// Results of other modules and execution buffers are not copied
+	layer->ptrdata = nullptr;
+	layer->swexec_output = nullptr;
+
+	return layer;
+}
+
+// Get a private copy of shared configuration data, before modifying it
+void Layer::cfg_data_unshare(unsigned nrow, unsigned ncol) {
+	if(cfg_data == nullptr || cfg_data_shared.get() != cfg_data || cfg_data_shared.use_count() <= 1) return;
+	int** data = array_create_dim2(nrow, ncol);
+	memcpy(data[0], cfg_data[0], nrow * ncol * sizeof(**data));
+	cfg_data = data;
+	cfg_nrow = nrow;
+	cfg_ncol = ncol;
+	cfg_data_shared.reset();
+}
 
 // Methods to re-parameterize a new layer (created with create_new or clone) with the user-specified layer name
 
@@ -1332,6 +1401,48 @@ void Network::DeleteSingleton(void) {
 	singleton = nullptr;
 }
 
+Network* Network::clone(void) {
+	// Copy all parameters and counters
+	Network* network = new Network(*this);
+
+	// The state of software execution is not copied
+	network->swexec_bufin = nullptr;
+	network->swexec_bufout = nullptr;
+	network->swexec_recode_tcam = nullptr;
+	network->swexec_layers_cat.clear();
+	network->swexec_capture = nullptr;
+	network->swexec_activity = nullptr;
+	network->swexec_time = nullptr;
+	network->swexec_time_cumul = 0;
+
+	// Copy the layers, then translate the links between layers
+	map<Layer*, Layer*> map_layers;
+	for(unsigned i=0; i<layers.size(); i++) {
+		Layer* layer = layers[i]->clone_for_network(network);
+		network->layers[i] = layer;
+		map_layers[layers[i]] = layer;
+	}
+	auto translate = [&](Layer* layer) { return (layer != nullptr) ? map_layers.at(layer) : nullptr; };
+	for(auto layer : network->layers) {
+		layer->prev = translate(layer->prev);
+		layer->next = translate(layer->next);
+		for(auto& other : layer->arr_layers) other = translate(other);
+	}
+	network->layer_first = translate(layer_first);
+	network->layer_last = translate(layer_last);
+
+	// The decoding layer is not in the vector of layers
+	if(layer_region != nullptr) {
+		network->layer_region = (LayerRegion*)layer_region->clone();
+		network->layer_region->network = network;
+	}
+
+	// Clones are usually edited directly, so cached evaluations are not kept
+	network->cache_invalidate();
+
+	return network;
+}
+
 void Network::clear(void) {
 
 	// Clear the contents of the layers
@@ -1345,11 +1456,14 @@ void Network::clear(void) {
 	layer_first = nullptr;
 	layer_last = nullptr;
 
+	delete layer_region;
+	layer_region = nullptr;
+
 	// Reset other fields
 
 	// FIXMEEEE This variable is out of the scope of this class
-	// Also need to null the global pointer to layers
-	param_out_layer = nullptr;
+	// Also need to null the global pointer to layers, unless it points to another network
+	if(this == singleton || (param_out_layer != nullptr && param_out_layer->network == this)) param_out_layer = nullptr;
 
 	param_cnn_origin = CNN_ORIGIN_SCRIPT;
 
@@ -12,6 +12,8 @@ extern "C" {
 #include <vector>
 #include <map>
 #include <string>
+#include <memory>
+#include <array>
 
 #include "hw_reg_fields.h"
 #include "mem_implem.h"
@@ -49,6 +51,9 @@ extern "C" {
 #define LAYER_NEU_CM 18
 #define LAYER_NORM_CM 19
 
+// Layer for decoding on the host, not implemented in hardware
+#define LAYER_REGION 20
+
 // The pooling type is a special field in the layer structure
 // In HW, the style is given by the layer ID itself
 #define POOL_TYPE_NONE 0
@@ -72,6 +77,7 @@ extern "C" {
 
 // Declaration of type from other source files
 class HwAcc_Common;
+class SwexecActivity;
 
 // Forward declarations
 class Network;
@@ -88,6 +94,25 @@ typedef struct {
 } Latency;
 
 
+//============================================
+// Utility structs to cache evaluations of layers
+//============================================
+
+// Signature of the parameters that are propagated between layers, and of the main hardware parameters
+// It is used to detect changes, see Layer::get_signature()
+typedef std::array<unsigned, 32> LayerSignature;
+
+// Contribution of one layer to the global statistics of the network, see Network::hwconfig_finalize()
+typedef struct {
+	unsigned neurons;
+	unsigned neurons_phy;
+	unsigned multipliers;
+	unsigned long weights;
+	unsigned long weight_bits;
+	unsigned long macs;
+} HwconfigTotals;
+
+
 //============================================
 // Definition of the main NN layer type (virtual class)
 //============================================
@@ -122,6 +147,10 @@ class Layer {
 	unsigned cfg_id       = 0;
 	char*    cfg_filename = nullptr;
 	int **   cfg_data     = nullptr;  // For execution in software
+	unsigned cfg_nrow     = 0;  // Allocated dimensions of the configuration data
+	unsigned cfg_ncol     = 0;
+	// Configuration data can be shared between clones of a network, then it is freed with its last owner
+	std::shared_ptr<void> cfg_data_shared;
 
 	// Fields specific to layer types
 
@@ -227,6 +256,8 @@ class Layer {
 	bool     flow_skip_inbuf = false;
 	// For layers that support it : the additional FIFO margin on output side to allow computation
 	unsigned out_extra_fifo_room = 0;
+	// For FIFO layers : the number of lines, see nn_size_fifos
+	unsigned fifo_depth = 64;
 
 	// For fork / concat layers and similar
 	bool     prev_is_arr = false;
@@ -236,11 +267,22 @@ class Layer {
 	// Stats, activity ratios for neurons
 	double   stat_zd     = 0;  // Ratio of data=0
 	double   stat_nzd_zw = 0;  // Ratio of data!=0 and weight=0
+	double   stat_toggle = -1; // Ratio of data bits that toggle, negative means the default estimation
 
 	// Layer CAT : a temp marker for forward propag
 	// FIXME This should be a private field of the traversal object
 	unsigned cat_cnt_fwd_propag = 0;
 
+	// Dirty tracking : layers edited with nn_layer_set are only updated with their successors, see Network::propag_params_dirty()
+	bool     params_dirty = true;
+	// Cached results of hwconfig_finalize() and eval_latency(), valid as long as the layer is not dirty and its signature is unchanged
+	bool     cache_hwconfig_valid = false;
+	bool     cache_latency_valid = false;
+	LayerSignature cache_hwconfig_sig;
+	LayerSignature cache_latency_sig;
+	HwconfigTotals cache_hwconfig_totals;
+	Latency  cache_latency;
+
 	// Output 3D image
 	unsigned out_fx = 0;
 	unsigned out_fy = 0;
@@ -300,6 +342,8 @@ class Layer {
 	virtual Layer* create_new(void);
 	Layer*         create_new(Network* network);
 	virtual Layer* clone(void);
+	Layer*         clone_for_network(Network* network);
+	void           cfg_data_unshare(unsigned nrow, unsigned ncol);
 
 	virtual int params_from_type_name(char const * type_name = nullptr);
 
@@ -307,12 +351,15 @@ class Layer {
 	virtual bool requires_idxcfg(void) { return false; }
 
 	virtual int propag_params_forward(void);
+	void get_signature(LayerSignature& sig) const;
+	void cache_invalidate(void);
 
 	virtual unsigned long eval_mem_size(void);
 	virtual void eval_latency(Latency& lat) const;
 
 	virtual void print_extra_details(void);
 
+	virtual int  check_par(bool verbose);  // Return the number of errors, does not exit
 	virtual void hwconfig_finalize(void);
 	virtual int  load_config_files(void);
 	virtual int  dump_config_vhdl(void);  // Does nothing, silently
@@ -338,8 +385,9 @@ class Layer {
 	virtual void genvhdl_comp_inst(FILE* Fo);
 
 	// Generate the constant parameters in a VHDL file
+	// The memory lines are generated in range [line_beg, line_end[, so that big layers can be generated in parallel blocks
 	virtual void genvhdl_const_params_vec(FILE* Fo, const char* indent);
-	virtual void genvhdl_const_params_mem(FILE* Fo, const char* indent);
+	virtual void genvhdl_const_params_mem(FILE* Fo, const char* indent, unsigned line_beg, unsigned line_end);
 
 	virtual int swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer);
 
@@ -411,6 +459,7 @@ class LayerWin : public Layer {
 
 	void print_extra_details(void);
 
+	int  check_par(bool verbose);
 	void hwconfig_finalize(void);
 
 	void write_config_regs(std::vector<uint32_t>& accreg_cfgnn);
@@ -498,6 +547,7 @@ class LayerNeu : public Layer {
 
 	void print_extra_details(void);
 
+	int  check_par(bool verbose);
 	void hwconfig_finalize(void);
 	int  load_config_files(void);
 	int  dump_config_vhdl(void);
@@ -522,7 +572,7 @@ class LayerNeu : public Layer {
 
 	// Generate the constant parameters in a VHDL file
 	void genvhdl_const_params_vec(FILE* Fo, const char* indent);
-	void genvhdl_const_params_mem(FILE* Fo, const char* indent);
+	void genvhdl_const_params_mem(FILE* Fo, const char* indent, unsigned line_beg, unsigned line_end);
 
 	int swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer);
 
@@ -581,6 +631,7 @@ class LayerNeu_CM : public Layer {
 
 	void print_extra_details(void);
 
+	int  check_par(bool verbose);
 	void hwconfig_finalize(void);
 	int  load_config_files(void);
 	int  dump_config_vhdl(void);
@@ -605,7 +656,7 @@ class LayerNeu_CM : public Layer {
 
 	// Generate the constant parameters in a VHDL file
 	void genvhdl_const_params_vec(FILE* Fo, const char* indent);
-	void genvhdl_const_params_mem(FILE* Fo, const char* indent);
+	void genvhdl_const_params_mem(FILE* Fo, const char* indent, unsigned line_beg, unsigned line_end);
 
 	int swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer);
 
@@ -743,7 +794,7 @@ class LayerNorm : public Layer {
 
 	// Generate the constant parameters in a VHDL file
 	void genvhdl_const_params_vec(FILE* Fo, const char* indent);
-	void genvhdl_const_params_mem(FILE* Fo, const char* indent);
+	void genvhdl_const_params_mem(FILE* Fo, const char* indent, unsigned line_beg, unsigned line_end);
 
 	int swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer);
 
@@ -824,7 +875,7 @@ class LayerTernarize : public Layer {
 
 	// Generate the constant parameters in a VHDL file
 	void genvhdl_const_params_vec(FILE* Fo, const char* indent);
-	void genvhdl_const_params_mem(FILE* Fo, const char* indent);
+	void genvhdl_const_params_mem(FILE* Fo, const char* indent, unsigned line_beg, unsigned line_end);
 
 	int swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer);
 
@@ -1312,6 +1363,56 @@ class LayerFifo : public Layer {
 
 };
 
+// One detection decoded by the layer REGION
+typedef struct {
+	unsigned frame;
+	unsigned cls;    // Index of the most probable class
+	float    score;  // Objectness multiplied by the probability of the class
+	float    x, y;   // Center of the box, in pixels
+	float    w, h;   // Size of the box, in pixels
+} RegionBox;
+
+// Decoding of YOLO region outputs : the output frame of the network is a grid of cells, with Z dimension boxes * (5 + classes)
+// For each box, the values are tx, ty, tw, th, objectness, then the scores of the classes
+// Values are dequantized as value * scale / 2^shift
+// This layer is not part of the hardware pipeline : it is attached to the network and applied on the host to the outputs
+// of software execution and of the hardware accelerator, see nn_region
+// Only the boxes with score above the threshold are kept, the others are rejected before any floating-point computation
+class LayerRegion : public Layer {
+
+	public :
+
+	// Parameters
+	unsigned boxes_nb   = 5;
+	unsigned classes_nb = 80;
+	std::vector<float> anchors;  // Width and height of each box, in grid cells
+	unsigned shift      = 0;
+	double   scale      = 1;
+	unsigned img_size   = 416;   // Size of the input image in pixels, to obtain the stride of the grid
+	double   thresh     = 0.5;
+
+	// Constructor / Destructor
+
+	LayerRegion(void);
+	//~LayerRegion(void) {}
+
+	// Methods
+
+	Layer* create_new(void);
+	Layer* clone(void);
+
+	void print_extra_details(void);
+
+	// Return true if the outputs of this layer are decoded into boxes, instead of being written as raw values
+	bool decodes(layer_t* outlayer) const;
+	// Decode a batch of contiguous frames, taken every frame_stride values, the boxes are appended to the vector
+	int  decode(layer_t* outlayer, const int* buf, unsigned frames_nb, unsigned frame_stride, unsigned frame_first, std::vector<RegionBox>& boxes) const;
+	void write_boxes(FILE* F, const std::vector<RegionBox>& boxes) const;
+
+	int swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer);
+
+};
+
 
 //============================================
 // Definition of the neural network
@@ -1319,7 +1420,8 @@ class LayerFifo : public Layer {
 
 class Network {
 
-	// Only one network is allowed for now
+	// The singleton is the network that the command-line and Tcl commands operate on
+	// Other networks are owned by sessions of the embeddable library
 
 	private :
 	static Network* singleton;
@@ -1327,15 +1429,22 @@ class Network {
 	public :
 	static Network* GetSingleton(void);
 	static void DeleteSingleton(void);
+	// Replace the singleton temporarily, return the previous one
+	static inline Network* GetAndSetSingleton(Network* network) {
+		Network* prev = singleton;
+		singleton = network;
+		return prev;
+	}
 
 	// Constructor / Destructor
 
-	private :
-	Network(void) {}
-
 	public :
+	Network(void) {}
 	~Network(void) {}
 
+	// Deep copy of the network, configuration data is shared until it is modified
+	Network* clone(void);
+
 	// Default parameters
 
 	// Parameters for compression
@@ -1435,6 +1544,9 @@ class Network {
 	// FIXME This parameter could/should also be set on a per-layer basis ?
 	// FIXME This parameter is not applied to layers NORM, TER, etc
 	bool     hwconfig_bram_opt_speed = false;
+	// Pack small memories of several layers in shared BRAM and URAM blocks, see mem_pack()
+	// FIXME This is only an evaluation, the VHDL components still have one memory per bank
+	bool     hwconfig_mem_pack = false;
 
 	// To perform some evaluations and generation tasks in a more ASIC-friendly mode
 	bool hwconfig_asicmode = false;
@@ -1478,8 +1590,29 @@ class Network {
 	// Memory size
 	unsigned total_bram18 = 0;
 	unsigned total_lutram = 0;
+	unsigned total_bram18_packed = 0;  // Estimation with packing of small memories, see mem_pack()
 	unsigned total_regs   = 0;
 
+	// State of frame-by-frame software execution, see swexec_begin()
+	bool     swexec_opt_tcam = false;
+	bool     swexec_opt_gen_in = false;
+	bool     swexec_opt_quiet = false;  // Do not report overflows and resized outputs
+	int*     swexec_bufin = nullptr;
+	int*     swexec_bufout = nullptr;
+	int**    swexec_recode_tcam = nullptr;
+	std::vector<layer_t*> swexec_layers_cat;
+	// When not NULL, results are copied there instead of being printed
+	int*     swexec_capture = nullptr;
+	// When not NULL, activity statistics are collected, see swexec_activity()
+	SwexecActivity* swexec_activity = nullptr;
+	// When not NULL, the execution time of each layer is cumulated there, see swexec_layer_times()
+	std::vector<int64_t>* swexec_time = nullptr;
+	// Total time measured for all layers, to exclude the time of branches from the time of layers FORK and SCATTER
+	int64_t  swexec_time_cumul = 0;
+
+	// When not NULL, the outputs are decoded into boxes on the host, see nn_region
+	LayerRegion* layer_region = nullptr;
+
 	// Methods
 
 	Layer* layer_new_fromtype(int type_id, char const * type_name = nullptr);
@@ -1495,6 +1628,8 @@ class Network {
 	layer_t* getlayer_from_hwid(unsigned hwid);
 
 	int propag_params(void);
+	int propag_params_dirty(void);
+	void cache_invalidate(void);
 	int insert_fifos(void);
 	void layers_reorder(void);
 	int check_integrity(void);
@@ -1502,8 +1637,13 @@ class Network {
 	unsigned long eval_latency(void) const;
 
 	void hwconfig_finalize(void);
+	unsigned mem_pack(void);
 	int  load_config_files(void);
 
+	// Binary snapshot of the network, see nn_snapshot.h
+	int  snapshot_save(const char* filename, bool with_cfg_data);
+	int  snapshot_load(const char* filename);
+
 	void genvhdl_set_config_regs_numbers(void);
 	void genvhdl_cst_decl(FILE* Fo);
 	void genvhdl_comp_decl(FILE* Fo);
@@ -1365,11 +1365,69 @@ int LayerFifo::propag_params_forward(void) {
 	return 0;
 }
 
+void Layer::get_signature(LayerSignature& sig) const {
+	unsigned i = 0;
+
+	// Input image
+	sig[i++] = fx;
+	sig[i++] = fy;
+	sig[i++] = fz;
+	sig[i++] = fsize;
+	sig[i++] = nbframes;
+	sig[i++] = wdata;
+	sig[i++] = sdata;
+	sig[i++] = split_in;
+	sig[i++] = cycles;
+
+	// Output image
+	sig[i++] = out_fx;
+	sig[i++] = out_fy;
+	sig[i++] = out_fz;
+	sig[i++] = out_fsize;
+	sig[i++] = out_nbframes;
+	sig[i++] = out_wdata;
+	sig[i++] = out_sdata;
+	sig[i++] = split_out;
+	sig[i++] = out_cycles;
+	sig[i++] = out_cycles_real;
+
+	// Main hardware parameters
+	sig[i++] = neurons;
+	sig[i++] = neurons_max;
+	sig[i++] = neu_wweight;
+	sig[i++] = neu_time_mux;
+	sig[i++] = ((unsigned)(unsigned char)neu_sgnd << 8) | (unsigned char)neu_sgnw;
+	sig[i++] = win_par_oz;
+	sig[i++] = win_dwconv;
+	sig[i++] = bufy;
+	sig[i++] = user_wout;
+	sig[i++] = mem.style;
+	sig[i++] = mem.opt_speed;
+	sig[i++] = fifo_depth;
+	sig[i++] = prev_is_arr ? arr_layers.size() : 0;
+
+	// Paranoia
+	if(i != sig.size()) abort();
+}
+
+void Layer::cache_invalidate(void) {
+	cache_hwconfig_valid = false;
+	cache_latency_valid = false;
+}
+
+void Network::cache_invalidate(void) {
+	for(auto layer : layers) layer->cache_invalidate();
+}
+
 // Propagate parameters from previous layer
-// FIXME This should return something to indicate that an update was actually done, in order to stop propagation through layers
+// Return non-zero if the layer was updated, to stop propagation through the next layers otherwise
 // FIXME This should not modify the next layer split_in
 static int propag_params_layer_internal(Network* network, layer_t* layer) {
 
+	// Signature before update, to detect changes
+	LayerSignature sig_before;
+	layer->get_signature(sig_before);
+
 	// Get the previous and next layers, if any
 	layer_t* layer_prev = layer->prev;
 	layer_t* layer_next = layer->next;
@@ -1430,7 +1488,16 @@ static int propag_params_layer_internal(Network* network, layer_t* layer) {
 	}
 	else if(layer_next!=nullptr) layer_next->split_in = layer->split_out;
 
-	return 0;
+	// Detect changes, cached evaluations are now obsolete
+	LayerSignature sig_after;
+	layer->get_signature(sig_after);
+	bool changed = sig_after != sig_before;
+	if(changed == true || layer->params_dirty == true) {
+		layer->cache_invalidate();
+	}
+	layer->params_dirty = false;
+
+	return changed;
 }
 
 int propag_params_layer(Network* network, layer_t* layer) {
@@ -1443,6 +1510,9 @@ int propag_params_layer(Network* network, layer_t* layer) {
 
 int Network::propag_params(void) {
 
+	// Layer fields may have been edited directly, so nothing is kept from cached evaluations
+	cache_invalidate();
+
 	// Clear traversal flags
 	for(auto layer : layers) {
 		layer->cat_cnt_fwd_propag = 0;
@@ -1476,6 +1546,55 @@ int Network::propag_params(void) {
 	return 0;
 }
 
+// Incremental version of propag_params() : only the dirty layers are updated, and their successors as long as they change
+// Layers FORK, SCATTER propagate to all their successors, layers CAT, GATHER are updated if any of their predecessors has changed
+// Return the number of layers that were updated
+int Network::propag_params_dirty(void) {
+
+	// Clear traversal flags
+	for(auto layer : layers) {
+		layer->cat_cnt_fwd_propag = 0;
+	}
+
+	// The layers that have changed during this traversal
+	vector<bool> changed(layers.size(), false);
+	unsigned updated_nb = 0;
+
+	// Note : can't use type "auto" for this lambda function because it is recursive and needs its return type to be deduced before usage
+	std::function<void(layer_t* layer)> propag_params_recurs = [&](layer_t* layer) -> void {
+		while(layer != nullptr) {
+			bool update = layer->params_dirty;
+			// The layer CAT is processed only once all its predecessors have been processed
+			if(layer->prev_is_arr == true) {
+				layer->cat_cnt_fwd_propag ++;
+				if(layer->cat_cnt_fwd_propag < layer->arr_layers.size()) return;
+				for(auto layer_prev : layer->arr_layers) update = update || changed[layer_prev->index];
+			}
+			else if(layer->prev != nullptr) {
+				update = update || changed[layer->prev->index];
+			}
+			// Update the local layer
+			if(update == true) {
+				changed[layer->index] = propag_params_layer_internal(this, layer);
+				updated_nb++;
+			}
+			// Traverse all successors of the layer FORK
+			if(layer->next_is_arr == true) {
+				for(auto layer_next : layer->arr_layers) {
+					propag_params_recurs(layer_next);
+				}
+			}
+			// Continue traversal of the current chain of layers
+			layer = layer->next;
+		}
+	};
+
+	// Propagate through next layers
+	propag_params_recurs(layer_first);
+
+	return updated_nb;
+}
+
 //============================================
 // Manipulate number of output neurons
 //============================================
@@ -1533,7 +1652,8 @@ unsigned maxcycles_per_layer(Network* network) {
 
 // FIXME This should be extensible, be member function of Layer* of some sort
 // Apply the required parallelism to reach the desired number of clock cycles
-static unsigned apply_parallelism_maxcy(Network* network, unsigned cycles_target) {
+// Return the new max number of cycles per layer, or zero if a legal parallelism could not be found
+unsigned apply_parallelism_maxcy(Network* network, unsigned cycles_target, bool verbose) {
 	unsigned maxcy = 0;
 	unsigned changes_nb = 0;
 
@@ -1551,20 +1671,24 @@ static unsigned apply_parallelism_maxcy(Network* network, unsigned cycles_target
 
 				// FIXME Explicitly skip layers whose PAR is decided previously at WIN layer
 				// FIXME For WIN layers followed by POOL, mark them as DWConv, this will reduce the amount of times we have to search for previous/next layers
+				// Note : PAR_IN is first saturated to the dimension it must divide, otherwise the divisor search is skipped and the illegal value reaches propagation, which exits
 
 				if(layer->type == LAYER_NEU) {
 					// DWConv : Adjust to a divisor of FZ
 					if(layer->win_dwconv == true) {
+						if(layer->fz > 0 && pari > layer->fz) pari = layer->fz;
 						for( ; pari <= layer->fz; pari++) if(layer->fz % pari == 0) break;
 					}
 					// Adjust to a divisor of the frame size
 					else {
+						if(layer->fsize_max > 0 && pari > layer->fsize_max) pari = layer->fsize_max;
 						for( ; pari <= layer->fsize_max; pari++) if(layer->fsize_max % pari == 0) break;
 					}
 				}
 				// Adjust to a divisor of FZ
 				// Note : reaching this is normally already handled in the previous WIN layer
 				if(layer->type == LAYER_POOL) {
+					if(layer->fz_max > 0 && pari > layer->fz_max) pari = layer->fz_max;
 					for( ; pari <= layer->fz_max; pari++) if(layer->fz_max % pari == 0) break;
 				}
 				// Adjust to a divisor of the frame size on Z
@@ -1575,20 +1699,20 @@ static unsigned apply_parallelism_maxcy(Network* network, unsigned cycles_target
 					unsigned prev_pi = layer->split_in;
 					layer->split_in = pari;
 					propag_backward_par(network, layer);
-					printf("Note : layer %s%u : Increasing PAR_IN %u -> %u (requested is %u)\n", layer->typenamel, layer->typeidx, prev_pi, layer->split_in, pari);
+					if(verbose == true) printf("Note : layer %s%u : Increasing PAR_IN %u -> %u (requested is %u)\n", layer->typenamel, layer->typeidx, prev_pi, layer->split_in, pari);
 					if(layer->split_in != pari) {
 						// We can still continue if the PAR value is at least legal
 						// FIXME This check does not apply to DWConv layers
 						if(layer->type == LAYER_NEU && layer->win_dwconv == false) {
 							if(layer->fsize_max % layer->split_in != 0) {
-								printf("Error : layer %s%u : The parameter PAR_IN could not be computed automatically\n", layer->typenamel, layer->typeidx);
-								exit(EXIT_FAILURE);
+								if(verbose == true) printf("Error : layer %s%u : The parameter PAR_IN could not be computed automatically\n", layer->typenamel, layer->typeidx);
+								return 0;
 							}
 						}
 					}
 					// Print saturation
 					if(layer->split_in < pari) {
-						printf("Warning : layer %s%u : Saturating PAR_IN to %u\n", layer->typenamel, layer->typeidx, layer->split_in);
+						if(verbose == true) printf("Warning : layer %s%u : Saturating PAR_IN to %u\n", layer->typenamel, layer->typeidx, layer->split_in);
 					}
 				}
 			}
@@ -1603,7 +1727,7 @@ static unsigned apply_parallelism_maxcy(Network* network, unsigned cycles_target
 						}
 						else {
 							paro = layer->win_par_oz;
-							printf("Warning : layer %s%u : Saturating PAR_OUT to %u\n", layer->typenamel, layer->typeidx, paro);
+							if(verbose == true) printf("Warning : layer %s%u : Saturating PAR_OUT to %u\n", layer->typenamel, layer->typeidx, paro);
 						}
 					}
 					else {
@@ -1612,7 +1736,7 @@ static unsigned apply_parallelism_maxcy(Network* network, unsigned cycles_target
 						}
 						else {
 							paro = layer->neurons_max;
-							printf("Warning : layer %s%u : Saturating PAR_OUT to %u\n", layer->typenamel, layer->typeidx, paro);
+							if(verbose == true) printf("Warning : layer %s%u : Saturating PAR_OUT to %u\n", layer->typenamel, layer->typeidx, paro);
 						}
 					}
 				}
@@ -1623,7 +1747,7 @@ static unsigned apply_parallelism_maxcy(Network* network, unsigned cycles_target
 					}
 					else {
 						paro = layer->split_in;
-						printf("Warning : layer %s%u : Saturating PAR_OUT to %u\n", layer->typenamel, layer->typeidx, paro);
+						if(verbose == true) printf("Warning : layer %s%u : Saturating PAR_OUT to %u\n", layer->typenamel, layer->typeidx, paro);
 					}
 				}
 				// Sliding window layer
@@ -1635,9 +1759,9 @@ static unsigned apply_parallelism_maxcy(Network* network, unsigned cycles_target
 				layer->split_out = paro;
 				propag_forward_par(network, layer);
 				// Print saturation
-				printf("Note : layer %s%u : Increasing PAR_OUT %u -> %u (requested is %u)\n", layer->typenamel, layer->typeidx, prev_po, layer->split_out, paro);
+				if(verbose == true) printf("Note : layer %s%u : Increasing PAR_OUT %u -> %u (requested is %u)\n", layer->typenamel, layer->typeidx, prev_po, layer->split_out, paro);
 				if(layer->split_out < paro) {
-					printf("Warning : layer %s%u : Saturating PAR_OUT to %u\n", layer->typenamel, layer->typeidx, layer->split_out);
+					if(verbose == true) printf("Warning : layer %s%u : Saturating PAR_OUT to %u\n", layer->typenamel, layer->typeidx, layer->split_out);
 				}
 				// Count changes
 				changes_nb++;
@@ -1665,7 +1789,7 @@ static unsigned apply_parallelism_maxcy(Network* network, unsigned cycles_target
 
 // Apply the required parallelism to reach the desired number of clock cycles
 // If the target is zero, it means maximum multiplexing desired
-static unsigned apply_time_mux_maxcy(Network* network, unsigned cycles_max) {
+unsigned apply_time_mux_maxcy(Network* network, unsigned cycles_max, bool verbose) {
 
 	auto& layers = network->layers;
 	for(auto layer : layers) {
@@ -1699,7 +1823,7 @@ static unsigned apply_time_mux_maxcy(Network* network, unsigned cycles_max) {
 			}
 		}
 		if(tmux <= 1) continue;
-		printf("Note : layer %s%u : cycles_in %u, multiplexing factor %u\n", layer->typenamel, layer->typeidx, layer->cycles, tmux);
+		if(verbose == true) printf("Note : layer %s%u : cycles_in %u, multiplexing factor %u\n", layer->typenamel, layer->typeidx, layer->cycles, tmux);
 
 		// Apply
 		layer_prev->win_repeat = tmux;
@@ -1722,6 +1846,7 @@ void apply_parallelism(Network* network, unsigned par) {
 
 	unsigned cycles_prev = cycles;
 	cycles = apply_parallelism_maxcy(network, cycles_target);
+	if(cycles == 0) exit(EXIT_FAILURE);
 
 	printf("Parallelism: got max %u cycles/layer, speedup %f\n", cycles, (double)cycles_prev/cycles);
 }
@@ -1746,7 +1871,7 @@ void apply_time_mux_max(Network* network) {
 	printf("Time multiplexing done\n");
 }
 
-void apply_parin_with_time_mux(Network* network) {
+void apply_parin_with_time_mux(Network* network, bool verbose) {
 	//unsigned cycles = maxcycles_per_layer(network);
 
 	auto& layers = network->layers;
@@ -1824,7 +1949,7 @@ void apply_parin_with_time_mux(Network* network) {
 		layer->neu_time_mux *= factor_want;
 		layer->split_in     *= factor_want;
 
-		printf("Note : layer %s%u : Increasing PAR_IN %u -> %u and TMUX %u -> %u to reduce the number of physical neurons\n",
+		if(verbose == true) printf("Note : layer %s%u : Increasing PAR_IN %u -> %u and TMUX %u -> %u to reduce the number of physical neurons\n",
 			layer->typenamel, layer->typeidx, save_par_in, layer->split_in, save_tmux, layer->neu_time_mux
 		);
 
@@ -1956,7 +2081,7 @@ int Network::insert_fifos(void) {
 			layer_next->flow_skip_inbuf = true;
 		}
 		// Warn about excessive extra fifo room that could exceed the fifo depth when added to the internal margin taken by the component
-		// FIXME Actually need to change the FIFO depth according to the layer latency and the extra fifo room
+		// Note : The command nn_size_fifos adapts the FIFO depth to the layer latency and the extra fifo room
 		if(layer->out_extra_fifo_room > 48) {
 			printf("WARNING %s%u : The extra fifo room margin is probably excessive (%u), the design may not be functional\n", layer->typenameu, layer->typeidx, layer->out_extra_fifo_room);
 		}
@@ -2289,9 +2414,16 @@ unsigned long Network::eval_latency(void) const {
 	// Latency results, after each layer
 	vector<pair<unsigned long, unsigned long> > latency_cumul(layers.size());
 
-	// Eval latency of all layers
+	// Eval latency of all layers, or get the cached result
 	for(auto layer : layers) {
-		layer->eval_latency(latency_layer[layer->index]);
+		LayerSignature sig;
+		layer->get_signature(sig);
+		if(layer->cache_latency_valid == false || layer->params_dirty == true || sig != layer->cache_latency_sig) {
+			layer->eval_latency(layer->cache_latency);
+			layer->cache_latency_sig = sig;
+			layer->cache_latency_valid = true;
+		}
+		latency_layer[layer->index] = layer->cache_latency;
 	}
 
 	// Clear traversal flags
@@ -2514,6 +2646,11 @@ void LayerSoftMax::print_extra_details(void) {
 	printf("fsize %u/%u", fsize, fsize_max);
 }
 
+void LayerRegion::print_extra_details(void) {
+	printf("boxes %u classes %u shift %u scale %g img %u thresh %g anchors", boxes_nb, classes_nb, shift, scale, img_size, thresh);
+	for(auto a : anchors) printf(" %g", a);
+}
+
 // Raw print, one line per layer
 
 int nnprint_oneline_layer(layer_t* layer, const char* indent) {
@@ -2854,6 +2991,84 @@ int nnprint(const vector<layer_t*>& layers, unsigned options, unsigned layer_typ
 }
 
 
+//============================================
+// Packing of small memories
+//============================================
+
+// Memories that are only accessed through one port during inference, so the other port of the block is free
+// FIXME This deserves a field or method in Layer class
+static bool mem_pack_layer_allowed(Layer* layer) {
+	return
+		layer->type == LAYER_NEU || layer->type == LAYER_NEU_CM ||
+		layer->type == LAYER_NORM || layer->type == LAYER_TER ||
+		layer->type == LAYER_SCATTER || layer->type == LAYER_GATHER;
+}
+
+// Number of blocks of each bank that have one port free, and half of the address space free
+// Wide banks use blocks with both ports for the full width, only the remaining columns can leave one port free
+static unsigned mem_pack_bank_items(const MemImplem& mem) {
+	if(mem.num == 0 || mem.blocks % mem.num != 0) return 0;
+	unsigned blocks_bank = mem.blocks / mem.num;
+	unsigned lines = uint_rndpow2_ceil(mem.lines);
+	if(mem.style == MemImplem::STYLE_BRAM) {
+		// The shape of the blocks must be 512 lines x 36 bits, or narrower with one block per bank
+		if(blocks_bank != (mem.width + 35) / 36) return 0;
+		if(blocks_bank > 1 && mem.lines > 512) return 0;
+		// Aspect ratios of one port of bram18k in true dual port mode
+		unsigned width = mem.width % 36;
+		if(width == 0 || width > 18) return 0;
+		unsigned port_lines = 1024;
+		if(width <= 1) port_lines = 16384;
+		else if(width <= 2) port_lines = 8192;
+		else if(width <= 4) port_lines = 4096;
+		else if(width <= 9) port_lines = 2048;
+		return (lines <= port_lines / 2) ? 1 : 0;
+	}
+	if(mem.style == MemImplem::STYLE_URAM) {
+		// Each port has the full width
+		if(blocks_bank != (mem.width + 71) / 72) return 0;
+		return (lines <= 4096 / 2) ? blocks_bank : 0;
+	}
+	return 0;
+}
+
+// Blocks with one port free are packed by pairs, one per port of the block, each in one half of the address space
+// Blocks are paired in the order of the layers, so paired memories are close in the pipeline
+// The shared block is attributed to the first memory of the pair
+// The packing is not implemented in the generated VHDL, so the result is only an estimation, kept apart from total_bram18
+// Return the total number of bram18k blocks after packing
+unsigned Network::mem_pack(void) {
+	unsigned pending_bram = 0;
+	unsigned pending_uram = 0;
+
+	total_bram18 = 0;
+	total_lutram = 0;
+	total_bram18_packed = 0;
+
+	for(auto layer : layers) {
+		layer->eval_mem_size();
+		layer->mem.EvalBlocks(hwconfig_lut_threshold, hwconfig_use_uram);
+
+		auto& mem = layer->mem;
+		unsigned items = 0;
+		if(hwconfig_mem_pack == true && mem_pack_layer_allowed(layer) == true) items = mem_pack_bank_items(mem) * mem.num;
+		if(items > 0) {
+			unsigned& pending = (mem.style == MemImplem::STYLE_BRAM) ? pending_bram : pending_uram;
+			for(unsigned i=0; i<items; i++) {
+				if(pending > 0) mem.blocks_packed--;
+				pending = 1 - pending;
+			}
+		}
+
+		if(mem.style == MemImplem::STYLE_BRAM) total_bram18 += mem.blocks;
+		if(mem.style == MemImplem::STYLE_BRAM) total_bram18_packed += mem.blocks_packed;
+		if(mem.style == MemImplem::STYLE_LUTRAM) total_lutram += mem.blocks;
+	}
+
+	return total_bram18_packed;
+}
+
+
 //============================================
 // Print network memory usage
 //============================================
@@ -2908,7 +3123,7 @@ unsigned long LayerGather::eval_mem_size(void) {
 }
 
 unsigned long LayerFifo::eval_mem_size(void) {
-	mem.lines = 64;  // FIXME Hardcoded FIFO size
+	mem.lines = fifo_depth;
 	mem.width = wdata * split_out;
 	mem.num   = 1;
 	return mem.EvalSizeTotal();
@@ -2979,6 +3194,10 @@ class nnprint_mem_table_t {
 	unsigned total_num_bram = 0;
 	unsigned total_num_uram = 0;
 
+	// Number of HW blocks when small memories share blocks
+	unsigned total_packed_bram = 0;
+	unsigned total_packed_uram = 0;
+
 	// Extra options
 	unsigned options;
 
@@ -3019,10 +3238,12 @@ void nnprint_mem_table_t::init_addlayer(layer_t* layer) {
 	else if(layer->mem.style == MemImplem::STYLE_BRAM) {
 		total_size_bram += size;
 		total_num_bram += layer->mem.blocks;
+		total_packed_bram += layer->mem.blocks_packed;
 	}
 	else if(layer->mem.style == MemImplem::STYLE_URAM) {
 		total_size_uram += size;
 		total_num_uram += layer->mem.blocks;
+		total_packed_uram += layer->mem.blocks_packed;
 	}
 	else total_size_other += size;
 
@@ -3192,6 +3413,14 @@ void nnprint_mem_table_t::print_total(void) {
 		printf("Total memory blocks : %*u %s\n", width_size, i.second, i.first);
 	}
 
+	// Blocks saved by packing of small memories
+	if(total_packed_bram < total_num_bram) {
+		printf("Total memory blocks : %*u bram after packing of small memories\n", width_size, total_packed_bram);
+	}
+	if(total_packed_uram < total_num_uram) {
+		printf("Total memory blocks : %*u uram after packing of small memories\n", width_size, total_packed_uram);
+	}
+
 }
 
 // Main pretty-print functions
@@ -3235,6 +3464,10 @@ int nnprint_mem(const vector<layer_t*>& layers, unsigned options, unsigned layer
 		return 0;
 	}
 
+	// Evaluate the sharing of blocks between layers
+	Network* network = layers.empty() ? nullptr : layers[0]->network;
+	if(network != nullptr && network->hwconfig_mem_pack == true) network->mem_pack();
+
 	nnprint_mem_table_t printobj;
 	printobj.options = options;
 
@@ -3370,9 +3603,14 @@ bool         param_out_mask = false;
 
 bool param_freerun = false;
 bool param_hw_blind = false;
+bool param_hw_lowlat = false;
+bool param_hw_hugepages = false;
 bool param_floop = false;
 unsigned param_bufsz_mb = 128;
 
+unsigned      param_bufsz_auto = BUFSZ_AUTO_NONE;
+unsigned long param_bufsz_lat_us = 0;
+
 bool param_print_time = false;
 
 // Ensure the output file is opened
@@ -3455,3 +3693,19 @@ int decodeparam_us(const char* str, unsigned long *us_p) {
 	return 0;
 }
 
+// Objective for auto-tuning of batch size : none, fps, or a latency target with time unit
+int decodeparam_bufsz_auto(const char* str, unsigned* mode_p, unsigned long *us_p) {
+	unsigned mode = BUFSZ_AUTO_NONE;
+	unsigned long us = 0;
+	if     (strcasecmp(str, "none") == 0) mode = BUFSZ_AUTO_NONE;
+	else if(strcasecmp(str, "fps") == 0)  mode = BUFSZ_AUTO_FPS;
+	else {
+		int z = decodeparam_us(str, &us);
+		if(z != 0 || us == 0) return 1;
+		mode = BUFSZ_AUTO_LAT;
+	}
+	if(mode_p != NULL) *mode_p = mode;
+	if(us_p != NULL) *us_p = us;
+	return 0;
+}
+
@@ -58,9 +58,18 @@ extern int  param_rand_max;
 
 extern bool param_freerun;
 extern bool param_hw_blind;
+extern bool param_hw_lowlat;
+extern bool param_hw_hugepages;
 extern bool param_floop;
 extern unsigned param_bufsz_mb;
 
+// Auto-tuning of the number of frames per batch sent to the HW accelerator
+#define BUFSZ_AUTO_NONE 0
+#define BUFSZ_AUTO_FPS  1  // Objective is max frames/s
+#define BUFSZ_AUTO_LAT  2  // Objective is a p99 latency target
+extern unsigned      param_bufsz_auto;
+extern unsigned long param_bufsz_lat_us;
+
 extern bool param_print_time;
 
 extern FILE*    Fo;
@@ -103,10 +112,12 @@ int propag_params_layer(Network* network, layer_t* layer);
 void apply_outneu(Network* network, unsigned nbneu);
 
 unsigned maxcycles_per_layer(Network* network);
+unsigned apply_parallelism_maxcy(Network* network, unsigned cycles_target, bool verbose = true);
+unsigned apply_time_mux_maxcy(Network* network, unsigned cycles_max, bool verbose = true);
 void apply_parallelism(Network* network, unsigned par);
 void apply_time_mux(Network* network);
 void apply_time_mux_max(Network* network);
-void apply_parin_with_time_mux(Network* network);
+void apply_parin_with_time_mux(Network* network, bool verbose = true);
 
 void chkoutfile();
 void chknonempty(Network* network);
@@ -114,5 +125,6 @@ void chknonempty(Network* network);
 int decodeparam_width_sign(const char* str, unsigned* width_p, bool* sign_bool_p, unsigned* sign_uint_p);
 int decodeparam_ms(const char* str, long unsigned *ms_p);
 int decodeparam_us(const char* str, long unsigned *us_p);
+int decodeparam_bufsz_auto(const char* str, unsigned* mode_p, long unsigned *us_p);
 
 
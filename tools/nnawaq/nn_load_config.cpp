@@ -264,6 +264,8 @@ int layer_loadcfg(layer_t* layer, unsigned nrow, unsigned ncol, unsigned alloc_n
 	if(alloc_nrow < nrow) alloc_nrow = nrow;
 	if(alloc_ncol < ncol) alloc_ncol = ncol;
 	layer->cfg_data = array_create_dim2(alloc_nrow, alloc_ncol);
+	layer->cfg_nrow = alloc_nrow;
+	layer->cfg_ncol = alloc_ncol;
 	// Load from the specified file
 	return loadfile(layer->cfg_data, layer->cfg_filename, nrow, ncol, param_multiline);
 }
@@ -272,6 +274,8 @@ int layer_loadcfg_or_random(layer_t* layer, unsigned nrow, unsigned ncol, unsign
 	if(alloc_nrow < nrow) alloc_nrow = nrow;
 	if(alloc_ncol < ncol) alloc_ncol = ncol;
 	layer->cfg_data = array_create_dim2(alloc_nrow, alloc_ncol);
+	layer->cfg_nrow = alloc_nrow;
+	layer->cfg_ncol = alloc_ncol;
 
 	// In case of missing config file, use random data
 	if(layer->cfg_filename==NULL) {
@@ -669,6 +673,8 @@ int LayerScatter::load_config_files(void) {
 	// In case of missing config file, random data is used, no checks needed
 	if(cfg_filename==NULL) {
 		cfg_data = array_create_dim2(fsize, arr_layers.size());
+		cfg_nrow = fsize;
+		cfg_ncol = arr_layers.size();
 		// Clear
 		memset(cfg_data[0], 0, fsize * arr_layers.size() * sizeof(cfg_data[0][0]));
 		// Initialize as many flags at 1 as necessary to match the successor fsize
@@ -721,6 +727,8 @@ int LayerGather::load_config_files(void) {
 	// In case of missing config file, random data is used, no checks needed
 	if(cfg_filename==NULL) {
 		cfg_data = array_create_dim2(out_fsize, arr_layers.size());
+		cfg_nrow = out_fsize;
+		cfg_ncol = arr_layers.size();
 		// Clear
 		memset(cfg_data[0], 0, out_fsize * arr_layers.size() * sizeof(cfg_data[0][0]));
 		// Initialize as many flags at 1 as necessary to match the successor fsize
@@ -0,0 +1,340 @@
+
+// Output writer for results of software execution and HW accelerator
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <sys/uio.h>
+
+#include "nnawaq_utils.h"
+
+}
+
+#include "nn_layers_utils.h"
+#include "nn_out_writer.h"
+
+using namespace std;
+
+
+// Global parameter for the output mode
+OutWriter::mode_type param_out_bin = OutWriter::MODE_TEXT;
+
+
+//============================================
+// Static methods
+//============================================
+
+OutWriter::mode_type OutWriter::GetMode(const char* name) {
+	if(strcmp(name, "none") == 0)  return MODE_TEXT;
+	if(strcmp(name, "text") == 0)  return MODE_TEXT;
+	if(strcmp(name, "8") == 0)     return MODE_RAW8;
+	if(strcmp(name, "int8") == 0)  return MODE_RAW8;
+	if(strcmp(name, "16") == 0)    return MODE_RAW16;
+	if(strcmp(name, "int16") == 0) return MODE_RAW16;
+	if(strcmp(name, "32") == 0)    return MODE_RAW32;
+	if(strcmp(name, "int32") == 0) return MODE_RAW32;
+	if(strcmp(name, "nnf") == 0)   return MODE_NNF;
+	return (mode_type)-1;
+}
+
+OutWriter::mode_type OutWriter::GetModeVerbose(const char* name) {
+	mode_type mode = GetMode(name);
+	if(mode == (mode_type)-1) {
+		printf("Error: Unknown output mode '%s', expected none, 8, 16, 32 or nnf\n", name);
+	}
+	return mode;
+}
+
+
+//============================================
+// Writer thread
+//============================================
+
+static void* outwriter_thread_wrapper(void* arg) {
+	OutWriter* outwr = (OutWriter*)arg;
+	return outwr->thread_routine();
+}
+
+void* OutWriter::thread_routine(void) {
+	char*    loc_bufs[BUF_NB];
+	unsigned loc_lens[BUF_NB];
+	struct iovec iov[BUF_NB];
+
+	do {
+
+		// Wait for full buffers
+		pthread_mutex_lock(&mutex);
+		while(bufs_full_nb == 0 && thread_stop == false) pthread_cond_wait(&cond_full, &mutex);
+		unsigned nb = bufs_full_nb;
+		for(unsigned i=0; i<nb; i++) {
+			loc_bufs[i] = bufs_full[i];
+			loc_lens[i] = bufs_full_len[i];
+		}
+		bufs_full_nb = 0;
+		pthread_mutex_unlock(&mutex);
+
+		if(nb == 0) break;
+
+		// Write all buffers with one system call, handle partial writes
+		unsigned iov_idx = 0;
+		for(unsigned i=0; i<nb; i++) {
+			iov[i].iov_base = loc_bufs[i];
+			iov[i].iov_len  = loc_lens[i];
+		}
+		while(iov_idx < nb && write_error == false) {
+			ssize_t r = writev(fd, iov + iov_idx, nb - iov_idx);
+			if(r < 0) {
+				if(errno == EINTR) continue;
+				printf("Error: Output writer failed to write data (errno %i)\n", errno);
+				write_error = true;
+				break;
+			}
+			size_t rem = r;
+			while(iov_idx < nb && rem >= iov[iov_idx].iov_len) {
+				rem -= iov[iov_idx].iov_len;
+				iov_idx++;
+			}
+			if(iov_idx < nb) {
+				iov[iov_idx].iov_base = (char*)iov[iov_idx].iov_base + rem;
+				iov[iov_idx].iov_len -= rem;
+			}
+		}
+
+		// Give the buffers back
+		pthread_mutex_lock(&mutex);
+		for(unsigned i=0; i<nb; i++) bufs_free[bufs_free_nb++] = loc_bufs[i];
+		pthread_cond_broadcast(&cond_free);
+		pthread_mutex_unlock(&mutex);
+
+	} while(1);
+
+	return NULL;
+}
+
+
+//============================================
+// Methods
+//============================================
+
+OutWriter::~OutWriter(void) {
+	if(F != nullptr) end();
+}
+
+void OutWriter::buf_commit(void) {
+	if(buf_len == 0) return;
+
+	if(use_thread == false) {
+		size_t r = fwrite(buf, 1, buf_len, F);
+		if(r < buf_len) write_error = true;
+		buf_len = 0;
+		return;
+	}
+
+	pthread_mutex_lock(&mutex);
+	bufs_full[bufs_full_nb] = buf;
+	bufs_full_len[bufs_full_nb] = buf_len;
+	bufs_full_nb++;
+	pthread_cond_signal(&cond_full);
+	while(bufs_free_nb == 0) pthread_cond_wait(&cond_free, &mutex);
+	buf = bufs_free[--bufs_free_nb];
+	pthread_mutex_unlock(&mutex);
+
+	buf_len = 0;
+}
+
+void OutWriter::put_str(const char* str, unsigned len) {
+	buf_reserve(len);
+	memcpy(buf + buf_len, str, len);
+	buf_len += len;
+}
+
+void OutWriter::put_value(uint32_t v) {
+	char* p = buf + buf_len;
+
+	if(mode != MODE_TEXT) {
+		// Little-endian, whatever the host endianness
+		for(unsigned i=0; i<bytes_per_value; i++) { p[i] = v; v >>= 8; }
+		buf_len += bytes_per_value;
+		return;
+	}
+
+	// The digits are generated from the end of a local buffer
+	char tmp[16];
+	char* t = tmp + sizeof(tmp);
+
+	if(fmt == FMT_DEC || fmt == FMT_UDEC) {
+		bool neg = (fmt == FMT_DEC) && (int32_t(v) < 0);
+		if(neg == true) v = -v;
+		do { *--t = '0' + v % 10; v /= 10; } while(v != 0);
+		if(neg == true) *--t = '-';
+	}
+	else if(fmt == FMT_HEX || fmt == FMT_HEXU) {
+		const char* digits = (fmt == FMT_HEX) ? "0123456789abcdef" : "0123456789ABCDEF";
+		do { *--t = digits[v & 0x0F]; v >>= 4; } while(v != 0);
+	}
+	else {
+		// Arbitrary printf-compatible format, it may produce more than the reserved margin
+		unsigned rem = BUF_SIZE - buf_len;
+		unsigned n = snprintf(p, rem, param_out_format, v);
+		if(n >= rem) {
+			buf_commit();
+			n = snprintf(buf, BUF_SIZE, param_out_format, v);
+			if(n >= BUF_SIZE) n = BUF_SIZE - 1;
+		}
+		buf_len += n;
+		return;
+	}
+
+	unsigned n = tmp + sizeof(tmp) - t;
+	memcpy(p, t, n);
+	buf_len += n;
+}
+
+int OutWriter::begin(FILE* F, mode_type mode, unsigned wdata, bool sdata, unsigned frame_size) {
+	if(this->F != nullptr) end();
+
+	this->F = F;
+	this->mode = mode;
+	fd = fileno(F);
+	frames_nb = 0;
+	write_error = false;
+	thread_stop = false;
+
+	// Text format of values
+	fmt = FMT_PRINTF;
+	if(strcmp(param_out_format, "%i") == 0 || strcmp(param_out_format, "%d") == 0) fmt = FMT_DEC;
+	else if(strcmp(param_out_format, "%u") == 0) fmt = FMT_UDEC;
+	else if(strcmp(param_out_format, "%x") == 0) fmt = FMT_HEX;
+	else if(strcmp(param_out_format, "%X") == 0) fmt = FMT_HEXU;
+
+	sep_len = (param_out_sep != NULL) ? strlen(param_out_sep) : 0;
+	print_prefix = (F == stdout) && (mode == MODE_TEXT);
+
+	bytes_per_value = 4;
+	if(mode == MODE_RAW8)  bytes_per_value = 1;
+	if(mode == MODE_RAW16) bytes_per_value = 2;
+	if(mode == MODE_NNF) {
+		if(wdata <= 8) bytes_per_value = 1;
+		else if(wdata <= 16) bytes_per_value = 2;
+	}
+
+	// Writes to stdout or to a terminal are kept ordered with the other messages
+	use_thread = (F != stdout && isatty(fd) == 0);
+
+	// Anything already buffered by stdio must be written before
+	fflush(F);
+	// Position of the NNF header, it is negative if the destination is not seekable
+	header_pos = lseek(fd, 0, SEEK_CUR);
+
+	for(unsigned i=0; i<BUF_NB; i++) bufs_free[i] = (char*)malloc(BUF_SIZE);
+	bufs_free_nb = BUF_NB;
+	bufs_full_nb = 0;
+	buf = bufs_free[--bufs_free_nb];
+	buf_len = 0;
+
+	if(mode == MODE_NNF) {
+		uint32_t header[8] = { 0, 1, bytes_per_value, sdata, frame_size, 0, 0, 0 };
+		memcpy(buf, "NNF1", 4);
+		buf_len = 4;
+		unsigned save_bytes = bytes_per_value;
+		bytes_per_value = 4;
+		for(unsigned i=1; i<8; i++) put_value(header[i]);
+		bytes_per_value = save_bytes;
+	}
+
+	if(use_thread == true) {
+		int z = pthread_create(&thread, NULL, outwriter_thread_wrapper, this);
+		if(z != 0) {
+			printf("Warning: Could not launch the output writer thread, writing synchronously\n");
+			use_thread = false;
+		}
+	}
+
+	return 0;
+}
+
+void OutWriter::frame(unsigned f, const int* data, unsigned nb, unsigned step, unsigned mask) {
+	if(step == 0) step = 1;
+
+	if(mode != MODE_TEXT) {
+		for(unsigned i=0; i<nb; i+=step) {
+			buf_reserve(BUF_MARGIN);
+			put_value(data[i] & mask);
+		}
+		frame_end();
+		return;
+	}
+
+	if(print_prefix == true) {
+		put_str("RESULT: Frame ", 14);
+		fmt_type save_fmt = fmt;
+		fmt = FMT_UDEC;
+		put_value(f);
+		fmt = save_fmt;
+		put_str(": ", 2);
+	}
+
+	unsigned oidx = 0;
+	for(unsigned i=0; i<nb; i+=step) {
+		if(param_out_nl > 0 && oidx > 0 && oidx % param_out_nl == 0) put_str("\n", 1);
+		else if(oidx > 0 && sep_len > 0) put_str(param_out_sep, sep_len);
+		buf_reserve(BUF_MARGIN);
+		put_value(data[i] & mask);
+		oidx++;
+	}
+	put_str("\n", 1);
+	if(param_out_nl > 0) put_str("\n", 1);
+
+	frame_end();
+}
+
+void OutWriter::frame_end(void) {
+	frames_nb++;
+
+	// Synchronous writes are flushed for each frame, so they are not delayed after later messages
+	if(use_thread == false) {
+		buf_commit();
+		fflush(F);
+	}
+}
+
+int OutWriter::end(void) {
+	if(F == nullptr) return 0;
+
+	buf_commit();
+
+	if(use_thread == true) {
+		pthread_mutex_lock(&mutex);
+		thread_stop = true;
+		pthread_cond_signal(&cond_full);
+		pthread_mutex_unlock(&mutex);
+		pthread_join(thread, NULL);
+	}
+	else {
+		fflush(F);
+	}
+
+	// Patch the number of frames in the NNF header, only possible if the destination is seekable
+	if(mode == MODE_NNF && header_pos >= 0) {
+		uint8_t le[4] = { uint8_t(frames_nb), uint8_t(frames_nb >> 8), uint8_t(frames_nb >> 16), uint8_t(frames_nb >> 24) };
+		ssize_t r = pwrite(fd, le, 4, header_pos + 20);
+		if(r != 4) printf("Warning: Could not write the number of frames in the NNF header\n");
+	}
+
+	// Clean
+	free(buf);
+	for(unsigned i=0; i<bufs_free_nb; i++) free(bufs_free[i]);
+	buf = nullptr;
+	bufs_free_nb = 0;
+	F = nullptr;
+
+	return (write_error == true) ? -1 : 0;
+}
+
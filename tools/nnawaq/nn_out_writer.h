@@ -0,0 +1,118 @@
+
+#pragma once
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <pthread.h>
+#include <sys/types.h>
+
+}
+
+
+//============================================
+// Output writer for results of software execution and HW accelerator
+//============================================
+
+// Text values are formatted into large buffers without using printf, the separator / newline / mask semantics of parameters onl, osep and omask are preserved
+// When the destination is a file, buffers are written by a dedicated thread with writev(), so formatting and file writes overlap
+// When the destination is stdout or a terminal, buffers are written synchronously with stdio after each frame, to keep the ordering with other messages
+
+// Raw binary output skips formatting entirely : values are written as little-endian integers of 1, 2 or 4 bytes
+// The NNF container is binary output with a header, all fields are 32-bit little-endian :
+//   magic "NNF1", version, bytes per value, flags (bit 0 : signed), values per frame, number of frames, 2 reserved words
+// The number of frames is patched at the end when the destination is seekable, it is zero otherwise
+
+class OutWriter {
+
+	public :
+
+	enum mode_type {
+		MODE_TEXT  = 0,
+		MODE_RAW8  = 1,
+		MODE_RAW16 = 2,
+		MODE_RAW32 = 3,
+		MODE_NNF   = 4,
+	};
+
+	static mode_type GetMode(const char* name);
+	static mode_type GetModeVerbose(const char* name);
+
+	private :
+
+	static const unsigned BUF_SIZE = 1024 * 1024;
+	static const unsigned BUF_NB   = 4;
+	// Reserve to format one value, or the frame prefix, without checking the buffer size
+	static const unsigned BUF_MARGIN = 64;
+
+	// Format of text values
+	enum fmt_type {
+		FMT_PRINTF = 0,
+		FMT_DEC    = 1,
+		FMT_UDEC   = 2,
+		FMT_HEX    = 3,
+		FMT_HEXU   = 4,
+	};
+
+	FILE*       F = nullptr;
+	int         fd = -1;
+	mode_type   mode = MODE_TEXT;
+	fmt_type    fmt = FMT_DEC;
+	bool        use_thread = false;
+	bool        print_prefix = false;
+	unsigned    sep_len = 0;
+	unsigned    bytes_per_value = 4;
+	unsigned    frames_nb = 0;
+	off_t       header_pos = -1;
+
+	// The buffer being filled
+	char*       buf = nullptr;
+	unsigned    buf_len = 0;
+
+	// Buffers exchanged with the writer thread
+	char*       bufs_free[BUF_NB];
+	unsigned    bufs_free_nb = 0;
+	char*       bufs_full[BUF_NB];
+	unsigned    bufs_full_len[BUF_NB];
+	unsigned    bufs_full_nb = 0;
+	bool        thread_stop = false;
+	bool        write_error = false;
+
+	pthread_t       thread;
+	pthread_mutex_t mutex = PTHREAD_MUTEX_INITIALIZER;
+	pthread_cond_t  cond_full = PTHREAD_COND_INITIALIZER;
+	pthread_cond_t  cond_free = PTHREAD_COND_INITIALIZER;
+
+	public :
+
+	// Constructor / destructor
+	OutWriter(void) {}
+	~OutWriter(void);
+
+	// Methods
+
+	int  begin(FILE* F, mode_type mode, unsigned wdata, bool sdata, unsigned frame_size);
+	void frame(unsigned f, const int* data, unsigned nb, unsigned step, unsigned mask);
+	int  end(void);
+
+	inline bool IsActive(void) { return F != nullptr; }
+
+	// Must be public to be called from the thread function
+	void* thread_routine(void);
+
+	private :
+
+	void buf_commit(void);
+	void frame_end(void);
+	inline void buf_reserve(unsigned len) { if(buf_len + len > BUF_SIZE) buf_commit(); }
+
+	void put_value(uint32_t v);
+	void put_str(const char* str, unsigned len);
+
+};
+
+// Global parameter for the output mode
+extern OutWriter::mode_type param_out_bin;
+
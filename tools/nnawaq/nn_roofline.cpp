@@ -0,0 +1,357 @@
+
+// Roofline analysis of layers : compute, memory traffic and interfaces
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "nnawaq_utils.h"
+
+}
+
+#include <vector>
+
+#include "nn_layers_utils.h"
+#include "swexec.h"
+
+#include "nn_roofline.h"
+
+using namespace std;
+
+
+//============================================
+// Accelerator
+//============================================
+
+static const char* roofline_bound_names[] = { "stream", "compute", "memory", "interface" };
+
+#define ROOFLINE_BOUND_STREAM     0
+#define ROOFLINE_BOUND_COMPUTE    1
+#define ROOFLINE_BOUND_MEMORY     2
+#define ROOFLINE_BOUND_INTERFACE  3
+
+typedef struct roofline_layer_t {
+	Layer* layer = nullptr;
+
+	// Per frame
+	unsigned long macs = 0;
+	unsigned long bytes_w = 0;   // Weights read from memory
+	unsigned long bytes_a = 0;   // Input and output activations
+	unsigned long mults = 0;     // Physical multipliers
+
+	// Clock cycles per frame
+	unsigned long cy_layer = 0;  // With the current parallelism
+	unsigned long cy_comp = 0;
+	unsigned long cy_mem = 0;
+	unsigned long cy_iface = 0;
+	unsigned long cy_bound = 0;  // The largest of all
+	unsigned bound = ROOFLINE_BOUND_STREAM;
+} roofline_layer_t;
+
+static inline unsigned long roofline_bytes(unsigned long bits) {
+	return (bits + 7) / 8;
+}
+
+// Same multipliers and MACs as in LayerNeu::hwconfig_finalize(), without padding to the parallelism
+static void roofline_eval_neu(Layer* layer, roofline_layer_t& rl) {
+	unsigned nbneu = (layer->neurons_max + layer->split_out - 1) / layer->split_out;
+	unsigned tmux = GetMax(layer->neu_time_mux, 1);
+	unsigned dwconv_tmux = 1;
+	if(layer->win_dwconv == true && layer->win_par_oz > 0) dwconv_tmux = GetMax(layer->fz / layer->win_par_oz, 1);
+
+	// For DWConv, the neurons are already accounted for in nbframes
+	if(layer->win_dwconv == true) rl.macs = (unsigned long)layer->nbframes * layer->fsize;
+	else rl.macs = (unsigned long)layer->nbframes * layer->fsize * layer->neurons;
+
+	rl.mults = (unsigned long)nbneu * layer->split_out / dwconv_tmux / tmux * layer->split_in;
+	if(rl.mults > 0) rl.cy_comp = (rl.macs + rl.mults - 1) / rl.mults;
+
+	// Each MAC reads one weight
+	// The memory may store the weights with padding or compression, the traffic is scaled accordingly
+	unsigned long bits_raw = rl.macs * layer->neu_wweight;
+	unsigned long weights_bits = (unsigned long)layer->neurons * layer->fsize * layer->neu_wweight;
+	if(layer->mem.IsEmpty() == false && weights_bits > 0) {
+		double ratio = (double)layer->mem.EvalSizeTotal() / weights_bits;
+		unsigned long bits_read = bits_raw * ratio;
+		unsigned long bits_per_cycle = (unsigned long)layer->mem.width * layer->mem.num;
+		rl.bytes_w = roofline_bytes(bits_read);
+		rl.cy_mem = (bits_read + bits_per_cycle - 1) / bits_per_cycle;
+	}
+	else {
+		// Weights are constant in logic, or the memories are not known yet
+		rl.bytes_w = roofline_bytes(bits_raw);
+	}
+}
+
+static void roofline_eval_layer(Network* network, Layer* layer, unsigned iface_width, roofline_layer_t& rl) {
+	rl.layer = layer;
+
+	unsigned long bits_in  = (unsigned long)layer->nbframes * layer->fsize * layer->wdata;
+	unsigned long bits_out = (unsigned long)layer->out_nbframes * layer->out_fsize * layer->out_wdata;
+	rl.bytes_a = roofline_bytes(bits_in) + roofline_bytes(bits_out);
+
+	if(layer->type == LAYER_NEU || layer->type == LAYER_NEU_CM) {
+		roofline_eval_neu(layer, rl);
+	}
+
+	rl.cy_layer = GetMax(layer->cycles, layer->out_cycles);
+
+	// The first and last layers are fed by and feed the host interface
+	unsigned long bits_iface = 0;
+	if(layer == network->layer_first) bits_iface = GetMax(bits_iface, bits_in);
+	if(layer == network->layer_last) bits_iface = GetMax(bits_iface, bits_out);
+	rl.cy_iface = (bits_iface + iface_width - 1) / iface_width;
+
+	// On equality, the compute bound is preferred because more parallelism also increases the width of memories
+	rl.cy_bound = rl.cy_layer;
+	rl.bound = ROOFLINE_BOUND_STREAM;
+	if(rl.cy_comp > 0 && rl.cy_comp >= rl.cy_bound) { rl.cy_bound = rl.cy_comp; rl.bound = ROOFLINE_BOUND_COMPUTE; }
+	if(rl.cy_mem > rl.cy_bound || (rl.cy_mem > 0 && rl.cy_mem == rl.cy_bound && rl.bound == ROOFLINE_BOUND_STREAM)) {
+		rl.cy_bound = rl.cy_mem;
+		rl.bound = ROOFLINE_BOUND_MEMORY;
+	}
+	if(rl.cy_iface > rl.cy_bound) { rl.cy_bound = rl.cy_iface; rl.bound = ROOFLINE_BOUND_INTERFACE; }
+}
+
+// FIFOs only propagate the throughput of their neighbours, unless they are at the interface with the host
+static bool roofline_is_limit(const roofline_layer_t& rl, unsigned long cycles) {
+	if(rl.cy_bound != cycles) return false;
+	if(rl.layer->type == LAYER_FIFO && rl.bound != ROOFLINE_BOUND_INTERFACE) return false;
+	return true;
+}
+
+static void roofline_print_hint(const roofline_layer_t& rl) {
+	Layer* layer = rl.layer;
+	printf("  Layer %s%u is %s-bound : ", layer->typenamel, layer->typeidx, roofline_bound_names[rl.bound]);
+	if(rl.bound == ROOFLINE_BOUND_COMPUTE) {
+		if(layer->neu_time_mux > 1) printf("reduce time multiplexing, or add parallelism PAR_IN / PAR_OUT\n");
+		else printf("add parallelism PAR_IN / PAR_OUT\n");
+	}
+	else if(rl.bound == ROOFLINE_BOUND_MEMORY) {
+		printf("compress weights, or use more memory banks\n");
+	}
+	else if(rl.bound == ROOFLINE_BOUND_INTERFACE) {
+		printf("widen the interface with the host\n");
+	}
+	else {
+		printf("add parallelism PAR_IN / PAR_OUT\n");
+	}
+}
+
+static void roofline_accel(Network* network, const RooflineParams& params) {
+
+	unsigned iface_width = params.iface_width;
+	if(iface_width == 0) iface_width = network->hwconfig_writewidth;
+
+	vector<roofline_layer_t> rlayers(network->layers.size());
+	unsigned long cycles = 0;
+	unsigned long total_macs = 0;
+	unsigned long total_mults = 0;
+	unsigned long total_bytes_w = 0;
+	bool mem_unknown = false;
+
+	for(auto layer : network->layers) {
+		auto& rl = rlayers[layer->index];
+		roofline_eval_layer(network, layer, iface_width, rl);
+		cycles = GetMax(cycles, rl.cy_bound);
+		total_macs    += rl.macs;
+		total_mults   += rl.mults;
+		total_bytes_w += rl.bytes_w;
+		if(rl.macs > 0 && rl.cy_mem == 0 && layer->const_params == false) mem_unknown = true;
+	}
+	if(cycles == 0) cycles = 1;
+
+	printf("Roofline of the accelerator : %lu clock cycles/frame, interface %u bits/cycle\n", cycles, iface_width);
+	printf("  Layer       MAC/frame    W bytes    A bytes    MAC/B     cycles  MAC/cy    peak   util  bound\n");
+	for(auto layer : network->layers) {
+		auto& rl = rlayers[layer->index];
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%s%u", layer->typenamel, layer->typeidx);
+		unsigned long bytes = rl.bytes_w + rl.bytes_a;
+		double intensity = (bytes > 0) ? (double)rl.macs / bytes : 0;
+		double mac_cy = (double)rl.macs / cycles;
+		printf("%c %-8s %12lu %10lu %10lu %8.2f %10lu", roofline_is_limit(rl, cycles) ? '*' : ' ', buf,
+			rl.macs, rl.bytes_w, rl.bytes_a, intensity, rl.cy_bound
+		);
+		if(rl.mults > 0) printf(" %7.1f %7lu %5.1f%%", mac_cy, rl.mults, 100 * mac_cy / rl.mults);
+		else printf(" %7s %7s %6s", "-", "-", "-");
+		printf("  %s\n", roofline_bound_names[rl.bound]);
+	}
+
+	if(total_mults > 0) {
+		double mac_cy = (double)total_macs / cycles;
+		printf("  Total : %lu MAC/frame, %.1f MAC/cycle achieved, %lu multipliers, utilization %.1f%%\n",
+			total_macs, mac_cy, total_mults, 100 * mac_cy / total_mults
+		);
+	}
+	if(params.freq_mhz > 0) {
+		double fps = params.freq_mhz * 1e6 / cycles;
+		printf("  At %g MHz : %.1f frames/s, %.3f GMAC/s achieved, %.3f GMAC/s peak\n",
+			params.freq_mhz, fps, total_macs * fps / 1e9, total_mults * params.freq_mhz / 1e3
+		);
+		printf("  At %g MHz : weight memories %.3f GB/s, interface %.3f GB/s available\n",
+			params.freq_mhz, total_bytes_w * fps / 1e9, iface_width / 8. * params.freq_mhz / 1e3
+		);
+	}
+	if(mem_unknown == true) {
+		printf("  Note : Weight memories are only known after the hardware configuration is finalized\n");
+	}
+
+	for(auto& rl : rlayers) {
+		if(roofline_is_limit(rl, cycles) == true) roofline_print_hint(rl);
+	}
+}
+
+
+//============================================
+// Software execution on the host
+//============================================
+
+// Layers that move less data than this are assumed to work in cache
+#define ROOFLINE_HOST_CACHE_BYTES (1024 * 1024)
+
+// Peak memory bandwidth in GB/s, read and write bytes are counted
+// The copy is repeated so that the total is the same for small buffers that stay in cache
+static double roofline_host_bandwidth(size_t size) {
+	size_t total = 256 * 1024 * 1024;
+	unsigned rounds = GetMax(total / size, 1);
+	char* src = (char*)malloc(size);
+	char* dst = (char*)malloc(size);
+	memset(src, 1, size);
+	memset(dst, 0, size);
+
+	double best = 0;
+	for(unsigned r=0; r<5; r++) {
+		int64_t time_beg = Time64_GetReal();
+		for(unsigned k=0; k<rounds; k++) {
+			memcpy(dst, src, size);
+			src[k % size] = dst[(k + 1) % size];
+		}
+		double t = TimeDouble_DiffCurrReal_From64(time_beg);
+		if(t > 0) best = GetMax(best, 2. * size * rounds / t / 1e9);
+	}
+
+	free(src);
+	free(dst);
+	return best;
+}
+
+// Peak MAC rate in GMAC/s, with a neuron layer on int data in cache like the software execution
+static double roofline_host_macs(void) {
+	unsigned fsize = 1024;
+	unsigned neurons = 64;
+	unsigned rounds = 64;
+	vector<int> data(fsize), weights(fsize * neurons), out(neurons);
+	// Small values so that sums do not overflow
+	for(unsigned i=0; i<fsize; i++) data[i] = rand() % 16;
+	for(unsigned i=0; i<fsize * neurons; i++) weights[i] = rand() % 16 - 8;
+
+	double best = 0;
+	for(unsigned r=0; r<5; r++) {
+		int64_t time_beg = Time64_GetReal();
+		for(unsigned k=0; k<rounds; k++) {
+			for(unsigned n=0; n<neurons; n++) {
+				const int* pw = weights.data() + n * fsize;
+				int sum = 0;
+				for(unsigned i=0; i<fsize; i++) sum += pw[i] * data[i];
+				out[n] = sum;
+			}
+			// Prevent the compiler from hoisting the loop
+			data[k % fsize] = out[k % neurons] & 15;
+		}
+		double t = TimeDouble_DiffCurrReal_From64(time_beg);
+		if(t > 0) best = GetMax(best, (double)fsize * neurons * rounds / t / 1e9);
+	}
+
+	return best;
+}
+
+static int roofline_host(Network* network, const RooflineParams& params) {
+
+	unsigned frames = params.frames_nb;
+	if(frames == 0) frames = param_fn;
+
+	vector<int64_t> times;
+	int z = swexec_layer_times(network, frames, times);
+	if(z != 0) return z;
+
+	double peak_bw_cache = roofline_host_bandwidth(ROOFLINE_HOST_CACHE_BYTES / 8);
+	double peak_bw_mem = roofline_host_bandwidth(64 * 1024 * 1024);
+	double peak_macs = roofline_host_macs();
+
+	int64_t time_total = 0;
+	int64_t time_max = 0;
+	for(auto layer : network->layers) {
+		time_total += times[layer->index];
+		if(layer->type != LAYER_FIFO) time_max = GetMax(time_max, times[layer->index]);
+	}
+	if(time_total == 0) time_total = 1;
+
+	printf("Roofline of the software execution : %u frames, %.3f ms/frame\n", frames, TimeDouble_From64(time_total) / frames * 1e3);
+	printf("  Host peak : %.3f GB/s in cache, %.3f GB/s in memory, %.3f GMAC/s\n", peak_bw_cache, peak_bw_mem, peak_macs);
+	printf("  Layer         us/frame   time    MAC/B    GMAC/s     GB/s   util  bound\n");
+
+	for(auto layer : network->layers) {
+		// FIFOs are only copies of data in software
+		if(layer->type == LAYER_FIFO) continue;
+		int64_t t64 = times[layer->index];
+		if(t64 == 0) continue;
+		double t = TimeDouble_From64(t64) / frames;
+
+		// Data and weights are int values
+		unsigned long macs = 0;
+		unsigned long bytes = ((unsigned long)layer->nbframes * layer->fsize + (unsigned long)layer->out_nbframes * layer->out_fsize) * sizeof(int);
+		if(layer->type == LAYER_NEU || layer->type == LAYER_NEU_CM) {
+			roofline_layer_t rl;
+			roofline_eval_neu(layer, rl);
+			macs = rl.macs;
+			bytes += macs * sizeof(int);
+		}
+
+		double intensity = (double)macs / bytes;
+		double gmacs = macs / t / 1e9;
+		double gbs = bytes / t / 1e9;
+
+		// The attainable performance is the lowest roof
+		double peak_bw = (bytes <= ROOFLINE_HOST_CACHE_BYTES) ? peak_bw_cache : peak_bw_mem;
+		bool mem_bound = (macs == 0) || (intensity * peak_bw < peak_macs);
+		double util = 0;
+		if(macs == 0) util = (peak_bw > 0) ? gbs / peak_bw : 0;
+		else util = gmacs / GetMin(peak_macs, intensity * peak_bw);
+
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%s%u", layer->typenamel, layer->typeidx);
+		printf("%c %-8s %12.3f %5.1f%% %8.2f %9.3f %8.3f %5.1f%%  %s\n", (t64 == time_max) ? '*' : ' ', buf,
+			t * 1e6, 100. * t64 / time_total, intensity, gmacs, gbs, 100 * util, mem_bound ? "memory" : "compute"
+		);
+	}
+
+	return 0;
+}
+
+
+//============================================
+// Main function
+//============================================
+
+int nn_roofline(Network* network, const RooflineParams& params) {
+
+	if(network->layers.empty()) {
+		printf("Error : The network is empty\n");
+		return -1;
+	}
+
+	roofline_accel(network, params);
+
+	if(params.host == true) {
+		int z = roofline_host(network, params);
+		if(z != 0) return -1;
+	}
+
+	return 0;
+}
+
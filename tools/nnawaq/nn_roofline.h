@@ -0,0 +1,42 @@
+
+#pragma once
+
+extern "C" {
+#include <stdbool.h>
+}
+
+#include "nn_layers_create.h"
+
+
+//============================================
+// Roofline analysis of layers
+//============================================
+
+// For each layer, the MAC operations are compared to the data moved, and to the time of the layer :
+// - MACs per frame, bytes of weights read from memory and bytes of input and output activations
+// - arithmetic intensity, in MACs per byte
+// - clock cycles per frame with the current parallelism, and utilization of the multipliers at the throughput of the pipeline
+// The layer is bound by the largest of these times, in clock cycles per frame :
+// - compute : MACs divided by the number of physical multipliers
+// - memory : one line of all weight memory banks is read per clock cycle, for each output position
+// - interface : data of the first and last layers divided by the width of the interface with the host
+// - stream : otherwise the data parallelism PAR_IN / PAR_OUT of the layer is the limit
+// The layers that set the throughput of the pipeline are highlighted
+// The weight memories are only known after the hardware configuration is finalized
+//
+// On the host, the software execution is timed on a sample of frames, and compared to the measured peak
+// memory bandwidth and MAC rate of the host, with data and weights as int values
+
+class RooflineParams {
+
+	public :
+
+	double   freq_mhz = 0;       // Frequency of the accelerator, zero means results in clock cycles only
+	unsigned iface_width = 0;    // Bits per clock cycle of the interface with the host, zero means the width of the PCIe interface
+	bool     host = false;       // Also time the software execution on the host
+	unsigned frames_nb = 0;      // Frames for the software execution, zero means the number of frames of the global parameters
+
+};
+
+int nn_roofline(Network* network, const RooflineParams& params);
+
@@ -0,0 +1,566 @@
+
+// Binary snapshot of a finalized network, to skip the build by Tcl script
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <ctype.h>
+
+#include "nnawaq_utils.h"
+#include "load_config.h"
+
+}
+
+#include "nn_layers_utils.h"
+
+#include "nn_snapshot.h"
+
+using namespace std;
+
+
+//============================================
+// Serialization of fields
+//============================================
+
+// The same list of fields is used to save and to load, so both directions are always consistent
+// Values are converted to fixed sizes, so snapshots are portable between 32-bit and 64-bit hosts
+
+class SnapshotIO {
+
+	public :
+
+	FILE* F = NULL;
+	bool  save = true;
+	bool  error = false;
+
+	// Correspondence between layers and their indexes in the vector of layers
+	map<Layer*, int32_t> map_layer2idx;
+	vector<Layer*>       layers;
+
+	void raw(void* data, size_t size) {
+		if(error == true) return;
+		size_t z = (save == true) ? fwrite(data, 1, size, F) : fread(data, 1, size, F);
+		if(z != size) error = true;
+	}
+
+	void val(uint32_t& v) { raw(&v, sizeof(v)); }
+	void val(int32_t& v)  { raw(&v, sizeof(v)); }
+	void val(float& v)    { raw(&v, sizeof(v)); }
+	void val(double& v)   { raw(&v, sizeof(v)); }
+
+	void val(bool& v) {
+		uint8_t b = v;
+		raw(&b, sizeof(b));
+		v = (b != 0);
+	}
+	void val(char& v) {
+		int8_t b = v;
+		raw(&b, sizeof(b));
+		v = b;
+	}
+	void val(unsigned long& v) {
+		uint64_t w = v;
+		raw(&w, sizeof(w));
+		v = w;
+	}
+	void val(MemImplem::style_type& v) {
+		uint32_t w = v;
+		raw(&w, sizeof(w));
+		v = (MemImplem::style_type)w;
+	}
+
+	// Strings are owned by the layer, a null pointer is stored as a special length
+	void str(char*& s) {
+		uint32_t len = (s != nullptr) ? strlen(s) : UINT32_MAX;
+		val(len);
+		if(save == true) {
+			if(len != UINT32_MAX) raw(s, len);
+			return;
+		}
+		if(error == true || len == UINT32_MAX) { s = nullptr; return; }
+		char* buf = (char*)malloc(len + 1);
+		raw(buf, len);
+		buf[len] = 0;
+		s = buf;
+	}
+
+	void link(Layer*& layer) {
+		int32_t idx = -1;
+		if(save == true) {
+			if(layer != nullptr) {
+				auto iter = map_layer2idx.find(layer);
+				if(iter == map_layer2idx.end()) { error = true; return; }
+				idx = iter->second;
+			}
+			val(idx);
+			return;
+		}
+		val(idx);
+		if(idx < -1 || idx >= (int32_t)layers.size()) { error = true; idx = -1; }
+		layer = (idx >= 0) ? layers[idx] : nullptr;
+	}
+
+	void mem(MemImplem& mem) {
+		val(mem.width);
+		val(mem.lines);
+		val(mem.num);
+		val(mem.opt_speed);
+		val(mem.style);
+		val(mem.blocks);
+		val(mem.blocks_packed);
+	}
+
+};
+
+static void snapshot_network_fields(SnapshotIO& io, Network* network) {
+
+	io.val(network->default_comp_all_style);
+	io.val(network->default_comp_all_nraw);
+	io.val(network->default_comp_all_nbin);
+	io.val(network->default_comp_bram_style);
+	io.val(network->default_comp_bram_nraw);
+	io.val(network->default_comp_bram_nbin);
+	io.val(network->default_comp_fc_style);
+	io.val(network->default_comp_fc_nraw);
+	io.val(network->default_comp_fc_nbin);
+
+	io.val(network->default_mem_implem_win);
+	io.val(network->default_mem_implem_neu);
+
+	io.val(network->default_round_nearest);
+
+	io.val(network->default_neu_wd);
+	io.val(network->default_neu_sd);
+	io.val(network->default_neu_ww);
+	io.val(network->default_neu_sw);
+	io.val(network->default_neu_wo);
+	io.val(network->default_neu_so);
+	io.val(network->default_neu_worder);
+
+	io.val(network->default_norm_mul_cst);
+	io.val(network->default_norm_shr_cst);
+	io.val(network->default_norm_wbias);
+	io.val(network->default_norm_wmul);
+	io.val(network->default_norm_wshr);
+
+	io.val(network->default_relu_min);
+	io.val(network->default_relu_max);
+	io.val(network->default_leaky_min);
+	io.val(network->default_leaky_max);
+
+	io.val(network->param_win);
+	io.val(network->param_sin);
+	io.val(network->param_fx);
+	io.val(network->param_fy);
+	io.val(network->param_fz);
+	io.val(network->param_inpar);
+
+	io.val(network->cnn_outneu);
+
+	io.val(network->nofifo_win_neu_th);
+	io.val(network->nofifo_win_pool);
+	io.val(network->nofifo_neu_relu);
+	io.val(network->nofifo_norm_relu);
+	io.val(network->nofifo_neu_leaky);
+	io.val(network->nofifo_norm_leaky);
+
+	io.val(network->param_selout);
+	io.val(network->param_fifomon);
+	io.val(network->param_noregs);
+	io.val(network->param_rdonly);
+
+	io.val(network->hwconfig_luts_per_bram18);
+	io.val(network->hwconfig_luts_bram_ratio);
+	io.val(network->hwconfig_writewidth);
+	io.val(network->hwconfig_neu_style);
+	io.val(network->hwconfig_lut_threshold);
+	io.val(network->hwconfig_use_uram);
+	io.val(network->hwconfig_bram_opt_speed);
+	io.val(network->hwconfig_mem_pack);
+	io.val(network->hwconfig_asicmode);
+
+	io.val(network->param_cnn_origin);
+
+	io.val(network->total_neurons);
+	io.val(network->total_neurons_phy);
+	io.val(network->total_multipliers);
+	io.val(network->total_weights);
+	io.val(network->total_weight_bits);
+	io.val(network->total_macs);
+	io.val(network->total_bram18);
+	io.val(network->total_lutram);
+	io.val(network->total_bram18_packed);
+	io.val(network->total_regs);
+
+	// Decoding of YOLO regions, not part of the vector of layers
+	bool has_region = (network->layer_region != nullptr);
+	io.val(has_region);
+	if(has_region == true && io.error == false) {
+		if(io.save == false) {
+			network->layer_region = new LayerRegion();
+			network->layer_region->network = network;
+		}
+		LayerRegion* region = network->layer_region;
+		io.val(region->boxes_nb);
+		io.val(region->classes_nb);
+		io.val(region->shift);
+		io.val(region->scale);
+		io.val(region->img_size);
+		io.val(region->thresh);
+		uint32_t anchors_nb = region->anchors.size();
+		io.val(anchors_nb);
+		if(io.save == false && io.error == false) region->anchors.resize(anchors_nb, 0);
+		for(unsigned i=0; i<anchors_nb && io.error == false; i++) io.val(region->anchors[i]);
+	}
+
+}
+
+// The type of the layer, the object itself, the links with the parent network and the configuration data are handled separately
+static void snapshot_layer_fields(SnapshotIO& io, Layer* layer) {
+
+	io.val(layer->typeidx);
+	io.val(layer->id);
+	io.str(layer->vhdl_prefixl);
+	io.str(layer->vhdl_prefixu);
+	io.val(layer->index);
+
+	io.val(layer->regs_idx);
+	io.val(layer->regs_nb);
+
+	io.val(layer->cfg_id);
+	io.str(layer->cfg_filename);
+
+	io.val(layer->user_wout);
+	io.val(layer->user_par_oz);
+	io.val(layer->split_in);
+	io.val(layer->split_out);
+
+	io.val(layer->fx);
+	io.val(layer->fy);
+	io.val(layer->fz);
+	io.val(layer->fx_max);
+	io.val(layer->fy_max);
+	io.val(layer->fz_max);
+	io.val(layer->wdata);
+	io.val(layer->sdata);
+	io.val(layer->fsize);
+	io.val(layer->fsize_max);
+	io.val(layer->nbframes);
+	io.val(layer->cycles);
+
+	io.mem(layer->mem);
+
+	io.val(layer->round_nearest);
+	io.val(layer->const_params);
+
+	io.val(layer->winx);
+	io.val(layer->winy);
+	io.val(layer->win_par_oz);
+	io.val(layer->win_repeat);
+	io.val(layer->win_dwconv);
+	io.val(layer->stepx);
+	io.val(layer->stepy);
+	io.val(layer->nwinx);
+	io.val(layer->nwiny);
+	io.val(layer->nwinz);
+	io.val(layer->begpadx);
+	io.val(layer->begpady);
+	io.val(layer->bufy);
+	io.val(layer->win_sym_xy);
+
+	io.val(layer->neurons);
+	io.val(layer->neurons_max);
+	io.val(layer->neu_wweight);
+	io.val(layer->neu_per_bram);
+	io.val(layer->neu_wrnb);
+	io.val(layer->neu_sgnd);
+	io.val(layer->neu_sgnw);
+	io.val(layer->neu_custom_mul);
+	io.val(layer->neu_custom_mul_id);
+	io.val(layer->neu_custom_wmul);
+	io.val(layer->neu_custom_smul);
+	io.val(layer->neu_style);
+	io.val(layer->neu_comp_style);
+	io.val(layer->neu_comp_nraw);
+	io.val(layer->neu_comp_nbin);
+	io.val(layer->neu_waccu);
+	io.val(layer->neu_time_mux);
+	io.val(layer->neu_worder);
+
+	io.val(layer->pool_type);
+	io.val(layer->pool_units_nb);
+	io.val(layer->pool_avg_mult);
+	io.val(layer->pool_avg_shr);
+
+	io.val(layer->norm_mul_cst);
+	io.val(layer->norm_shr_cst);
+	io.val(layer->norm_wbias);
+	io.val(layer->norm_wmul);
+	io.val(layer->norm_wshr);
+
+	io.val(layer->ter_out_static);
+
+	io.val(layer->relu_min);
+	io.val(layer->relu_max);
+	io.val(layer->leaky_min);
+	io.val(layer->leaky_max);
+
+	io.val(layer->custom_user_id);
+	io.val(layer->custom_latency);
+
+	io.val(layer->flow_skip_inbuf);
+	io.val(layer->out_extra_fifo_room);
+	io.val(layer->fifo_depth);
+
+	io.val(layer->prev_is_arr);
+	io.val(layer->next_is_arr);
+	uint32_t arr_nb = layer->arr_layers.size();
+	io.val(arr_nb);
+	if(io.save == false && io.error == false) layer->arr_layers.resize(arr_nb, nullptr);
+	for(unsigned i=0; i<arr_nb && io.error == false; i++) io.link(layer->arr_layers[i]);
+
+	io.val(layer->stat_zd);
+	io.val(layer->stat_nzd_zw);
+	io.val(layer->stat_toggle);
+
+	io.val(layer->out_fx);
+	io.val(layer->out_fy);
+	io.val(layer->out_fz);
+	io.val(layer->out_wdata);
+	io.val(layer->out_sdata);
+	io.val(layer->out_fsize);
+	io.val(layer->out_nbframes);
+	io.val(layer->out_cycles);
+	io.val(layer->out_cycles_real);
+
+	io.link(layer->prev);
+	io.link(layer->next);
+
+}
+
+
+//============================================
+// Save and load
+//============================================
+
+int Network::snapshot_save(const char* filename, bool with_cfg_data) {
+
+	// The configuration data may not be loaded yet, the snapshot must not need the CSV files
+	if(with_cfg_data == true) {
+		int z = load_config_files();
+		if(z != 0) {
+			printf("Error : Failed to load the configuration data to save in the snapshot '%s'\n", filename);
+			return -1;
+		}
+	}
+
+	FILE* F = fopen(filename, "wb");
+	if(F == NULL) {
+		printf("Error : Can't open file '%s' for writing\n", filename);
+		return -1;
+	}
+
+	SnapshotIO io;
+	io.F = F;
+	io.save = true;
+	for(unsigned i=0; i<layers.size(); i++) io.map_layer2idx[layers[i]] = i;
+
+	nn_snapshot_header_t header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, NN_SNAPSHOT_MAGIC, sizeof(header.magic));
+	header.version = NN_SNAPSHOT_VERSION;
+	header.flags = with_cfg_data ? NN_SNAPSHOT_CFGDATA : 0;
+	header.layers_nb = layers.size();
+	io.raw(&header, sizeof(header));
+
+	// Network parameters and counters
+	snapshot_network_fields(io, this);
+	uint32_t idx_nb = layers_idx.size();
+	io.val(idx_nb);
+	for(auto& idx : layers_idx) io.val(idx);
+	io.val(layers_idxhw);
+	io.val(layers_idxcfg);
+	io.link(layer_first);
+	io.link(layer_last);
+
+	// Layer types, custom types are defined again at load time
+	for(auto layer : layers) {
+		uint32_t type = layer->type;
+		char* type_name = (char*)layer->typenamel;
+		bool is_custom = (dynamic_cast<LayerCustom*>(layer) != nullptr);
+		io.val(type);
+		io.str(type_name);
+		io.val(is_custom);
+		if(is_custom == true) io.str(layer->custom_entity);
+	}
+
+	// Layer fields
+	for(auto layer : layers) snapshot_layer_fields(io, layer);
+
+	// Configuration data
+	if(with_cfg_data == true) {
+		for(auto layer : layers) {
+			uint32_t nrow = 0;
+			uint32_t ncol = 0;
+			if(layer->cfg_data != nullptr) {
+				nrow = layer->cfg_nrow;
+				ncol = layer->cfg_ncol;
+			}
+			io.val(nrow);
+			io.val(ncol);
+			if(nrow > 0 && ncol > 0) io.raw(layer->cfg_data[0], (size_t)nrow * ncol * sizeof(int));
+		}
+	}
+
+	fclose(F);
+
+	if(io.error == true) {
+		printf("Error : Failed to write the snapshot '%s'\n", filename);
+		return -1;
+	}
+
+	return 0;
+}
+
+int Network::snapshot_load(const char* filename) {
+	FILE* F = fopen(filename, "rb");
+	if(F == NULL) {
+		printf("Error : Can't open file '%s'\n", filename);
+		return -1;
+	}
+
+	SnapshotIO io;
+	io.F = F;
+	io.save = false;
+
+	nn_snapshot_header_t header;
+	io.raw(&header, sizeof(header));
+	if(io.error == true || memcmp(header.magic, NN_SNAPSHOT_MAGIC, sizeof(header.magic)) != 0) {
+		printf("Error : File '%s' is not a network snapshot\n", filename);
+		fclose(F);
+		return -1;
+	}
+	if(header.version != NN_SNAPSHOT_VERSION) {
+		printf("Error : Snapshot '%s' has version %u, only version %u is supported\n", filename, header.version, NN_SNAPSHOT_VERSION);
+		fclose(F);
+		return -1;
+	}
+
+	// The current network is replaced
+	clear();
+
+	// Network parameters and counters, links to layers are resolved after creation of the layers
+	snapshot_network_fields(io, this);
+	uint32_t idx_nb = 0;
+	io.val(idx_nb);
+	if(io.error == false) layers_idx.resize(idx_nb, 0);
+	for(unsigned i=0; i<idx_nb && io.error == false; i++) io.val(layers_idx[i]);
+	io.val(layers_idxhw);
+	io.val(layers_idxcfg);
+	int32_t idx_first = -1;
+	int32_t idx_last = -1;
+	io.val(idx_first);
+	io.val(idx_last);
+
+	// Create the layers
+	unsigned errors_nb = 0;
+	for(unsigned i=0; i<header.layers_nb && io.error == false; i++) {
+		uint32_t type = 0;
+		char* type_name = nullptr;
+		bool is_custom = false;
+		char* entity = nullptr;
+		io.val(type);
+		io.str(type_name);
+		io.val(is_custom);
+		if(is_custom == true) io.str(entity);
+		if(io.error == true) break;
+
+		// Define a custom layer type that the program does not know yet
+		if(is_custom == true && strcmp(Layer::get_type_id2namel(type), "unknown") == 0) {
+			Layer* ref_layer = new LayerCustom();
+			ref_layer->type = type;
+			ref_layer->typenamel = strdup(type_name);
+			char* nameu = strdup(type_name);
+			for(unsigned c=0; nameu[c]!=0; c++) nameu[c] = toupper(nameu[c]);
+			ref_layer->typenameu = nameu;
+			ref_layer->custom_entity = entity;
+			entity = nullptr;
+			int z = Layer::register_type(ref_layer, ref_layer->typenamel);
+			if(z != 0) errors_nb++;
+		}
+
+		Layer* layer = nullptr;
+		if(strcmp(Layer::get_type_id2namel(type), type_name) != 0) {
+			printf("Error : Layer %u has type %u '%s' in the snapshot, but this type is '%s' in this program\n", i, type, type_name, Layer::get_type_id2namel(type));
+			errors_nb++;
+		}
+		else {
+			layer = Layer::create_new_from_id_verbose(type, nullptr);
+		}
+
+		free(type_name);
+		free(entity);
+
+		if(layer == nullptr) {
+			errors_nb++;
+			break;
+		}
+
+		// The layer type is fully given by the snapshot, no network defaults are applied
+		layer->type = type;
+		layer->network = this;
+		// Owned strings of the reference layer are not shared
+		if(is_custom == true) layer->custom_entity = strdup(layer->custom_entity);
+		layers.push_back(layer);
+	}
+	if(io.error == false && errors_nb == 0 && layers.size() != header.layers_nb) errors_nb++;
+
+	// Layer fields
+	io.layers = layers;
+	for(auto layer : layers) {
+		if(io.error == true || errors_nb > 0) break;
+		snapshot_layer_fields(io, layer);
+	}
+	if(io.error == false && errors_nb == 0) {
+		layer_first = (idx_first >= 0 && idx_first < (int32_t)layers.size()) ? layers[idx_first] : nullptr;
+		layer_last  = (idx_last  >= 0 && idx_last  < (int32_t)layers.size()) ? layers[idx_last]  : nullptr;
+	}
+
+	// Configuration data
+	if((header.flags & NN_SNAPSHOT_CFGDATA) != 0) {
+		for(auto layer : layers) {
+			if(io.error == true || errors_nb > 0) break;
+			uint32_t nrow = 0;
+			uint32_t ncol = 0;
+			io.val(nrow);
+			io.val(ncol);
+			if(io.error == true || nrow == 0 || ncol == 0) continue;
+			layer->cfg_data = array_create_dim2(nrow, ncol);
+			layer->cfg_nrow = nrow;
+			layer->cfg_ncol = ncol;
+			io.raw(layer->cfg_data[0], (size_t)nrow * ncol * sizeof(int));
+		}
+	}
+
+	fclose(F);
+
+	if(io.error == true) {
+		printf("Error : Snapshot '%s' is truncated or corrupted\n", filename);
+		errors_nb++;
+	}
+	if(errors_nb == 0) {
+		errors_nb += check_integrity();
+	}
+	if(errors_nb > 0) {
+		printf("Error : Failed to load the snapshot '%s'\n", filename);
+		clear();
+		return -1;
+	}
+
+	return 0;
+}
+
@@ -0,0 +1,35 @@
+
+#pragma once
+
+extern "C" {
+#include <stdint.h>
+}
+
+
+//============================================
+// Binary snapshot of a finalized network
+//============================================
+
+// The snapshot contains all fields of the network and of its layers, so it can be loaded in place of the Tcl script that built it
+// The file begins with a header, then :
+// - the parameters and counters of the network, and the decoding of YOLO regions if any
+// - the type of each layer, with the definition of custom layer types
+// - the fields of each layer, links to other layers are stored as indexes in the vector of layers
+// - optionally the configuration data of each layer
+// Values have fixed sizes and are stored in host endianness
+// The version must be incremented each time a field of the network or of the layers is added, removed or reordered
+
+#define NN_SNAPSHOT_MAGIC   "NNAWSNP"  // With the terminating null character, this is 8 bytes
+#define NN_SNAPSHOT_VERSION 5
+
+// Flags in header
+#define NN_SNAPSHOT_CFGDATA 0x01  // The configuration data is present
+
+typedef struct nn_snapshot_header_t {
+	char     magic[8];
+	uint32_t version;
+	uint32_t flags;
+	uint32_t layers_nb;
+	uint32_t reserved;
+} nn_snapshot_header_t;
+
@@ -0,0 +1,467 @@
+
+// Tuning of data and weight widths, with the software execution as reference
+
+extern "C" {
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <math.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "nnawaq_utils.h"
+
+}
+
+#include "nn_layers_utils.h"
+#include "nn_hw_config.h"
+#include "swexec.h"
+
+#include "nn_tune_widths.h"
+
+using namespace std;
+
+
+//============================================
+// Tuned parameters
+//============================================
+
+static const char* tune_metric_names[TUNE_METRIC_NB] = { "mismatch", "maxerr", "top1" };
+
+int nn_tune_widths_metric(const char* name) {
+	for(unsigned i=0; i<TUNE_METRIC_NB; i++) {
+		if(strcmp(name, tune_metric_names[i]) == 0) return i;
+	}
+	return -1;
+}
+
+typedef struct tune_knob_t {
+	unsigned layer_idx;  // Position in the vector of layers, this is the same in copies of the network
+	bool     weights;    // Weight width, or output width
+	unsigned width_ref;
+	unsigned width_min;
+} tune_knob_t;
+
+// Layers that accept a user-specified output width
+static bool tune_layer_has_wout(Layer* layer) {
+	switch(layer->type) {
+		case LAYER_NEU :
+		case LAYER_NEU_CM :
+		case LAYER_POOL :
+		case LAYER_NORM :
+		case LAYER_RELU :
+		case LAYER_LEAKY :
+		case LAYER_ADD :
+			return true;
+		default :
+			break;
+	}
+	return false;
+}
+
+static void tune_saturate_weights(Layer* layer, unsigned width) {
+	if(layer->cfg_data == nullptr) return;
+
+	bool sgn = (layer->neu_sgnw & NEUSGN_SIGNED) != 0;
+	int vmin = sgn ? -(1 << (width - 1)) : 0;
+	int vmax = sgn ? (1 << (width - 1)) - 1 : (1 << width) - 1;
+
+	layer->cfg_data_unshare(layer->neurons, layer->fsize);
+	for(unsigned n=0; n<layer->neurons; n++) {
+		int* weights = layer->cfg_data[n];
+		for(unsigned i=0; i<layer->fsize; i++) {
+			if(weights[i] < vmin) weights[i] = vmin;
+			else if(weights[i] > vmax) weights[i] = vmax;
+		}
+	}
+}
+
+// Return non-zero if the parameters could not be propagated
+static int tune_apply(Network* network, const vector<tune_knob_t>& knobs, const vector<unsigned>& widths) {
+	for(unsigned k=0; k<knobs.size(); k++) {
+		auto& knob = knobs[k];
+		Layer* layer = network->layers[knob.layer_idx];
+		if(widths[k] >= knob.width_ref) continue;
+		if(knob.weights == true) {
+			layer->neu_wweight = widths[k];
+			tune_saturate_weights(layer, widths[k]);
+		}
+		else {
+			layer->user_wout = widths[k];
+		}
+	}
+	return network->propag_params();
+}
+
+
+//============================================
+// Evaluation of one configuration
+//============================================
+
+typedef struct tune_context_t {
+	Network* network = nullptr;
+	vector<tune_knob_t> knobs;
+	unsigned metric = TUNE_METRIC_MISMATCH;
+	unsigned frames_nb = 0;
+	int**    dataframes = nullptr;
+	unsigned out_size = 0;   // Output values per frame
+	vector<int> out_ref;     // Output values of all frames, with the reference widths
+} tune_context_t;
+
+// Software execution of all calibration frames, the outputs of the last layer are saved
+static int tune_run(Network* network, const tune_context_t& ctx, vector<int>& out) {
+	network->swexec_opt_quiet = true;
+	int z = swexec_begin(network, false, false);
+	if(z != 0) return z;
+
+	layer_t* lastlayer = network->layer_last;
+	vector<int> buf(GetMax(ctx.out_size, lastlayer->nbframes * lastlayer->fsize));
+	out.resize((size_t)ctx.frames_nb * ctx.out_size);
+
+	for(unsigned f=0; f<ctx.frames_nb; f++) {
+		z = swexec_oneframe(network, lastlayer, ctx.dataframes[f], buf.data(), f);
+		if(z != 0) break;
+		memcpy(out.data() + (size_t)f * ctx.out_size, buf.data(), ctx.out_size * sizeof(int));
+	}
+
+	swexec_end(network);
+	return z;
+}
+
+static double tune_error(const tune_context_t& ctx, const vector<int>& out) {
+	double error = 0;
+	unsigned long mismatch = 0;
+
+	for(unsigned f=0; f<ctx.frames_nb; f++) {
+		const int* ref = ctx.out_ref.data() + (size_t)f * ctx.out_size;
+		const int* val = out.data() + (size_t)f * ctx.out_size;
+		if(ctx.metric == TUNE_METRIC_TOP1) {
+			unsigned idx_ref = 0, idx_val = 0;
+			for(unsigned i=1; i<ctx.out_size; i++) {
+				if(ref[i] > ref[idx_ref]) idx_ref = i;
+				if(val[i] > val[idx_val]) idx_val = i;
+			}
+			mismatch += (idx_ref != idx_val);
+			continue;
+		}
+		for(unsigned i=0; i<ctx.out_size; i++) {
+			mismatch += (val[i] != ref[i]);
+			error = GetMax(error, fabs((double)val[i] - ref[i]));
+		}
+	}
+
+	if(ctx.metric == TUNE_METRIC_MISMATCH) return (double)mismatch / ((double)ctx.frames_nb * ctx.out_size);
+	if(ctx.metric == TUNE_METRIC_TOP1) return (double)mismatch / ctx.frames_nb;
+	return error;
+}
+
+// Same evaluation of resources as in ExploreConfig::evaluate()
+static void tune_eval_resources(Network* network, TuneWidthsConfig& config) {
+	network->total_neurons     = 0;
+	network->total_neurons_phy = 0;
+	network->total_multipliers = 0;
+	network->total_weights     = 0;
+	network->total_weight_bits = 0;
+	network->total_macs        = 0;
+
+	unsigned lutram = 0;
+	config.luts = 0;
+	config.bram18 = 0;
+	config.data_bits = 0;
+
+	for(auto layer : network->layers) {
+		unsigned neurons_phy = network->total_neurons_phy;
+		layer->hwconfig_finalize();
+		layer->eval_mem_size();
+		layer->mem.EvalBlocks(network->hwconfig_lut_threshold, network->hwconfig_use_uram);
+
+		if(layer->mem.style == MemImplem::STYLE_LUTRAM) lutram += layer->mem.blocks;
+		else if(layer->mem.style == MemImplem::STYLE_BRAM) config.bram18 += layer->mem.blocks;
+
+		if(layer->type == LAYER_NEU || layer->type == LAYER_NEU_CM) {
+			neurons_phy = network->total_neurons_phy - neurons_phy;
+			config.luts += (unsigned long)neurons_phy * hwconfig_luts_per_neuron(layer->neu_style, layer->wdata, layer->neu_waccu, layer->split_in);
+		}
+
+		// Width of the data path to the next layer, this is the width of the FIFOs inserted at finalization
+		config.data_bits += (unsigned long)layer->out_wdata * layer->split_out;
+	}
+
+	config.luts += lutram;
+	config.weight_bits = network->total_weight_bits;
+}
+
+static void tune_evaluate(const tune_context_t& ctx, TuneWidthsConfig& config) {
+	Network* network = ctx.network->clone();
+
+	int z = tune_apply(network, ctx.knobs, config.widths);
+	if(z == 0) {
+		// Narrower inputs or weights may have reduced the natural output width below the requested one
+		config.widths_eff = config.widths;
+		for(unsigned k=0; k<ctx.knobs.size(); k++) {
+			auto& knob = ctx.knobs[k];
+			Layer* layer = network->layers[knob.layer_idx];
+			if(knob.weights == false) config.widths_eff[k] = GetMin(config.widths[k], layer->out_wdata);
+		}
+		vector<int> out;
+		z = tune_run(network, ctx, out);
+		if(z == 0) config.error = tune_error(ctx, out);
+	}
+	if(z == 0) {
+		tune_eval_resources(network, config);
+		config.valid = true;
+	}
+
+	network->clear();
+	delete network;
+}
+
+// Relative cost compared to the reference configuration
+static double tune_cost(const TuneWidthsConfig& config, const TuneWidthsConfig& ref) {
+	double cost = 0;
+	if(ref.weight_bits > 0) cost += (double)config.weight_bits / ref.weight_bits;
+	if(ref.luts > 0)        cost += (double)config.luts / ref.luts;
+	if(ref.bram18 > 0)      cost += (double)config.bram18 / ref.bram18;
+	if(ref.data_bits > 0)   cost += (double)config.data_bits / ref.data_bits;
+	return cost;
+}
+
+
+//============================================
+// Pool of threads
+//============================================
+
+typedef struct tune_pool_t {
+	const tune_context_t* ctx;
+	vector<TuneWidthsConfig>* configs;
+	pthread_mutex_t mutex;
+	unsigned next;
+} tune_pool_t;
+
+static void* tune_thread(void* arg) {
+	tune_pool_t* pool = (tune_pool_t*)arg;
+
+	do {
+		pthread_mutex_lock(&pool->mutex);
+		unsigned idx = pool->next++;
+		pthread_mutex_unlock(&pool->mutex);
+		if(idx >= pool->configs->size()) break;
+		tune_evaluate(*pool->ctx, (*pool->configs)[idx]);
+	} while(1);
+
+	return NULL;
+}
+
+static void tune_evaluate_all(const tune_context_t& ctx, vector<TuneWidthsConfig>& configs, unsigned threads_nb) {
+	if(threads_nb > configs.size()) threads_nb = configs.size();
+
+	tune_pool_t pool;
+	pool.ctx = &ctx;
+	pool.configs = &configs;
+	pthread_mutex_init(&pool.mutex, NULL);
+	pool.next = 0;
+
+	vector<pthread_t> threads(threads_nb);
+	for(unsigned i=0; i<threads_nb; i++) {
+		pthread_create(&threads[i], NULL, tune_thread, &pool);
+	}
+	for(unsigned i=0; i<threads_nb; i++) {
+		pthread_join(threads[i], NULL);
+	}
+	pthread_mutex_destroy(&pool.mutex);
+}
+
+
+//============================================
+// Tuning
+//============================================
+
+static void tune_print_config(const char* title, const TuneWidthsConfig& config, const TuneWidthsParams& params) {
+	printf("  %-10s : %s %g, weight bits %lu, luts %lu, bram18 %u, data bits %lu\n",
+		title, tune_metric_names[params.metric], config.error, config.weight_bits, config.luts, config.bram18, config.data_bits
+	);
+}
+
+int nn_tune_widths(Network* network, const TuneWidthsParams& params) {
+
+	if(network->layers.empty()) {
+		printf("Error : The network is empty\n");
+		return -1;
+	}
+	for(auto layer : network->layers) {
+		if(layer->type == LAYER_FIFO) {
+			printf("Error : The tuning of widths must be done before the hardware configuration is finalized\n");
+			return -1;
+		}
+	}
+	if(params.metric >= TUNE_METRIC_NB) {
+		printf("Error : Invalid error metric %u\n", params.metric);
+		return -1;
+	}
+
+	unsigned frames_nb = params.frames_nb;
+	if(frames_nb == 0) frames_nb = param_fn;
+	if(frames_nb == 0) {
+		printf("Error: frames = %u\n", frames_nb);
+		return -1;
+	}
+
+	// Load configuration data, copies of the network share it
+	int z = network->load_config_files();
+	if(z != 0) return -1;
+
+	tune_context_t ctx;
+	ctx.network   = network;
+	ctx.metric    = params.metric;
+	ctx.frames_nb = frames_nb;
+	ctx.out_size  = network->layer_last->out_nbframes * network->layer_last->out_fsize;
+
+	// List the tuned parameters
+	for(unsigned i=0; i<network->layers.size(); i++) {
+		Layer* layer = network->layers[i];
+		if((layer->type == LAYER_NEU || layer->type == LAYER_NEU_CM) && layer->cfg_data != nullptr) {
+			tune_knob_t knob;
+			knob.layer_idx = i;
+			knob.weights   = true;
+			knob.width_ref = layer->neu_wweight;
+			knob.width_min = (layer->neu_sgnw & NEUSGN_SIGNED) ? 2 : 1;
+			if(knob.width_ref > knob.width_min) ctx.knobs.push_back(knob);
+		}
+		if(tune_layer_has_wout(layer) == true) {
+			tune_knob_t knob;
+			knob.layer_idx = i;
+			knob.weights   = false;
+			knob.width_ref = layer->out_wdata;
+			knob.width_min = 1 + (layer->out_sdata ? 1 : 0);
+			if(knob.width_ref > knob.width_min) ctx.knobs.push_back(knob);
+		}
+	}
+	if(ctx.knobs.empty()) {
+		printf("No width to tune\n");
+		return 0;
+	}
+
+	ctx.dataframes = swexec_load_frames(network, frames_nb);
+	if(ctx.dataframes == nullptr) return -1;
+
+	// Outputs with the reference widths
+	Network* network_ref = network->clone();
+	z = tune_run(network_ref, ctx, ctx.out_ref);
+	network_ref->clear();
+	delete network_ref;
+	if(z != 0) {
+		free(ctx.dataframes[0]);
+		free(ctx.dataframes);
+		return -1;
+	}
+
+	// The experimental weight decompressors write to a shared file during finalization
+	bool thread_safe = true;
+	if(network->default_comp_all_style > 5 || network->default_comp_bram_style > 5 || network->default_comp_fc_style > 5) thread_safe = false;
+	for(auto layer : network->layers) {
+		if(layer->neu_comp_style > 5) thread_safe = false;
+	}
+
+	unsigned threads_nb = params.threads_nb;
+	if(threads_nb == 0) {
+		long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+		threads_nb = (cpus > 0) ? cpus : 1;
+	}
+	if(thread_safe == false) threads_nb = 1;
+
+	printf("Tuning of widths : %zu parameters, %u frames, metric %s, budget %g, %u threads\n",
+		ctx.knobs.size(), frames_nb, tune_metric_names[params.metric], params.budget, threads_nb
+	);
+
+	TuneWidthsConfig config_ref;
+	for(auto& knob : ctx.knobs) config_ref.widths.push_back(knob.width_ref);
+	tune_evaluate(ctx, config_ref);
+	if(config_ref.valid == false) {
+		printf("Error : The reference configuration could not be evaluated\n");
+		free(ctx.dataframes[0]);
+		free(ctx.dataframes);
+		return -1;
+	}
+
+	// Remove one bit at a time, keep the candidate with the lowest cost within the error budget
+	TuneWidthsConfig best = config_ref;
+	double best_cost = tune_cost(best, config_ref);
+	unsigned steps_nb = 0;
+
+	do {
+		vector<TuneWidthsConfig> configs;
+		vector<unsigned> configs_knob;
+		for(unsigned k=0; k<ctx.knobs.size(); k++) {
+			// Start from the effective width, so the candidate is not a width that changes nothing
+			if(best.widths_eff[k] <= ctx.knobs[k].width_min) continue;
+			TuneWidthsConfig config;
+			config.widths = best.widths;
+			config.widths[k] = best.widths_eff[k] - 1;
+			configs.push_back(config);
+			configs_knob.push_back(k);
+		}
+		if(configs.empty()) break;
+
+		tune_evaluate_all(ctx, configs, threads_nb);
+
+		int sel = -1;
+		double sel_cost = best_cost;
+		for(unsigned c=0; c<configs.size(); c++) {
+			auto& config = configs[c];
+			if(config.valid == false || config.error > params.budget) continue;
+			double cost = tune_cost(config, config_ref);
+			if(cost > sel_cost) continue;
+			if(cost == sel_cost && (sel < 0 || config.error >= configs[sel].error)) continue;
+			sel = c;
+			sel_cost = cost;
+		}
+		if(sel < 0) break;
+
+		best = configs[sel];
+		best_cost = sel_cost;
+		steps_nb++;
+
+		auto& knob = ctx.knobs[configs_knob[sel]];
+		Layer* layer = network->layers[knob.layer_idx];
+		printf("  Step %u : layer %s%u %s %u bits : %s %g, weight bits %lu, luts %lu, bram18 %u, data bits %lu\n", steps_nb,
+			layer->typenamel, layer->typeidx, knob.weights ? "weights" : "outputs", best.widths_eff[configs_knob[sel]],
+			tune_metric_names[params.metric], best.error, best.weight_bits, best.luts, best.bram18, best.data_bits
+		);
+
+	} while(1);
+
+	free(ctx.dataframes[0]);
+	free(ctx.dataframes);
+
+	// Report
+	printf("Tuned widths :\n");
+	printf("  Layer      weights    outputs\n");
+	for(unsigned i=0; i<network->layers.size(); i++) {
+		Layer* layer = network->layers[i];
+		char buf_w[32] = "";
+		char buf_o[32] = "";
+		for(unsigned k=0; k<ctx.knobs.size(); k++) {
+			auto& knob = ctx.knobs[k];
+			if(knob.layer_idx != i) continue;
+			if(knob.weights == true) snprintf(buf_w, sizeof(buf_w), "%u -> %u", knob.width_ref, best.widths_eff[k]);
+			else snprintf(buf_o, sizeof(buf_o), "%u -> %u", knob.width_ref, best.widths_eff[k]);
+		}
+		if(buf_w[0] == 0 && buf_o[0] == 0) continue;
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%s%u", layer->typenamel, layer->typeidx);
+		printf("  %-8s  %8s   %8s\n", buf, buf_w, buf_o);
+	}
+	tune_print_config("Reference", config_ref, params);
+	tune_print_config("Tuned", best, params);
+
+	if(params.apply == true && steps_nb > 0) {
+		z = tune_apply(network, ctx.knobs, best.widths);
+		if(z != 0) return -1;
+	}
+
+	return 0;
+}
+
@@ -0,0 +1,70 @@
+
+#pragma once
+
+extern "C" {
+#include <stdbool.h>
+}
+
+#include <vector>
+
+#include "nn_layers_create.h"
+
+
+//============================================
+// Tuning of data and weight widths
+//============================================
+
+// The widths of layers are reduced one bit at a time, as long as the outputs of the network stay within an error budget
+// The tuned widths are the output width of layers NEU, POOL, NORM, RELU, LEAKY, ADD, like with the layer parameter wout,
+// and the weight width of neuron layers
+// The reference is the software execution of the network with its current widths, on a set of calibration frames
+// Narrower outputs are truncated like in the software execution and in hardware
+// Narrower weights are saturated, the config data of the network is saturated the same way when the result is applied
+// At each step, all candidates with one bit less are evaluated on copies of the network, on a pool of threads,
+// and the candidate with the largest relative savings of weight bits, LUTs, BRAM18 and data bits between layers is kept
+// The data bits between layers are the output width multiplied by the output parallelism, so narrower outputs are rewarded
+// The resources are evaluated like with nn_explore
+// The network must not be finalized yet : the tuning is done before nn_finalize_hw_config
+
+// Error metrics on the outputs of the last layer
+#define TUNE_METRIC_MISMATCH  0  // Ratio of output values that differ
+#define TUNE_METRIC_MAXERR    1  // Max absolute difference
+#define TUNE_METRIC_TOP1      2  // Ratio of frames where the index of the max output differs
+#define TUNE_METRIC_NB        3
+
+class TuneWidthsConfig {
+
+	public :
+
+	// Parameters, one width per tuned parameter
+	std::vector<unsigned> widths;
+	// Widths obtained after propagation, output widths may be lower than requested
+	std::vector<unsigned> widths_eff;
+
+	// Results
+	bool     valid = false;
+	double   error = 0;
+	unsigned long weight_bits = 0;
+	unsigned long luts = 0;
+	unsigned bram18 = 0;
+	unsigned long data_bits = 0;
+
+};
+
+class TuneWidthsParams {
+
+	public :
+
+	unsigned metric = TUNE_METRIC_MISMATCH;
+	double   budget = 0;         // Max error, zero means the outputs must be identical
+	unsigned frames_nb = 0;      // Zero means the number of frames of the global parameters
+	unsigned threads_nb = 0;     // Zero means the number of processors
+
+	// Apply the tuned widths to the network
+	bool apply = false;
+
+};
+
+int  nn_tune_widths_metric(const char* name);
+int  nn_tune_widths(Network* network, const TuneWidthsParams& params);
+
@@ -36,6 +36,14 @@ extern "C" {
 #endif
 
 #include "hwacc_common.h"
+#include "hwacc_emu.h"
+#include "hwacc_trace.h"
+#include "hwacc_server.h"
+#include "nn_infer_server.h"
+#include "hwacc_wait.h"
+#include "hwacc_timing.h"
+#include "hwacc_fifomon.h"
+#include "nn_out_writer.h"
 
 #ifdef HAVE_RIFFA
 #include "hwacc_pcieriffa.h"
@@ -92,6 +100,12 @@ void print_usage(int argc, char** argv) {
 	printf("\n");
 	#endif    // ifndef NOTCL
 
+	printf("Options for network snapshots:\n");
+	printf("  -save-snapshot <file>      Save the current network in a binary snapshot\n");
+	printf("  -save-snapshot-cfg <file>  Same, and include the configuration data, loaded if needed\n");
+	printf("  -load-snapshot <file>      Replace the current network by the one saved in a snapshot, instead of building it\n");
+	printf("\n");
+
 	printf("Options for NN topology:\n");
 	printf("  -f <x> <y> <z>    Input frame size, 3 dimensions\n");
 	printf("  -bin              Build binary neural networks\n");
@@ -120,6 +134,7 @@ void print_usage(int argc, char** argv) {
 	printf("  -ofmt-norm <f>    Raw output data follows printf-compatible format <f>\n");
 	printf("                    This is with normalization data, output data type is double\n");
 	printf("  -omask            Raw output data has a mask on raw data bits, useful for dump as hex (does not apply with normalization data)\n");
+	printf("  -obin <m>         Binary output data, no formatting : none, 8, 16, 32 (little-endian integers) or nnf (container with header)\n");
 	printf("  -rand-range <min> <max> Range of random data to use in case of missing configuration data\n");
 	printf("  -gencsv-rand <l> <c>  Generate CSV data, random, <l> lines and <c> columns\n");
 	printf("  -gencsv-id <r> <c>\n");
@@ -170,10 +185,19 @@ void print_usage(int argc, char** argv) {
 
 	printf("Options for hardware accelerator usage:\n");
 	printf("  -hw-fbufsz <sz>   Use a buffer size of max <sz> MB to send frames to hardware (default %u)\n", param_bufsz_mb);
+	printf("  -hw-fbufsz-auto <o> Auto-tune the number of frames per batch, within the max buffer size\n");
+	printf("                    Objective <o> is fps (max frames/s), a p99 latency target with time unit (e.g. 5ms), or none\n");
 	printf("  -hw-freerun       Disable sending hardware accelerator results back to computer (outputs are still counted in hardware side)\n");
 	printf("  -hw-timeout <ms>  Timeout at receiving frame results, in seconds (0 means no timeout)\n");
 	printf("  -hw-blind         Enable blind run on the hardware accelerator by assuming the current network is the one being implemented in HW:\n");
 	printf("                    Don't try to get/set parameters, but still send config data and frames\n");
+	printf("  -hw-lowlat        Send frames one at a time with minimal host overhead, and print a latency histogram\n");
+	printf("  -hw-hugepages     Use hugepages for the buffers of frames and results, if available\n");
+	printf("  -hw-wait <s>      Strategy to wait for FIFOs : adaptive (default), spin, pause, backoff, sleep\n");
+	printf("  -hw-hist          Print percentiles of per-frame and per-batch timings, and throughput of data streams\n");
+	printf("  -hw-hist-json <f> Export the timing histograms to a JSON file\n");
+	printf("  -hw-fifomon <hz>  Sample the FIFOs at this rate while frames are streamed, and report the bottleneck layer\n");
+	printf("  -hw-fifomon-csv <f>  Export the time series of FIFO occupancy to a CSV file\n");
 	printf("\n");
 
 	#ifdef HAVE_RIFFA
@@ -186,9 +210,31 @@ void print_usage(int argc, char** argv) {
 	#ifdef HAVE_ZYNQ7
 	printf("Options for Zynq-7000 hardware accelerators:\n");
 	printf("  -zynq7-init        Detect PCIe accelerator\n");
+	printf("  -zynq7-mock <rx> <tx>\n");
+	printf("                     Simulate the register window, FIFOs consume <rx> and produce <tx> words/us\n");
+	printf("  -zynq7-bench <nb>  Send and receive <nb> 32b words, print throughput and stats of the wait strategy\n");
 	printf("\n");
 	#endif  // ifdef HAVE_ZYNQ7
 
+	printf("Options for the emulated hardware accelerator:\n");
+	printf("  -emu-init          Emulate a hardware accelerator for the current network, results are computed in software\n");
+	printf("  -trace-record <f>  Record the traffic with the current hardware accelerator into a trace file\n");
+	printf("  -trace-record-full <f>  Same, and store the sent data instead of only its hash\n");
+	printf("  -trace-replay <f>  Use a recorded trace in place of a hardware accelerator\n");
+	printf("  -trace-replay-timed <f>  Same, and reproduce the durations of data transfers\n");
+	printf("\n");
+
+	printf("Options for sharing a hardware accelerator between processes:\n");
+	printf("  -serve <sock>      Configure the current hardware accelerator, then serve clients on a UNIX socket until SIGINT or SIGTERM\n");
+	printf("  -serve-batch-us <us>  Wait for jobs of other clients before launching a batch (default 0)\n");
+	printf("  -hwacc-client <sock>  Use the hardware accelerator of a server, the accelerator is already configured\n");
+	printf("\n");
+
+	printf("Options for the persistent inference server:\n");
+	printf("  -infer-mode <sw|hw>  Execution engine of the inference server (default hw if an accelerator is initialized)\n");
+	printf("  -infer-serve <sock>  Load the network once, then serve inference requests on a UNIX socket, or on stdin with -\n");
+	printf("\n");
+
 	printf("Options for using the hardware accelerator:\n");
 	printf("  -hwacc-init        Automatically find a hardware accelerator\n");
 	printf("  -hwacc-clear       Send clear signal to hardware accelerator\n");
@@ -204,6 +250,7 @@ void print_usage(int argc, char** argv) {
 	printf("Options for ASIC estimations:\n");
 	printf("  -asic             Launch diginal ASIC estimations\n");
 	printf("  -analog           Launch analog ASIC estimations\n");
+	printf("  -activity         Measure data activity of layers with software execution, used by estimations\n");
 	printf("  -sci              Print stats using scientific notation\n");
 	printf("  -st-ll10          Use power calibration for ST LL 1.0V\n");
 	printf("  -st-ll06          Use power calibration for ST LL 0.6V\n");
@@ -329,6 +376,16 @@ static int read_params(int argc, char** argv) {
 
 		#endif
 
+		else if(strcmp(arg, "-save-snapshot")==0 || strcmp(arg, "-save-snapshot-cfg")==0) {
+			bool with_cfg = strcmp(arg, "-save-snapshot-cfg")==0;
+			int z = network->snapshot_save(getparam_str(), with_cfg);
+			if(z != 0) exit(EXIT_FAILURE);
+		}
+		else if(strcmp(arg, "-load-snapshot")==0) {
+			int z = network->snapshot_load(getparam_str());
+			if(z != 0) exit(EXIT_FAILURE);
+		}
+
 		else if(strcmp(arg, "-debug")==0) {
 			param_debug = true;
 		}
@@ -404,6 +461,12 @@ static int read_params(int argc, char** argv) {
 		else if(strcmp(arg, "-ofmt")==0) {
 			param_out_format = strdup(getparam_str());
 		}
+		else if(strcmp(arg, "-obin")==0) {
+			char* param = getparam_str();
+			OutWriter::mode_type mode = OutWriter::GetModeVerbose(param);
+			if(mode == (OutWriter::mode_type)-1) exit(EXIT_FAILURE);
+			param_out_bin = mode;
+		}
 
 		else if(strcmp(arg, "-print")==0) {
 			nnprint_oneline(network->layers, "");
@@ -516,6 +579,14 @@ static int read_params(int argc, char** argv) {
 		else if(strcmp(arg, "-hw-fbufsz")==0) {
 			param_bufsz_mb = atoi(getparam_str());
 		}
+		else if(strcmp(arg, "-hw-fbufsz-auto")==0) {
+			char* param = getparam_str();
+			int z = decodeparam_bufsz_auto(param, &param_bufsz_auto, &param_bufsz_lat_us);
+			if(z != 0) {
+				printf("Error: Invalid objective '%s' for option '%s'\n", param, arg);
+				exit(EXIT_FAILURE);
+			}
+		}
 		else if(strcmp(arg, "-hw-freerun")==0) {
 			param_freerun = true;
 		}
@@ -529,6 +600,29 @@ static int read_params(int argc, char** argv) {
 		else if(strcmp(arg, "-hw-blind")==0) {
 			param_hw_blind = true;
 		}
+		else if(strcmp(arg, "-hw-lowlat")==0) {
+			param_hw_lowlat = true;
+		}
+		else if(strcmp(arg, "-hw-hugepages")==0) {
+			param_hw_hugepages = true;
+		}
+		else if(strcmp(arg, "-hw-wait")==0) {
+			HwAcc_Wait::mode_type mode = HwAcc_Wait::GetModeVerbose(getparam_str());
+			if(mode == (HwAcc_Wait::mode_type)-1) exit(EXIT_FAILURE);
+			param_hw_wait = mode;
+		}
+		else if(strcmp(arg, "-hw-hist")==0) {
+			param_hw_hist = true;
+		}
+		else if(strcmp(arg, "-hw-hist-json")==0) {
+			param_hw_hist_json = getparam_str();
+		}
+		else if(strcmp(arg, "-hw-fifomon")==0) {
+			param_hw_fifomon_hz = atoi(getparam_str());
+		}
+		else if(strcmp(arg, "-hw-fifomon-csv")==0) {
+			param_hw_fifomon_csv = getparam_str();
+		}
 
 		#ifdef HAVE_RIFFA
 		else if(strcmp(arg, "-riffa-init")==0) {
@@ -547,8 +641,70 @@ static int read_params(int argc, char** argv) {
 			HwAcc_Common* hwacc = HwAcc_Zynq7::GetSingleton();
 			HwAcc_Common::CurrentHwAcc_Set(hwacc);
 		}
+		else if(strcmp(arg, "-zynq7-mock")==0) {
+			double rx_rate = atof(getparam_str());
+			double tx_rate = atof(getparam_str());
+			HwAcc_Common* hwacc = HwAcc_Zynq7::GetSingletonMock(rx_rate, tx_rate);
+			HwAcc_Common::CurrentHwAcc_Set(hwacc);
+		}
+		else if(strcmp(arg, "-zynq7-bench")==0) {
+			unsigned nb32 = atoi(getparam_str());
+			HwAcc_Zynq7* hwacc = dynamic_cast<HwAcc_Zynq7*>(HwAcc_Common::CurrentHwAcc_GetCheck());
+			if(hwacc == nullptr) {
+				printf("Error: The current hardware accelerator is not Zynq7\n");
+				exit(EXIT_FAILURE);
+			}
+			hwacc->zynq7_bench(nb32);
+		}
 		#endif  // ifdef HAVE_ZYNQ7
 
+		else if(strcmp(arg, "-emu-init")==0) {
+			HwAcc_Common* hwacc = HwAcc_Emu::GetSingleton(network);
+			HwAcc_Common::CurrentHwAcc_Set(hwacc);
+		}
+		else if(strcmp(arg, "-trace-record")==0 || strcmp(arg, "-trace-record-full")==0) {
+			bool full = strcmp(arg, "-trace-record-full")==0;
+			HwAcc_Common* inner = HwAcc_Common::CurrentHwAcc_GetCheck();
+			HwAcc_Common* hwacc = HwAcc_Record::OpenSingleton(inner, getparam_str(), full);
+			if(hwacc == nullptr) exit(EXIT_FAILURE);
+			HwAcc_Common::CurrentHwAcc_Set(hwacc);
+		}
+		else if(strcmp(arg, "-trace-replay")==0 || strcmp(arg, "-trace-replay-timed")==0) {
+			bool timed = strcmp(arg, "-trace-replay-timed")==0;
+			HwAcc_Common* hwacc = HwAcc_Replay::OpenSingleton(getparam_str(), timed);
+			if(hwacc == nullptr) exit(EXIT_FAILURE);
+			HwAcc_Common::CurrentHwAcc_Set(hwacc);
+		}
+
+		else if(strcmp(arg, "-serve")==0) {
+			HwAcc_Common* hwacc = HwAcc_Common::CurrentHwAcc_GetCheck();
+			HwAcc_Server server(hwacc, network);
+			int z = server.serve(getparam_str());
+			if(z != 0) exit(EXIT_FAILURE);
+		}
+		else if(strcmp(arg, "-serve-batch-us")==0) {
+			param_serve_batch_us = atoi(getparam_str());
+		}
+		else if(strcmp(arg, "-infer-mode")==0) {
+			const char* str = getparam_str();
+			if(strcmp(str, "sw")==0) param_infer_mode = InferServer::MODE_SW;
+			else if(strcmp(str, "hw")==0) param_infer_mode = InferServer::MODE_HW;
+			else {
+				printf("Error : Unknown inference mode '%s'\n", str);
+				exit(EXIT_FAILURE);
+			}
+		}
+		else if(strcmp(arg, "-infer-serve")==0) {
+			InferServer server(network);
+			int z = server.serve(getparam_str());
+			if(z != 0) exit(EXIT_FAILURE);
+		}
+		else if(strcmp(arg, "-hwacc-client")==0) {
+			HwAcc_Common* hwacc = HwAcc_Client::OpenSingleton(getparam_str());
+			if(hwacc == nullptr) exit(EXIT_FAILURE);
+			HwAcc_Common::CurrentHwAcc_Set(hwacc);
+		}
+
 		else if(strcmp(arg, "-hwacc-init")==0) {
 			HwAcc_Common* hwacc = nullptr;
 
@@ -628,6 +784,11 @@ static int read_params(int argc, char** argv) {
 		else if(strcmp(arg, "-asic-mixed") == 0) {
 			estimasic_mixed(network);
 		}
+		else if(strcmp(arg, "-activity") == 0) {
+			chknonempty(network);
+			int z = swexec_activity(network, param_fn);
+			if(z != 0) exit(EXIT_FAILURE);
+		}
 
 		else if(strcmp(arg, "-fifo-depth") == 0) {
 			fifo_depth = atoi(getparam_str());
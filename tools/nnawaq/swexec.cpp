@@ -18,9 +18,12 @@ extern "C" {
 
 }
 
+#include <map>
+
 #include "nnawaq.h"
 #include "nn_load_config.h"
 #include "swexec.h"
+#include "nn_out_writer.h"
 
 
 // Shared variables
@@ -51,9 +54,11 @@ int64_t shround64_tf2(int64_t val, int shr) {
 	return (val >> shr) + (u > t);
 }
 
-static int swexec_print(FILE* Fo, layer_t* layer, int* bufin, int* bufout, unsigned f) {
-	if(Fo==stdout) printf("RESULT: Frame %u: ", f);
+// The writer for results, active during the loop on frames of swexec()
+static OutWriter swexec_outwr;
 
+static int swexec_print(FILE* Fo, layer_t* layer, int* bufin, int* bufout, unsigned f) {
+	Network* network = layer->network;
 	unsigned mask = ~0;
 	if(param_out_mask==true) mask = ((unsigned)~0) >> (32 - layer->out_wdata);
 
@@ -82,31 +87,39 @@ static int swexec_print(FILE* Fo, layer_t* layer, int* bufin, int* bufout, unsig
 	// Select output side by default
 	unsigned print_fsize = layer->out_nbframes*layer->out_fsize;
 	int*     print_pdata = bufout;
+	unsigned print_wdata = layer->out_wdata;
+	bool     print_sdata = layer->out_sdata;
 
 	// Select input side
-	if(swexec_gen_in==true) {
+	if(network->swexec_opt_gen_in==true) {
 		print_fsize = layer->nbframes*layer->fsize;
 		print_pdata = bufin;
+		print_wdata = layer->wdata;
+		print_sdata = layer->sdata;
 		if(param_out_mask==true) mask = ((unsigned)~0) >> (32 - layer->wdata);
 	}
 
+	// Save outputs for the caller
+	if(network->swexec_capture != NULL) {
+		memcpy(network->swexec_capture, print_pdata, print_fsize * sizeof(*print_pdata));
+		return 0;
+	}
+
+	// Decode the outputs into boxes, instead of printing raw values
+	if(network->layer_region != nullptr && network->swexec_opt_gen_in == false && network->layer_region->decodes(layer) == true) {
+		return network->layer_region->swexec(bufout, nullptr, f, layer);
+	}
+
 	// Print outputs
-	unsigned oidx = 0;
-	for(unsigned i=0; i<print_fsize; i++) {
-		if(swexec_param_mod > 1 && i % swexec_param_mod != 0) continue;
-		if(param_out_nl > 0 && oidx > 0 && oidx % param_out_nl == 0) fprintf(Fo, "\n");
-		else if(oidx > 0 && param_out_sep != NULL) fprintf(Fo, "%s", param_out_sep);
-		fprintf(Fo, param_out_format, print_pdata[i] & mask);
-		oidx++;
+	if(swexec_outwr.IsActive() == false) {
+		unsigned step = GetMax(swexec_param_mod, 1);
+		swexec_outwr.begin(Fo, param_out_bin, print_wdata, print_sdata, (print_fsize + step - 1) / step);
 	}
-	fprintf(Fo, "\n");
-	if(param_out_nl > 0) fprintf(Fo, "\n");
+	swexec_outwr.frame(f, print_pdata, print_fsize, swexec_param_mod, mask);
 
 	return 0;
 }
 
-static int** recode_tcam_style = NULL;
-
 int Layer::swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer) {
 	printf("Error: Layer type %s is not handled yet in swexec\n", typenameu);
 	exit(EXIT_FAILURE);
@@ -116,7 +129,7 @@ int Layer::swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer) {
 int LayerWin::swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer) {
 	// Variable to ease code refactoring
 	Layer* layer = this;
-	printf("Layer Index WIN: %u\n", layer->index);
+	if(param_debug==true) printf("Layer Index WIN: %u\n", layer->index);
 	int* loc_bufout = bufout;
 	unsigned buf_xz = layer->fx * layer->fz;
 
@@ -170,7 +183,7 @@ int LayerWin::swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer) {
 int LayerWin_CM::swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer) {
     // Variable pour faciliter la refactorisation
     Layer* layer = this;
-    printf("Layer Index WIN_CM (YOLOv2 channel-major ordering): %u\n", layer->index);
+    if(param_debug==true) printf("Layer Index WIN_CM (YOLOv2 channel-major ordering): %u\n", layer->index);
 
     // Taille d'une image (pour un canal) en entrée
     unsigned buf_xy = layer->fx * layer->fy;
@@ -227,8 +240,8 @@ int LayerNeu::swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer) {
 			int* weights = layer->cfg_data[n];
 
 			int* arr_recode_tcam = NULL;
-			if(swexec_mode_tcam==true) {
-				arr_recode_tcam = recode_tcam_style[layer->typeidx];
+			if(network->swexec_opt_tcam==true) {
+				arr_recode_tcam = network->swexec_recode_tcam[layer->typeidx];
 			}
 
 			// Normal, digital neuron
@@ -238,7 +251,7 @@ int LayerNeu::swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer) {
 				for(unsigned i=0; i<layer->fsize; i++) sum += weights[i] * loc_bufin[i];
 				for(unsigned i=0; i<layer->fsize; i++) sum2 += weights[i] * loc_bufin[i];
 
-				if (sum2!=sum){
+				if (sum2!=sum && network->swexec_opt_quiet==false){
 					printf("########## Overflow !##########\n\n\n");
 				}
 
@@ -291,8 +304,8 @@ int LayerNeu_CM::swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer)
     for(unsigned n = 0; n < layer->neurons; n++) {
         int* weights = layer->cfg_data[n];
         int* arr_recode_tcam = NULL;
-        if(swexec_mode_tcam == true) {
-            arr_recode_tcam = recode_tcam_style[layer->typeidx];
+        if(network->swexec_opt_tcam == true) {
+            arr_recode_tcam = network->swexec_recode_tcam[layer->typeidx];
         }
 
         // Pour chaque neurone, on parcourt toutes les frames
@@ -311,7 +324,7 @@ int LayerNeu_CM::swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer)
                     int val = bufin[i * layer->nbframes + k];
                     sum2 += weights[i] * val;
                 }
-                if(sum2 != sum) {
+                if(sum2 != sum && network->swexec_opt_quiet == false) {
                     printf("########## Overflow !##########\n\n\n");
                 }
                 // Stockage du résultat dans le buffer de sortie en channel-major
@@ -569,7 +582,7 @@ int LayerFork::swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer) {
 		}
 		// Launch recursion
 		int z = swexec_series_of_layers(arr_layers[i], outlayer, bufin, bufout, f);
-		if(z != 0) return 1;
+		if(z != 0) return z;
 	}
 
 	return 0;
@@ -674,7 +687,7 @@ int LayerScatter::swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer)
 
 		// Launch recursion
 		int z = swexec_series_of_layers(layer_next, outlayer, bufin, bufout, f);
-		if(z != 0) return 1;
+		if(z != 0) return z;
 
 	}  // Successor layers
 
@@ -746,7 +759,141 @@ int LayerFifo::swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer) {
 	return 0;
 }
 
-// Return zero if outlayer has not been reached yet
+//============================================
+// Decoding of YOLO regions
+//============================================
+
+static inline float region_sigmoid(float x) {
+	return 1 / (1 + expf(-x));
+}
+
+// Only the last layer feeds the region decoding
+// Outputs of other layers, and outputs in binary modes, are written as raw values
+bool LayerRegion::decodes(layer_t* outlayer) const {
+	return outlayer == network->layer_last && param_out_bin == OutWriter::MODE_TEXT;
+}
+
+int LayerRegion::decode(layer_t* outlayer, const int* buf, unsigned frames_nb, unsigned frame_stride, unsigned frame_first, std::vector<RegionBox>& boxes) const {
+	unsigned gx = outlayer->out_fx;
+	unsigned gy = outlayer->out_fy;
+	unsigned fz = outlayer->out_fz;
+	unsigned box_size = 5 + classes_nb;
+
+	if(fz != boxes_nb * box_size || (uint64_t)gx * gy * fz > frame_stride) {
+		printf("Error : Layer %s : The output of layer %s%u is %ux%ux%u, expected Z = %u for %u boxes and %u classes\n",
+			typenameu, outlayer->typenamel, outlayer->typeidx, gx, gy, fz, boxes_nb * box_size, boxes_nb, classes_nb
+		);
+		return 1;
+	}
+	if(anchors.size() < 2 * boxes_nb) {
+		printf("Error : Layer %s : Got %u anchor values, expected %u\n", typenameu, (unsigned)anchors.size(), 2 * boxes_nb);
+		return 1;
+	}
+
+	// Dequantization factor, and size of grid cells in pixels
+	float dq = ldexp(scale, -(int)shift);
+	float stride_x = (float)img_size / gx;
+	float stride_y = (float)img_size / gy;
+
+	// The score is at most the objectness, so boxes are rejected from the raw objectness value with one integer comparison
+	// Note : sigmoid(v * dq) >= thresh  <=>  v >= logit(thresh) / dq
+	int64_t raw_min = INT32_MIN;
+	if(thresh >= 1) raw_min = (int64_t)INT32_MAX + 1;
+	else if(thresh > 0) raw_min = ceil(log(thresh / (1 - thresh)) / dq);
+	raw_min = GetMax(raw_min, (int64_t)INT32_MIN);
+
+	for(unsigned f=0; f<frames_nb; f++) {
+		const int* data = buf + (uint64_t)f * frame_stride;
+
+		for(unsigned cy=0; cy<gy; cy++) {
+			for(unsigned cx=0; cx<gx; cx++) {
+				for(unsigned b=0; b<boxes_nb; b++, data+=box_size) {
+					if(data[4] < raw_min) continue;
+
+					// Only the most probable class is kept, so only the sum of the softmax is needed
+					const int* cls_data = data + 5;
+					unsigned cls = 0;
+					for(unsigned i=1; i<classes_nb; i++) if(cls_data[i] > cls_data[cls]) cls = i;
+					float sum = 0;
+					for(unsigned i=0; i<classes_nb; i++) sum += expf((cls_data[i] - cls_data[cls]) * dq);
+
+					float score = region_sigmoid(data[4] * dq) / sum;
+					if(score < thresh) continue;
+
+					// Note : The exponent is saturated to avoid overflow
+					RegionBox box;
+					box.frame = frame_first + f;
+					box.cls   = cls;
+					box.score = score;
+					box.x     = (region_sigmoid(data[0] * dq) + cx) * stride_x;
+					box.y     = (region_sigmoid(data[1] * dq) + cy) * stride_y;
+					box.w     = anchors[2*b]   * expf(GetMin(data[2] * dq, 50.0f)) * stride_x;
+					box.h     = anchors[2*b+1] * expf(GetMin(data[3] * dq, 50.0f)) * stride_y;
+					boxes.push_back(box);
+				}
+			}
+		}
+
+	}
+
+	return 0;
+}
+
+// One line per box : frame, class, score, then center and size of the box in pixels
+void LayerRegion::write_boxes(FILE* F, const std::vector<RegionBox>& boxes) const {
+	for(auto& box : boxes) {
+		fprintf(F, "%u %u %.4f %.1f %.1f %.1f %.1f\n", box.frame, box.cls, box.score, box.x, box.y, box.w, box.h);
+	}
+}
+
+int LayerRegion::swexec(int* bufin, int* bufout, unsigned f, layer_t* outlayer) {
+	std::vector<RegionBox> boxes;
+	int z = decode(outlayer, bufin, 1, outlayer->out_nbframes * outlayer->out_fsize, f, boxes);
+	if(z != 0) return z;
+	write_boxes(Fo, boxes);
+	return 0;
+}
+
+//============================================
+// Activity statistics
+//============================================
+
+// Accumulators for one layer
+typedef struct swexec_activity_layer_t {
+	uint64_t values = 0;
+	uint64_t zd = 0;       // Data=0
+	uint64_t nzd_zw = 0;   // Data!=0 and weight=0, summed over all neurons
+	uint64_t toggles = 0;  // Bits that toggle between consecutive values of the input stream
+	int      prev = 0;
+	// Neuron layers : for each input position, the number of neurons that have weight=0
+	std::vector<unsigned> zw_nb;
+} swexec_activity_layer_t;
+
+class SwexecActivity {
+	public :
+	std::map<Layer*, swexec_activity_layer_t> layers;
+};
+
+static void swexec_activity_collect(layer_t* layer, const int* bufin) {
+	auto iter = layer->network->swexec_activity->layers.find(layer);
+	if(iter == layer->network->swexec_activity->layers.end()) return;
+	auto& acc = iter->second;
+
+	unsigned mask = uint_genmask(layer->wdata);
+	unsigned values_nb = layer->nbframes * layer->fsize;
+	bool with_weights = (acc.zw_nb.empty() == false);
+
+	for(unsigned i=0; i<values_nb; i++) {
+		int v = bufin[i];
+		acc.zd += (v == 0);
+		acc.toggles += __builtin_popcount((unsigned)(v ^ acc.prev) & mask);
+		acc.prev = v;
+		if(v != 0 && with_weights == true) acc.nzd_zw += acc.zw_nb[i % layer->fsize];
+	}
+	acc.values += values_nb;
+}
+
+// Return zero if outlayer has not been reached yet, a negative value on error
 int swexec_series_of_layers(layer_t* inlayer, layer_t* outlayer, int* bufin, int* bufout, unsigned f) {
 
 	// Process all layers in series
@@ -767,8 +914,9 @@ int swexec_series_of_layers(layer_t* inlayer, layer_t* outlayer, int* bufin, int
 		}
 
 		// Print input data
-		if(param_noout==false && layer==outlayer && swexec_gen_in==true) {
-			swexec_print(Fo, layer, bufin, bufout, f);
+		if((param_noout==false || layer->network->swexec_capture != NULL) && layer==outlayer && layer->network->swexec_opt_gen_in==true) {
+			int z = swexec_print(Fo, layer, bufin, bufout, f);
+			if(z != 0) return -1;
 			// Output layer is reached, stop calculation for this frame
 			return 1;
 		}
@@ -777,8 +925,27 @@ int swexec_series_of_layers(layer_t* inlayer, layer_t* outlayer, int* bufin, int
 			printf("Warning : Layer %s%u has output width %u, this is not handled in SW execution\n", layer->typenameu, layer->typeidx, layer->out_wdata);
 		}
 
+		// Observe the input data
+		if(layer->network->swexec_activity != NULL) {
+			swexec_activity_collect(layer, bufin);
+		}
+
+		int64_t time_beg = 0;
+		int64_t time_cumul_beg = 0;
+		if(layer->network->swexec_time != NULL) {
+			time_cumul_beg = layer->network->swexec_time_cumul;
+			time_beg = Time64_GetReal();
+		}
+
 		// Layer-specific processing
 		int res = layer->swexec(bufin, bufout, f, outlayer);
+
+		// Layers FORK and SCATTER process their branches recursively, the time of branches is not counted twice
+		if(layer->network->swexec_time != NULL) {
+			int64_t time_self = Time64_GetReal() - time_beg - (layer->network->swexec_time_cumul - time_cumul_beg);
+			(*layer->network->swexec_time)[layer->index] += time_self;
+			layer->network->swexec_time_cumul += time_self;
+		}
 		if(res != 0) return res;
 
 		// Optionally apply the constraint on output width
@@ -806,7 +973,7 @@ int swexec_series_of_layers(layer_t* inlayer, layer_t* outlayer, int* bufin, int
 			bufout[i] = v2;
 			num_resized += (v2 != v);
 		}
-		if(num_resized > 0) {
+		if(num_resized > 0 && layer->network->swexec_opt_quiet == false) {
 			printf("Info : Layer %s%u : Resizing output to %u bits did affect %u values\n", layer->typenameu, layer->typeidx, layer->out_wdata, num_resized);
 		}
 		#endif
@@ -814,8 +981,9 @@ int swexec_series_of_layers(layer_t* inlayer, layer_t* outlayer, int* bufin, int
 		// Print results
 		// FIXME If the layer to print is in predecessors of a CAT, some branches will be executed even if not used
 		//   Potential solution ? Create an array of layers with only the necessary layers in it
-		if(param_noout==false && layer==outlayer) {
-			swexec_print(Fo, layer, bufin, bufout, f);
+		if((param_noout==false || layer->network->swexec_capture != NULL) && layer==outlayer) {
+			int z = swexec_print(Fo, layer, bufin, bufout, f);
+			if(z != 0) return -1;
 			// Output layer is reached, stop calculation for this frame
 			return 1;
 		}
@@ -830,63 +998,14 @@ int swexec_series_of_layers(layer_t* inlayer, layer_t* outlayer, int* bufin, int
 	return 0;
 }
 
-int swexec(Network* network, layer_t* outlayer) {
+// Allocate the buffers for frame-by-frame execution
+// The configuration data of layers must have been loaded already
+// All the state is stored in the network, so different networks can be executed concurrently
+int swexec_begin(Network* network, bool mode_tcam, bool gen_in) {
 	auto& layers = network->layers;
 
-	unsigned frames = param_fn;
-	if(frames==0) {
-		printf("Error: frames = %u\n", frames);
-		exit(EXIT_FAILURE);
-	}
-
-	if(outlayer==NULL) outlayer = network->layer_last;
-
-	// Load configuration data
-	int z = network->load_config_files();
-	if(z != 0) return 1;
-
-	// Load frame data
-	layer_t* firstlayer = network->layer_first;
-	int **dataframes = array_create_dim2(frames, firstlayer->fsize);
-	if(filename_frames!=NULL) {
-		int z = loadfile(dataframes, filename_frames, frames, firstlayer->fsize, param_multiline);
-		if(z != 0) return 1;
-		unsigned num_exceed = array_check_data_width(dataframes, frames, 0, firstlayer->fsize, firstlayer->wdata, firstlayer->sdata);
-		if(num_exceed > 0) {
-			printf("Warning: Some values from frame inputs exceed the hardware capacity (%u values)\n", num_exceed);
-		}
-	}
-	else {
-		if(param_rand_given==false) {
-			printf("Error: No file is specified for input frames\n");
-			return 1;
-		}
-		array_fillrand_dim2(dataframes, frames, firstlayer->fsize, firstlayer->wdata, param_rand_min, param_rand_max);
-	}
-	#if 0
-	// If needed, reorder image data
-	if(firstlayer->fx > 1 || firstlayer->fy > 1) {
-		if(param_debug==true) {
-			printf("INFO: Reordering data inside input frames...\n");
-		}
-		unsigned fx = firstlayer->fx;
-		unsigned fy = firstlayer->fy;
-		unsigned fz = firstlayer->fz;
-		// Reorder
-		reorder_to_zfirst_dim2(dataframes, frames, firstlayer->fsize, fx, fy, fz, 0);
-	}
-	#endif
-	#if 0  // For debug: print frame data
-	for(unsigned f=0; f<frames; f++) {
-		if(Fo==stdout) printf("FRAME %u: ", f);
-		for(unsigned i=0; i<firstlayer->fsize; i++) {
-			if(i > 0) fprintf(Fo, ",");
-			fprintf(Fo, "%i", dataframes[f][i]);
-		}
-		fprintf(Fo, "\n");
-	}
-	fprintf(Fo, "\n");
-	#endif
+	network->swexec_opt_tcam = mode_tcam;
+	network->swexec_opt_gen_in = gen_in;
 
 	// Allocate per-layer storage of output data
 	unsigned max_fsize = 0;
@@ -907,22 +1026,21 @@ int swexec(Network* network, layer_t* outlayer) {
 	}
 
 	// List the CAT layers to ease reset of counters between frames
-	layer_t* layers_cat[layers_cat_nb];
-	if(layers_cat_nb > 0) {
-		layers_cat_nb = 0;
-		for(auto layer : layers) {
-			if(layer->prev_is_arr == true) layers_cat[layers_cat_nb++] = layer;
-		}
+	network->swexec_layers_cat.clear();
+	network->swexec_layers_cat.reserve(layers_cat_nb);
+	for(auto layer : layers) {
+		if(layer->prev_is_arr == true) network->swexec_layers_cat.push_back(layer);
 	}
 
 	// Allocate shared data buffers to be used ping-pong way
-	int* bufin  = (int*)malloc(max_fsize * sizeof(*bufin));
-	int* bufout = (int*)malloc(max_fsize * sizeof(*bufout));
+	network->swexec_bufin  = (int*)malloc(max_fsize * sizeof(*network->swexec_bufin));
+	network->swexec_bufout = (int*)malloc(max_fsize * sizeof(*network->swexec_bufout));
 
 	// Under TCAM-approximations, pre-compute recoding arrays
-	recode_tcam_style = NULL;
-	if(swexec_mode_tcam==true) {
-		recode_tcam_style = (int**)calloc(100, sizeof(*recode_tcam_style));
+	network->swexec_recode_tcam = NULL;
+	if(mode_tcam==true) {
+		int** recode_tcam_style = (int**)calloc(100, sizeof(*recode_tcam_style));
+		network->swexec_recode_tcam = recode_tcam_style;
 		// Scan all neuron layers
 		for(auto layer : layers) {
 			if(layer->type!=LAYER_NEU) continue;
@@ -952,24 +1070,33 @@ int swexec(Network* network, layer_t* outlayer) {
 		}  // Scan all neuron layers
 	}
 
-	printf("INFO: Processing.......\n");
+	return 0;
+}
 
-	for(unsigned f=0; f<frames; f++) {
+// Execute one frame until the output layer is reached
+// If the output buffer is not NULL, results are copied there instead of being printed
+int swexec_oneframe(Network* network, layer_t* outlayer, const int* frame, int* out, unsigned f) {
+	if(outlayer==NULL) outlayer = network->layer_last;
 
-		// Get the frame data
+	// Get the frame data
+	memcpy(network->swexec_bufin, frame, network->layer_first->fsize * sizeof(*network->swexec_bufin));
 
-		memcpy(bufin, dataframes[f], firstlayer->fsize * sizeof(*bufin));
+	// Reset counters of CAT layers
+	for(auto layer : network->swexec_layers_cat) {
+		layer->cat_cnt_fwd_propag = 0;
+	}
 
-		// Reset counters of CAT layers
-		for(unsigned i=0; i<layers_cat_nb; i++) {
-			layer_t* layer = layers_cat[i];
-			layer->cat_cnt_fwd_propag = 0;
-		}
+	// Process all layers from the first one
+	network->swexec_capture = out;
+	int z = swexec_series_of_layers(network->layer_first, outlayer, network->swexec_bufin, network->swexec_bufout, f);
+	network->swexec_capture = NULL;
 
-		// Process all layers from the first one
-		swexec_series_of_layers(network->layer_first, outlayer, bufin, bufout, f);
+	return (z < 0) ? z : 0;
+}
 
-	}  // Loop on frames
+// Free the buffers for frame-by-frame execution
+void swexec_end(Network* network) {
+	auto& layers = network->layers;
 
 	// Clean per-layer buffers
 	for(auto layer : layers) {
@@ -980,10 +1107,218 @@ int swexec(Network* network, layer_t* outlayer) {
 	}
 
 	// Clean shared buffers
-	free(bufin);
-	free(bufout);
+	FreeNull(network->swexec_bufin);
+	FreeNull(network->swexec_bufout);
+	network->swexec_layers_cat.clear();
+
+	// Clean recoding arrays of TCAM-approximations
+	if(network->swexec_recode_tcam != NULL) {
+		for(unsigned i=0; i<100; i++) free(network->swexec_recode_tcam[i]);
+		FreeNull(network->swexec_recode_tcam);
+	}
+}
+
+// Load the input frames from the file of frames, or generate random frames
+// Return NULL on error
+int** swexec_load_frames(Network* network, unsigned frames) {
+	layer_t* firstlayer = network->layer_first;
+	int **dataframes = array_create_dim2(frames, firstlayer->fsize);
+	if(filename_frames!=NULL) {
+		int z = loadfile(dataframes, filename_frames, frames, firstlayer->fsize, param_multiline);
+		if(z != 0) return NULL;
+		unsigned num_exceed = array_check_data_width(dataframes, frames, 0, firstlayer->fsize, firstlayer->wdata, firstlayer->sdata);
+		if(num_exceed > 0) {
+			printf("Warning: Some values from frame inputs exceed the hardware capacity (%u values)\n", num_exceed);
+		}
+	}
+	else {
+		if(param_rand_given==false) {
+			printf("Error: No file is specified for input frames\n");
+			return NULL;
+		}
+		array_fillrand_dim2(dataframes, frames, firstlayer->fsize, firstlayer->wdata, param_rand_min, param_rand_max);
+	}
+	return dataframes;
+}
+
+int swexec(Network* network, layer_t* outlayer) {
+
+	unsigned frames = param_fn;
+	if(frames==0) {
+		printf("Error: frames = %u\n", frames);
+		exit(EXIT_FAILURE);
+	}
+
+	if(outlayer==NULL) outlayer = network->layer_last;
+
+	// Load configuration data
+	int z = network->load_config_files();
+	if(z != 0) return 1;
+
+	// Load frame data
+	int **dataframes = swexec_load_frames(network, frames);
+	if(dataframes == NULL) return 1;
+	#if 0
+	layer_t* firstlayer = network->layer_first;
+	// If needed, reorder image data
+	if(firstlayer->fx > 1 || firstlayer->fy > 1) {
+		if(param_debug==true) {
+			printf("INFO: Reordering data inside input frames...\n");
+		}
+		unsigned fx = firstlayer->fx;
+		unsigned fy = firstlayer->fy;
+		unsigned fz = firstlayer->fz;
+		// Reorder
+		reorder_to_zfirst_dim2(dataframes, frames, firstlayer->fsize, fx, fy, fz, 0);
+	}
+	#endif
+	#if 0  // For debug: print frame data
+	for(unsigned f=0; f<frames; f++) {
+		if(Fo==stdout) printf("FRAME %u: ", f);
+		for(unsigned i=0; i<firstlayer->fsize; i++) {
+			if(i > 0) fprintf(Fo, ",");
+			fprintf(Fo, "%i", dataframes[f][i]);
+		}
+		fprintf(Fo, "\n");
+	}
+	fprintf(Fo, "\n");
+	#endif
+
+	z = swexec_begin(network);
+	if(z != 0) return 1;
+
+	printf("INFO: Processing.......\n");
+
+	// Stop at the first frame that can't be processed
+	int zf = 0;
+	for(unsigned f=0; f<frames; f++) {
+		zf = swexec_oneframe(network, outlayer, dataframes[f], NULL, f);
+		if(zf != 0) break;
+	}  // Loop on frames
+
+	// Flush the results
+	if(swexec_outwr.IsActive() == true) {
+		z = swexec_outwr.end();
+		if(z != 0) printf("Error: Failed to write the results\n");
+	}
+
+	swexec_end(network);
+
+	return (zf != 0) ? 1 : 0;
+}
+
+
+
+
+// Execute a sample of frames, the results are captured and dropped
+// This is used to collect statistics about the execution
+static int swexec_sample(Network* network, unsigned frames) {
+
+	int **dataframes = swexec_load_frames(network, frames);
+	if(dataframes == NULL) return 1;
+
+	int z = swexec_begin(network, false, false);
+	if(z == 0) {
+		layer_t* lastlayer = network->layer_last;
+		std::vector<int> out(GetMax(lastlayer->out_nbframes * lastlayer->out_fsize, lastlayer->nbframes * lastlayer->fsize));
+		for(unsigned f=0; f<frames; f++) {
+			swexec_oneframe(network, lastlayer, dataframes[f], out.data(), f);
+		}
+		swexec_end(network);
+	}
+
+	free(dataframes[0]);
+	free(dataframes);
+
+	return z;
+}
+
+// Measure the activity of layers on a sample of frames, to be used by energy estimations
+int swexec_activity(Network* network, unsigned frames) {
+
+	if(network->layers.empty()) {
+		printf("Error : The network is empty\n");
+		return 1;
+	}
+	if(frames == 0) frames = param_fn;
+	if(frames == 0) {
+		printf("Error: frames = %u\n", frames);
+		return 1;
+	}
+
+	// Load configuration data
+	int z = network->load_config_files();
+	if(z != 0) return 1;
+
+	// Initialize the accumulators
+	// The input of CAT layers is not in the shared buffer, these layers keep their statistics
+	SwexecActivity activity;
+	for(auto layer : network->layers) {
+		if(layer->prev_is_arr == true) continue;
+		auto& acc = activity.layers[layer];
+		if((layer->type == LAYER_NEU || layer->type == LAYER_NEU_CM) && layer->cfg_data != nullptr) {
+			acc.zw_nb.resize(layer->fsize, 0);
+			for(unsigned n=0; n<layer->neurons; n++) {
+				for(unsigned i=0; i<layer->fsize; i++) acc.zw_nb[i] += (layer->cfg_data[n][i] == 0);
+			}
+		}
+	}
+
+	network->swexec_activity = &activity;
+	z = swexec_sample(network, frames);
+	network->swexec_activity = nullptr;
+	if(z != 0) return 1;
+
+	// Save the statistics in the layers
+	printf("Activity on %u frames :\n", frames);
+	printf("  Layer      zero data   zero weight   toggle\n");
+	for(auto layer : network->layers) {
+		auto iter = activity.layers.find(layer);
+		if(iter == activity.layers.end()) continue;
+		auto& acc = iter->second;
+		if(acc.values == 0) continue;
+
+		layer->stat_zd = (double)acc.zd / acc.values;
+		if(acc.zw_nb.empty() == false) {
+			layer->stat_nzd_zw = (double)acc.nzd_zw / ((double)acc.values * layer->neurons);
+		}
+		layer->stat_toggle = (layer->wdata > 0) ? (double)acc.toggles / ((double)acc.values * layer->wdata) : 0;
+
+		char buf[32];
+		snprintf(buf, sizeof(buf), "%s%u", layer->typenamel, layer->typeidx);
+		printf("  %-8s     %6.2f%%", buf, 100 * layer->stat_zd);
+		if(acc.zw_nb.empty() == false) printf("       %6.2f%%", 100 * layer->stat_nzd_zw);
+		else printf("             -");
+		printf("   %6.2f%%\n", 100 * layer->stat_toggle);
+	}
 
 	return 0;
 }
 
+// Measure the execution time of each layer on a sample of frames
+// The times are cumulated over all frames, in the units of Time64_GetReal(), indexed with the layer index
+int swexec_layer_times(Network* network, unsigned frames, std::vector<int64_t>& times) {
+
+	if(network->layers.empty()) {
+		printf("Error : The network is empty\n");
+		return 1;
+	}
+	if(frames == 0) frames = param_fn;
+	if(frames == 0) {
+		printf("Error: frames = %u\n", frames);
+		return 1;
+	}
+
+	// Load configuration data
+	int z = network->load_config_files();
+	if(z != 0) return 1;
 
+	times.assign(network->layers.size(), 0);
+
+	network->swexec_time = &times;
+	network->swexec_time_cumul = 0;
+	z = swexec_sample(network, frames);
+	network->swexec_time = nullptr;
+
+	return z;
+}
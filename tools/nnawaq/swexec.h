@@ -12,6 +12,29 @@ extern double swexec_emulate_error_lin;
 // Function used internally
 int swexec_series_of_layers(layer_t* inlayer, layer_t* outlayer, int* bufin, int* bufout, unsigned f);
 
+// Frame-by-frame software execution
+// The execution options are given explicitly, or taken from the global parameters
+int  swexec_begin(Network* network, bool mode_tcam, bool gen_in);
+inline int swexec_begin(Network* network) { return swexec_begin(network, swexec_mode_tcam, swexec_gen_in); }
+int  swexec_oneframe(Network* network, layer_t* outlayer, const int* frame, int* out, unsigned f);
+void swexec_end(Network* network);
+
 // Software execution
 int swexec(Network* network, layer_t* outlayer);
 
+// Load the input frames from the file of frames, or generate random frames
+// The array is freed with free(dataframes[0]) then free(dataframes), NULL is returned on error
+int** swexec_load_frames(Network* network, unsigned frames);
+
+// Activity statistics measured by software execution, for energy estimations
+// The input data of each layer is observed on a sample of frames :
+// - the ratio of data=0, and for neuron layers the ratio of data!=0 and weight=0 over all multiplications
+// - the ratio of data bits that toggle between consecutive values of the input stream
+// The results are saved in the fields stat_zd, stat_nzd_zw and stat_toggle of layers
+// Zero frames means the number of frames of the global parameters
+int swexec_activity(Network* network, unsigned frames);
+
+// Execution time of each layer on a sample of frames, indexed with the layer index
+// Zero frames means the number of frames of the global parameters
+int swexec_layer_times(Network* network, unsigned frames, std::vector<int64_t>& times);
+
@@ -17,6 +17,14 @@ extern "C" {
 
 #include "nn_layers_utils.h"
 #include "hwacc_common.h"
+#include "hwacc_emu.h"
+#include "hwacc_trace.h"
+#include "hwacc_server.h"
+#include "nn_infer_server.h"
+#include "hwacc_wait.h"
+#include "hwacc_timing.h"
+#include "hwacc_fifomon.h"
+#include "nn_out_writer.h"
 #include "tcl_parser.h"
 
 #ifdef HAVE_RIFFA
@@ -29,6 +37,10 @@ extern "C" {
 
 #include "nn_hw_config.h"
 #include "nn_hwacc_config.h"
+#include "nn_explore.h"
+#include "nn_flowsim.h"
+#include "nn_roofline.h"
+#include "nn_tune_widths.h"
 #include "swexec.h"
 
 #ifndef LIMITED
@@ -672,6 +684,12 @@ static int nn_param_eq(const char* name, const char* val1, const char* val2, con
 		if(non_empty_nb != 1) return PARAM_WRONG_NB;
 		param_out_nl = atoi(val1);
 	}
+	else if(strcasecmp(name, "obin")==0) {
+		if(non_empty_nb != 1) return PARAM_WRONG_NB;
+		OutWriter::mode_type mode = OutWriter::GetModeVerbose(val1);
+		if(mode == (OutWriter::mode_type)-1) return PARAM_KO;
+		param_out_bin = mode;
+	}
 
 	// Options for VHDL generation
 
@@ -738,6 +756,12 @@ static int nn_param_eq(const char* name, const char* val1, const char* val2, con
 		if(b < 0) return PARAM_KO;
 		network->hwconfig_bram_opt_speed = b;
 	}
+	else if(strcasecmp(name, "mem_pack")==0) {
+		if(non_empty_nb != 1) return PARAM_WRONG_NB;
+		int b = str2bool(val1);
+		if(b < 0) return PARAM_KO;
+		network->hwconfig_mem_pack = b;
+	}
 	else if(strcasecmp(name, "round_near")==0) {
 		if(non_empty_nb != 1) return PARAM_WRONG_NB;
 		int b = str2bool(val1);
@@ -803,6 +827,11 @@ static int nn_param_eq(const char* name, const char* val1, const char* val2, con
 		if(non_empty_nb != 1) return PARAM_WRONG_NB;
 		param_bufsz_mb = atoi(val1);
 	}
+	else if(strcmp(name, "hw_fbufsz_auto")==0) {
+		if(non_empty_nb != 1) return PARAM_WRONG_NB;
+		int z = decodeparam_bufsz_auto(val1, &param_bufsz_auto, &param_bufsz_lat_us);
+		if(z != 0) return PARAM_KO;
+	}
 	else if(strcmp(name, "hw_freerun")==0) {
 		if(non_empty_nb != 1) return PARAM_WRONG_NB;
 		int b = str2bool(val1);
@@ -839,6 +868,55 @@ static int nn_param_eq(const char* name, const char* val1, const char* val2, con
 		if(b < 0) return PARAM_KO;
 		param_hw_blind = b;
 	}
+	else if(strcmp(name, "hw_lowlat")==0) {
+		if(non_empty_nb != 1) return PARAM_WRONG_NB;
+		int b = str2bool(val1);
+		if(b < 0) return PARAM_KO;
+		param_hw_lowlat = b;
+	}
+	else if(strcmp(name, "hw_hugepages")==0) {
+		if(non_empty_nb != 1) return PARAM_WRONG_NB;
+		int b = str2bool(val1);
+		if(b < 0) return PARAM_KO;
+		param_hw_hugepages = b;
+	}
+	else if(strcmp(name, "hw_wait")==0) {
+		if(non_empty_nb != 1) return PARAM_WRONG_NB;
+		HwAcc_Wait::mode_type mode = HwAcc_Wait::GetModeVerbose(val1);
+		if(mode == (HwAcc_Wait::mode_type)-1) return PARAM_KO;
+		param_hw_wait = mode;
+	}
+	else if(strcmp(name, "hw_hist")==0) {
+		if(non_empty_nb != 1) return PARAM_WRONG_NB;
+		int b = str2bool(val1);
+		if(b < 0) return PARAM_KO;
+		param_hw_hist = b;
+	}
+	else if(strcmp(name, "hw_hist_json")==0) {
+		if(non_empty_nb > 1) return PARAM_WRONG_NB;
+		param_hw_hist_json = (non_empty_nb == 1) ? strdup(val1) : NULL;
+	}
+	else if(strcmp(name, "hw_fifomon")==0) {
+		if(non_empty_nb != 1) return PARAM_WRONG_NB;
+		param_hw_fifomon_hz = atoi(val1);
+	}
+	else if(strcmp(name, "serve_batch_us")==0) {
+		if(non_empty_nb != 1) return PARAM_WRONG_NB;
+		param_serve_batch_us = atoi(val1);
+	}
+	else if(strcmp(name, "infer_mode")==0) {
+		if(non_empty_nb != 1) return PARAM_WRONG_NB;
+		if(strcmp(val1, "sw")==0) param_infer_mode = InferServer::MODE_SW;
+		else if(strcmp(val1, "hw")==0) param_infer_mode = InferServer::MODE_HW;
+		else {
+			printf("Error param %s: Unknown mode '%s'\n", name, val1);
+			return PARAM_KO;
+		}
+	}
+	else if(strcmp(name, "hw_fifomon_csv")==0) {
+		if(non_empty_nb > 1) return PARAM_WRONG_NB;
+		param_hw_fifomon_csv = (non_empty_nb == 1) ? strdup(val1) : NULL;
+	}
 
 	else if(strcasecmp(name, "swexec_err_lin")==0) {
 		if(non_empty_nb != 1) return PARAM_WRONG_NB;
@@ -850,6 +928,21 @@ static int nn_param_eq(const char* name, const char* val1, const char* val2, con
 		if(non_empty_nb != 1) return PARAM_WRONG_NB;
 		genvhdl_dump_dir = strdup(val1);
 	}
+	else if(strcasecmp(name, "vhdl_manifest")==0) {
+		if(non_empty_nb > 1) return PARAM_WRONG_NB;
+		if(genvhdl_manifest != NULL) free(genvhdl_manifest);
+		genvhdl_manifest = (non_empty_nb == 1) ? strdup(val1) : NULL;
+	}
+	else if(strcasecmp(name, "vhdl_threads")==0) {
+		if(non_empty_nb != 1) return PARAM_WRONG_NB;
+		genvhdl_threads = atoi(val1);
+	}
+	else if(strcasecmp(name, "vhdl_cst_memfile")==0) {
+		if(non_empty_nb != 1) return PARAM_WRONG_NB;
+		int b = str2bool(val1);
+		if(b < 0) return PARAM_KO;
+		genvhdl_cst_memfile = b;
+	}
 	#endif
 
 	else {
@@ -1135,6 +1228,10 @@ static int nn_layer_param_eq(layer_t* layer, const char* name, const char* val1,
 		if(non_empty_nb != 1) return PARAM_WRONG_NB;
 		layer->stat_nzd_zw = strtod_perc(val1);
 	}
+	else if(strcasecmp(name, "toggle")==0) {
+		if(non_empty_nb != 1) return PARAM_WRONG_NB;
+		layer->stat_toggle = strtod_perc(val1);
+	}
 
 	else {
 		printf("Error: Unknown parameter name '%s'\n", name);
@@ -1257,6 +1354,10 @@ static int nn_set_param_list(Tcl_Interp *interp, layer_t* layer, Tcl_Obj* obj) {
 		}
 	}
 
+	// Dirty tracking : global parameters may impact all layers
+	if(layer != NULL) layer->params_dirty = true;
+	else Network::GetSingleton()->cache_invalidate();
+
 	return TCL_OK;
 }
 
@@ -1576,8 +1677,8 @@ static int cb_nn_layer_set(ClientData clientData, Tcl_Interp *interp, int objc,
 		}
 	}
 
-	// Propagate other layer parameters from previous layer
-	propag_params_layer(network, layer);
+	// Propagate other layer parameters from previous layer, only to the layers impacted by the edits
+	network->propag_params_dirty();
 
 	if(fflush_after_callback == true) fflush(nullptr);
 
@@ -1814,6 +1915,299 @@ static int cb_nn_parin_with_tmux(ClientData clientData, Tcl_Interp *interp, int
 	return TCL_OK;
 }
 
+static int cb_nn_explore(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+	ExploreParams params;
+
+	for(int i=1; i < objc; i++) {
+		char* param = Tcl_GetString(objv[i]);
+		if(strcmp(param, "-apply") == 0) {
+			params.apply = true;
+			continue;
+		}
+		if(i + 1 >= objc) {
+			sprintf(errmsg, "%s - Missing value for argument %s", Tcl_GetString(objv[0]), param);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+		char* value = Tcl_GetString(objv[++i]);
+		if(strcmp(param, "-j") == 0) {
+			params.threads_nb = atoi(value);
+		}
+		else if(strcmp(param, "-parmax") == 0) {
+			params.par_max = atoi(value);
+		}
+		else if(strcmp(param, "-bram18") == 0) {
+			params.budget_bram18 = atoi(value);
+		}
+		else if(strcmp(param, "-uram") == 0) {
+			params.budget_uram = atoi(value);
+		}
+		else if(strcmp(param, "-luts") == 0) {
+			params.budget_luts = strtoul(value, NULL, 10);
+		}
+		else {
+			sprintf(errmsg, "%s - Unknown argument : %s", Tcl_GetString(objv[0]), param);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+	}
+
+	auto network = Network::GetSingleton();
+	int z = nn_explore(network, params);
+
+	if(fflush_after_callback == true) fflush(nullptr);
+
+	if(z != 0) return TCL_ERROR;
+	return TCL_OK;
+}
+
+static int cb_nn_flowsim(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+	auto network = Network::GetSingleton();
+	FlowSim flowsim(network);
+
+	for(int i=1; i < objc; i++) {
+		char* param = Tcl_GetString(objv[i]);
+		if(i + 1 >= objc) {
+			sprintf(errmsg, "%s - Missing value for argument %s", Tcl_GetString(objv[0]), param);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+		char* value = Tcl_GetString(objv[++i]);
+		if(strcmp(param, "-frames") == 0) {
+			flowsim.frames_nb = atoi(value);
+		}
+		else if(strcmp(param, "-fifo") == 0) {
+			flowsim.fifo_depth = atoi(value);
+		}
+		else if(strcmp(param, "-freq") == 0) {
+			flowsim.freq_mhz = atof(value);
+		}
+		else if(strcmp(param, "-maxcy") == 0) {
+			flowsim.cycles_max = strtoull(value, NULL, 10);
+		}
+		else {
+			sprintf(errmsg, "%s - Unknown argument : %s", Tcl_GetString(objv[0]), param);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+	}
+
+	int z = flowsim.run();
+	if(z == 0) flowsim.print();
+
+	if(fflush_after_callback == true) fflush(nullptr);
+
+	if(z != 0) return TCL_ERROR;
+	return TCL_OK;
+}
+
+static int cb_nn_size_fifos(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+	auto network = Network::GetSingleton();
+	bool use_sim = false;
+	unsigned frames_nb = 16;
+
+	for(int i=1; i < objc; i++) {
+		char* param = Tcl_GetString(objv[i]);
+		if(strcmp(param, "-sim") == 0) {
+			use_sim = true;
+			continue;
+		}
+		if(i + 1 >= objc) {
+			sprintf(errmsg, "%s - Missing value for argument %s", Tcl_GetString(objv[0]), param);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+		char* value = Tcl_GetString(objv[++i]);
+		if(strcmp(param, "-frames") == 0) {
+			frames_nb = atoi(value);
+		}
+		else {
+			sprintf(errmsg, "%s - Unknown argument : %s", Tcl_GetString(objv[0]), param);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+	}
+
+	int z = nn_size_fifos(network, use_sim, frames_nb);
+
+	if(fflush_after_callback == true) fflush(nullptr);
+
+	if(z != 0) return TCL_ERROR;
+	return TCL_OK;
+}
+
+static int cb_nn_roofline(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+	auto network = Network::GetSingleton();
+	RooflineParams params;
+
+	for(int i=1; i < objc; i++) {
+		char* param = Tcl_GetString(objv[i]);
+		if(strcmp(param, "-host") == 0) {
+			params.host = true;
+			continue;
+		}
+		if(i + 1 >= objc) {
+			sprintf(errmsg, "%s - Missing value for argument %s", Tcl_GetString(objv[0]), param);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+		char* value = Tcl_GetString(objv[++i]);
+		if(strcmp(param, "-freq") == 0) {
+			params.freq_mhz = atof(value);
+		}
+		else if(strcmp(param, "-iface") == 0) {
+			params.iface_width = atoi(value);
+		}
+		else if(strcmp(param, "-frames") == 0) {
+			params.frames_nb = atoi(value);
+		}
+		else {
+			sprintf(errmsg, "%s - Unknown argument : %s", Tcl_GetString(objv[0]), param);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+	}
+
+	int z = nn_roofline(network, params);
+
+	if(fflush_after_callback == true) fflush(nullptr);
+
+	if(z != 0) return TCL_ERROR;
+	return TCL_OK;
+}
+
+static int cb_nn_tune_widths(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+	TuneWidthsParams params;
+
+	for(int i=1; i < objc; i++) {
+		char* param = Tcl_GetString(objv[i]);
+		if(strcmp(param, "-apply") == 0) {
+			params.apply = true;
+			continue;
+		}
+		if(i + 1 >= objc) {
+			sprintf(errmsg, "%s - Missing value for argument %s", Tcl_GetString(objv[0]), param);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+		char* value = Tcl_GetString(objv[++i]);
+		if(strcmp(param, "-metric") == 0) {
+			int metric = nn_tune_widths_metric(value);
+			if(metric < 0) {
+				sprintf(errmsg, "%s - Unknown metric : %s", Tcl_GetString(objv[0]), value);
+				Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+				return TCL_ERROR;
+			}
+			params.metric = metric;
+		}
+		else if(strcmp(param, "-budget") == 0) {
+			params.budget = strtod_perc(value);
+		}
+		else if(strcmp(param, "-frames") == 0) {
+			params.frames_nb = atoi(value);
+		}
+		else if(strcmp(param, "-j") == 0) {
+			params.threads_nb = atoi(value);
+		}
+		else {
+			sprintf(errmsg, "%s - Unknown argument : %s", Tcl_GetString(objv[0]), param);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+	}
+
+	auto network = Network::GetSingleton();
+	int z = nn_tune_widths(network, params);
+
+	if(fflush_after_callback == true) fflush(nullptr);
+
+	if(z != 0) return TCL_ERROR;
+	return TCL_OK;
+}
+
+// Configure the decoding of YOLO region outputs, applied on the host after software execution and hardware execution
+static int cb_nn_region(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+	auto network = Network::GetSingleton();
+
+	if(objc == 2 && strcmp(Tcl_GetString(objv[1]), "-off") == 0) {
+		delete network->layer_region;
+		network->layer_region = nullptr;
+		if(fflush_after_callback == true) fflush(nullptr);
+		return TCL_OK;
+	}
+
+	// Work on a copy, so the current config is kept in case of error
+	LayerRegion region;
+	if(network->layer_region != nullptr) region = *network->layer_region;
+
+	for(int i=1; i < objc; i++) {
+		char* param = Tcl_GetString(objv[i]);
+		if(i + 1 >= objc) {
+			sprintf(errmsg, "%s - Missing value for argument %s", Tcl_GetString(objv[0]), param);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+		char* value = Tcl_GetString(objv[++i]);
+		if(strcmp(param, "-boxes") == 0) {
+			region.boxes_nb = atoi(value);
+		}
+		else if(strcmp(param, "-classes") == 0) {
+			region.classes_nb = atoi(value);
+		}
+		else if(strcmp(param, "-anchors") == 0) {
+			int list_nb = 0;
+			Tcl_Obj** list = NULL;
+			if(Tcl_ListObjGetElements(interp, objv[i], &list_nb, &list) == TCL_ERROR) return TCL_ERROR;
+			region.anchors.clear();
+			for(int k=0; k<list_nb; k++) {
+				double d = 0;
+				if(Tcl_GetDoubleFromObj(interp, list[k], &d) == TCL_ERROR) return TCL_ERROR;
+				region.anchors.push_back(d);
+			}
+		}
+		else if(strcmp(param, "-shift") == 0) {
+			region.shift = atoi(value);
+		}
+		else if(strcmp(param, "-scale") == 0) {
+			region.scale = atof(value);
+		}
+		else if(strcmp(param, "-img") == 0) {
+			region.img_size = atoi(value);
+		}
+		else if(strcmp(param, "-thresh") == 0) {
+			region.thresh = strtod_perc(value);
+		}
+		else {
+			sprintf(errmsg, "%s - Unknown argument : %s", Tcl_GetString(objv[0]), param);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+	}
+
+	if(region.boxes_nb == 0 || region.classes_nb == 0 || region.scale <= 0 || region.img_size == 0 || region.shift >= 32) {
+		sprintf(errmsg, "%s - Invalid parameters", Tcl_GetString(objv[0]));
+		Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+		return TCL_ERROR;
+	}
+	if(region.anchors.size() != 2 * region.boxes_nb) {
+		sprintf(errmsg, "%s - Got %u anchor values, expected %u for %u boxes", Tcl_GetString(objv[0]), (unsigned)region.anchors.size(), 2 * region.boxes_nb, region.boxes_nb);
+		Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+		return TCL_ERROR;
+	}
+
+	if(network->layer_region == nullptr) network->layer_region = new LayerRegion();
+	*network->layer_region = region;
+	network->layer_region->network = network;
+
+	printf("Region decoding : ");
+	network->layer_region->print_extra_details();
+	printf("\n");
+
+	if(fflush_after_callback == true) fflush(nullptr);
+
+	return TCL_OK;
+}
+
 static int cb_nn_swexec(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
 
 	auto network = Network::GetSingleton();
@@ -1825,6 +2219,86 @@ static int cb_nn_swexec(ClientData clientData, Tcl_Interp *interp, int objc, Tcl
 	return TCL_OK;
 }
 
+static int cb_nn_activity(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+	auto network = Network::GetSingleton();
+	unsigned frames_nb = 0;
+
+	for(int i=1; i < objc; i++) {
+		char* param = Tcl_GetString(objv[i]);
+		if(i + 1 >= objc) {
+			sprintf(errmsg, "%s - Missing value for argument %s", Tcl_GetString(objv[0]), param);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+		char* value = Tcl_GetString(objv[++i]);
+		if(strcmp(param, "-frames") == 0) {
+			frames_nb = atoi(value);
+		}
+		else {
+			sprintf(errmsg, "%s - Unknown argument : %s", Tcl_GetString(objv[0]), param);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+	}
+
+	int z = swexec_activity(network, frames_nb);
+
+	if(fflush_after_callback == true) fflush(nullptr);
+
+	if(z != 0) return TCL_ERROR;
+	return TCL_OK;
+}
+
+static int cb_nn_save_snapshot(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+	char* filename = nullptr;
+	bool with_cfg = false;
+
+	for(int j=1; j < objc; j++) {
+		char* str = Tcl_GetString(objv[j]);
+		if(strcmp(str, "-cfg") == 0) {
+			with_cfg = true;
+		}
+		else if(filename == nullptr) {
+			filename = str;
+		}
+		else {
+			sprintf(errmsg, "%s - Error unknown argument '%s'", Tcl_GetString(objv[0]), str);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+	}
+	if(filename == nullptr) {
+		sprintf(errmsg, "%s - Error missing file name", Tcl_GetString(objv[0]));
+		Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+		return TCL_ERROR;
+	}
+
+	auto network = Network::GetSingleton();
+	int z = network->snapshot_save(filename, with_cfg);
+	if(z != 0) return TCL_ERROR;
+
+	if(fflush_after_callback == true) fflush(nullptr);
+
+	return TCL_OK;
+}
+
+static int cb_nn_load_snapshot(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+
+	if (objc != 2) {
+		sprintf(errmsg, "%s - Expected argument is : <file>", Tcl_GetString(objv[0]));
+		Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+		return TCL_ERROR;
+	}
+
+	auto network = Network::GetSingleton();
+	int z = network->snapshot_load(Tcl_GetString(objv[1]));
+	if(z != 0) return TCL_ERROR;
+
+	if(fflush_after_callback == true) fflush(nullptr);
+
+	return TCL_OK;
+}
+
 #ifdef HAVE_RIFFA
 
 static int cb_nn_riffa_init(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
@@ -1852,8 +2326,47 @@ static int cb_nn_zynq7_init(ClientData clientData, Tcl_Interp *interp, int objc,
 	return TCL_OK;
 }
 
+static int cb_nn_zynq7_mock(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+	if(objc != 3) {
+		sprintf(errmsg, "%s - Error expected rates of RX and TX FIFOs, in words per us", Tcl_GetString(objv[0]));
+		Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+		return TCL_ERROR;
+	}
+	double rx_rate = atof(Tcl_GetString(objv[1]));
+	double tx_rate = atof(Tcl_GetString(objv[2]));
+	HwAcc_Common* hwacc = HwAcc_Zynq7::GetSingletonMock(rx_rate, tx_rate);
+	HwAcc_Common::CurrentHwAcc_Set(hwacc);
+	if(fflush_after_callback == true) fflush(nullptr);
+	return TCL_OK;
+}
+
+static int cb_nn_zynq7_bench(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+	if(objc != 2) {
+		sprintf(errmsg, "%s - Error expected the number of 32b words", Tcl_GetString(objv[0]));
+		Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+		return TCL_ERROR;
+	}
+	HwAcc_Zynq7* hwacc = dynamic_cast<HwAcc_Zynq7*>(HwAcc_Common::CurrentHwAcc_GetCheck());
+	if(hwacc == nullptr) {
+		sprintf(errmsg, "%s - Error the current hardware accelerator is not Zynq7", Tcl_GetString(objv[0]));
+		Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+		return TCL_ERROR;
+	}
+	hwacc->zynq7_bench(atoi(Tcl_GetString(objv[1])));
+	if(fflush_after_callback == true) fflush(nullptr);
+	return TCL_OK;
+}
+
 #endif  // ifdef HAVE_ZYNQ7
 
+static int cb_nn_emu_init(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+	auto network = Network::GetSingleton();
+	HwAcc_Common* hwacc = HwAcc_Emu::GetSingleton(network);
+	HwAcc_Common::CurrentHwAcc_Set(hwacc);
+	if(fflush_after_callback == true) fflush(nullptr);
+	return TCL_OK;
+}
+
 static int cb_nn_hwacc_init(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
 	HwAcc_Common* hwacc = nullptr;
 
@@ -1880,6 +2393,128 @@ static int cb_nn_hwacc_init(ClientData clientData, Tcl_Interp *interp, int objc,
 	return TCL_OK;
 }
 
+static int cb_nn_trace_record(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+	char* filename = nullptr;
+	bool full = false;
+
+	for(int j=1; j < objc; j++) {
+		char* str = Tcl_GetString(objv[j]);
+		if(strcmp(str, "-full") == 0) {
+			full = true;
+		}
+		else if(filename == nullptr) {
+			filename = str;
+		}
+		else {
+			sprintf(errmsg, "%s - Error unknown argument '%s'", Tcl_GetString(objv[0]), str);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+	}
+	if(filename == nullptr) {
+		sprintf(errmsg, "%s - Error missing file name", Tcl_GetString(objv[0]));
+		Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+		return TCL_ERROR;
+	}
+
+	HwAcc_Common* inner = HwAcc_Common::CurrentHwAcc_GetCheck();
+	HwAcc_Common* hwacc = HwAcc_Record::OpenSingleton(inner, filename, full);
+	if(hwacc == nullptr) return TCL_ERROR;
+	HwAcc_Common::CurrentHwAcc_Set(hwacc);
+	if(fflush_after_callback == true) fflush(nullptr);
+	return TCL_OK;
+}
+
+static int cb_nn_trace_replay(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+	char* filename = nullptr;
+	bool timed = false;
+
+	for(int j=1; j < objc; j++) {
+		char* str = Tcl_GetString(objv[j]);
+		if(strcmp(str, "-timed") == 0) {
+			timed = true;
+		}
+		else if(filename == nullptr) {
+			filename = str;
+		}
+		else {
+			sprintf(errmsg, "%s - Error unknown argument '%s'", Tcl_GetString(objv[0]), str);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+	}
+	if(filename == nullptr) {
+		sprintf(errmsg, "%s - Error missing file name", Tcl_GetString(objv[0]));
+		Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+		return TCL_ERROR;
+	}
+
+	HwAcc_Common* hwacc = HwAcc_Replay::OpenSingleton(filename, timed);
+	if(hwacc == nullptr) return TCL_ERROR;
+	HwAcc_Common::CurrentHwAcc_Set(hwacc);
+	if(fflush_after_callback == true) fflush(nullptr);
+	return TCL_OK;
+}
+
+static int cb_nn_serve(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+	if(objc != 2) {
+		sprintf(errmsg, "%s - Error usage : <socket>", Tcl_GetString(objv[0]));
+		Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+		return TCL_ERROR;
+	}
+
+	auto hwacc = HwAcc_Common::CurrentHwAcc_GetCheck();
+	auto network = Network::GetSingleton();
+	HwAcc_Server server(hwacc, network);
+	int z = server.serve(Tcl_GetString(objv[1]));
+
+	if(fflush_after_callback == true) fflush(nullptr);
+	return (z == 0) ? TCL_OK : TCL_ERROR;
+}
+
+static int cb_nn_infer_serve(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+	if(objc < 2 || objc > 3) {
+		sprintf(errmsg, "%s - Error usage : <socket|-> [-sw|-hw]", Tcl_GetString(objv[0]));
+		Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+		return TCL_ERROR;
+	}
+
+	auto network = Network::GetSingleton();
+	InferServer server(network);
+
+	// The engine is prepared by the server, after the redirection of messages when serving stdin
+	int mode = -1;
+	if(objc == 3) {
+		const char* str = Tcl_GetString(objv[2]);
+		if(strcmp(str, "-sw")==0) mode = InferServer::MODE_SW;
+		else if(strcmp(str, "-hw")==0) mode = InferServer::MODE_HW;
+		else {
+			sprintf(errmsg, "%s - Error : Unknown option '%s'", Tcl_GetString(objv[0]), str);
+			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+			return TCL_ERROR;
+		}
+	}
+
+	int z = server.serve(Tcl_GetString(objv[1]), mode);
+
+	if(fflush_after_callback == true) fflush(nullptr);
+	return (z == 0) ? TCL_OK : TCL_ERROR;
+}
+
+static int cb_nn_hwacc_client(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
+	if(objc != 2) {
+		sprintf(errmsg, "%s - Error usage : <socket>", Tcl_GetString(objv[0]));
+		Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
+		return TCL_ERROR;
+	}
+
+	HwAcc_Common* hwacc = HwAcc_Client::OpenSingleton(Tcl_GetString(objv[1]));
+	if(hwacc == nullptr) return TCL_ERROR;
+	HwAcc_Common::CurrentHwAcc_Set(hwacc);
+	if(fflush_after_callback == true) fflush(nullptr);
+	return TCL_OK;
+}
+
 static int cb_nn_hwacc_clear(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
 	auto hwacc = HwAcc_Common::CurrentHwAcc_GetCheck();
 	hwacc->accreg_clear();
@@ -1905,8 +2540,9 @@ static int cb_nn_hwacc_fifoscan(ClientData clientData, Tcl_Interp *interp, int o
 
 static int cb_nn_hwacc_run(ClientData clientData, Tcl_Interp *interp, int objc, Tcl_Obj *const objv[]){
 
-	// Save global parameter
+	// Save global parameters
 	bool save_blind = param_hw_blind;
+	bool save_lowlat = param_hw_lowlat;
 
 	// Parse extra options
 	for(int j=1; j < objc; j++) {
@@ -1914,6 +2550,9 @@ static int cb_nn_hwacc_run(ClientData clientData, Tcl_Interp *interp, int objc,
 		if(strcmp(str, "-blind") == 0) {
 			param_hw_blind = true;
 		}
+		else if(strcmp(str, "-lowlat") == 0) {
+			param_hw_lowlat = true;
+		}
 		else {
 			sprintf(errmsg, "%s - Error unknown argument '%s'", Tcl_GetString(objv[0]), str);
 			Tcl_SetResult(interp, errmsg, TCL_VOLATILE);
@@ -1926,8 +2565,9 @@ static int cb_nn_hwacc_run(ClientData clientData, Tcl_Interp *interp, int objc,
 	auto network = Network::GetSingleton();
 	hwacc->run(network);
 
-	// Restore global parameter
+	// Restore global parameters
 	param_hw_blind = save_blind;
+	param_hw_lowlat = save_lowlat;
 
 	if(fflush_after_callback == true) fflush(nullptr);
 
@@ -1960,7 +2600,16 @@ static int tcl_add_commands(Tcl_Interp *interp) {
 	Tcl_CreateObjCommand(interp, "nn_autotmux",     cb_nn_autotmux, (ClientData) NULL, NULL);
 	Tcl_CreateObjCommand(interp, "nn_maxtmux",      cb_nn_maxtmux, (ClientData) NULL, NULL);
 	Tcl_CreateObjCommand(interp, "nn_maxparin",     cb_nn_parin_with_tmux, (ClientData) NULL, NULL);
+	Tcl_CreateObjCommand(interp, "nn_explore",      cb_nn_explore, (ClientData) NULL, NULL);
+	Tcl_CreateObjCommand(interp, "nn_flowsim",      cb_nn_flowsim, (ClientData) NULL, NULL);
+	Tcl_CreateObjCommand(interp, "nn_size_fifos",   cb_nn_size_fifos, (ClientData) NULL, NULL);
+	Tcl_CreateObjCommand(interp, "nn_roofline",     cb_nn_roofline, (ClientData) NULL, NULL);
+	Tcl_CreateObjCommand(interp, "nn_tune_widths",  cb_nn_tune_widths, (ClientData) NULL, NULL);
+	Tcl_CreateObjCommand(interp, "nn_region",       cb_nn_region, (ClientData) NULL, NULL);
 	Tcl_CreateObjCommand(interp, "nn_swexec",       cb_nn_swexec, (ClientData) NULL, NULL);
+	Tcl_CreateObjCommand(interp, "nn_activity",     cb_nn_activity, (ClientData) NULL, NULL);
+	Tcl_CreateObjCommand(interp, "nn_save_snapshot", cb_nn_save_snapshot, (ClientData) NULL, NULL);
+	Tcl_CreateObjCommand(interp, "nn_load_snapshot", cb_nn_load_snapshot, (ClientData) NULL, NULL);
 
 	#ifndef LIMITED
 	Tcl_CreateObjCommand(interp, "nn_layer_finalize_hw_config", cb_nn_layer_finalize_hw_config, (ClientData) NULL, NULL);
@@ -1980,8 +2629,17 @@ static int tcl_add_commands(Tcl_Interp *interp) {
 
 	#ifdef HAVE_ZYNQ7
 	Tcl_CreateObjCommand(interp, "nn_zynq7_init",    cb_nn_zynq7_init, (ClientData) NULL, NULL);
+	Tcl_CreateObjCommand(interp, "nn_zynq7_mock",    cb_nn_zynq7_mock, (ClientData) NULL, NULL);
+	Tcl_CreateObjCommand(interp, "nn_zynq7_bench",   cb_nn_zynq7_bench, (ClientData) NULL, NULL);
 	#endif
 
+	Tcl_CreateObjCommand(interp, "nn_emu_init",      cb_nn_emu_init, (ClientData) NULL, NULL);
+	Tcl_CreateObjCommand(interp, "nn_trace_record",  cb_nn_trace_record, (ClientData) NULL, NULL);
+	Tcl_CreateObjCommand(interp, "nn_trace_replay",  cb_nn_trace_replay, (ClientData) NULL, NULL);
+	Tcl_CreateObjCommand(interp, "nn_serve",         cb_nn_serve, (ClientData) NULL, NULL);
+	Tcl_CreateObjCommand(interp, "nn_infer_serve",   cb_nn_infer_serve, (ClientData) NULL, NULL);
+	Tcl_CreateObjCommand(interp, "nn_hwacc_client",  cb_nn_hwacc_client, (ClientData) NULL, NULL);
+
 	Tcl_CreateObjCommand(interp, "nn_hwacc_init",    cb_nn_hwacc_init, (ClientData) NULL, NULL);
 	Tcl_CreateObjCommand(interp, "nn_hwacc_clear",   cb_nn_hwacc_clear, (ClientData) NULL, NULL);
 	Tcl_CreateObjCommand(interp, "nn_hwacc_build",   cb_nn_hwacc_build, (ClientData) NULL, NULL);
@@ -2039,7 +2697,7 @@ int tcl_exec_line(const char* tcl_line) {
 	return 0;
 }
 
-int tcl_exec_file(const char* tcl_filename) {
+static int tcl_exec_file_internal(const char* tcl_filename, bool exit_on_error) {
 
 	if(interp == nullptr) {
 		fprintf(stderr, "Internal Error: TCL interpreter is not initialized\n");
@@ -2059,6 +2717,7 @@ int tcl_exec_file(const char* tcl_filename) {
 	int retcode = Tcl_EvalFile(interp, tcl_filename);
 	if(retcode == TCL_ERROR) {
 		fprintf(stderr, "Tcl_EvalFile error: %s\n", Tcl_GetStringResult(interp));
+		if(exit_on_error == false) return 1;
 		Tcl_Exit(EXIT_FAILURE);
 	}
 
@@ -2067,6 +2726,15 @@ int tcl_exec_file(const char* tcl_filename) {
 	return 0;
 }
 
+int tcl_exec_file(const char* tcl_filename) {
+	return tcl_exec_file_internal(tcl_filename, true);
+}
+
+// Same as tcl_exec_file(), but errors in the script are returned to the caller
+int tcl_eval_file(const char* tcl_filename) {
+	return tcl_exec_file_internal(tcl_filename, false);
+}
+
 int tcl_clear(void) {
 
 	// Free regexs if necessary
@@ -0,0 +1,35 @@
+#!./nnawaq -tcl
+
+# This TCL script is intended to be executed by the tool nnawaq
+
+# Input images : 32x32x3
+# Input data : 8b signed
+
+global env
+
+set par 1
+
+if {[info exists env(PAR)]} {
+	set par $env(PAR)
+}
+
+nn_set f=32/32/3
+nn_set in=8s
+
+# Create the network
+# Some frame sizes (27, 144, 32) have few divisors, so high parallelism levels reach their saturation
+nn_layer_create window win=3 step=1 pad=1 nwin=32x32
+nn_layer_create neuron neu=16
+nn_layer_create relu
+nn_layer_create window win=2x2 step=2x2 pad=0x0 nwin=16x16
+nn_layer_create maxpool
+nn_layer_create window win=3 step=1 pad=1 nwin=16x16
+nn_layer_create neuron neu=32
+nn_layer_create neuron neu=10
+
+# Apply the parallelism, the result must be legal for the hardware configuration
+nn_autopar $par
+nn_finalize_hw_config
+
+nn_print -cycles
+
@@ -10,6 +10,7 @@ global env
 set tm 1
 set pi 1
 set po 1
+set threads 1
 
 if {[info exists env(TM)]} {
 	set tm $env(TM)
@@ -20,6 +21,9 @@ if {[info exists env(PI)]} {
 if {[info exists env(PO)]} {
 	set po $env(PO)
 }
+if {[info exists env(THREADS)]} {
+	set threads $env(THREADS)
+}
 
 nn_set f=1/1/16
 nn_set fn=1
@@ -31,21 +35,26 @@ nn_set weights=8u
 # Default values for ReLU, just model a kind of crop for the sake of bit width
 nn_set relu=0/255
 
+# Number of threads for generation of the constant weights
+nn_set vhdl_threads=$threads
+
 # Create the network
 # Use a different number for fsize and neurons
 # Use phony neuron layers before and after to not being limited by interface widthes
-nn_layer_create neurons neu=16 paro=$pi
+# The last layer also has constant weights, so generation can be split across threads
+nn_layer_create neurons neu=16 par_out=$pi
 nn_layer_create relu
 nn_layer_create window win=1x1 step=1x1 pad=0x0 repeat=$tm
-nn_layer_create neurons neu=8 paro=$po weights_const=true tmux=$tm
+nn_layer_create neurons neu=8 par_out=$po const_params=true tmux=$tm
 nn_layer_create relu
-nn_layer_create neurons neu=8
+nn_layer_create neurons neu=8 const_params=true
 
 nn_print -cycles
 nn_finalize_hw_config
 
 # Assign config file
 nn_layer_set neu1 cfg=config_neu1.csv
+nn_layer_set neu2 cfg=config_neu2.csv
 
 # Generate the constant weights
 
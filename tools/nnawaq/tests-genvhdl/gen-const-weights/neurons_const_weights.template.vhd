@@ -1,5 +1,5 @@
 
-	-- AUTOGEN CONST WEIGHTS BEGIN
+	-- AUTOGEN CONST PARAMS BEGIN
 
 	-- This implementation is an example template to be replaced by custom IDs and data
 	gen : if LAYER_ID = 0 generate
@@ -14,5 +14,5 @@
 
 	end generate;
 
-	-- AUTOGEN CONST WEIGHTS END
+	-- AUTOGEN CONST PARAMS END
 
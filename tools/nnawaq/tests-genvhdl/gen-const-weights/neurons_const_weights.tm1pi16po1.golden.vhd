@@ -1,7 +1,9 @@
 
-	-- AUTOGEN CONST WEIGHTS BEGIN
+	-- AUTOGEN CONST PARAMS BEGIN
 
-	if LAYER_ID = 2 generate
+	gen : if LAYER_ID = 1 generate
+
+		-- Layer (null)
 
 		data_out <= (
 			-- Neuron 7
@@ -142,12 +144,99 @@
 			"00000000"
 		);
 
+	elsif LAYER_ID = 2 generate
+
+		-- Layer (null)
+
+		type mem_type is array (0 to 8-1) of std_logic_vector(WDATA*PAR_OUT-1 downto 0);
+		signal mem : mem_type := (
+			-- Frame position 0
+			"00111000" &
+			"00110000" &
+			"00101000" &
+			"00100000" &
+			"00011000" &
+			"00010000" &
+			"00001000" &
+			"00000000",
+			-- Frame position 1
+			"00111001" &
+			"00110001" &
+			"00101001" &
+			"00100001" &
+			"00011001" &
+			"00010001" &
+			"00001001" &
+			"00000001",
+			-- Frame position 2
+			"00111010" &
+			"00110010" &
+			"00101010" &
+			"00100010" &
+			"00011010" &
+			"00010010" &
+			"00001010" &
+			"00000010",
+			-- Frame position 3
+			"00111011" &
+			"00110011" &
+			"00101011" &
+			"00100011" &
+			"00011011" &
+			"00010011" &
+			"00001011" &
+			"00000011",
+			-- Frame position 4
+			"00111100" &
+			"00110100" &
+			"00101100" &
+			"00100100" &
+			"00011100" &
+			"00010100" &
+			"00001100" &
+			"00000100",
+			-- Frame position 5
+			"00111101" &
+			"00110101" &
+			"00101101" &
+			"00100101" &
+			"00011101" &
+			"00010101" &
+			"00001101" &
+			"00000101",
+			-- Frame position 6
+			"00111110" &
+			"00110110" &
+			"00101110" &
+			"00100110" &
+			"00011110" &
+			"00010110" &
+			"00001110" &
+			"00000110",
+			-- Frame position 7
+			"00111111" &
+			"00110111" &
+			"00101111" &
+			"00100111" &
+			"00011111" &
+			"00010111" &
+			"00001111" &
+			"00000111"
+		);
+
+		attribute ram_style : string;
+		attribute ram_style of mem : signal is "block";
+
+	begin
+
+		data_out <= mem(to_integer(unsigned(addr_in)));
+
 	else generate
 
-		-- Default assignement just in case
+		-- Default assignment just in case
 		data_out <= (others => '0');
 
 	end generate;
 
-	-- AUTOGEN CONST WEIGHTS END
+	-- AUTOGEN CONST PARAMS END
 
@@ -1,10 +1,12 @@
 
-	-- AUTOGEN CONST WEIGHTS BEGIN
+	-- AUTOGEN CONST PARAMS BEGIN
 
-	if LAYER_ID = 2 generate
+	gen : if LAYER_ID = 1 generate
 
-		type memweight_type is array (0 to 16-1) of std_logic_vector(WDATA*PAR_OUT-1 downto 0);
-		signal memweight : memweight_type := (
+		-- Layer (null)
+
+		type mem_type is array (0 to 4-1) of std_logic_vector(WDATA*PAR_OUT-1 downto 0);
+		signal mem : mem_type := (
 			-- Frame position 0
 			-- Neurons 3 mod PAR_OUT=4
 			-- Neuron 7
@@ -188,18 +190,115 @@
 		);
 
 		attribute ram_style : string;
-		attribute ram_style of memweight : signal is "distributed";
+		attribute ram_style of mem : signal is "block";
+
+	begin
+
+		data_out <= mem(to_integer(unsigned(addr_in)));
+
+	elsif LAYER_ID = 2 generate
+
+		-- Layer (null)
+
+		type mem_type is array (0 to 2-1) of std_logic_vector(WDATA*PAR_OUT-1 downto 0);
+		signal mem : mem_type := (
+			-- Frame position 0
+			-- Neuron 7
+			"00111011" &
+			"00111010" &
+			"00111001" &
+			"00111000" &
+			-- Neuron 6
+			"00110011" &
+			"00110010" &
+			"00110001" &
+			"00110000" &
+			-- Neuron 5
+			"00101011" &
+			"00101010" &
+			"00101001" &
+			"00101000" &
+			-- Neuron 4
+			"00100011" &
+			"00100010" &
+			"00100001" &
+			"00100000" &
+			-- Neuron 3
+			"00011011" &
+			"00011010" &
+			"00011001" &
+			"00011000" &
+			-- Neuron 2
+			"00010011" &
+			"00010010" &
+			"00010001" &
+			"00010000" &
+			-- Neuron 1
+			"00001011" &
+			"00001010" &
+			"00001001" &
+			"00001000" &
+			-- Neuron 0
+			"00000011" &
+			"00000010" &
+			"00000001" &
+			"00000000",
+			-- Frame position 4
+			-- Neuron 7
+			"00111111" &
+			"00111110" &
+			"00111101" &
+			"00111100" &
+			-- Neuron 6
+			"00110111" &
+			"00110110" &
+			"00110101" &
+			"00110100" &
+			-- Neuron 5
+			"00101111" &
+			"00101110" &
+			"00101101" &
+			"00101100" &
+			-- Neuron 4
+			"00100111" &
+			"00100110" &
+			"00100101" &
+			"00100100" &
+			-- Neuron 3
+			"00011111" &
+			"00011110" &
+			"00011101" &
+			"00011100" &
+			-- Neuron 2
+			"00010111" &
+			"00010110" &
+			"00010101" &
+			"00010100" &
+			-- Neuron 1
+			"00001111" &
+			"00001110" &
+			"00001101" &
+			"00001100" &
+			-- Neuron 0
+			"00000111" &
+			"00000110" &
+			"00000101" &
+			"00000100"
+		);
+
+		attribute ram_style : string;
+		attribute ram_style of mem : signal is "block";
 
 	begin
 
-		data_out <= memweight(to_integer(unsigned(addr_in)));
+		data_out <= mem(to_integer(unsigned(addr_in)));
 
 	else generate
 
-		-- Default assignement just in case
+		-- Default assignment just in case
 		data_out <= (others => '0');
 
 	end generate;
 
-	-- AUTOGEN CONST WEIGHTS END
+	-- AUTOGEN CONST PARAMS END
 
@@ -0,0 +1,43 @@
+#!./nnawaq -tcl
+
+# This TCL script is intended to be executed by the tool nnawaq
+
+# Input images : 2x2x7, for 1 box of 2 classes per grid cell
+# Input data : 12b signed
+
+global env
+
+nn_set f=2/2/7
+nn_set fn=2
+nn_set inpar=1
+
+nn_set in=12s
+
+# Create the network
+nn_layer_create fifo
+nn_layer_create fifo
+
+nn_print -cycles
+nn_finalize_hw_config
+
+# Decoding of the outputs of the last layer
+# Boxes are rejected from the raw objectness value, or from the score of the most probable class
+nn_region -boxes 1 -classes 2 -anchors {1.5 2.0} -shift 4 -img 64 -thresh 0.5
+
+# Set input frames
+nn_set frames=$env(TESTPREFIX)frames.csv
+
+# Run
+
+nn_set floop=1 ml=1
+nn_set fn=2
+nn_set o=$env(TESTPREFIX)output.csv
+
+nn_swexec
+
+# The outputs of an intermediate layer are not decoded
+
+nn_set ol=fifo0
+nn_set o=$env(TESTPREFIX)output_raw.csv
+
+nn_swexec
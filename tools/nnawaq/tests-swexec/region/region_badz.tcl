@@ -0,0 +1,33 @@
+#!./nnawaq -tcl
+
+# This TCL script is intended to be executed by the tool nnawaq
+
+# Input images : 2x2x7, this does not match the 2 boxes of 2 classes per grid cell expected by the decoding
+# Input data : 12b signed
+
+global env
+
+nn_set f=2/2/7
+nn_set fn=2
+nn_set inpar=1
+
+nn_set in=12s
+
+# Create the network
+nn_layer_create fifo
+
+nn_print -cycles
+nn_finalize_hw_config
+
+nn_region -boxes 2 -classes 2 -anchors {1.5 2.0 1.0 1.0} -shift 4 -img 64 -thresh 0.5
+
+# Set input frames
+nn_set frames=$env(TESTPREFIX)frames.csv
+
+# Run, this must fail
+
+nn_set floop=1 ml=1
+nn_set fn=2
+nn_set o=$env(TESTPREFIX)output_badz.csv
+
+nn_swexec
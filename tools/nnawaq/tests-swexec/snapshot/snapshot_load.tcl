@@ -0,0 +1,19 @@
+#!./nnawaq -tcl
+
+# This TCL script is intended to be executed by the tool nnawaq
+
+global env
+
+# The network and its configuration data come from the snapshot only
+nn_load_snapshot $env(TESTPREFIX)net.snap
+
+# Set input frames
+nn_set frames=$env(TESTPREFIX)frames.csv
+
+# Run
+
+nn_set floop=1 ml=1
+nn_set fn=4
+nn_set o=$env(TESTPREFIX)output_snap.csv
+
+nn_swexec
@@ -0,0 +1,38 @@
+#!./nnawaq -tcl
+
+# This TCL script is intended to be executed by the tool nnawaq
+
+# Input images : 1x1x16
+# Input data : 8b signed
+
+global env
+
+nn_set f=1/1/16
+nn_set fn=1
+nn_set inpar=1
+
+nn_set in=8s
+nn_set weights=4s
+
+# Create the network
+nn_layer_create neurons neu=6
+
+nn_print -cycles
+nn_finalize_hw_config
+
+# Assign config file, a copy that is removed before the snapshot is loaded
+nn_layer_set neu0 cfg=$env(TESTPREFIX)config_tmp.csv
+
+# Save the snapshot with the configuration data, which is not loaded yet
+nn_save_snapshot $env(TESTPREFIX)net.snap -cfg
+
+# Set input frames
+nn_set frames=$env(TESTPREFIX)frames.csv
+
+# Run
+
+nn_set floop=1 ml=1
+nn_set fn=4
+nn_set o=$env(TESTPREFIX)output.csv
+
+nn_swexec
@@ -0,0 +1,31 @@
+#!./nnawaq -tcl
+
+# This TCL script is intended to be executed by the tool nnawaq
+
+# Input images : 4x4x3
+# Input data : 8b signed
+
+global env
+
+nn_set f=4/4/3
+nn_set fn=1
+nn_set in=8s
+
+# Create the network
+nn_layer_create window win=2 step=2
+nn_layer_create maxpool
+
+nn_print -cycles
+nn_finalize_hw_config
+
+# Set input frames
+nn_set frames=$env(TESTPREFIX)frames.csv
+
+nn_set floop=1 ml=1
+nn_set fn=8
+
+# Run on the recorded trace, no accelerator is needed
+nn_trace_replay $env(TESTPREFIX)trace.bin
+nn_set o=$env(TESTPREFIX)output_rep.csv
+nn_hwacc_run -blind
+
@@ -0,0 +1,44 @@
+#!./nnawaq -tcl
+
+# This TCL script is intended to be executed by the tool nnawaq
+
+# Input images : 1x1x16
+# Input data : 8b signed
+
+global env
+
+# Output mode : none (text), 8, 16, 32 or nnf
+set obin none
+
+if {[info exists env(OBIN)]} {
+	set obin $env(OBIN)
+}
+
+nn_set f=1/1/16
+nn_set fn=1
+nn_set inpar=1
+
+nn_set in=8s
+nn_set weights=4s
+
+# Create the network
+nn_layer_create neurons neu=6
+
+nn_print -cycles
+nn_finalize_hw_config
+
+# Assign config file
+nn_layer_set neu0 cfg=$env(TESTPREFIX)config_neu0.csv
+
+# Set input frames
+nn_set frames=$env(TESTPREFIX)frames.csv
+
+# Run
+
+nn_set floop=1 ml=1
+nn_set fn=4
+nn_set obin=$obin
+nn_set o=$env(TESTPREFIX)output_$obin.out
+
+nn_swexec
+